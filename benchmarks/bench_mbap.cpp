@@ -0,0 +1,341 @@
+//****************************************************************************/
+//! @file bench_mbap.cpp
+//! @brief Microbenchmarks of the modbus application. Drives
+//!        mbap_ProcessRequest() for every function code across request sizes
+//!        and for exception paths. Reports ns/op, bytes/sec and, where
+//!        perf_event_open is allowed, instructions, cycles and cache misses
+//!        per op.
+//****************************************************************************/
+#include <benchmark/benchmark.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+extern "C"
+{
+    #include "mbap_conf.h"
+    #include "mbap.h"
+}
+
+#define BUFF_SIZE_IN_BYTES          (260u)
+#define MBAP_HEADER_LEN             (7u)
+#define DEVICE_ID                   (1u)
+#define BENCH_REGISTERS             (256u)
+#define BENCH_BITS                  (2048u)
+
+static int16_t m_asRegisters[BENCH_REGISTERS];
+static int16_t m_asLowerLimit[BENCH_REGISTERS];
+static int16_t m_asHigherLimit[BENCH_REGISTERS];
+static uint8_t m_aucBits[BENCH_BITS / 8u];
+
+//user functions copying from and into plain buffers, cost of engine dominates
+static void ReadRegisters(uint16_t usStartAddress, uint16_t usNumOfData, uint8_t *pucRecBuf)
+{
+    memcpy(pucRecBuf, &m_asRegisters[usStartAddress], usNumOfData * 2u);
+}
+
+static void WriteRegisters(uint16_t usStartAddress, uint16_t usNumOfData, const uint8_t *pucWriteBuf)
+{
+    memcpy(&m_asRegisters[usStartAddress], pucWriteBuf, usNumOfData * 2u);
+}
+
+static void ReadBits(uint16_t usStartAddress, int16_t sNumOfData, uint8_t *pucRecBuf)
+{
+    memcpy(pucRecBuf, &m_aucBits[usStartAddress / 8u], (sNumOfData + 7u) / 8u);
+}
+
+static void WriteBits(uint16_t usStartAddress, int16_t sNumOfData, const uint8_t *pucWriteBuf)
+{
+    memcpy(&m_aucBits[usStartAddress / 8u], pucWriteBuf, (sNumOfData + 7u) / 8u);
+}
+
+//! @brief Hardware counters of calling thread, not available in most containers
+class PerfCounters
+{
+public:
+    PerfCounters()
+    {
+#ifdef __linux__
+        static const uint64_t aullConfig[NUM_OF_COUNTERS] =
+        {
+            PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES
+        };
+
+        for (int iCount = 0; iCount < NUM_OF_COUNTERS; iCount++)
+        {
+            struct perf_event_attr tAttr;
+
+            memset(&tAttr, 0, sizeof(tAttr));
+            tAttr.size           = sizeof(tAttr);
+            tAttr.type           = PERF_TYPE_HARDWARE;
+            tAttr.config         = aullConfig[iCount];
+            tAttr.disabled       = 1;
+            tAttr.exclude_kernel = 1;
+            tAttr.exclude_hv     = 1;
+            m_aiFd[iCount] = (int)syscall(__NR_perf_event_open, &tAttr, 0, -1, -1, 0);
+        }
+#endif
+    }
+
+    ~PerfCounters()
+    {
+        for (int iCount = 0; iCount < NUM_OF_COUNTERS; iCount++)
+        {
+            if (m_aiFd[iCount] >= 0)
+            {
+                close(m_aiFd[iCount]);
+            }
+        }
+    }
+
+    void Start()
+    {
+#ifdef __linux__
+        for (int iCount = 0; iCount < NUM_OF_COUNTERS; iCount++)
+        {
+            if (m_aiFd[iCount] >= 0)
+            {
+                ioctl(m_aiFd[iCount], PERF_EVENT_IOC_RESET, 0);
+                ioctl(m_aiFd[iCount], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    //! @brief Stop counting and report counts per iteration
+    void Stop(benchmark::State &tState)
+    {
+#ifdef __linux__
+        static const char *apcName[NUM_OF_COUNTERS] = {"instructions", "cycles", "cache_misses"};
+
+        for (int iCount = 0; iCount < NUM_OF_COUNTERS; iCount++)
+        {
+            uint64_t ullValue = 0;
+
+            if (m_aiFd[iCount] < 0)
+            {
+                continue;
+            }
+
+            ioctl(m_aiFd[iCount], PERF_EVENT_IOC_DISABLE, 0);
+
+            if (sizeof(ullValue) == read(m_aiFd[iCount], &ullValue, sizeof(ullValue)))
+            {
+                tState.counters[apcName[iCount]] = benchmark::Counter((double)ullValue,
+                                                                      benchmark::Counter::kAvgIterations);
+            }
+        }
+#else
+        (void)tState;
+#endif
+    }
+
+private:
+    enum { NUM_OF_COUNTERS = 3 };
+    int m_aiFd[NUM_OF_COUNTERS] = {-1, -1, -1};
+};
+
+//! @brief Register user functions of a unit large enough for all benchmark sizes
+static void InitData(void)
+{
+    static bool   bIsInit = false;
+    ModbusData_t  tModbusData;
+
+    if (bIsInit)
+    {
+        return;
+    }
+
+    for (uint16_t usCount = 0; usCount < BENCH_REGISTERS; usCount++)
+    {
+        m_asLowerLimit[usCount]  = INT16_MIN;
+        m_asHigherLimit[usCount] = INT16_MAX;
+    }
+
+    memset(&tModbusData, 0, sizeof(tModbusData));
+    tModbusData.usMaxInputRegisters          = BENCH_REGISTERS;
+    tModbusData.usMaxHoldingRegisters        = BENCH_REGISTERS;
+    tModbusData.usMaxDiscreteInputs          = BENCH_BITS;
+    tModbusData.usMaxCoils                   = BENCH_BITS;
+    tModbusData.psHoldingRegisterLowerLimit  = m_asLowerLimit;
+    tModbusData.psHoldingRegisterHigherLimit = m_asHigherLimit;
+    tModbusData.ptfnReadInputRegisters       = ReadRegisters;
+    tModbusData.ptfnReadHoldingRegisters     = ReadRegisters;
+    tModbusData.ptfnWriteHoldingRegisters    = WriteRegisters;
+    tModbusData.ptfnReadDiscreteInputs       = ReadBits;
+    tModbusData.ptfnReadCoils                = ReadBits;
+    tModbusData.ptfnWriteCoils               = WriteBits;
+
+    mbap_DataInit(tModbusData);
+    bIsInit = true;
+}
+
+//! @brief Build query with MBAP header
+//! @return Query length
+static uint16_t BuildQuery(uint8_t *pucQuery, uint8_t ucUnitId, uint8_t ucFunctionCode,
+                           uint16_t usAddress, uint16_t usValue, uint8_t ucNumOfBytes)
+{
+    uint16_t usPduLen = 5u;
+
+    memset(pucQuery, 0, BUFF_SIZE_IN_BYTES);
+    pucQuery[1]  = 1;
+    pucQuery[6]  = ucUnitId;
+    pucQuery[7]  = ucFunctionCode;
+    pucQuery[8]  = (uint8_t)(usAddress >> 8);
+    pucQuery[9]  = (uint8_t)usAddress;
+    pucQuery[10] = (uint8_t)(usValue >> 8);
+    pucQuery[11] = (uint8_t)usValue;
+
+    if (0 != ucNumOfBytes)
+    {
+        //multiple write, byte count and data follow
+        pucQuery[12] = ucNumOfBytes;
+        usPduLen    += 1u + ucNumOfBytes;
+    }
+
+    //length counts unit id and pdu
+    pucQuery[4] = (uint8_t)((usPduLen + 1u) >> 8);
+    pucQuery[5] = (uint8_t)(usPduLen + 1u);
+
+    return (uint16_t)(MBAP_HEADER_LEN + usPduLen);
+}
+
+//! @brief Process one query repeatedly
+static void RunQuery(benchmark::State &tState, const uint8_t *pucQuery, uint16_t usQueryLen)
+{
+    uint8_t      aucResponse[BUFF_SIZE_IN_BYTES];
+    uint16_t     usResponseLen = 0;
+    PerfCounters tCounters;
+
+    tCounters.Start();
+
+    for (auto _ : tState)
+    {
+        usResponseLen = mbap_ProcessRequest(pucQuery, (uint8_t)usQueryLen, aucResponse);
+        benchmark::DoNotOptimize(aucResponse);
+    }
+
+    tCounters.Stop(tState);
+    tState.SetBytesProcessed((int64_t)tState.iterations() * (usQueryLen + usResponseLen));
+    tState.counters["response_len"] = usResponseLen;
+}
+
+static void BM_ReadCoils(benchmark::State &tState)
+{
+    uint8_t aucQuery[BUFF_SIZE_IN_BYTES];
+
+    InitData();
+    RunQuery(tState, aucQuery, BuildQuery(aucQuery, DEVICE_ID, 1, 0, (uint16_t)tState.range(0), 0));
+}
+BENCHMARK(BM_ReadCoils)->Arg(1)->Arg(64)->Arg(2000);
+
+static void BM_ReadDiscreteInputs(benchmark::State &tState)
+{
+    uint8_t aucQuery[BUFF_SIZE_IN_BYTES];
+
+    InitData();
+    RunQuery(tState, aucQuery, BuildQuery(aucQuery, DEVICE_ID, 2, 0, (uint16_t)tState.range(0), 0));
+}
+BENCHMARK(BM_ReadDiscreteInputs)->Arg(1)->Arg(64)->Arg(2000);
+
+static void BM_ReadHoldingRegisters(benchmark::State &tState)
+{
+    uint8_t aucQuery[BUFF_SIZE_IN_BYTES];
+
+    InitData();
+    RunQuery(tState, aucQuery, BuildQuery(aucQuery, DEVICE_ID, 3, 0, (uint16_t)tState.range(0), 0));
+}
+BENCHMARK(BM_ReadHoldingRegisters)->Arg(1)->Arg(16)->Arg(64)->Arg(125);
+
+static void BM_ReadInputRegisters(benchmark::State &tState)
+{
+    uint8_t aucQuery[BUFF_SIZE_IN_BYTES];
+
+    InitData();
+    RunQuery(tState, aucQuery, BuildQuery(aucQuery, DEVICE_ID, 4, 0, (uint16_t)tState.range(0), 0));
+}
+BENCHMARK(BM_ReadInputRegisters)->Arg(1)->Arg(16)->Arg(64)->Arg(125);
+
+static void BM_WriteSingleCoil(benchmark::State &tState)
+{
+    uint8_t aucQuery[BUFF_SIZE_IN_BYTES];
+
+    InitData();
+    RunQuery(tState, aucQuery, BuildQuery(aucQuery, DEVICE_ID, 5, 3, 0xFF00, 0));
+}
+BENCHMARK(BM_WriteSingleCoil);
+
+static void BM_WriteSingleRegister(benchmark::State &tState)
+{
+    uint8_t aucQuery[BUFF_SIZE_IN_BYTES];
+
+    InitData();
+    RunQuery(tState, aucQuery, BuildQuery(aucQuery, DEVICE_ID, 6, 3, 100, 0));
+}
+BENCHMARK(BM_WriteSingleRegister);
+
+//write multiple coils is limited to 1968 coils by protocol
+static void BM_WriteMultipleCoils(benchmark::State &tState)
+{
+    uint8_t  aucQuery[BUFF_SIZE_IN_BYTES];
+    uint16_t usNumOfCoils = (uint16_t)tState.range(0);
+
+    InitData();
+    RunQuery(tState, aucQuery, BuildQuery(aucQuery, DEVICE_ID, 15, 0, usNumOfCoils, (uint8_t)((usNumOfCoils + 7u) / 8u)));
+}
+BENCHMARK(BM_WriteMultipleCoils)->Arg(1)->Arg(64)->Arg(1968);
+
+//write multiple registers is limited to 123 registers by protocol
+static void BM_WriteMultipleRegisters(benchmark::State &tState)
+{
+    uint8_t  aucQuery[BUFF_SIZE_IN_BYTES];
+    uint16_t usNumOfRegs = (uint16_t)tState.range(0);
+
+    InitData();
+    RunQuery(tState, aucQuery, BuildQuery(aucQuery, DEVICE_ID, 16, 0, usNumOfRegs, (uint8_t)(usNumOfRegs * 2u)));
+}
+BENCHMARK(BM_WriteMultipleRegisters)->Arg(1)->Arg(16)->Arg(64)->Arg(123);
+
+static void BM_ExceptionIllegalFunction(benchmark::State &tState)
+{
+    uint8_t aucQuery[BUFF_SIZE_IN_BYTES];
+
+    InitData();
+    RunQuery(tState, aucQuery, BuildQuery(aucQuery, DEVICE_ID, 0x2B, 0, 1, 0));
+}
+BENCHMARK(BM_ExceptionIllegalFunction);
+
+static void BM_ExceptionIllegalAddress(benchmark::State &tState)
+{
+    uint8_t aucQuery[BUFF_SIZE_IN_BYTES];
+
+    InitData();
+    RunQuery(tState, aucQuery, BuildQuery(aucQuery, DEVICE_ID, 3, BENCH_REGISTERS, 1, 0));
+}
+BENCHMARK(BM_ExceptionIllegalAddress);
+
+static void BM_ExceptionIllegalValue(benchmark::State &tState)
+{
+    uint8_t aucQuery[BUFF_SIZE_IN_BYTES];
+
+    InitData();
+    RunQuery(tState, aucQuery, BuildQuery(aucQuery, DEVICE_ID, 3, 0, 0, 0));
+}
+BENCHMARK(BM_ExceptionIllegalValue);
+
+//unknown unit is not answered
+static void BM_UnknownUnit(benchmark::State &tState)
+{
+    uint8_t aucQuery[BUFF_SIZE_IN_BYTES];
+
+    InitData();
+    RunQuery(tState, aucQuery, BuildQuery(aucQuery, 77, 3, 0, 1, 0));
+}
+BENCHMARK(BM_UnknownUnit);
+
+BENCHMARK_MAIN();
@@ -19,7 +19,13 @@
 //user defined header files
 #include "mbap_conf.h"
 #include "mbap.h"
+#include "mbap_unit.h"
+#include "mbap_history.h"
+#include "mbap_change.h"
+#include "mbap_subscription.h"
 #include "mbap_debug.h"
+#include "mbap_hist.h"
+#include "mbap_stats.h"
 
 //****************************************************************************/
 //                           Defines and typedefs
@@ -63,6 +69,51 @@
 //Error Code(1 byte) + Exception Code(1 byte) = 2 bytes
 #define EXCEPTION_PACKET_LEN                        (MBAP_HEADER_LEN + 2u)
 #define MAX_PDU_LEN                                 (256u)
+//Largest response, response buffers of transport hold a Modbus TCP ADU
+#define MAX_ADU_LEN                                 (260u)
+//MBAP length counts bytes following length field
+#define MBAP_LEN_FIELD_END                          (6u)
+
+//Read History query: range and sequence of first sample
+#define HISTORY_RANGE_OFFSET                        (8u)
+#define HISTORY_SEQUENCE_OFFSET                     (9u)
+#define MBAP_LEN_READ_HISTORY_QUERY                 (7u)
+
+//Subscribe query: table, start address, number of data, deadband and interval
+#define SUBSCRIBE_TABLE_OFFSET                      (8u)
+#define SUBSCRIBE_START_ADDRESS_OFFSET              (9u)
+#define SUBSCRIBE_NUM_OF_DATA_OFFSET                (11u)
+#define SUBSCRIBE_DEADBAND_OFFSET                   (13u)
+#define SUBSCRIBE_INTERVAL_OFFSET                   (15u)
+#define MBAP_LEN_SUBSCRIBE_QUERY                    (11u)
+//Cancel Subscription query and response: subscription id
+#define SUBSCRIPTION_ID_OFFSET                      (8u)
+#define MBAP_LEN_CANCEL_SUBSCRIPTION_QUERY          (3u)
+#define CANCEL_SUBSCRIPTION_RESPONSE_LEN            (MBAP_HEADER_LEN + 2u)
+//Conditional Read query: table, start address, number of data and version of last read
+#define CONDITIONAL_READ_TABLE_OFFSET               (8u)
+#define CONDITIONAL_READ_START_ADDRESS_OFFSET       (9u)
+#define CONDITIONAL_READ_NUM_OF_DATA_OFFSET         (11u)
+#define CONDITIONAL_READ_VERSION_OFFSET             (13u)
+#define MBAP_LEN_CONDITIONAL_READ_QUERY             (11u)
+//Conditional Read response: version, byte count and data, function code only if unchanged
+#define CONDITIONAL_READ_RESPONSE_VERSION_OFFSET    (8u)
+#define CONDITIONAL_READ_BYTE_COUNT_OFFSET          (12u)
+#define CONDITIONAL_READ_DATA_OFFSET                (13u)
+#define CONDITIONAL_READ_UNCHANGED_RESPONSE_LEN     (MBAP_HEADER_LEN + 1u)
+#define CONDITIONAL_READ_MAX_REGISTERS              ((MAX_ADU_LEN - CONDITIONAL_READ_DATA_OFFSET) / 2u)
+#define CONDITIONAL_READ_MAX_BITS                   ((MAX_ADU_LEN - CONDITIONAL_READ_DATA_OFFSET) * 8u)
+//Read Multiple Ranges query: number of ranges and per range table, start address and number of data
+#define RANGES_NUM_OF_RANGES_OFFSET                 (8u)
+#define RANGES_DESCRIPTORS_OFFSET                   (9u)
+#define RANGE_DESCRIPTOR_LEN                        (5u)
+#define MAX_RANGES                                  (32u)
+//Unit Id(1 byte) + function code(1 byte) + number of ranges(1 byte) + descriptors
+#define MBAP_LEN_READ_MULTIPLE_RANGES_QUERY(ucNum)  (3u + (ucNum) * RANGE_DESCRIPTOR_LEN)
+//Read Multiple Ranges response: number of ranges and per range byte count and data
+#define RANGES_DATA_OFFSET                          (9u)
+//Read query built to validate a range of a table
+#define TABLE_RANGE_QUERY_LEN                       (12u)
 
 #define MULTIPLE_OF_8                               (0x0007)
 
@@ -87,108 +138,255 @@
 //****************************************************************************/
 //
 //! @brief Handle Modbus Request after function code data adddress validated successfully
-//! @param[in]    pucQuery         Pointer to modbus query buffer
-//! @param[out]   pucResponse      Pointer to modbus response buffer
-//! @return       uint16_t         ResponeLength
+//! @param[in]    ptRequest        Modbus request
+//! @return       uint16_t         ResponeLength, MBAP_RESPONSE_PENDING
 //
-static uint16_t HandleRequest(const uint8_t *pucQuery, uint8_t *pucResponse);
+static uint16_t HandleRequest(ModbusRequest_t *ptRequest);
 
 //
 //! @brief Validate function code and data address in modbus query
+//! @param[in]  ptData   Modbus data of unit addressed by query
 //! @param[in]  pucQuery Pointer to modbus query buffer
 //! @param[out] None
 //! @return     uint8_t 0 - NoException, nonzero - Exception
 //
-static uint8_t ValidateFunctionCodeAndDataAddress(const uint8_t *pucQuery);
+static uint8_t ValidateFunctionCodeAndDataAddress(const ModbusData_t *ptData, const uint8_t *pucQuery);
+
+#if FC_SUBSCRIBE_ENABLE || FC_CONDITIONAL_READ_ENABLE || FC_READ_MULTIPLE_RANGES_ENABLE
+//
+//! @brief Validate range of a table as a read query of it would be validated
+//! @param[in]  ptData       Modbus data of unit
+//! @param[in]  ucTable      Table(enum DataTable)
+//! @param[in]  usAddress    First data as addressed by query
+//! @param[in]  usNumOfData  Number of data
+//! @return     uint8_t      eNO_EXCEPTION or exception code for response
+//
+static uint8_t ValidateTableRange(const ModbusData_t *ptData, uint8_t ucTable, uint16_t usAddress, uint16_t usNumOfData);
+#endif//FC_SUBSCRIBE_ENABLE || FC_CONDITIONAL_READ_ENABLE || FC_READ_MULTIPLE_RANGES_ENABLE
+
+#if FC_READ_MULTIPLE_RANGES_ENABLE
+//
+//! @brief Validate ranges of Read Multiple Ranges query, each as a read query
+//!        of its table would be validated, and that data fits into response
+//! @param[in]  ptData    Modbus data of unit
+//! @param[in]  pucQuery  Pointer to modbus query buffer
+//! @return     uint8_t   eNO_EXCEPTION or exception code for response
+//
+static uint8_t ValidateRanges(const ModbusData_t *ptData, const uint8_t *pucQuery);
+#endif//FC_READ_MULTIPLE_RANGES_ENABLE
+
+#if FC_CONDITIONAL_READ_ENABLE || FC_READ_MULTIPLE_RANGES_ENABLE
+//
+//! @brief Start address of a table as addressed by queries
+//! @param[in]  ptData    Modbus data of unit
+//! @param[in]  ucTable   Table(enum DataTable)
+//! @return     uint16_t  Start address
+//
+static uint16_t TableStartAddress(const ModbusData_t *ptData, uint8_t ucTable);
+
+//
+//! @brief Bytes of data of a range in a read response
+//! @param[in]  ucTable      Table(enum DataTable)
+//! @param[in]  usNumOfData  Number of data
+//! @return     uint16_t     Byte count
+//
+static uint16_t TableByteCount(uint8_t ucTable, uint16_t usNumOfData);
+#endif//FC_CONDITIONAL_READ_ENABLE || FC_READ_MULTIPLE_RANGES_ENABLE
 
 //
 //! @brief Validate protocol id, uint id and pdu length
-//! @param[in] pucQuery Pointer to modbus query buffer
-//! @parm[out] None
-//! @return    bool true - Validation ok, false - Validate not ok
+//! @param[in]  pucQuery     Pointer to modbus query buffer
+//! @param[in]  usMaxPduLen  Largest MBAP length
+//! @param[in]  usExtKey     Extension key of unit
+//! @param[out] pptUnit      Unit addressed by query
+//! @return     bool true - Validation ok, false - Validate not ok
+//
+static bool BasicValidation(const uint8_t *pucQuery, uint16_t usMaxPduLen, uint16_t usExtKey, const ModbusUnit_t **pptUnit);
+
 //
-static bool BasicValidation(const uint8_t *pucQuery);
+//! @brief Validate that data of a write query is complete and that a read
+//!        response fits into response buffer of request
+//! @param[in]  ptRequest  Modbus request
+//! @return     uint8_t    eNO_EXCEPTION or exception code for response
+//
+static uint8_t ValidateDataLength(const ModbusRequest_t *ptRequest);
+
+//
+//! @brief Read data of a unit from user functions or copy-on-write image.
+//!        Response must be prepared before, user function may complete later.
+//! @param[in]   ptRequest       Modbus request
+//! @param[in]   ucTable         Data table
+//! @param[in]   usStartAddress  Start address relative to table start
+//! @param[in]   usNumOfData     Number of data
+//! @param[out]  pucRecBuf       Receive buffer
+//! @param[in]   usResponseLen   Response length if read succeeds
+//! @return      uint16_t        Response Length, MBAP_RESPONSE_PENDING
+//
+static uint16_t ReadUnitData(ModbusRequest_t *ptRequest,
+                             uint8_t ucTable,
+                             uint16_t usStartAddress,
+                             uint16_t usNumOfData,
+                             uint8_t *pucRecBuf,
+                             uint16_t usResponseLen);
+
+//
+//! @brief Write data of a unit into user functions or copy-on-write image.
+//!        Response must be prepared before, user function may complete later.
+//! @param[in]   ptRequest       Modbus request
+//! @param[in]   ucTable         eTABLE_COILS or eTABLE_HOLDING_REGISTERS
+//! @param[in]   usStartAddress  Start address relative to table start
+//! @param[in]   usNumOfData     Number of data
+//! @param[in]   pucWriteBuf     Write buffer
+//! @param[in]   usResponseLen   Response length if write succeeds
+//! @return      uint16_t        Response Length, MBAP_RESPONSE_PENDING
+//
+static uint16_t WriteUnitData(ModbusRequest_t *ptRequest,
+                              uint8_t ucTable,
+                              uint16_t usStartAddress,
+                              uint16_t usNumOfData,
+                              const uint8_t *pucWriteBuf,
+                              uint16_t usResponseLen);
+
+//
+//! @brief Start asynchronous user function if unit and request support it
+//! @param[in]   ptRequest       Modbus request
+//! @param[in]   usResponseLen   Response length if access succeeds
+//! @param[out]  pusResponseLen  Response Length, MBAP_RESPONSE_PENDING
+//! @return      bool            true - asynchronous function called, false - use synchronous functions
+//
+static bool StartAsyncAccess(ModbusRequest_t *ptRequest, uint16_t usResponseLen, uint16_t *pusResponseLen);
+
+//
+//! @brief Access data of request by profile image or synchronous user functions
+//! @param[in,out]  ptRequest  Modbus request
+//! @return         uint8_t    eNO_EXCEPTION or exception code for response
+//
+static uint8_t AccessData(ModbusRequest_t *ptRequest);
+
+//
+//! @brief Finish request after data access
+//! @param[in]   ptRequest       Modbus request
+//! @param[in]   ucException     Exception of data access
+//! @param[in]   usResponseLen   Response length if access succeeded
+//! @return      uint16_t        Response Length
+//
+static uint16_t FinishAccess(ModbusRequest_t *ptRequest, uint8_t ucException, uint16_t usResponseLen);
 
 #if FC_READ_COILS_ENABLE
 //
 //! @brief Read Coils from Modbus data
-//! @param[in]  pucQuery    Pointer to modbus query buffer
-//! @param[out] pucResponse Pointer to modbus response buffer
+//! @param[in]  ptRequest   Modbus request
 //! @return     uint16_t    Response Length
 //
-static uint16_t ReadCoils (const uint8_t *pucQuery, uint8_t *pucResponse);
+static uint16_t ReadCoils (ModbusRequest_t *ptRequest);
 #endif//FC_READ_COILS_ENABLE
 
 #if FC_READ_DISCRETE_INPUTS_ENABLE
 //
 //! @brief Read Discrete Inputs from Modbus data
-//! @param[in]   pucQuery   Pointer  to modbus query buffer
-//! @param[out]  pucResponse Pointer to modbus response buffer
+//! @param[in]   ptRequest  Modbus request
 //! @return      uint16_t    Response Length
 //
-static uint16_t ReadDiscreteInputs (const uint8_t *pucQuery, uint8_t *pucResponse);
+static uint16_t ReadDiscreteInputs (ModbusRequest_t *ptRequest);
 #endif//FC_READ_DISCRETE_INPUTS_ENABLE
 
 #if FC_READ_HOLDING_REGISTERS_ENABLE
 //
 //! @brief Read Holding Registers from Modbus data
-//! @param[in]   pucQuery   Pointer  to modbus query buffer
-//! @param[out]  pucResponse Pointer to modbus response buffer
+//! @param[in]   ptRequest  Modbus request
 //! @return      uint16_t    Response Length
 //
-static uint16_t ReadHoldingRegisters (const uint8_t *pucQuery, uint8_t *pucResponse);
+static uint16_t ReadHoldingRegisters (ModbusRequest_t *ptRequest);
 #endif//FC_READ_HOLDING_REGISTERS_ENABLE
 
 #if FC_READ_INPUT_REGISTERS_ENABLE
 //
 //! @brief Read Input Registers from Modbus data
-//! @param[in]   pucQuery   Pointer  to modbus query buffer
-//! @param[out]  pucResponse Pointer to modbus response buffer
+//! @param[in]   ptRequest  Modbus request
 //! @return      uint16_t    Response Length
 //
-static uint16_t ReadInputRegisters (const uint8_t *pucQuery, uint8_t *pucResponse);
+static uint16_t ReadInputRegisters (ModbusRequest_t *ptRequest);
 #endif//FC_READ_INPUT_REGISTERS_ENABLE
 
 #if FC_WRITE_COIL_ENABLE
 //
 //! @brief Read Write Single Coil into Modbus data
-//! @param[in]   pucQuery   Pointer  to modbus query buffer
-//! @param[out]  pucResponse Pointer to modbus response buffer
+//! @param[in]   ptRequest  Modbus request
 //! @return      uint16_t    Response Length
 //
-static uint16_t WriteSingleCoil (const uint8_t *pucQuery, uint8_t *pucResponse);
+static uint16_t WriteSingleCoil (ModbusRequest_t *ptRequest);
 #endif//FC_WRITE_COIL_ENABLE
 
 #if FC_WRITE_HOLDING_REGISTER_ENABLE
 //
 //! @brief Read Write Single Holding Register into Modbus data
-//! @param[in]   pucQuery   Pointer  to modbus query buffer
-//! @param[out]  pucResponse Pointer to modbus response buffer
+//! @param[in]   ptRequest  Modbus request
 //! @return      uint16_t    Response Length
 //
-static uint16_t WriteSingleHoldingRegister (const uint8_t *pucQuery, uint8_t *pucResponse);
+static uint16_t WriteSingleHoldingRegister (ModbusRequest_t *ptRequest);
 #endif//FC_WRITE_HOLDING_REGISTER_ENABLE
 
 #if FC_WRITE_COILS_ENABLE
 //
 //! @brief Read Write Multiple Coils into Modbus data
-//! @param[in]   pucQuery   Pointer  to modbus query buffer
-//! @param[out]  pucResponse Pointer to modbus response buffer
+//! @param[in]   ptRequest  Modbus request
 //! @return      uint16_t    Response Length
 //
-static uint16_t WriteMultipleCoils (const uint8_t *pucQuery, uint8_t *pucResponse);
+static uint16_t WriteMultipleCoils (ModbusRequest_t *ptRequest);
 #endif//FC_WRITE_COILS_ENABLE
 
 #if FC_WRITE_HOLDING_REGISTERS_ENABLE
 //
 //! @brief Read Write Multiple Holding Registers into Modbus data
-//! @param[in]   pucQuery   Pointer  to modbus query buffer
-//! @param[out]  pucResponse Pointer to modbus response buffer
+//! @param[in]   ptRequest  Modbus request
 //! @return      uint16_t    Response Length
 //
-static uint16_t WriteMultipleHoldingRegisters (const uint8_t *pucQuery, uint8_t *pucResponse);
+static uint16_t WriteMultipleHoldingRegisters (ModbusRequest_t *ptRequest);
 #endif//FC_WRITE_HOLDING_REGISTERS_ENABLE
 
+#if FC_READ_HISTORY_ENABLE
+//
+//! @brief Read samples of a history range
+//! @param[in]   ptRequest  Modbus request
+//! @return      uint16_t   Response Length
+//
+static uint16_t ReadHistory (ModbusRequest_t *ptRequest);
+#endif//FC_READ_HISTORY_ENABLE
+
+#if FC_SUBSCRIBE_ENABLE
+//
+//! @brief Subscribe to changes of a range, respond with its data
+//! @param[in]   ptRequest  Modbus request
+//! @return      uint16_t   Response Length
+//
+static uint16_t Subscribe (ModbusRequest_t *ptRequest);
+
+//
+//! @brief Cancel subscription of connection
+//! @param[in]   ptRequest  Modbus request
+//! @return      uint16_t   Response Length
+//
+static uint16_t CancelSubscription (ModbusRequest_t *ptRequest);
+#endif//FC_SUBSCRIBE_ENABLE
+
+#if FC_CONDITIONAL_READ_ENABLE
+//
+//! @brief Read range unless unchanged since version of query
+//! @param[in]   ptRequest  Modbus request
+//! @return      uint16_t   Response Length
+//
+static uint16_t ConditionalRead (ModbusRequest_t *ptRequest);
+#endif//FC_CONDITIONAL_READ_ENABLE
+
+#if FC_READ_MULTIPLE_RANGES_ENABLE
+//
+//! @brief Read ranges of several tables into one response
+//! @param[in]   ptRequest  Modbus request
+//! @return      uint16_t   Response Length
+//
+static uint16_t ReadMultipleRanges (ModbusRequest_t *ptRequest);
+#endif//FC_READ_MULTIPLE_RANGES_ENABLE
+
 //
 //! @brief Build Exception Packet
 //! @param[in]    pucQuery     Pointer to modbus query buffer
@@ -198,6 +396,13 @@ static uint16_t WriteMultipleHoldingRegisters (const uint8_t *pucQuery, uint8_t
 //
 static uint16_t BuildExceptionPacket (const uint8_t *pucQuery, uint8_t ucException, uint8_t *pucResponse);
 
+//
+//! @brief Check whether function code writes a table
+//! @param[in]    ucFunctionCode  Function code of query
+//! @return       bool            true - write function code
+//
+static bool IsWriteFunctionCode(uint8_t ucFunctionCode);
+
 //****************************************************************************/
 //                           external variables
 //****************************************************************************/
@@ -206,6 +411,8 @@ static uint16_t BuildExceptionPacket (const uint8_t *pucQuery, uint8_t ucExcepti
 //                           Private variables
 //****************************************************************************/
 static ModbusData_t m_tModbusData;
+//writes of clients are rejected for all units
+static bool         m_bReadOnly = false;
 
 //****************************************************************************/
 //                    G L O B A L  F U N C T I O N S
@@ -213,41 +420,254 @@ static ModbusData_t m_tModbusData;
 void mbap_DataInit(ModbusData_t tModbusData)
 {
     m_tModbusData = tModbusData;
+
+    //default unit is served by user functions, further units are added later
+    mbap_UnitInit();
+    (void)mbap_UnitAdd(0, DEVICE_ID, &m_tModbusData);
     MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Modbus tcp data intialised\r\n");
 
 }//end mbtcp_DataInit
 
+void mbap_SetReadOnly(bool bReadOnly)
+{
+    __atomic_store_n(&m_bReadOnly, bReadOnly, __ATOMIC_RELAXED);
+}//end mbap_SetReadOnly
+
 uint16_t mbap_ProcessRequest(const uint8_t *pucQuery, uint8_t ucQueryLen, uint8_t *pucResponse)
 {
-    uint16_t usResponseLen = 0;
-    uint8_t  ucException   = 0;
-    bool     bIsQueryOk    = false;
+    return mbap_ProcessUnitRequest(0, pucQuery, ucQueryLen, pucResponse);
+}//end mbtcp_ProcessRequest
+
+uint16_t mbap_ProcessUnitRequest(uint16_t usExtKey,
+                                 const uint8_t *pucQuery,
+                                 uint8_t ucQueryLen,
+                                 uint8_t *pucResponse)
+{
+    ModbusRequest_t tRequest;
 
-    bIsQueryOk = BasicValidation(pucQuery);
+    //without completion function only synchronous user functions are used
+    memset(&tRequest, 0, sizeof(tRequest));
+    tRequest.pucQuery    = pucQuery;
+    tRequest.pucResponse = pucResponse;
+    tRequest.usQueryLen  = ucQueryLen;
+    tRequest.usExtKey    = usExtKey;
+
+    return mbap_SubmitRequest(&tRequest);
+}//end mbap_ProcessUnitRequest
+
+uint16_t mbap_SubmitRequest(ModbusRequest_t *ptRequest)
+{
+    const ModbusUnit_t *ptUnit        = NULL;
+    uint16_t           usResponseLen  = 0;
+    uint16_t           usMaxPduLen    = 0;
+    uint8_t            ucException    = 0;
+    bool               bIsQueryOk     = false;
+
+#if STATS_ENABLE
+    ptRequest->ullStartTime = mbap_StatsTime();
+#endif
+
+    MBT_PROBE_QUERY(request__start, ptRequest->ulConnectionId, ptRequest->pucQuery);
+
+    //extended framing allows MBAP length up to response buffer of transport
+    usMaxPduLen = (0 == ptRequest->usMaxAduLen) ? MAX_PDU_LEN : (uint16_t)(ptRequest->usMaxAduLen - MBAP_LEN_FIELD_END);
+    bIsQueryOk  = BasicValidation(ptRequest->pucQuery, usMaxPduLen, ptRequest->usExtKey, &ptUnit);
 
     //If Protocol Id, Pdu length or Unit Id validated sucessfully
     //Proceed for next validation steps
     if (bIsQueryOk)
     {
-        ucException = ValidateFunctionCodeAndDataAddress(pucQuery);
+        ptRequest->ptUnit = ptUnit;
+
+        //server is in wrong state for writes, e.g. standby
+        if (IsWriteFunctionCode(ptRequest->pucQuery[FUNCTION_CODE_OFFSET]) &&
+            __atomic_load_n(&m_bReadOnly, __ATOMIC_RELAXED))
+        {
+            ucException = eILLEGAL_FUNCTION_CODE;
+        }
+        else
+        {
+            ucException = ValidateFunctionCodeAndDataAddress(ptUnit->ptModbusData, ptRequest->pucQuery);
+        }
+
+        if (eNO_EXCEPTION == ucException)
+        {
+            ucException = ValidateDataLength(ptRequest);
+        }
 
         if (ucException)
         {
-            usResponseLen = BuildExceptionPacket(pucQuery, ucException, pucResponse);
+            MBT_PROBE_QUERY_RESULT(request__invalid, ptRequest->ulConnectionId, ptRequest->pucQuery, ucException);
+            usResponseLen = BuildExceptionPacket(ptRequest->pucQuery, ucException, ptRequest->pucResponse);
         }
         else
         {
-            usResponseLen = HandleRequest(pucQuery, pucResponse);
+            usResponseLen = HandleRequest(ptRequest);
         }
+    }
+    else
+    {
+        //no response, exception 0
+        MBT_PROBE_QUERY_RESULT(request__invalid, ptRequest->ulConnectionId, ptRequest->pucQuery, 0u);
     }//end if
 
+    //pending request owns response length until it is completed
+    if (MBAP_RESPONSE_PENDING != usResponseLen)
+    {
+        ptRequest->usResponseLen = usResponseLen;
+        MBT_PROBE_QUERY_RESULT(request__done, ptRequest->ulConnectionId, ptRequest->pucQuery, usResponseLen);
+#if STATS_ENABLE
+        mbap_StatsRecord(ptRequest);
+#endif
+    }
+
     return (usResponseLen);
-}//end mbtcp_ProcessRequest
+}//end mbap_SubmitRequest
+
+uint16_t mbap_RejectRequest(ModbusRequest_t *ptRequest, uint8_t ucException)
+{
+    ptRequest->usResponseLen = BuildExceptionPacket(ptRequest->pucQuery,
+                                                    ucException,
+                                                    ptRequest->pucResponse);
+
+#if STATS_ENABLE
+    //rejected before processing, counted without processing time
+    ptRequest->ullStartTime = 0;
+    mbap_StatsRecord(ptRequest);
+#endif
+
+    return ptRequest->usResponseLen;
+}//end mbap_RejectRequest
+
+uint8_t mbap_AccessRequestData(ModbusRequest_t *ptRequest)
+{
+    uint8_t ucException = eNO_EXCEPTION;
+
+    MBT_PROBE_QUERY(callback__start, ptRequest->ulConnectionId, ptRequest->pucQuery);
+    ucException = AccessData(ptRequest);
+    MBT_PROBE_QUERY_RESULT(callback__done, ptRequest->ulConnectionId, ptRequest->pucQuery, ucException);
+
+    return ucException;
+}//end mbap_AccessRequestData
+
+bool mbap_IsAsyncRange(const ModbusRequest_t *ptRequest)
+{
+    const ModbusData_t *ptData = ptRequest->ptUnit->ptModbusData;
+
+    if (NULL == ptData->ptfnAsyncAccess)
+    {
+        return false;
+    }
+
+    return (NULL == ptData->ptfnIsAsyncRange) || ptData->ptfnIsAsyncRange(ptRequest);
+}//end mbap_IsAsyncRange
+
+void mbap_CompleteRequest(ModbusRequest_t *ptRequest, uint8_t ucException)
+{
+    if (eNO_EXCEPTION != ucException)
+    {
+        ptRequest->usResponseLen = BuildExceptionPacket(ptRequest->pucQuery,
+                                                        ucException,
+                                                        ptRequest->pucResponse);
+    }
+    else if (ptRequest->bWrite)
+    {
+        //data is written before completion, subscribers see it with next poll
+        mbap_ChangeMark(ptRequest->ptUnit, ptRequest->ucTable, ptRequest->usStartAddress, ptRequest->usNumOfData);
+    }
+
+    MBT_PROBE_QUERY_RESULT(request__done, ptRequest->ulConnectionId, ptRequest->pucQuery, ptRequest->usResponseLen);
+
+#if STATS_ENABLE
+    //request may be reused as soon as it is done
+    mbap_StatsRecord(ptRequest);
+#endif
+
+    ptRequest->ptfnDone(ptRequest);
+}//end mbap_CompleteRequest
 
 /******************************************************************************
  *                           L O C A L  F U N C T I O N S
  *****************************************************************************/
-static bool BasicValidation(const uint8_t *pucQuery)
+static uint8_t AccessData(ModbusRequest_t *ptRequest)
+{
+    const ModbusUnit_t *ptUnit      = ptRequest->ptUnit;
+    const ModbusData_t *ptData      = ptUnit->ptModbusData;
+    uint8_t            ucTable      = ptRequest->ucTable;
+    bool               bWritten     = true;
+
+    if (NULL != ptUnit->ptProfile)
+    {
+        bool bIsBitTable = (eTABLE_COILS == ucTable) || (eTABLE_DISCRETE_INPUTS == ucTable);
+
+        if (!ptRequest->bWrite && bIsBitTable)
+        {
+            mbap_UnitReadBits(ptUnit, ucTable, ptRequest->usStartAddress,
+                              ptRequest->usNumOfData, ptRequest->pucReadData);
+        }
+        else if (!ptRequest->bWrite)
+        {
+            mbap_UnitReadRegisters(ptUnit, ucTable, ptRequest->usStartAddress,
+                                   ptRequest->usNumOfData, ptRequest->pucReadData);
+        }
+        else if (bIsBitTable)
+        {
+            bWritten = mbap_UnitWriteBits(ptUnit, ucTable, ptRequest->usStartAddress,
+                                          ptRequest->usNumOfData, ptRequest->pucWriteData);
+        }
+        else
+        {
+            bWritten = mbap_UnitWriteRegisters(ptUnit, ucTable, ptRequest->usStartAddress,
+                                               ptRequest->usNumOfData, ptRequest->pucWriteData);
+        }
+
+        return bWritten ? eNO_EXCEPTION : eSERVER_DEVICE_FAILURE;
+    }
+
+    if (ptRequest->bWrite)
+    {
+        if (eTABLE_COILS == ucTable)
+        {
+            ptData->ptfnWriteCoils(ptRequest->usStartAddress,
+                                   (int16_t)ptRequest->usNumOfData,
+                                   ptRequest->pucWriteData);
+        }
+        else
+        {
+            ptData->ptfnWriteHoldingRegisters(ptRequest->usStartAddress,
+                                              ptRequest->usNumOfData,
+                                              ptRequest->pucWriteData);
+        }
+
+        return eNO_EXCEPTION;
+    }
+
+    switch (ucTable)
+    {
+    case eTABLE_COILS:
+        ptData->ptfnReadCoils(ptRequest->usStartAddress, (int16_t)ptRequest->usNumOfData, ptRequest->pucReadData);
+        break;
+
+    case eTABLE_DISCRETE_INPUTS:
+        ptData->ptfnReadDiscreteInputs(ptRequest->usStartAddress, (int16_t)ptRequest->usNumOfData, ptRequest->pucReadData);
+        break;
+
+    case eTABLE_HOLDING_REGISTERS:
+        ptData->ptfnReadHoldingRegisters(ptRequest->usStartAddress, ptRequest->usNumOfData, ptRequest->pucReadData);
+        break;
+
+    case eTABLE_INPUT_REGISTERS:
+        ptData->ptfnReadInputRegisters(ptRequest->usStartAddress, ptRequest->usNumOfData, ptRequest->pucReadData);
+        break;
+
+    default:
+        break;
+    }//end switch
+
+    return eNO_EXCEPTION;
+}//end AccessData
+
+static bool BasicValidation(const uint8_t *pucQuery, uint16_t usMaxPduLen, uint16_t usExtKey, const ModbusUnit_t **pptUnit)
 {
     uint16_t usProtocolId = 0;
     uint16_t usMbapLen    = 0;
@@ -265,27 +685,29 @@ static bool BasicValidation(const uint8_t *pucQuery)
     if (MBT_PROTOCOL_ID != usProtocolId)
     {
         bIsQueryOk = false;
-        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Wrong protocol id\r\n");
+        MBT_DEBUGF_ARGS(MBT_CONF_DEBUG_LEVEL_WARNING, "Wrong protocol id %u\r\n", usProtocolId, 0u);
     }
 
     //check if pdu length exceed
-    if (usMbapLen > MAX_PDU_LEN)
+    if (usMbapLen > usMaxPduLen)
     {
         bIsQueryOk = false;
-        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Pdu length exceeded\r\n");
+        MBT_DEBUGF_ARGS(MBT_CONF_DEBUG_LEVEL_WARNING, "Pdu length %u exceeded\r\n", usMbapLen, 0u);
     }
 
     //check for Unit Id
-    if (DEVICE_ID != ucUnitId)
+    *pptUnit = mbap_UnitFind(usExtKey, ucUnitId);
+
+    if (NULL == *pptUnit)
     {
         bIsQueryOk = false;
-        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Wrong device id\r\n");
+        MBT_DEBUGF_ARGS(MBT_CONF_DEBUG_LEVEL_WARNING, "Wrong device id %u, extension key %u\r\n", ucUnitId, usExtKey);
     }
 
     return (bIsQueryOk);
 }//end BasicValidation
 
-static uint8_t ValidateFunctionCodeAndDataAddress(const uint8_t *pucQuery)
+static uint8_t ValidateFunctionCodeAndDataAddress(const ModbusData_t *ptData, const uint8_t *pucQuery)
 {
     uint8_t  ucFunctionCode     = 0;
     uint16_t usDataStartAddress = 0;
@@ -303,8 +725,8 @@ static uint8_t ValidateFunctionCodeAndDataAddress(const uint8_t *pucQuery)
     {
 #if FC_READ_COILS_ENABLE
     case eFC_READ_COILS:
-        if (!((usDataStartAddress >= m_tModbusData.usCoilsStartAddress) &&
-             ((usDataStartAddress + usNumOfData) <= (m_tModbusData.usCoilsStartAddress + m_tModbusData.usMaxCoils))))
+        if (!((usDataStartAddress >= ptData->usCoilsStartAddress) &&
+             ((usDataStartAddress + usNumOfData) <= (ptData->usCoilsStartAddress + ptData->usMaxCoils))))
         {
             ucException = eILLEGAL_DATA_ADDRESS;
             MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal coil address\r\n");
@@ -314,8 +736,8 @@ static uint8_t ValidateFunctionCodeAndDataAddress(const uint8_t *pucQuery)
 
 #if FC_READ_DISCRETE_INPUTS_ENABLE
     case eFC_READ_DISCRETE_INPUTS:
-        if (!((usDataStartAddress >= m_tModbusData.usDiscreteInputStartAddress) &&
-             ((usDataStartAddress + usNumOfData) <= (m_tModbusData.usDiscreteInputStartAddress + m_tModbusData.usMaxDiscreteInputs))))
+        if (!((usDataStartAddress >= ptData->usDiscreteInputStartAddress) &&
+             ((usDataStartAddress + usNumOfData) <= (ptData->usDiscreteInputStartAddress + ptData->usMaxDiscreteInputs))))
         {
             ucException = eILLEGAL_DATA_ADDRESS;
             MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal discrete input address\r\n");
@@ -325,8 +747,8 @@ static uint8_t ValidateFunctionCodeAndDataAddress(const uint8_t *pucQuery)
 
 #if FC_READ_HOLDING_REGISTERS_ENABLE
     case eFC_READ_HOLDING_REGISTERS:
-        if (!((usDataStartAddress >= m_tModbusData.usHoldingRegisterStartAddress) &&
-             ((usDataStartAddress + usNumOfData) <= (m_tModbusData.usHoldingRegisterStartAddress + m_tModbusData.usMaxHoldingRegisters))))
+        if (!((usDataStartAddress >= ptData->usHoldingRegisterStartAddress) &&
+             ((usDataStartAddress + usNumOfData) <= (ptData->usHoldingRegisterStartAddress + ptData->usMaxHoldingRegisters))))
         {
             ucException = eILLEGAL_DATA_ADDRESS;
             MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal holding register address\r\n");
@@ -336,8 +758,8 @@ static uint8_t ValidateFunctionCodeAndDataAddress(const uint8_t *pucQuery)
 
 #if FC_READ_INPUT_REGISTERS_ENABLE
     case eFC_READ_INPUT_REGISTERS:
-        if (!((usDataStartAddress >= m_tModbusData.usInputRegisterStartAddress) &&
-             ((usDataStartAddress + usNumOfData) <= (m_tModbusData.usInputRegisterStartAddress + m_tModbusData.usMaxInputRegisters))))
+        if (!((usDataStartAddress >= ptData->usInputRegisterStartAddress) &&
+             ((usDataStartAddress + usNumOfData) <= (ptData->usInputRegisterStartAddress + ptData->usMaxInputRegisters))))
 
         {
             ucException = eILLEGAL_DATA_ADDRESS;
@@ -348,8 +770,8 @@ static uint8_t ValidateFunctionCodeAndDataAddress(const uint8_t *pucQuery)
 
 #if FC_WRITE_COIL_ENABLE
         case eFC_WRITE_COIL:
-            if (!((usDataStartAddress >= m_tModbusData.usCoilsStartAddress) &&
-                 (usDataStartAddress <= (m_tModbusData.usCoilsStartAddress + m_tModbusData.usMaxCoils))))
+            if (!((usDataStartAddress >= ptData->usCoilsStartAddress) &&
+                 (usDataStartAddress <= (ptData->usCoilsStartAddress + ptData->usMaxCoils))))
             {
                 ucException = eILLEGAL_DATA_ADDRESS;
                 MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal coil address\r\n");
@@ -359,8 +781,8 @@ static uint8_t ValidateFunctionCodeAndDataAddress(const uint8_t *pucQuery)
 
 #if FC_WRITE_HOLDING_REGISTER_ENABLE
         case eFC_WRITE_HOLDING_REGISTER:
-            if (!((usDataStartAddress >= m_tModbusData.usHoldingRegisterStartAddress) &&
-                 (usDataStartAddress <= (m_tModbusData.usHoldingRegisterStartAddress + m_tModbusData.usMaxHoldingRegisters))))
+            if (!((usDataStartAddress >= ptData->usHoldingRegisterStartAddress) &&
+                 (usDataStartAddress <= (ptData->usHoldingRegisterStartAddress + ptData->usMaxHoldingRegisters))))
             {
                 ucException = eILLEGAL_DATA_ADDRESS;
                 MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal holding register address\r\n");
@@ -370,8 +792,8 @@ static uint8_t ValidateFunctionCodeAndDataAddress(const uint8_t *pucQuery)
 
 #if FC_WRITE_COILS_ENABLE
         case eFC_WRITE_COILS:
-            if (!((usDataStartAddress >= m_tModbusData.usCoilsStartAddress) &&
-                 ((usDataStartAddress + usNumOfData) <= (m_tModbusData.usCoilsStartAddress + m_tModbusData.usMaxCoils))))
+            if (!((usDataStartAddress >= ptData->usCoilsStartAddress) &&
+                 ((usDataStartAddress + usNumOfData) <= (ptData->usCoilsStartAddress + ptData->usMaxCoils))))
             {
                 ucException = eILLEGAL_DATA_ADDRESS;
                 MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal coil address\r\n");
@@ -381,8 +803,8 @@ static uint8_t ValidateFunctionCodeAndDataAddress(const uint8_t *pucQuery)
 
 #if FC_WRITE_HOLDING_REGISTERS_ENABLE
         case eFC_WRITE_HOLDING_REGISTERS:
-            if (!((usDataStartAddress >= m_tModbusData.usHoldingRegisterStartAddress) &&
-                 ((usDataStartAddress + usNumOfData) <= (m_tModbusData.usHoldingRegisterStartAddress + m_tModbusData.usMaxHoldingRegisters))))
+            if (!((usDataStartAddress >= ptData->usHoldingRegisterStartAddress) &&
+                 ((usDataStartAddress + usNumOfData) <= (ptData->usHoldingRegisterStartAddress + ptData->usMaxHoldingRegisters))))
             {
                 ucException = eILLEGAL_DATA_ADDRESS;
                 MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal holding register address\r\n");
@@ -390,6 +812,77 @@ static uint8_t ValidateFunctionCodeAndDataAddress(const uint8_t *pucQuery)
             break;
 #endif
 
+#if FC_READ_HISTORY_ENABLE
+        case eFC_READ_HISTORY:
+            //start address and number of data are range and sequence here
+            if (MBAP_LEN_READ_HISTORY_QUERY != (uint16_t)((pucQuery[MBAP_LEN_OFFSET] << 8) | pucQuery[MBAP_LEN_OFFSET + 1]))
+            {
+                ucException = eILLEGAL_DATA_VALUE;
+                MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal history query length\r\n");
+            }
+            break;
+#endif
+
+#if FC_SUBSCRIBE_ENABLE
+        case eFC_SUBSCRIBE:
+            if ((MBAP_LEN_SUBSCRIBE_QUERY != (uint16_t)((pucQuery[MBAP_LEN_OFFSET] << 8) | pucQuery[MBAP_LEN_OFFSET + 1])) ||
+                (pucQuery[SUBSCRIBE_TABLE_OFFSET] > eTABLE_INPUT_REGISTERS))
+            {
+                ucException = eILLEGAL_DATA_VALUE;
+                MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal subscribe query\r\n");
+            }
+            else
+            {
+                usDataStartAddress = (uint16_t)((pucQuery[SUBSCRIBE_START_ADDRESS_OFFSET] << 8) |
+                                                pucQuery[SUBSCRIBE_START_ADDRESS_OFFSET + 1]);
+                usNumOfData        = (uint16_t)((pucQuery[SUBSCRIBE_NUM_OF_DATA_OFFSET] << 8) |
+                                                pucQuery[SUBSCRIBE_NUM_OF_DATA_OFFSET + 1]);
+                ucException        = ValidateTableRange(ptData, pucQuery[SUBSCRIBE_TABLE_OFFSET],
+                                                        usDataStartAddress, usNumOfData);
+            }
+            break;
+
+        case eFC_CANCEL_SUBSCRIPTION:
+            if (MBAP_LEN_CANCEL_SUBSCRIPTION_QUERY != (uint16_t)((pucQuery[MBAP_LEN_OFFSET] << 8) | pucQuery[MBAP_LEN_OFFSET + 1]))
+            {
+                ucException = eILLEGAL_DATA_VALUE;
+                MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal cancel subscription query length\r\n");
+            }
+            break;
+#endif
+
+#if FC_CONDITIONAL_READ_ENABLE
+        case eFC_CONDITIONAL_READ:
+            usNumOfData = (uint16_t)((pucQuery[CONDITIONAL_READ_NUM_OF_DATA_OFFSET] << 8) |
+                                     pucQuery[CONDITIONAL_READ_NUM_OF_DATA_OFFSET + 1]);
+
+            //whole range must fit into one response
+            if ((MBAP_LEN_CONDITIONAL_READ_QUERY != (uint16_t)((pucQuery[MBAP_LEN_OFFSET] << 8) | pucQuery[MBAP_LEN_OFFSET + 1])) ||
+                (pucQuery[CONDITIONAL_READ_TABLE_OFFSET] > eTABLE_INPUT_REGISTERS) ||
+                (0 == usNumOfData) ||
+                (usNumOfData > (((eTABLE_COILS == pucQuery[CONDITIONAL_READ_TABLE_OFFSET]) ||
+                                 (eTABLE_DISCRETE_INPUTS == pucQuery[CONDITIONAL_READ_TABLE_OFFSET])) ?
+                                CONDITIONAL_READ_MAX_BITS : CONDITIONAL_READ_MAX_REGISTERS)))
+            {
+                ucException = eILLEGAL_DATA_VALUE;
+                MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal conditional read query\r\n");
+            }
+            else
+            {
+                usDataStartAddress = (uint16_t)((pucQuery[CONDITIONAL_READ_START_ADDRESS_OFFSET] << 8) |
+                                                pucQuery[CONDITIONAL_READ_START_ADDRESS_OFFSET + 1]);
+                ucException        = ValidateTableRange(ptData, pucQuery[CONDITIONAL_READ_TABLE_OFFSET],
+                                                        usDataStartAddress, usNumOfData);
+            }
+            break;
+#endif
+
+#if FC_READ_MULTIPLE_RANGES_ENABLE
+        case eFC_READ_MULTIPLE_RANGES:
+            ucException = ValidateRanges(ptData, pucQuery);
+            break;
+#endif
+
     default:
         ucException = eILLEGAL_FUNCTION_CODE;
         break;
@@ -398,71 +891,256 @@ static uint8_t ValidateFunctionCodeAndDataAddress(const uint8_t *pucQuery)
     return (ucException);
 }//end ValidateFunctionCodeAndDataAddress
 
-static uint16_t HandleRequest(const uint8_t *pucQuery, uint8_t *pucResponse)
+static uint8_t ValidateDataLength(const ModbusRequest_t *ptRequest)
+{
+    const uint8_t *pucQuery    = ptRequest->pucQuery;
+    uint32_t      ulMaxAduLen  = (0 == ptRequest->usMaxAduLen) ? MAX_ADU_LEN : ptRequest->usMaxAduLen;
+    uint32_t      ulQueryEnd   = 0;
+    uint32_t      ulNumOfData  = 0;
+    uint8_t       ucException  = eNO_EXCEPTION;
+
+    ulQueryEnd  = MBAP_LEN_FIELD_END + (uint32_t)((pucQuery[MBAP_LEN_OFFSET] << 8) | pucQuery[MBAP_LEN_OFFSET + 1]);
+    ulNumOfData = (uint32_t)((pucQuery[NO_OF_DATA_OFFSET] << 8) | pucQuery[NO_OF_DATA_OFFSET + 1]);
+
+    switch (pucQuery[FUNCTION_CODE_OFFSET])
+    {
+    case eFC_READ_COILS:
+    case eFC_READ_DISCRETE_INPUTS:
+        //user functions take number of coils as int16_t
+        if (((DATA_VALUES_OFFSET + ((ulNumOfData + 7u) / 8u)) > ulMaxAduLen) || (ulNumOfData > INT16_MAX))
+        {
+            ucException = eILLEGAL_DATA_VALUE;
+        }
+        break;
+
+    case eFC_READ_HOLDING_REGISTERS:
+    case eFC_READ_INPUT_REGISTERS:
+        if ((DATA_VALUES_OFFSET + (ulNumOfData * 2u)) > ulMaxAduLen)
+        {
+            ucException = eILLEGAL_DATA_VALUE;
+        }
+        break;
+
+    case eFC_WRITE_COILS:
+        if (((WRITE_VALUE_OFFSET + ((ulNumOfData + 7u) / 8u)) > ulQueryEnd) || (ulNumOfData > INT16_MAX))
+        {
+            ucException = eILLEGAL_DATA_VALUE;
+        }
+        break;
+
+    case eFC_WRITE_HOLDING_REGISTERS:
+        if ((WRITE_VALUE_OFFSET + (ulNumOfData * 2u)) > ulQueryEnd)
+        {
+            ucException = eILLEGAL_DATA_VALUE;
+        }
+        break;
+
+    default:
+        break;
+    }//end switch
+
+    if (eNO_EXCEPTION != ucException)
+    {
+        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal quantity of data\r\n");
+    }
+
+    return (ucException);
+}//end ValidateDataLength
+
+#if FC_SUBSCRIBE_ENABLE || FC_CONDITIONAL_READ_ENABLE || FC_READ_MULTIPLE_RANGES_ENABLE
+static uint8_t ValidateTableRange(const ModbusData_t *ptData, uint8_t ucTable, uint16_t usAddress, uint16_t usNumOfData)
+{
+    static const uint8_t s_aucReadCodes[] = {eFC_READ_COILS, eFC_READ_DISCRETE_INPUTS,
+                                             eFC_READ_HOLDING_REGISTERS, eFC_READ_INPUT_REGISTERS};
+    uint8_t aucQuery[TABLE_RANGE_QUERY_LEN] = {0};
+
+    aucQuery[FUNCTION_CODE_OFFSET]          = s_aucReadCodes[ucTable];
+    aucQuery[DATA_START_ADDRESS_OFFSET]     = (uint8_t)(usAddress >> 8);
+    aucQuery[DATA_START_ADDRESS_OFFSET + 1] = (uint8_t)(usAddress & 0xFF);
+    aucQuery[NO_OF_DATA_OFFSET]             = (uint8_t)(usNumOfData >> 8);
+    aucQuery[NO_OF_DATA_OFFSET + 1]         = (uint8_t)(usNumOfData & 0xFF);
+
+    return ValidateFunctionCodeAndDataAddress(ptData, aucQuery);
+}//end ValidateTableRange
+#endif//FC_SUBSCRIBE_ENABLE || FC_CONDITIONAL_READ_ENABLE || FC_READ_MULTIPLE_RANGES_ENABLE
+
+#if FC_READ_MULTIPLE_RANGES_ENABLE
+static uint8_t ValidateRanges(const ModbusData_t *ptData, const uint8_t *pucQuery)
+{
+    const uint8_t *pucDescriptor = &pucQuery[RANGES_DESCRIPTORS_OFFSET];
+    uint8_t       ucNumOfRanges  = pucQuery[RANGES_NUM_OF_RANGES_OFFSET];
+    uint8_t       ucRange        = 0;
+    uint8_t       ucException    = eNO_EXCEPTION;
+    uint32_t      ulResponseLen  = RANGES_DATA_OFFSET;
+
+    if ((0 == ucNumOfRanges) || (ucNumOfRanges > MAX_RANGES) ||
+        (MBAP_LEN_READ_MULTIPLE_RANGES_QUERY(ucNumOfRanges) !=
+         (uint16_t)((pucQuery[MBAP_LEN_OFFSET] << 8) | pucQuery[MBAP_LEN_OFFSET + 1])))
+    {
+        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal number of ranges\r\n");
+        return eILLEGAL_DATA_VALUE;
+    }
+
+    for (ucRange = 0; (ucRange < ucNumOfRanges) && (eNO_EXCEPTION == ucException); ucRange++)
+    {
+        uint8_t  ucTable     = pucDescriptor[0];
+        uint16_t usAddress   = (uint16_t)((pucDescriptor[1] << 8) | pucDescriptor[2]);
+        uint16_t usNumOfData = (uint16_t)((pucDescriptor[3] << 8) | pucDescriptor[4]);
+
+        if ((ucTable > eTABLE_INPUT_REGISTERS) || (0 == usNumOfData))
+        {
+            ucException = eILLEGAL_DATA_VALUE;
+            MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal range\r\n");
+        }
+        else
+        {
+            ucException    = ValidateTableRange(ptData, ucTable, usAddress, usNumOfData);
+            //byte count(1 byte) + data
+            ulResponseLen += 1u + TableByteCount(ucTable, usNumOfData);
+        }
+
+        pucDescriptor += RANGE_DESCRIPTOR_LEN;
+    }
+
+    //all ranges must fit into one response
+    if ((eNO_EXCEPTION == ucException) && (ulResponseLen > MAX_ADU_LEN))
+    {
+        ucException = eILLEGAL_DATA_VALUE;
+        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Ranges exceed response\r\n");
+    }
+
+    return ucException;
+}//end ValidateRanges
+#endif//FC_READ_MULTIPLE_RANGES_ENABLE
+
+#if FC_CONDITIONAL_READ_ENABLE || FC_READ_MULTIPLE_RANGES_ENABLE
+static uint16_t TableStartAddress(const ModbusData_t *ptData, uint8_t ucTable)
+{
+    switch (ucTable)
+    {
+    case eTABLE_COILS:
+        return ptData->usCoilsStartAddress;
+
+    case eTABLE_DISCRETE_INPUTS:
+        return ptData->usDiscreteInputStartAddress;
+
+    case eTABLE_HOLDING_REGISTERS:
+        return ptData->usHoldingRegisterStartAddress;
+
+    default:
+        return ptData->usInputRegisterStartAddress;
+    }//end switch
+}//end TableStartAddress
+
+static uint16_t TableByteCount(uint8_t ucTable, uint16_t usNumOfData)
+{
+    if ((eTABLE_COILS == ucTable) || (eTABLE_DISCRETE_INPUTS == ucTable))
+    {
+        return (uint16_t)((usNumOfData + 7u) / 8u);
+    }
+
+    return (uint16_t)(usNumOfData * 2u);
+}//end TableByteCount
+#endif//FC_CONDITIONAL_READ_ENABLE || FC_READ_MULTIPLE_RANGES_ENABLE
+
+static uint16_t HandleRequest(ModbusRequest_t *ptRequest)
 {
     uint8_t  ucFunctionCode = 0;
     uint16_t usResponseLen  = 0;
 
     // filter PDU information
-    ucFunctionCode = pucQuery[FUNCTION_CODE_OFFSET];
+    ucFunctionCode = ptRequest->pucQuery[FUNCTION_CODE_OFFSET];
 
     switch (ucFunctionCode)
     {
 #if FC_READ_COILS_ENABLE
     case eFC_READ_COILS:
         MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Reading coils\r\n");
-        usResponseLen = ReadCoils(pucQuery, pucResponse);
+        usResponseLen = ReadCoils(ptRequest);
         break;
 #endif//FC_READ_COILS_ENABLE
 
 #if FC_READ_DISCRETE_INPUTS_ENABLE
     case eFC_READ_DISCRETE_INPUTS:
         MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Reading discrete inputs\r\n");
-        usResponseLen = ReadDiscreteInputs(pucQuery, pucResponse);
+        usResponseLen = ReadDiscreteInputs(ptRequest);
         break;
 #endif//FC_READ_DISCRETE_INPUTS_ENABLE
 
 #if FC_READ_HOLDING_REGISTERS_ENABLE
     case eFC_READ_HOLDING_REGISTERS:
         MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Reading holding registers\r\n");
-        usResponseLen = ReadHoldingRegisters(pucQuery, pucResponse);
+        usResponseLen = ReadHoldingRegisters(ptRequest);
         break;
 #endif//FC_READ_HOLDING_REGISTERS_ENABLE
 
 #if FC_READ_INPUT_REGISTERS_ENABLE
     case eFC_READ_INPUT_REGISTERS:
         MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Reading input registers\r\n");
-        usResponseLen = ReadInputRegisters(pucQuery, pucResponse);
+        usResponseLen = ReadInputRegisters(ptRequest);
         break;
 #endif//FC_READ_INPUT_REGISTERS_ENABLE
 
 #if FC_WRITE_COIL_ENABLE
     case eFC_WRITE_COIL:
         MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Writing coil\r\n");
-        usResponseLen = WriteSingleCoil(pucQuery, pucResponse);
+        usResponseLen = WriteSingleCoil(ptRequest);
         break;
 #endif//FC_WRITE_COIL_ENABLE
 
 #if FC_WRITE_HOLDING_REGISTER_ENABLE
     case eFC_WRITE_HOLDING_REGISTER:
         MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Writing holding register\r\n");
-        usResponseLen = WriteSingleHoldingRegister(pucQuery, pucResponse);
+        usResponseLen = WriteSingleHoldingRegister(ptRequest);
         break;
 #endif//FC_WRITE_HOLDING_REGISTER_ENABLE
 
 #if FC_WRITE_COILS_ENABLE
     case eFC_WRITE_COILS:
         MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Writing Coils\r\n");
-        usResponseLen = WriteMultipleCoils(pucQuery, pucResponse);
+        usResponseLen = WriteMultipleCoils(ptRequest);
         break;
 #endif//FC_WRITE_COILS_ENABLE
 
 #if FC_WRITE_HOLDING_REGISTERS_ENABLE
     case eFC_WRITE_HOLDING_REGISTERS:
         MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Writing holding registers\r\n");
-        usResponseLen = WriteMultipleHoldingRegisters(pucQuery, pucResponse);
+        usResponseLen = WriteMultipleHoldingRegisters(ptRequest);
         break;
 #endif//FC_WRITE_HOLDING_REGISTERS
+
+#if FC_READ_HISTORY_ENABLE
+    case eFC_READ_HISTORY:
+        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Reading history\r\n");
+        usResponseLen = ReadHistory(ptRequest);
+        break;
+#endif//FC_READ_HISTORY_ENABLE
+
+#if FC_SUBSCRIBE_ENABLE
+    case eFC_SUBSCRIBE:
+        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Subscribing\r\n");
+        usResponseLen = Subscribe(ptRequest);
+        break;
+
+    case eFC_CANCEL_SUBSCRIPTION:
+        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Cancelling subscription\r\n");
+        usResponseLen = CancelSubscription(ptRequest);
+        break;
+#endif//FC_SUBSCRIBE_ENABLE
+
+#if FC_CONDITIONAL_READ_ENABLE
+    case eFC_CONDITIONAL_READ:
+        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Reading if changed\r\n");
+        usResponseLen = ConditionalRead(ptRequest);
+        break;
+#endif//FC_CONDITIONAL_READ_ENABLE
+
+#if FC_READ_MULTIPLE_RANGES_ENABLE
+    case eFC_READ_MULTIPLE_RANGES:
+        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Reading multiple ranges\r\n");
+        usResponseLen = ReadMultipleRanges(ptRequest);
+        break;
+#endif//FC_READ_MULTIPLE_RANGES_ENABLE
     default:
         usResponseLen = 0;
         break;
@@ -471,6 +1149,12 @@ static uint16_t HandleRequest(const uint8_t *pucQuery, uint8_t *pucResponse)
     return (usResponseLen);
 }//end HandleRequest
 
+static bool IsWriteFunctionCode(uint8_t ucFunctionCode)
+{
+    return (eFC_WRITE_COIL == ucFunctionCode) || (eFC_WRITE_HOLDING_REGISTER == ucFunctionCode) ||
+           (eFC_WRITE_COILS == ucFunctionCode) || (eFC_WRITE_HOLDING_REGISTERS == ucFunctionCode);
+}//end IsWriteFunctionCode
+
 static uint16_t BuildExceptionPacket(const uint8_t *pucQuery, uint8_t ucException, uint8_t *pucResponse)
 {
     memcpy(pucResponse, pucQuery, MBAP_HEADER_LEN);
@@ -484,9 +1168,99 @@ static uint16_t BuildExceptionPacket(const uint8_t *pucQuery, uint8_t ucExceptio
     return (EXCEPTION_PACKET_LEN);
 }//end BuildExceptionPacket
 
+static uint16_t ReadUnitData(ModbusRequest_t *ptRequest,
+                             uint8_t ucTable,
+                             uint16_t usStartAddress,
+                             uint16_t usNumOfData,
+                             uint8_t *pucRecBuf,
+                             uint16_t usResponseLen)
+{
+    ptRequest->ucTable        = ucTable;
+    ptRequest->bWrite         = false;
+    ptRequest->usStartAddress = usStartAddress;
+    ptRequest->usNumOfData    = usNumOfData;
+    ptRequest->pucReadData    = pucRecBuf;
+    ptRequest->pucWriteData   = NULL;
+
+    if (StartAsyncAccess(ptRequest, usResponseLen, &usResponseLen))
+    {
+        return usResponseLen;
+    }
+
+    return FinishAccess(ptRequest, mbap_AccessRequestData(ptRequest), usResponseLen);
+}//end ReadUnitData
+
+static uint16_t WriteUnitData(ModbusRequest_t *ptRequest,
+                              uint8_t ucTable,
+                              uint16_t usStartAddress,
+                              uint16_t usNumOfData,
+                              const uint8_t *pucWriteBuf,
+                              uint16_t usResponseLen)
+{
+    ptRequest->ucTable        = ucTable;
+    ptRequest->bWrite         = true;
+    ptRequest->usStartAddress = usStartAddress;
+    ptRequest->usNumOfData    = usNumOfData;
+    ptRequest->pucReadData    = NULL;
+    ptRequest->pucWriteData   = pucWriteBuf;
+
+    if (StartAsyncAccess(ptRequest, usResponseLen, &usResponseLen))
+    {
+        return usResponseLen;
+    }
+
+    return FinishAccess(ptRequest, mbap_AccessRequestData(ptRequest), usResponseLen);
+}//end WriteUnitData
+
+static bool StartAsyncAccess(ModbusRequest_t *ptRequest, uint16_t usResponseLen, uint16_t *pusResponseLen)
+{
+    const ModbusData_t *ptData      = ptRequest->ptUnit->ptModbusData;
+    uint8_t            ucException  = eNO_EXCEPTION;
+
+    if ((NULL == ptData->ptfnAsyncAccess) || (NULL == ptRequest->ptfnDone))
+    {
+        return false;
+    }
+
+    //response length must be set before user function may complete from other thread
+    ptRequest->usResponseLen = usResponseLen;
+    MBT_PROBE_QUERY(async__start, ptRequest->ulConnectionId, ptRequest->pucQuery);
+    ucException              = ptData->ptfnAsyncAccess(ptRequest);
+    MBT_PROBE_QUERY_RESULT(async__done, ptRequest->ulConnectionId, ptRequest->pucQuery, ucException);
+
+    if (eASYNC_PENDING == ucException)
+    {
+        *pusResponseLen = MBAP_RESPONSE_PENDING;
+    }
+    else
+    {
+        *pusResponseLen = FinishAccess(ptRequest, ucException, usResponseLen);
+    }
+
+    return true;
+}//end StartAsyncAccess
+
+static uint16_t FinishAccess(ModbusRequest_t *ptRequest, uint8_t ucException, uint16_t usResponseLen)
+{
+    if (eNO_EXCEPTION != ucException)
+    {
+        usResponseLen = BuildExceptionPacket(ptRequest->pucQuery, ucException, ptRequest->pucResponse);
+    }
+    else if (ptRequest->bWrite)
+    {
+        mbap_ChangeMark(ptRequest->ptUnit, ptRequest->ucTable, ptRequest->usStartAddress, ptRequest->usNumOfData);
+    }
+
+    return usResponseLen;
+}//end FinishAccess
+
 #if FC_READ_COILS_ENABLE
-static uint16_t ReadCoils(const uint8_t *pucQuery, uint8_t *pucResponse)
+static uint16_t ReadCoils(ModbusRequest_t *ptRequest)
 {
+    const ModbusUnit_t *ptUnit      = ptRequest->ptUnit;
+    const ModbusData_t *ptData      = ptUnit->ptModbusData;
+    const uint8_t      *pucQuery    = ptRequest->pucQuery;
+    uint8_t            *pucResponse = ptRequest->pucResponse;
     uint16_t usDataStartAddress = 0;
     int16_t  sNumOfData         = 0;
     uint16_t usStartAddress     = 0;
@@ -499,7 +1273,7 @@ static uint16_t ReadCoils(const uint8_t *pucQuery, uint8_t *pucResponse)
     sNumOfData          = (int16_t)(pucQuery[NO_OF_DATA_OFFSET] << 8);
     sNumOfData         |= (int16_t)(pucQuery[NO_OF_DATA_OFFSET + 1]);
 
-    usStartAddress = usDataStartAddress - m_tModbusData.usCoilsStartAddress;
+    usStartAddress = usDataStartAddress - ptData->usCoilsStartAddress;
 
     //Copy MBAP Header and function code into respone
     memcpy(pucResponse, pucQuery, (MBAP_HEADER_LEN + 1));
@@ -512,7 +1286,7 @@ static uint16_t ReadCoils(const uint8_t *pucQuery, uint8_t *pucResponse)
     }
 
     //Modify Information in MBAP Header for response
-    pucResponse[MBAP_LEN_OFFSET]     = (uint8_t)(usMbapLen << 8);
+    pucResponse[MBAP_LEN_OFFSET]     = (uint8_t)(usMbapLen >> 8);
     pucResponse[MBAP_LEN_OFFSET + 1] = (uint8_t)(usMbapLen & 0xFF);
     pucResponse[BYTE_COUNT_OFFSET]   = (uint8_t)(sNumOfData / 8);
     pucBuffer                        = &pucResponse[DATA_VALUES_OFFSET];
@@ -525,15 +1299,19 @@ static uint16_t ReadCoils(const uint8_t *pucQuery, uint8_t *pucResponse)
         pucResponse[BYTE_COUNT_OFFSET] += 1;
     }
 
-    m_tModbusData.ptfnReadCoils(usStartAddress, sNumOfData, pucBuffer);
+    usResponseLen = ReadUnitData(ptRequest, eTABLE_COILS, usStartAddress, (uint16_t)sNumOfData, pucBuffer, usResponseLen);
 
     return usResponseLen;
 }//end ReadCoils
 #endif//FC_READ_COILS_ENABLE
 
 #if FC_READ_DISCRETE_INPUTS_ENABLE
-static uint16_t ReadDiscreteInputs(const uint8_t *pucQuery, uint8_t *pucResponse)
+static uint16_t ReadDiscreteInputs(ModbusRequest_t *ptRequest)
 {
+    const ModbusUnit_t *ptUnit      = ptRequest->ptUnit;
+    const ModbusData_t *ptData      = ptUnit->ptModbusData;
+    const uint8_t      *pucQuery    = ptRequest->pucQuery;
+    uint8_t            *pucResponse = ptRequest->pucResponse;
     uint16_t usDataStartAddress = 0;
     int16_t  sNumOfData         = 0;
     uint16_t usStartAddress     = 0;
@@ -546,7 +1324,7 @@ static uint16_t ReadDiscreteInputs(const uint8_t *pucQuery, uint8_t *pucResponse
     sNumOfData          = (int16_t)(pucQuery[NO_OF_DATA_OFFSET] << 8);
     sNumOfData         |= (int16_t)(pucQuery[NO_OF_DATA_OFFSET + 1]);
 
-    usStartAddress = usDataStartAddress - m_tModbusData.usDiscreteInputStartAddress;
+    usStartAddress = usDataStartAddress - ptData->usDiscreteInputStartAddress;
 
     //Copy MBAP Header and function code into respone
     memcpy(pucResponse, pucQuery, (MBAP_HEADER_LEN + 1));
@@ -559,7 +1337,7 @@ static uint16_t ReadDiscreteInputs(const uint8_t *pucQuery, uint8_t *pucResponse
     }
 
     //Modify Information in MBAP Header for response
-    pucResponse[MBAP_LEN_OFFSET]     = (uint16_t)(usMbapLen << 8);
+    pucResponse[MBAP_LEN_OFFSET]     = (uint16_t)(usMbapLen >> 8);
     pucResponse[MBAP_LEN_OFFSET + 1] = (uint16_t)(usMbapLen & 0xFF);
     pucResponse[BYTE_COUNT_OFFSET]   = (uint8_t)(sNumOfData / 8);
     pucBuffer                        = &pucResponse[DATA_VALUES_OFFSET];
@@ -572,15 +1350,19 @@ static uint16_t ReadDiscreteInputs(const uint8_t *pucQuery, uint8_t *pucResponse
         pucResponse[BYTE_COUNT_OFFSET] += 1;
     }
 
-    m_tModbusData.ptfnReadDiscreteInputs(usStartAddress, sNumOfData, pucBuffer);
+    usResponseLen = ReadUnitData(ptRequest, eTABLE_DISCRETE_INPUTS, usStartAddress, (uint16_t)sNumOfData, pucBuffer, usResponseLen);
 
     return usResponseLen;
 }//end ReadDiscreteInputs
 #endif//FC_READ_DISCRETE_INPUTS_ENABLE
 
 #ifdef FC_READ_HOLDING_REGISTERS_ENABLE
-static uint16_t ReadHoldingRegisters(const uint8_t *pucQuery, uint8_t *pucResponse)
+static uint16_t ReadHoldingRegisters(ModbusRequest_t *ptRequest)
 {
+    const ModbusUnit_t *ptUnit      = ptRequest->ptUnit;
+    const ModbusData_t *ptData      = ptUnit->ptModbusData;
+    const uint8_t      *pucQuery    = ptRequest->pucQuery;
+    uint8_t            *pucResponse = ptRequest->pucResponse;
     uint16_t usDataStartAddress = 0;
     uint16_t usNumOfData        = 0;
     uint16_t usPduLength        = 0;
@@ -593,29 +1375,33 @@ static uint16_t ReadHoldingRegisters(const uint8_t *pucQuery, uint8_t *pucRespon
     usNumOfData         = (uint16_t)(pucQuery[NO_OF_DATA_OFFSET] << 8);
     usNumOfData        |= (uint16_t)(pucQuery[NO_OF_DATA_OFFSET + 1]);
 
-    usStartAddress = (usDataStartAddress - m_tModbusData.usHoldingRegisterStartAddress);
+    usStartAddress = (usDataStartAddress - ptData->usHoldingRegisterStartAddress);
     usPduLength    = MBAP_LEN_READ_INPUT_REGISTERS(usNumOfData);
 
     //Copy MBAP Header and function code into respone
     memcpy(pucResponse, pucQuery, (MBAP_HEADER_LEN + 1));
 
     //Modify Information in MBAP Header for response
-    pucResponse[MBAP_LEN_OFFSET]     = (uint8_t)(usPduLength << 8);
+    pucResponse[MBAP_LEN_OFFSET]     = (uint8_t)(usPduLength >> 8);
     pucResponse[MBAP_LEN_OFFSET + 1] = (uint8_t)(usPduLength & 0xFF);
     pucResponse[BYTE_COUNT_OFFSET]   = (uint8_t)(usNumOfData * 2);
     pucRegBuffer                     = &pucResponse[DATA_VALUES_OFFSET];
 
     usResponseLen = READ_HOLDING_REGISTERS_RESPONSE_LEN(usNumOfData);
 
-    m_tModbusData.ptfnReadHoldingRegisters(usStartAddress, usNumOfData, pucRegBuffer);
+    usResponseLen = ReadUnitData(ptRequest, eTABLE_HOLDING_REGISTERS, usStartAddress, usNumOfData, pucRegBuffer, usResponseLen);
 
     return (usResponseLen);
 }//end ReadHoldingRegisters
 #endif//FC_READ_HOLDING_REGISTERS_ENABLE
 
 #if FC_READ_INPUT_REGISTERS_ENABLE
-static uint16_t ReadInputRegisters(const uint8_t *pucQuery, uint8_t *pucResponse)
+static uint16_t ReadInputRegisters(ModbusRequest_t *ptRequest)
 {
+    const ModbusUnit_t *ptUnit      = ptRequest->ptUnit;
+    const ModbusData_t *ptData      = ptUnit->ptModbusData;
+    const uint8_t      *pucQuery    = ptRequest->pucQuery;
+    uint8_t            *pucResponse = ptRequest->pucResponse;
     uint16_t usDataStartAddress = 0;
     uint16_t usNumOfData        = 0;
     uint16_t usMbapLength       = 0;
@@ -628,29 +1414,33 @@ static uint16_t ReadInputRegisters(const uint8_t *pucQuery, uint8_t *pucResponse
     usNumOfData         = (uint16_t)(pucQuery[NO_OF_DATA_OFFSET] << 8);
     usNumOfData        |= (uint16_t)(pucQuery[NO_OF_DATA_OFFSET + 1]);
 
-    usStartAddress = (usDataStartAddress - m_tModbusData.usInputRegisterStartAddress);
+    usStartAddress = (usDataStartAddress - ptData->usInputRegisterStartAddress);
     usMbapLength   = MBAP_LEN_READ_INPUT_REGISTERS(usNumOfData);
 
     //Copy MBAP Header and function code into response
     memcpy(pucResponse, pucQuery, (MBAP_HEADER_LEN + 1));
 
     //Modify Information in MBAP Header for response
-    pucResponse[MBAP_LEN_OFFSET]     = (uint8_t)(usMbapLength << 8);
+    pucResponse[MBAP_LEN_OFFSET]     = (uint8_t)(usMbapLength >> 8);
     pucResponse[MBAP_LEN_OFFSET + 1] = (uint8_t)(usMbapLength & 0xFF);
     pucResponse[BYTE_COUNT_OFFSET]   = (uint8_t)(usNumOfData * 2);
     pucRegBuffer                     = &pucResponse[DATA_VALUES_OFFSET];
 
     usResponseLen = READ_INPUT_REGISTERS_RESPONSE_LEN(usNumOfData);
 
-    m_tModbusData.ptfnReadInputRegisters(usStartAddress, usNumOfData, pucRegBuffer);
+    usResponseLen = ReadUnitData(ptRequest, eTABLE_INPUT_REGISTERS, usStartAddress, usNumOfData, pucRegBuffer, usResponseLen);
 
     return (usResponseLen);
 }//end ReadInputRegisters
 #endif//FC_READ_INPUT_REGISTERS_ENABLE
 
 #if FC_WRITE_COIL_ENABLE
-static uint16_t WriteSingleCoil(const uint8_t *pucQuery, uint8_t *pucResponse)
+static uint16_t WriteSingleCoil(ModbusRequest_t *ptRequest)
 {
+    const ModbusUnit_t *ptUnit      = ptRequest->ptUnit;
+    const ModbusData_t *ptData      = ptUnit->ptModbusData;
+    const uint8_t      *pucQuery    = ptRequest->pucQuery;
+    uint8_t            *pucResponse = ptRequest->pucResponse;
     uint16_t usDataStartAddress = 0;
     uint16_t usStartAddress     = 0;
     uint16_t usResponseLen      = 0;
@@ -659,23 +1449,33 @@ static uint16_t WriteSingleCoil(const uint8_t *pucQuery, uint8_t *pucResponse)
     usDataStartAddress |= (uint16_t)(pucQuery[DATA_START_ADDRESS_OFFSET + 1]);
 
 
-    usStartAddress = usDataStartAddress - m_tModbusData.usCoilsStartAddress;
+    usStartAddress = usDataStartAddress - ptData->usCoilsStartAddress;
 
+    //packed coil values for unit image, request may complete in other thread
+    static const uint8_t aucPackedCoil[2] = {0u, 1u};
     const uint8_t *pucCoilBuf = &pucQuery[COIL_VALUE_OFFSSET];
-
-    m_tModbusData.ptfnWriteCoils(usStartAddress, 1, pucCoilBuf);
+    uint8_t       ucCoil      = (0xFF == pucCoilBuf[0]) ? 1u : 0u;
 
     //Copy same data in response as received in query
     usResponseLen = WRITE_SINGLE_COIL_RESPONSE_LEN;
     memcpy(pucResponse, pucQuery, usResponseLen);
 
+    //user functions take coil value as received, unit image takes packed bits
+    usResponseLen = WriteUnitData(ptRequest, eTABLE_COILS, usStartAddress, 1,
+                                  (NULL != ptUnit->ptProfile) ? &aucPackedCoil[ucCoil] : pucCoilBuf,
+                                  usResponseLen);
+
     return usResponseLen;
 }//end WriteSingleCoil
 #endif//FC_WRITE_COIL_ENABLE
 
 #if FC_WRITE_HOLDING_REGISTER_ENABLE
-static uint16_t WriteSingleHoldingRegister(const uint8_t *pucQuery, uint8_t *pucResponse)
+static uint16_t WriteSingleHoldingRegister(ModbusRequest_t *ptRequest)
 {
+    const ModbusUnit_t *ptUnit      = ptRequest->ptUnit;
+    const ModbusData_t *ptData      = ptUnit->ptModbusData;
+    const uint8_t      *pucQuery    = ptRequest->pucQuery;
+    uint8_t            *pucResponse = ptRequest->pucResponse;
     uint16_t usDataStartAddress = 0;
     uint16_t usRegisterValue    = 0;
     uint16_t usStartAddress     = 0;
@@ -686,17 +1486,19 @@ static uint16_t WriteSingleHoldingRegister(const uint8_t *pucQuery, uint8_t *puc
     usRegisterValue     = (uint16_t)(pucQuery[REGISTER_VALUE_OFFSET] << 8);
     usRegisterValue    |= (uint16_t)(pucQuery[REGISTER_VALUE_OFFSET + 1]);
 
-    usStartAddress = usDataStartAddress - m_tModbusData.usHoldingRegisterStartAddress;
+    usStartAddress = usDataStartAddress - ptData->usHoldingRegisterStartAddress;
 
-    if ((m_tModbusData.psHoldingRegisterHigherLimit[usStartAddress] >= (int16_t) usRegisterValue) &&
-        (m_tModbusData.psHoldingRegisterLowerLimit[usStartAddress] <= (int16_t) usRegisterValue))
+    if ((ptData->psHoldingRegisterHigherLimit[usStartAddress] >= (int16_t) usRegisterValue) &&
+        (ptData->psHoldingRegisterLowerLimit[usStartAddress] <= (int16_t) usRegisterValue))
     {
         const uint8_t *pucRegBuf = &pucQuery[REGISTER_VALUE_OFFSET];
-        m_tModbusData.ptfnWriteHoldingRegisters(usStartAddress, 1, pucRegBuf);
 
         //Copy same data in response as received in query
         usResponseLen = WRITE_SINGLE_REGISTER_RESPONSE_LEN;
         memcpy(pucResponse, pucQuery, usResponseLen);
+
+        usResponseLen = WriteUnitData(ptRequest, eTABLE_HOLDING_REGISTERS, usStartAddress, 1,
+                                      pucRegBuf, usResponseLen);
     }
     else
     {
@@ -705,7 +1507,7 @@ static uint16_t WriteSingleHoldingRegister(const uint8_t *pucQuery, uint8_t *puc
         MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal data value\r\n");
 
         usPduLen                                    = MBAP_LEN_IN_EXCEPTION_PACKET;
-        pucResponse[MBAP_LEN_OFFSET]                = (uint8_t)(usPduLen << 8);
+        pucResponse[MBAP_LEN_OFFSET]                = (uint8_t)(usPduLen >> 8);
         pucResponse[MBAP_LEN_OFFSET + 1]            = (uint8_t)(usPduLen & 0xFF);
         pucResponse[EXCEPTION_FUNCTION_CODE_OFFSET] = EXCEPTION_START_FUNCTION_CODE + pucQuery[FUNCTION_CODE_OFFSET];
         pucResponse[EXCEPTION_TYPE_OFFSET]          = eILLEGAL_DATA_VALUE;
@@ -717,8 +1519,12 @@ static uint16_t WriteSingleHoldingRegister(const uint8_t *pucQuery, uint8_t *puc
 #endif//FC_WRITE_HOLDING_REGISTER_ENABLE
 
 #if FC_WRITE_COILS_ENABLE
-static uint16_t WriteMultipleCoils(const uint8_t *pucQuery, uint8_t *pucResponse)
+static uint16_t WriteMultipleCoils(ModbusRequest_t *ptRequest)
 {
+    const ModbusUnit_t *ptUnit      = ptRequest->ptUnit;
+    const ModbusData_t *ptData      = ptUnit->ptModbusData;
+    const uint8_t      *pucQuery    = ptRequest->pucQuery;
+    uint8_t            *pucResponse = ptRequest->pucResponse;
     uint16_t usDataStartAddress = 0;
     int16_t  sNumOfData         = 0;
     uint16_t usMbapLength       = 0;
@@ -743,39 +1549,42 @@ static uint16_t WriteMultipleCoils(const uint8_t *pucQuery, uint8_t *pucResponse
         sTmp = sNumOfData / 8;
     }
 
-    //check byte count
-    if (ucByteCount != sTmp)
+    //check byte count, low byte of it when data exceeds 255 bytes
+    if (ucByteCount != (uint8_t)sTmp)
     {
         return usResponseLen;
     }
 
-    usStartAddress = (usDataStartAddress - m_tModbusData.usCoilsStartAddress);
+    usStartAddress = (usDataStartAddress - ptData->usCoilsStartAddress);
     usMbapLength   = MBAP_LEN_WRITE_COILS;
 
     //Copy MBAP Header and function code into response
     memcpy(pucResponse, pucQuery, (MBAP_HEADER_LEN + 1));
 
     //Modify Information in MBAP Header for response
-    pucResponse[MBAP_LEN_OFFSET]         = (uint8_t)(usMbapLength << 8);
+    pucResponse[MBAP_LEN_OFFSET]         = (uint8_t)(usMbapLength >> 8);
     pucResponse[MBAP_LEN_OFFSET + 1]     = (uint8_t)(usMbapLength & 0xFF);
-    pucResponse[WRITE_START_ADDRESS]     = (uint8_t)(usDataStartAddress << 8);
+    pucResponse[WRITE_START_ADDRESS]     = (uint8_t)(usDataStartAddress >> 8);
     pucResponse[WRITE_START_ADDRESS + 1] = (uint8_t)(usDataStartAddress & 0xFF);
-    pucResponse[WRITE_NUM_OF_DATA ]      = (uint8_t)(sNumOfData << 8);
+    pucResponse[WRITE_NUM_OF_DATA ]      = (uint8_t)(sNumOfData >> 8);
     pucResponse[WRITE_NUM_OF_DATA + 1]   = (uint8_t)(sNumOfData & 0xFF);
 
     const uint8_t *pucCoilBuf = &pucQuery[WRITE_VALUE_OFFSET];
 
-    m_tModbusData.ptfnWriteCoils(usStartAddress, sNumOfData, pucCoilBuf);
-
-    usResponseLen = WRITE_COILS_RESPONSE_LEN;
+    usResponseLen = WriteUnitData(ptRequest, eTABLE_COILS, usStartAddress, (uint16_t)sNumOfData,
+                                  pucCoilBuf, WRITE_COILS_RESPONSE_LEN);
 
     return (usResponseLen);
 }//end WriteMultipleCoils
 #endif//FC_WRITE_COILS_ENABLE
 
 #if FC_WRITE_HOLDING_REGISTERS_ENABLE
-static uint16_t WriteMultipleHoldingRegisters(const uint8_t *pucQuery, uint8_t *pucResponse)
+static uint16_t WriteMultipleHoldingRegisters(ModbusRequest_t *ptRequest)
 {
+    const ModbusUnit_t *ptUnit      = ptRequest->ptUnit;
+    const ModbusData_t *ptData      = ptUnit->ptModbusData;
+    const uint8_t      *pucQuery    = ptRequest->pucQuery;
+    uint8_t            *pucResponse = ptRequest->pucResponse;
     uint16_t usDataStartAddress = 0;
     uint16_t usNumOfData        = 0;
     uint16_t usMbapLength       = 0;
@@ -790,27 +1599,28 @@ static uint16_t WriteMultipleHoldingRegisters(const uint8_t *pucQuery, uint8_t *
     usNumOfData        |= (uint16_t)(pucQuery[NO_OF_DATA_OFFSET + 1]);
     ucByteCount         = pucQuery[WRITE_BYTE_COUNT_OFFSET];
 
-    if (ucByteCount != (usNumOfData * 2) )
+    //low byte of byte count when data exceeds 255 bytes
+    if (ucByteCount != (uint8_t)(usNumOfData * 2))
     {
         usResponseLen = 0;
         return usResponseLen;
     }
 
-    usStartAddress = (usDataStartAddress - m_tModbusData.usHoldingRegisterStartAddress);
+    usStartAddress = (usDataStartAddress - ptData->usHoldingRegisterStartAddress);
     usMbapLength   = MBAP_LEN_WRITE_HOLDING_REGISTERS;
 
     //Copy MBAP Header and function code into response
     memcpy(pucResponse, pucQuery, (MBAP_HEADER_LEN + 1));
 
     //Modify Information in MBAP Header for response
-    pucResponse[MBAP_LEN_OFFSET]         = (uint8_t)(usMbapLength << 8);
+    pucResponse[MBAP_LEN_OFFSET]         = (uint8_t)(usMbapLength >> 8);
     pucResponse[MBAP_LEN_OFFSET + 1]     = (uint8_t)(usMbapLength & 0xFF);
-    pucResponse[WRITE_START_ADDRESS]     = (uint8_t)(usDataStartAddress << 8);
+    pucResponse[WRITE_START_ADDRESS]     = (uint8_t)(usDataStartAddress >> 8);
     pucResponse[WRITE_START_ADDRESS + 1] = (uint8_t)(usDataStartAddress & 0xFF);
-    pucResponse[WRITE_NUM_OF_DATA ]      = (uint8_t)(usNumOfData << 8);
+    pucResponse[WRITE_NUM_OF_DATA ]      = (uint8_t)(usNumOfData >> 8);
     pucResponse[WRITE_NUM_OF_DATA + 1]   = (uint8_t)(usNumOfData & 0xFF);
 
-    uint8_t  ucCount           = 0;
+    uint16_t usCount           = 0;
     uint16_t usTmpStartAddress = usStartAddress;
     uint16_t usTmpNumOfData    = usNumOfData;
 
@@ -818,13 +1628,13 @@ static uint16_t WriteMultipleHoldingRegisters(const uint8_t *pucQuery, uint8_t *
     {
         uint16_t usValue = 0;
 
-        usValue  = (uint16_t)(pucQuery[WRITE_VALUE_OFFSET + ucCount] << 8);
-        ucCount++;
-        usValue |= (uint16_t)(pucQuery[WRITE_VALUE_OFFSET + ucCount]);
-        ucCount++;
+        usValue  = (uint16_t)(pucQuery[WRITE_VALUE_OFFSET + usCount] << 8);
+        usCount++;
+        usValue |= (uint16_t)(pucQuery[WRITE_VALUE_OFFSET + usCount]);
+        usCount++;
 
-        if ( !((m_tModbusData.psHoldingRegisterHigherLimit[usStartAddress] >= (int16_t) usValue) &&
-            (m_tModbusData.psHoldingRegisterLowerLimit[usStartAddress] <= (int16_t) usValue)))
+        if ( !((ptData->psHoldingRegisterHigherLimit[usStartAddress] >= (int16_t) usValue) &&
+            (ptData->psHoldingRegisterLowerLimit[usStartAddress] <= (int16_t) usValue)))
         {
             bException = true;
         }
@@ -840,7 +1650,7 @@ static uint16_t WriteMultipleHoldingRegisters(const uint8_t *pucQuery, uint8_t *
         MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal data value\r\n");
 
         usPduLen                                    = MBAP_LEN_IN_EXCEPTION_PACKET;
-        pucResponse[MBAP_LEN_OFFSET]                = (uint8_t)(usPduLen << 8);
+        pucResponse[MBAP_LEN_OFFSET]                = (uint8_t)(usPduLen >> 8);
         pucResponse[MBAP_LEN_OFFSET + 1]            = (uint8_t)(usPduLen & 0xFF);
         pucResponse[EXCEPTION_FUNCTION_CODE_OFFSET] = EXCEPTION_START_FUNCTION_CODE + pucQuery[FUNCTION_CODE_OFFSET];
         pucResponse[EXCEPTION_TYPE_OFFSET]          = eILLEGAL_DATA_VALUE;
@@ -850,14 +1660,219 @@ static uint16_t WriteMultipleHoldingRegisters(const uint8_t *pucQuery, uint8_t *
     {
         const uint8_t *pucRegBuf = &pucQuery[WRITE_VALUE_OFFSET];
 
-        usResponseLen = WRITE_HOLDING_REGISTERS_RESPONSE_LEN;
-        m_tModbusData.ptfnWriteHoldingRegisters(usStartAddress, usNumOfData, pucRegBuf);
+        usResponseLen = WriteUnitData(ptRequest, eTABLE_HOLDING_REGISTERS, usStartAddress, usNumOfData,
+                                      pucRegBuf, WRITE_HOLDING_REGISTERS_RESPONSE_LEN);
     }
 
     return (usResponseLen);
 }//end WriteMultipleHoldingRegisters
 #endif//FC_WRITE_HOLDING_REGISTERS_ENABLE
 
+#if FC_READ_HISTORY_ENABLE
+static uint16_t ReadHistory(ModbusRequest_t *ptRequest)
+{
+    const uint8_t *pucQuery    = ptRequest->pucQuery;
+    uint8_t       *pucResponse = ptRequest->pucResponse;
+    uint32_t      ulSince      = 0;
+    uint16_t      usDataLen    = 0;
+    uint16_t      usMbapLen    = 0;
+
+    ulSince  = (uint32_t)pucQuery[HISTORY_SEQUENCE_OFFSET] << 24;
+    ulSince |= (uint32_t)pucQuery[HISTORY_SEQUENCE_OFFSET + 1] << 16;
+    ulSince |= (uint32_t)pucQuery[HISTORY_SEQUENCE_OFFSET + 2] << 8;
+    ulSince |= (uint32_t)pucQuery[HISTORY_SEQUENCE_OFFSET + 3];
+
+    //samples are encoded straight after function code of response
+    usDataLen = mbap_HistoryRead(ptRequest->ptUnit, pucQuery[HISTORY_RANGE_OFFSET], ulSince,
+                                 &pucResponse[MBAP_HEADER_LEN + 1], MAX_ADU_LEN - (MBAP_HEADER_LEN + 1));
+
+    if (0 == usDataLen)
+    {
+        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal history range\r\n");
+        return BuildExceptionPacket(pucQuery, eILLEGAL_DATA_ADDRESS, pucResponse);
+    }
+
+    //Copy MBAP Header and function code into response
+    memcpy(pucResponse, pucQuery, (MBAP_HEADER_LEN + 1));
+
+    usMbapLen                        = (uint16_t)(2u + usDataLen);
+    pucResponse[MBAP_LEN_OFFSET]     = (uint8_t)(usMbapLen >> 8);
+    pucResponse[MBAP_LEN_OFFSET + 1] = (uint8_t)(usMbapLen & 0xFF);
+
+    return (uint16_t)(MBAP_HEADER_LEN + 1 + usDataLen);
+}//end ReadHistory
+#endif//FC_READ_HISTORY_ENABLE
+
+#if FC_SUBSCRIBE_ENABLE
+static uint16_t Subscribe(ModbusRequest_t *ptRequest)
+{
+    const uint8_t *pucQuery       = ptRequest->pucQuery;
+    uint8_t       *pucResponse    = ptRequest->pucResponse;
+    uint16_t      usStartAddress  = 0;
+    uint16_t      usNumOfData     = 0;
+    uint16_t      usDeadband      = 0;
+    uint16_t      usMinIntervalMs = 0;
+    uint16_t      usDataLen       = 0;
+    uint16_t      usMbapLen       = 0;
+    uint8_t       ucException     = 0;
+
+    usStartAddress  = (uint16_t)((pucQuery[SUBSCRIBE_START_ADDRESS_OFFSET] << 8) | pucQuery[SUBSCRIBE_START_ADDRESS_OFFSET + 1]);
+    usNumOfData     = (uint16_t)((pucQuery[SUBSCRIBE_NUM_OF_DATA_OFFSET] << 8) | pucQuery[SUBSCRIBE_NUM_OF_DATA_OFFSET + 1]);
+    usDeadband      = (uint16_t)((pucQuery[SUBSCRIBE_DEADBAND_OFFSET] << 8) | pucQuery[SUBSCRIBE_DEADBAND_OFFSET + 1]);
+    usMinIntervalMs = (uint16_t)((pucQuery[SUBSCRIBE_INTERVAL_OFFSET] << 8) | pucQuery[SUBSCRIBE_INTERVAL_OFFSET + 1]);
+
+    //data of range is encoded straight after function code of response
+    ucException = mbap_SubscriptionAdd(ptRequest, pucQuery[SUBSCRIBE_TABLE_OFFSET], usStartAddress, usNumOfData,
+                                       usDeadband, usMinIntervalMs, &pucResponse[MBAP_HEADER_LEN + 1], &usDataLen);
+
+    if (eNO_EXCEPTION != ucException)
+    {
+        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Subscription not added\r\n");
+        return BuildExceptionPacket(pucQuery, ucException, pucResponse);
+    }
+
+    //Copy MBAP Header and function code into response
+    memcpy(pucResponse, pucQuery, (MBAP_HEADER_LEN + 1));
+
+    usMbapLen                        = (uint16_t)(2u + usDataLen);
+    pucResponse[MBAP_LEN_OFFSET]     = (uint8_t)(usMbapLen >> 8);
+    pucResponse[MBAP_LEN_OFFSET + 1] = (uint8_t)(usMbapLen & 0xFF);
+
+    return (uint16_t)(MBAP_HEADER_LEN + 1 + usDataLen);
+}//end Subscribe
+
+static uint16_t CancelSubscription(ModbusRequest_t *ptRequest)
+{
+    const uint8_t *pucQuery    = ptRequest->pucQuery;
+    uint8_t       *pucResponse = ptRequest->pucResponse;
+
+    if (!mbap_SubscriptionCancel(ptRequest->pvConnection, pucQuery[SUBSCRIPTION_ID_OFFSET]))
+    {
+        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Illegal subscription id\r\n");
+        return BuildExceptionPacket(pucQuery, eILLEGAL_DATA_ADDRESS, pucResponse);
+    }
+
+    //response echoes query
+    memcpy(pucResponse, pucQuery, CANCEL_SUBSCRIPTION_RESPONSE_LEN);
+
+    return CANCEL_SUBSCRIPTION_RESPONSE_LEN;
+}//end CancelSubscription
+#endif//FC_SUBSCRIBE_ENABLE
+
+#if FC_CONDITIONAL_READ_ENABLE
+static uint16_t ConditionalRead(ModbusRequest_t *ptRequest)
+{
+    const ModbusData_t *ptData      = ptRequest->ptUnit->ptModbusData;
+    const uint8_t      *pucQuery    = ptRequest->pucQuery;
+    uint8_t            *pucResponse = ptRequest->pucResponse;
+    uint8_t            ucTable      = pucQuery[CONDITIONAL_READ_TABLE_OFFSET];
+    uint16_t usDataStartAddress = 0;
+    uint16_t usNumOfData        = 0;
+    uint16_t usStartAddress     = 0;
+    uint16_t usByteCount        = 0;
+    uint16_t usMbapLen          = 0;
+    uint32_t ulSince            = 0;
+    uint32_t ulVersion          = 0;
+
+    usDataStartAddress = (uint16_t)((pucQuery[CONDITIONAL_READ_START_ADDRESS_OFFSET] << 8) |
+                                    pucQuery[CONDITIONAL_READ_START_ADDRESS_OFFSET + 1]);
+    usNumOfData        = (uint16_t)((pucQuery[CONDITIONAL_READ_NUM_OF_DATA_OFFSET] << 8) |
+                                    pucQuery[CONDITIONAL_READ_NUM_OF_DATA_OFFSET + 1]);
+    ulSince            = (uint32_t)pucQuery[CONDITIONAL_READ_VERSION_OFFSET] << 24;
+    ulSince           |= (uint32_t)pucQuery[CONDITIONAL_READ_VERSION_OFFSET + 1] << 16;
+    ulSince           |= (uint32_t)pucQuery[CONDITIONAL_READ_VERSION_OFFSET + 2] << 8;
+    ulSince           |= (uint32_t)pucQuery[CONDITIONAL_READ_VERSION_OFFSET + 3];
+
+    usStartAddress = (uint16_t)(usDataStartAddress - TableStartAddress(ptData, ucTable));
+    usByteCount    = TableByteCount(ucTable, usNumOfData);
+
+    //version before data, a write while reading shows as a change next time
+    ulVersion = mbap_ChangeVersion(ptRequest->ptUnit, ucTable, usStartAddress, usNumOfData);
+
+    //Copy MBAP Header and function code into response
+    memcpy(pucResponse, pucQuery, (MBAP_HEADER_LEN + 1));
+
+    //version 0 always reads, clients start with it
+    if ((0 != ulSince) && (ulSince == ulVersion))
+    {
+        pucResponse[MBAP_LEN_OFFSET]     = 0;
+        pucResponse[MBAP_LEN_OFFSET + 1] = 2u;
+
+        return CONDITIONAL_READ_UNCHANGED_RESPONSE_LEN;
+    }
+
+    //Unit Id(1 byte) + function code(1 byte) + version(4 bytes) + Byte Count(1 byte) + data
+    usMbapLen                                                 = (uint16_t)(7u + usByteCount);
+    pucResponse[MBAP_LEN_OFFSET]                              = (uint8_t)(usMbapLen >> 8);
+    pucResponse[MBAP_LEN_OFFSET + 1]                          = (uint8_t)(usMbapLen & 0xFF);
+    pucResponse[CONDITIONAL_READ_RESPONSE_VERSION_OFFSET]     = (uint8_t)(ulVersion >> 24);
+    pucResponse[CONDITIONAL_READ_RESPONSE_VERSION_OFFSET + 1] = (uint8_t)(ulVersion >> 16);
+    pucResponse[CONDITIONAL_READ_RESPONSE_VERSION_OFFSET + 2] = (uint8_t)(ulVersion >> 8);
+    pucResponse[CONDITIONAL_READ_RESPONSE_VERSION_OFFSET + 3] = (uint8_t)ulVersion;
+    pucResponse[CONDITIONAL_READ_BYTE_COUNT_OFFSET]           = (uint8_t)usByteCount;
+
+    return ReadUnitData(ptRequest, ucTable, usStartAddress, usNumOfData, &pucResponse[CONDITIONAL_READ_DATA_OFFSET],
+                        (uint16_t)(CONDITIONAL_READ_DATA_OFFSET + usByteCount));
+}//end ConditionalRead
+#endif//FC_CONDITIONAL_READ_ENABLE
+
+#if FC_READ_MULTIPLE_RANGES_ENABLE
+static uint16_t ReadMultipleRanges(ModbusRequest_t *ptRequest)
+{
+    const ModbusData_t *ptData        = ptRequest->ptUnit->ptModbusData;
+    const uint8_t      *pucQuery      = ptRequest->pucQuery;
+    const uint8_t      *pucDescriptor = &pucQuery[RANGES_DESCRIPTORS_OFFSET];
+    uint8_t            *pucResponse   = ptRequest->pucResponse;
+    uint8_t            ucNumOfRanges  = pucQuery[RANGES_NUM_OF_RANGES_OFFSET];
+    uint8_t            ucRange        = 0;
+    uint16_t           usResponseLen  = RANGES_DATA_OFFSET;
+    uint16_t           usMbapLen      = 0;
+
+    //Copy MBAP Header, function code and number of ranges into response
+    memcpy(pucResponse, pucQuery, RANGES_DATA_OFFSET);
+
+    for (ucRange = 0; ucRange < ucNumOfRanges; ucRange++)
+    {
+        uint8_t  ucTable     = pucDescriptor[0];
+        uint16_t usAddress   = (uint16_t)((pucDescriptor[1] << 8) | pucDescriptor[2]);
+        uint16_t usNumOfData = (uint16_t)((pucDescriptor[3] << 8) | pucDescriptor[4]);
+        uint16_t usByteCount = TableByteCount(ucTable, usNumOfData);
+        uint8_t  ucException = eNO_EXCEPTION;
+
+        ptRequest->ucTable        = ucTable;
+        ptRequest->bWrite         = false;
+        ptRequest->usStartAddress = (uint16_t)(usAddress - TableStartAddress(ptData, ucTable));
+        ptRequest->usNumOfData    = usNumOfData;
+        ptRequest->pucReadData    = &pucResponse[usResponseLen + 1u];
+        ptRequest->pucWriteData   = NULL;
+
+        //ranges are read one after the other in calling thread, a range the
+        //asynchronous access function would defer must not be read here
+        if ((NULL != ptRequest->ptfnDone) && mbap_IsAsyncRange(ptRequest))
+        {
+            return BuildExceptionPacket(pucQuery, eILLEGAL_FUNCTION_CODE, pucResponse);
+        }
+
+        pucResponse[usResponseLen] = (uint8_t)usByteCount;
+        ucException                = mbap_AccessRequestData(ptRequest);
+
+        if (eNO_EXCEPTION != ucException)
+        {
+            return BuildExceptionPacket(pucQuery, ucException, pucResponse);
+        }
+
+        usResponseLen  = (uint16_t)(usResponseLen + 1u + usByteCount);
+        pucDescriptor += RANGE_DESCRIPTOR_LEN;
+    }
+
+    usMbapLen                        = (uint16_t)(usResponseLen - (MBAP_HEADER_LEN - 1u));
+    pucResponse[MBAP_LEN_OFFSET]     = (uint8_t)(usMbapLen >> 8);
+    pucResponse[MBAP_LEN_OFFSET + 1] = (uint8_t)(usMbapLen & 0xFF);
+
+    return usResponseLen;
+}//end ReadMultipleRanges
+#endif//FC_READ_MULTIPLE_RANGES_ENABLE
+
 /******************************************************************************
  *                             End of file
  ******************************************************************************/
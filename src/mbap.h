@@ -29,7 +29,12 @@ enum FunctionCode
     eFC_WRITE_COIL              = 5,  //!< Write Single Coil Function Code
     eFC_WRITE_HOLDING_REGISTER  = 6,  //!< Write Single Holding Register Function Code
     eFC_WRITE_COILS             = 15, //!< Write Multiple Coils Function Code
-    eFC_WRITE_HOLDING_REGISTERS = 16  //!< Write Multiple Holding Registers Function Code
+    eFC_WRITE_HOLDING_REGISTERS = 16, //!< Write Multiple Holding Registers Function Code
+    eFC_READ_HISTORY            = 65, //!< Read History Samples, user defined Function Code
+    eFC_SUBSCRIBE               = 66, //!< Subscribe to changes of a range, user defined Function Code
+    eFC_CANCEL_SUBSCRIPTION     = 67, //!< Cancel Subscription, user defined Function Code
+    eFC_CONDITIONAL_READ        = 68, //!< Read range if changed since version, user defined Function Code
+    eFC_READ_MULTIPLE_RANGES    = 69  //!< Read ranges of several tables, user defined Function Code
 };
 
 //!Modbus Exception
@@ -38,7 +43,22 @@ enum Exception
     eNO_EXCEPTION          = 0,     //!< No Exception
     eILLEGAL_FUNCTION_CODE = 1,     //!< Illegal Function Code
     eILLEGAL_DATA_ADDRESS  = 2,     //!< Illegal Data Address
-    eILLEGAL_DATA_VALUE    = 3      //!< Illegal Data Value
+    eILLEGAL_DATA_VALUE    = 3,     //!< Illegal Data Value
+    eSERVER_DEVICE_FAILURE = 4,     //!< Server Device Failure
+    eSERVER_BUSY           = 6,     //!< Server Device Busy
+    eASYNC_PENDING         = 0xFF   //!< Asynchronous access completes later(not sent)
+};
+
+//! @brief Response length while asynchronous access is pending
+#define MBAP_RESPONSE_PENDING   (0xFFFFu)
+
+//!Modbus Data Tables
+enum DataTable
+{
+    eTABLE_COILS             = 0,   //!< Coils
+    eTABLE_DISCRETE_INPUTS   = 1,   //!< Discrete Inputs
+    eTABLE_HOLDING_REGISTERS = 2,   //!< Holding Registers
+    eTABLE_INPUT_REGISTERS   = 3    //!< Input Registers
 };
 
 //! @brief  Read Coils Function Code enable or not
@@ -97,6 +117,90 @@ enum Exception
 #define FC_WRITE_HOLDING_REGISTERS_ENABLE   0
 #endif // MBT_CONF_FC_WRITE_HOLDING_REGISTERS_ENABLE
 
+//! @brief Read History Function Code enable or not
+#ifdef MBT_CONF_FC_READ_HISTORY_ENABLE
+#define FC_READ_HISTORY_ENABLE  MBT_CONF_FC_READ_HISTORY_ENABLE
+#else // MBT_CONF_FC_READ_HISTORY_ENABLE
+#define FC_READ_HISTORY_ENABLE  0
+#endif // MBT_CONF_FC_READ_HISTORY_ENABLE
+
+//! @brief Subscribe and Cancel Subscription Function Codes enable or not
+#ifdef MBT_CONF_FC_SUBSCRIBE_ENABLE
+#define FC_SUBSCRIBE_ENABLE     MBT_CONF_FC_SUBSCRIBE_ENABLE
+#else // MBT_CONF_FC_SUBSCRIBE_ENABLE
+#define FC_SUBSCRIBE_ENABLE     0
+#endif // MBT_CONF_FC_SUBSCRIBE_ENABLE
+
+//! @brief Conditional Read Function Code enable or not
+#ifdef MBT_CONF_FC_CONDITIONAL_READ_ENABLE
+#define FC_CONDITIONAL_READ_ENABLE  MBT_CONF_FC_CONDITIONAL_READ_ENABLE
+#else // MBT_CONF_FC_CONDITIONAL_READ_ENABLE
+#define FC_CONDITIONAL_READ_ENABLE  0
+#endif // MBT_CONF_FC_CONDITIONAL_READ_ENABLE
+
+//! @brief Read Multiple Ranges Function Code enable or not
+#ifdef MBT_CONF_FC_READ_MULTIPLE_RANGES_ENABLE
+#define FC_READ_MULTIPLE_RANGES_ENABLE  MBT_CONF_FC_READ_MULTIPLE_RANGES_ENABLE
+#else // MBT_CONF_FC_READ_MULTIPLE_RANGES_ENABLE
+#define FC_READ_MULTIPLE_RANGES_ENABLE  0
+#endif // MBT_CONF_FC_READ_MULTIPLE_RANGES_ENABLE
+
+//! @brief Maximum number of units addressed by extension key
+#ifdef MBT_CONF_MAX_EXT_UNITS
+#define MAX_EXT_UNITS   MBT_CONF_MAX_EXT_UNITS
+#else // MBT_CONF_MAX_EXT_UNITS
+#define MAX_EXT_UNITS   0
+#endif // MBT_CONF_MAX_EXT_UNITS
+
+//! @brief Number of private copy-on-write pages shared by all profile units
+#ifdef MBT_CONF_UNIT_PAGE_POOL_SIZE
+#define UNIT_PAGE_POOL_SIZE MBT_CONF_UNIT_PAGE_POOL_SIZE
+#else // MBT_CONF_UNIT_PAGE_POOL_SIZE
+#define UNIT_PAGE_POOL_SIZE 64
+#endif // MBT_CONF_UNIT_PAGE_POOL_SIZE
+
+//! @brief Per function code statistics enable or not
+#ifdef MBT_CONF_STATS_ENABLE
+#define STATS_ENABLE    MBT_CONF_STATS_ENABLE
+#else // MBT_CONF_STATS_ENABLE
+#define STATS_ENABLE    0
+#endif // MBT_CONF_STATS_ENABLE
+
+//! @brief Number of threads counting statistics
+#ifdef MBT_CONF_STATS_THREADS
+#define STATS_THREADS   MBT_CONF_STATS_THREADS
+#else // MBT_CONF_STATS_THREADS
+#define STATS_THREADS   4
+#endif // MBT_CONF_STATS_THREADS
+
+//! @brief Number of function codes with own statistics
+#ifdef MBT_CONF_STATS_FC_SLOTS
+#define STATS_FC_SLOTS  MBT_CONF_STATS_FC_SLOTS
+#else // MBT_CONF_STATS_FC_SLOTS
+#define STATS_FC_SLOTS  12
+#endif // MBT_CONF_STATS_FC_SLOTS
+
+//! @brief Number of register ranges sampled into history
+#ifdef MBT_CONF_HISTORY_RANGES
+#define HISTORY_RANGES  MBT_CONF_HISTORY_RANGES
+#else // MBT_CONF_HISTORY_RANGES
+#define HISTORY_RANGES  4
+#endif // MBT_CONF_HISTORY_RANGES
+
+//! @brief Number of history blocks shared by the rings of all ranges
+#ifdef MBT_CONF_HISTORY_POOL_BLOCKS
+#define HISTORY_POOL_BLOCKS MBT_CONF_HISTORY_POOL_BLOCKS
+#else // MBT_CONF_HISTORY_POOL_BLOCKS
+#define HISTORY_POOL_BLOCKS 64
+#endif // MBT_CONF_HISTORY_POOL_BLOCKS
+
+//! @brief Number of subscriptions of all connections, at most 256
+#ifdef MBT_CONF_SUBSCRIPTIONS
+#define SUBSCRIPTIONS   MBT_CONF_SUBSCRIPTIONS
+#else // MBT_CONF_SUBSCRIPTIONS
+#define SUBSCRIPTIONS   16
+#endif // MBT_CONF_SUBSCRIPTIONS
+
 //****************************************************************************
 //                           Global variables
 //****************************************************************************
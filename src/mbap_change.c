@@ -0,0 +1,207 @@
+//! @addtogroup ModbusTCPChange
+//! @brief Change tracking of the data tables
+//! @{
+//!
+//****************************************************************************/
+//! @file mbap_change.c
+//! @brief Per block version counters of the data tables. A version of a range
+//!        is the epoch plus the sum of its block versions, which rises with
+//!        every write of any of its blocks. Blocks of a profile unit are
+//!        spread over the counters by a multiplicative hash of the unit index.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+//user defined header files
+#include "mbap_conf.h"
+#include "mbap.h"
+#include "mbap_unit.h"
+#include "mbap_change.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+#define NUM_OF_TABLES               (4u)
+//blocks covering all 16 bit addresses of a register table
+#define MAX_BLOCKS                  (0x10000u / CHANGE_BLOCK_REGISTERS)
+//Knuth multiplicative hash of unit index
+#define UNIT_HASH                   (2654435761u)
+
+//counters of tables of user functions are not shared with each other
+typedef char ChangeSlotsCheck_t[(CHANGE_SLOTS >= NUM_OF_TABLES * MAX_BLOCKS) &&
+                                (0 == (CHANGE_SLOTS & (CHANGE_SLOTS - 1u))) ? 1 : -1];
+
+//****************************************************************************/
+//                           Private Functions
+//****************************************************************************/
+//
+//! @brief Blocks of a range
+//! @param[in]   ucTable         Table
+//! @param[in]   usStartAddress  First data
+//! @param[in]   usNumOfData     Number of data, not 0
+//! @param[out]  pulFirst        First block
+//! @return      uint32_t        Last block
+//
+static uint32_t GetBlocks(uint8_t ucTable, uint16_t usStartAddress, uint16_t usNumOfData, uint32_t *pulFirst);
+
+//
+//! @brief Counter of a block
+//! @param[in]   ulUnitHash  Hash of unit, 0 - tables of user functions
+//! @param[in]   ucTable     Table
+//! @param[in]   ulBlock     Block
+//! @return      uint32_t*   Counter
+//
+static uint32_t *GetSlot(uint32_t ulUnitHash, uint8_t ucTable, uint32_t ulBlock);
+
+//
+//! @brief Hash of unit keying its counters
+//! @param[in]   ptUnit    Unit, NULL - tables of user functions
+//! @return      uint32_t  Hash, 0 - tables of user functions
+//
+static uint32_t HashUnit(const ModbusUnit_t *ptUnit);
+
+//****************************************************************************/
+//                           Private variables
+//****************************************************************************/
+static uint32_t m_aulVersions[CHANGE_SLOTS];
+static uint32_t m_ulNumOfMarks;
+static uint32_t m_ulEpoch;
+//counters of writers which do not mark their writes, per table of user functions
+static const uint32_t *m_apulWatched[NUM_OF_TABLES];
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+void mbap_ChangeSetEpoch(uint32_t ulEpoch)
+{
+    __atomic_store_n(&m_ulEpoch, ulEpoch, __ATOMIC_RELEASE);
+}//end mbap_ChangeSetEpoch
+
+void mbap_ChangeWatch(uint8_t ucTable, const uint32_t *pulCounter)
+{
+    if (ucTable < NUM_OF_TABLES)
+    {
+        __atomic_store_n(&m_apulWatched[ucTable], pulCounter, __ATOMIC_RELEASE);
+    }
+}//end mbap_ChangeWatch
+
+void mbap_ChangeMark(const ModbusUnit_t *ptUnit, uint8_t ucTable, uint16_t usStartAddress, uint16_t usNumOfData)
+{
+    uint32_t ulUnitHash = HashUnit(ptUnit);
+    uint32_t ulBlock    = 0;
+    uint32_t ulLast     = 0;
+
+    if ((ucTable >= NUM_OF_TABLES) || (0 == usNumOfData))
+    {
+        return;
+    }
+
+    ulLast = GetBlocks(ucTable, usStartAddress, usNumOfData, &ulBlock);
+
+    for (; ulBlock <= ulLast; ulBlock++)
+    {
+        //data written before is seen by readers of the new version
+        __atomic_fetch_add(GetSlot(ulUnitHash, ucTable, ulBlock), 1u, __ATOMIC_RELEASE);
+    }
+
+    __atomic_fetch_add(&m_ulNumOfMarks, 1u, __ATOMIC_RELEASE);
+}//end mbap_ChangeMark
+
+uint32_t mbap_ChangeVersion(const ModbusUnit_t *ptUnit, uint8_t ucTable, uint16_t usStartAddress,
+                            uint16_t usNumOfData)
+{
+    uint32_t ulVersion  = __atomic_load_n(&m_ulEpoch, __ATOMIC_ACQUIRE);
+    uint32_t ulUnitHash = HashUnit(ptUnit);
+    uint32_t ulBlock    = 0;
+    uint32_t ulLast     = 0;
+    const uint32_t *pulWatched = NULL;
+
+    if ((ucTable >= NUM_OF_TABLES) || (0 == usNumOfData))
+    {
+        return ulVersion;
+    }
+
+    ulLast     = GetBlocks(ucTable, usStartAddress, usNumOfData, &ulBlock);
+    pulWatched = __atomic_load_n(&m_apulWatched[ucTable], __ATOMIC_ACQUIRE);
+
+    //writes of unmarking writers move the whole table
+    if ((0 == ulUnitHash) && (NULL != pulWatched))
+    {
+        ulVersion += __atomic_load_n(pulWatched, __ATOMIC_ACQUIRE);
+    }
+
+    for (; ulBlock <= ulLast; ulBlock++)
+    {
+        ulVersion += __atomic_load_n(GetSlot(ulUnitHash, ucTable, ulBlock), __ATOMIC_ACQUIRE);
+    }
+
+    return ulVersion;
+}//end mbap_ChangeVersion
+
+uint32_t mbap_ChangeCount(void)
+{
+    uint32_t       ulCount    = __atomic_load_n(&m_ulNumOfMarks, __ATOMIC_ACQUIRE);
+    const uint32_t *pulWatched = NULL;
+    uint8_t        ucTable    = 0;
+
+    //writes of unmarking writers count as well
+    for (ucTable = 0; ucTable < NUM_OF_TABLES; ucTable++)
+    {
+        pulWatched = __atomic_load_n(&m_apulWatched[ucTable], __ATOMIC_ACQUIRE);
+
+        if (NULL != pulWatched)
+        {
+            ulCount += __atomic_load_n(pulWatched, __ATOMIC_ACQUIRE);
+        }
+    }
+
+    return ulCount;
+}//end mbap_ChangeCount
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static uint32_t GetBlocks(uint8_t ucTable, uint16_t usStartAddress, uint16_t usNumOfData, uint32_t *pulFirst)
+{
+    uint32_t ulBlockLen = ((eTABLE_COILS == ucTable) || (eTABLE_DISCRETE_INPUTS == ucTable)) ?
+                          CHANGE_BLOCK_BITS : CHANGE_BLOCK_REGISTERS;
+    uint32_t ulEnd      = (uint32_t)usStartAddress + usNumOfData;
+
+    //range beyond address space is cut
+    if (ulEnd > 0x10000u)
+    {
+        ulEnd = 0x10000u;
+    }
+
+    *pulFirst = usStartAddress / ulBlockLen;
+
+    return (ulEnd - 1u) / ulBlockLen;
+}//end GetBlocks
+
+static uint32_t *GetSlot(uint32_t ulUnitHash, uint8_t ucTable, uint32_t ulBlock)
+{
+    return &m_aulVersions[(((uint32_t)ucTable * MAX_BLOCKS + ulBlock) ^ ulUnitHash) & (CHANGE_SLOTS - 1u)];
+}//end GetSlot
+
+static uint32_t HashUnit(const ModbusUnit_t *ptUnit)
+{
+    //index is counted from 1, so that unit index 0 does not take counters of shared tables
+    if ((NULL == ptUnit) || (NULL == ptUnit->ptProfile))
+    {
+        return 0;
+    }
+
+    return ((uint32_t)ptUnit->usIndex + 1u) * UNIT_HASH;
+}//end HashUnit
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
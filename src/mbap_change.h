@@ -0,0 +1,105 @@
+//! @addtogroup ModbusTCPChange
+//! @{
+//
+//****************************************************************************
+//! @file mbap_change.h
+//! @brief This contains the prototypes, macros, constants or global variables
+//!        for change tracking of the data tables.
+//!
+//!        Every table is split into blocks of CHANGE_BLOCK_REGISTERS registers
+//!        or CHANGE_BLOCK_BITS coils or discrete inputs. A block version is
+//!        incremented after every write into the block, by writes of clients
+//!        in the modbus application and by producers updating tables in
+//!        place. Profile units keep versions of their own, as their private
+//!        pages are written by nobody else. Units served by user functions
+//!        may share storage and share one set of versions. Versions are kept
+//!        in CHANGE_SLOTS counters hashed by unit, table and block, so a
+//!        write may show a change to readers of another block, a change is
+//!        never missed. Tables of user functions written in place by other
+//!        processes, which do not mark their writes here, add a counter moved
+//!        by every write of the table, e.g. the sequence of a shared image
+//!        region. Versions start at the epoch set at startup, so that
+//!        versions held by clients across a restart of the server do not
+//!        match by chance.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//
+//****************************************************************************
+#ifndef MBAP_CHANGE_H
+#define MBAP_CHANGE_H
+
+//****************************************************************************
+//                           Includes
+//****************************************************************************
+
+//****************************************************************************
+//                           Constants and typedefs
+//****************************************************************************
+//! @brief Registers of a block
+#define CHANGE_BLOCK_REGISTERS            (16u)
+//! @brief Coils or discrete inputs of a block
+#define CHANGE_BLOCK_BITS                 (256u)
+//! @brief Number of version counters, power of 2. Blocks of units served by
+//!        user functions fill them exactly, profile units share them.
+#define CHANGE_SLOTS                      (4u * (0x10000u / CHANGE_BLOCK_REGISTERS))
+
+//****************************************************************************
+//                           Global variables
+//****************************************************************************
+
+//****************************************************************************
+//                           Global Functions
+//****************************************************************************
+//
+//! @brief Set epoch added to all versions, called once before serving
+//! @param[in]  ulEpoch  Epoch, e.g. from time and process id
+//! @return     None
+//
+void mbap_ChangeSetEpoch(uint32_t ulEpoch);
+
+//
+//! @brief Add a counter moved by every write of a table of user functions
+//!        to versions of the whole table, for writers which do not mark
+//!        their writes, e.g. other processes sharing a register image
+//! @param[in]  ucTable      Table(enum DataTable)
+//! @param[in]  pulCounter   Counter, must stay valid, NULL - none
+//! @return     None
+//
+void mbap_ChangeWatch(uint8_t ucTable, const uint32_t *pulCounter);
+
+//
+//! @brief Mark data as written, called after data is written, may be called
+//!        from any thread
+//! @param[in]  ptUnit          Unit written, NULL - tables of user functions
+//! @param[in]  ucTable         Table(enum DataTable)
+//! @param[in]  usStartAddress  First data relative to table start
+//! @param[in]  usNumOfData     Number of data
+//! @return     None
+//
+void mbap_ChangeMark(const struct ModbusUnit *ptUnit, uint8_t ucTable, uint16_t usStartAddress, uint16_t usNumOfData);
+
+//
+//! @brief Version of data, differs from an earlier version once data was
+//!        written since. Taken before data is read, so that a write while
+//!        reading shows as a change next time.
+//! @param[in]  ptUnit          Unit read, NULL - tables of user functions
+//! @param[in]  ucTable         Table(enum DataTable)
+//! @param[in]  usStartAddress  First data relative to table start
+//! @param[in]  usNumOfData     Number of data
+//! @return     uint32_t        Version
+//
+uint32_t mbap_ChangeVersion(const struct ModbusUnit *ptUnit, uint8_t ucTable, uint16_t usStartAddress, uint16_t usNumOfData);
+
+//
+//! @brief Number of marks of all tables and watched counters, a cheap check
+//!        whether anything changed
+//! @param[in]  None
+//! @return     uint32_t  Number of marks
+//
+uint32_t mbap_ChangeCount(void);
+
+#endif // MBAP_CHANGE_H
+//****************************************************************************
+//                             End of file
+//****************************************************************************
+//! @}
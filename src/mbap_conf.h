@@ -44,6 +44,14 @@ typedef void(*pfnWriteCoils)(uint16_t usStartAddress,
                              int16_t sNumOfData,
                              const uint8_t *pucWriteBuf);
 
+typedef struct ModbusRequest ModbusRequest_t;
+
+typedef uint8_t(*pfnAsyncAccess)(ModbusRequest_t *ptRequest);
+
+typedef bool(*pfnIsAsyncRange)(const ModbusRequest_t *ptRequest);
+
+typedef void(*pfnRequestDone)(ModbusRequest_t *ptRequest);
+
 typedef struct ModbusData
 {
     int16_t                       *psHoldingRegisterLowerLimit;  //!<Pointer to Holding Register Lower Limits
@@ -62,8 +70,39 @@ typedef struct ModbusData
     pfnReadCoils                  ptfnReadCoils;                 //!<Read Coils function
     pfnWriteHoldingRegisters      ptfnWriteHoldingRegisters;     //!<Write Holding Registers function
     pfnWriteCoils                 ptfnWriteCoils;                //!<Write Coils function
+    pfnAsyncAccess                ptfnAsyncAccess;               //!<Asynchronous access function, NULL - synchronous functions only
+    pfnIsAsyncRange               ptfnIsAsyncRange;              //!<Tells whether asynchronous access function defers range of
+                                                                 //!<request, NULL - every range may be deferred
 } ModbusData_t;
 
+//! @brief Modbus request submitted by transport.
+//!        Asynchronous access function reads ucTable, bWrite, usStartAddress,
+//!        usNumOfData and pucReadData/pucWriteData, returns eASYNC_PENDING and
+//!        later calls mbap_CompleteRequest.
+struct ModbusRequest
+{
+    const uint8_t           *pucQuery;        //!<Query, must stay valid until request is done
+    uint8_t                 *pucResponse;     //!<Response buffer, must stay valid until request is done
+    uint16_t                usQueryLen;       //!<Query length
+    uint16_t                usResponseLen;    //!<Response length, valid when request is done
+    uint16_t                usExtKey;         //!<Extension key of unit, 0 - unit id table
+    pfnRequestDone          ptfnDone;         //!<Called when pending request is done, NULL - synchronous only
+    void                    *pvContext;       //!<Transport context, not used by modbus application
+    uint32_t                ulConnectionId;   //!<Transport connection, only reported by probes
+    void                    *pvConnection;    //!<Transport connection notifications of subscriptions are
+                                              //!<sent on, NULL - subscriptions not supported
+    uint16_t                usMaxAduLen;      //!<Size of query and response buffers of extended framing,
+                                              //!<0 - Modbus TCP ADU of 260 bytes
+    const struct ModbusUnit *ptUnit;          //!<Unit addressed by query
+    uint8_t                 ucTable;          //!<Data table accessed by user function
+    bool                    bWrite;           //!<true - write access, false - read access
+    uint16_t                usStartAddress;   //!<Start address relative to table start
+    uint16_t                usNumOfData;      //!<Number of data
+    uint8_t                 *pucReadData;     //!<Read access: buffer for data as for synchronous functions
+    const uint8_t           *pucWriteData;    //!<Write access: data as for synchronous functions
+    uint64_t                ullStartTime;     //!<Start of processing for statistics, ns, 0 - not measured
+};
+
 //! @brief Enable or Disable Read Coils  Function Code
 #define MBT_CONF_FC_READ_COILS_ENABLE               1
 
@@ -88,6 +127,44 @@ typedef struct ModbusData
 //! @brief Enable or Disable Write Single Holding Registers Function Code
 #define MBT_CONF_FC_WRITE_HOLDING_REGISTERS_ENABLE  1
 
+//! @brief Enable or Disable Read History Function Code(user defined)
+#define MBT_CONF_FC_READ_HISTORY_ENABLE             1
+
+//! @brief Enable or Disable Subscribe and Cancel Subscription Function Codes(user defined)
+#define MBT_CONF_FC_SUBSCRIBE_ENABLE                1
+
+//! @brief Enable or Disable Conditional Read Function Code(user defined)
+#define MBT_CONF_FC_CONDITIONAL_READ_ENABLE         1
+
+//! @brief Enable or Disable Read Multiple Ranges Function Code(user defined)
+#define MBT_CONF_FC_READ_MULTIPLE_RANGES_ENABLE     1
+
+//! @brief Maximum number of units addressed by extension key in addition
+//!        to the 256 entry unit id table
+#define MBT_CONF_MAX_EXT_UNITS                      2048
+
+//! @brief Number of private copy-on-write pages shared by all profile units
+#define MBT_CONF_UNIT_PAGE_POOL_SIZE                1024
+
+//! @brief Enable or Disable per function code statistics
+#define MBT_CONF_STATS_ENABLE                       1
+
+//! @brief Number of threads counting statistics, further threads are not counted
+#define MBT_CONF_STATS_THREADS                      8
+
+//! @brief Number of function codes with own statistics, further function
+//!        codes are counted together
+#define MBT_CONF_STATS_FC_SLOTS                     16
+
+//! @brief Number of register ranges sampled into history
+#define MBT_CONF_HISTORY_RANGES                     8
+
+//! @brief Number of history blocks shared by the rings of all ranges
+#define MBT_CONF_HISTORY_POOL_BLOCKS                1024
+
+//! @brief Number of subscriptions of all connections, at most 256
+#define MBT_CONF_SUBSCRIPTIONS                      128
+
 //****************************************************************************
 //                           Global variables
 //****************************************************************************
@@ -111,6 +188,56 @@ void mbap_DataInit(ModbusData_t tModbusData);
 //
 uint16_t mbap_ProcessRequest(const uint8_t *pucQuery, uint8_t ucQueryLen, uint8_t *pucResponse);
 
+//
+//! @brief Process Modbus TCP Application request, user function may complete later
+//! @param[in,out]  ptRequest  Modbus request
+//! @return         uint16_t   Modbus TCP Response Length, MBAP_RESPONSE_PENDING if
+//!                            ptRequest->ptfnDone is called later
+//
+uint16_t mbap_SubmitRequest(ModbusRequest_t *ptRequest);
+
+//
+//! @brief Answer request with an exception without processing it, e.g. when
+//!        transport sheds stale requests
+//! @param[in,out]  ptRequest    Modbus request with query and response buffer
+//! @param[in]      ucException  Exception code for response
+//! @return         uint16_t     Modbus TCP Response Length
+//
+uint16_t mbap_RejectRequest(ModbusRequest_t *ptRequest, uint8_t ucException);
+
+//
+//! @brief Access data of request with synchronous user functions or unit image,
+//!        used by asynchronous access functions which run them in other threads
+//! @param[in,out]  ptRequest  Request passed to asynchronous access function
+//! @return         uint8_t    eNO_EXCEPTION or exception code for response
+//
+uint8_t mbap_AccessRequestData(ModbusRequest_t *ptRequest);
+
+//
+//! @brief Check whether range of request would be deferred by asynchronous
+//!        access function of unit, such range must not be accessed with
+//!        mbap_AccessRequestData by functions reading ranges on their own
+//! @param[in]  ptRequest  Request with unit, table, start address and number of data
+//! @return     bool       true - range is accessed asynchronously
+//
+bool mbap_IsAsyncRange(const ModbusRequest_t *ptRequest);
+
+//
+//! @brief Complete pending request from asynchronous access function
+//! @param[in]  ptRequest    Pending modbus request
+//! @param[in]  ucException  eNO_EXCEPTION or exception code for response
+//! @return     None
+//
+void mbap_CompleteRequest(ModbusRequest_t *ptRequest, uint8_t ucException);
+
+//
+//! @brief Reject writes of clients to all units with illegal function
+//!        exception, e.g. on a standby server. May be set from any thread.
+//! @param[in]  bReadOnly  true - reject writes
+//! @return     None
+//
+void mbap_SetReadOnly(bool bReadOnly);
+
 
 #endif // MBAP_CONF_H
 //****************************************************************************
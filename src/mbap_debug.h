@@ -26,6 +26,14 @@
 #define MBT_DEBUG                                   1
 #define MBT_CONF_DEBUG_WARNING_ENABLE               1
 #define MBT_CONFIG_DEBUG_MSG_ENABLE                 1
+//1 - record debug messages into binary trace rings, 0 - print with printf
+#define MBT_CONF_DEBUG_TRACE                        1
+//Records per trace ring, power of two
+#define MBT_CONF_TRACE_RING_SIZE                    (256u)
+//Number of threads which may record debug messages
+#define MBT_CONF_TRACE_THREADS                      (16u)
+//1 - USDT probes for bpftrace and perf if sys/sdt.h is available, 0 - no probes
+#define MBT_CONF_USDT_PROBES                        1
 
 
 #if MBT_CONF_DEBUG_WARNING_ENABLE
@@ -41,22 +49,69 @@
 #endif //MBT_CONF_DEBUG_DEBUG_ENABLE
 
 
-#ifdef MBT_DEBUG
+#if defined(MBT_DEBUG) && MBT_CONF_DEBUG_TRACE
+#include "mbap_trace.h"
+// record debug message only if debug message type is enabled,
+// message is formatted later by trace drainer
+#define MBT_DEBUGF_ARGS(debug, message, arg0, arg1)    do { \
+                                             if ((debug) & MBT_CONF_DEBUG_MASK)\
+                                             {\
+                                                 mbap_TraceRecord((debug), (message), (arg0), (arg1));\
+                                             }\
+                                        }while(0)
+
+#elif defined(MBT_DEBUG)
 //NOTE: standard I/O header file is chosen because of printf
 //      If some other function is used for printing debug then
 //      header file of that function should be used instead of stdio.h
 #include <stdio.h>
 // print debug message only if debug message type is enabled
-#define MBT_DEBUGF(debug, message)    do { \
-                                             if (debug & MBT_CONF_DEBUG_MASK)\
+#define MBT_DEBUGF_ARGS(debug, message, arg0, arg1)    do { \
+                                             if ((debug) & MBT_CONF_DEBUG_MASK)\
                                              {\
-                                                 printf(message);\
+                                                 printf((message), (unsigned)(arg0), (unsigned)(arg1));\
                                              }\
                                         }while(0)
 
 #else  //MBT_DEBUG
-#define MBT_DEBUGF(debug, message)
+#define MBT_DEBUGF_ARGS(debug, message, arg0, arg1)
 #endif //MBT_DEBUG
+
+// debug message without arguments
+#define MBT_DEBUGF(debug, message)    MBT_DEBUGF_ARGS(debug, message, 0u, 0u)
+
+#if MBT_CONF_USDT_PROBES && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+//NOTE: sys/sdt.h only places a nop and a note section entry per probe,
+//      there is no runtime dependency and no cost while nothing is attached
+#include <sys/sdt.h>
+#define MBT_USDT_AVAILABLE
+#endif //__has_include(<sys/sdt.h>)
+#endif //MBT_CONF_USDT_PROBES
+
+#ifdef MBT_USDT_AVAILABLE
+#define MBT_PROBE2(name, arg0, arg1)    STAP_PROBE2(modbus, name, (arg0), (arg1))
+#define MBT_PROBE5(name, arg0, arg1, arg2, arg3, arg4) \
+                                        STAP_PROBE5(modbus, name, (arg0), (arg1), (arg2), (arg3), (arg4))
+#define MBT_PROBE6(name, arg0, arg1, arg2, arg3, arg4, arg5) \
+                                        STAP_PROBE6(modbus, name, (arg0), (arg1), (arg2), (arg3), (arg4), (arg5))
+#else  //MBT_USDT_AVAILABLE
+#define MBT_PROBE2(name, arg0, arg1)                            do { } while(0)
+#define MBT_PROBE5(name, arg0, arg1, arg2, arg3, arg4)          do { } while(0)
+#define MBT_PROBE6(name, arg0, arg1, arg2, arg3, arg4, arg5)    do { } while(0)
+#endif //MBT_USDT_AVAILABLE
+
+// probe of a query: connection id, transaction id, function code, start address
+// and count as sent by client(value for single writes)
+#define MBT_PROBE_QUERY(name, conn, query)    MBT_PROBE5(name, (uint32_t)(conn), \
+                                             (uint16_t)(((query)[0] << 8) | (query)[1]), (query)[7], \
+                                             (uint16_t)(((query)[8] << 8) | (query)[9]), \
+                                             (uint16_t)(((query)[10] << 8) | (query)[11]))
+// probe of a query with result as sixth argument
+#define MBT_PROBE_QUERY_RESULT(name, conn, query, result)    MBT_PROBE6(name, (uint32_t)(conn), \
+                                             (uint16_t)(((query)[0] << 8) | (query)[1]), (query)[7], \
+                                             (uint16_t)(((query)[8] << 8) | (query)[9]), \
+                                             (uint16_t)(((query)[10] << 8) | (query)[11]), (uint32_t)(result))
 //****************************************************************************
 //                           Global variables
 //****************************************************************************
@@ -0,0 +1,176 @@
+//! @addtogroup ModbusTCPHistogram
+//! @brief Latency histograms
+//! @{
+//!
+//****************************************************************************/
+//! @file mbap_hist.c
+//! @brief Latency histograms with logarithmic buckets. Values below
+//!        HIST_SUB_BUCKETS get a bucket each, every further power of two is
+//!        split into HIST_SUB_BUCKETS buckets.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+//user defined header files
+#include "mbap_hist.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+//Single writer updates with plain load and store, readers see whole values
+#define HIST_LOAD(x)          __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define HIST_STORE(x, v)      __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+
+//****************************************************************************/
+//                           Private Functions
+//****************************************************************************/
+//
+//! @brief Bucket of a value
+//! @param[in]  ulValue   Value
+//! @return     uint16_t  Bucket index
+//
+static uint16_t GetBucket(uint32_t ulValue);
+
+//
+//! @brief Largest value of a bucket
+//! @param[in]  usBucket  Bucket index
+//! @return     uint32_t  Value
+//
+static uint32_t GetBucketUpperBound(uint16_t usBucket);
+
+//****************************************************************************/
+//                           external variables
+//****************************************************************************/
+
+//****************************************************************************/
+//                           Private variables
+//****************************************************************************/
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+void mbap_HistRecord(LatencyHistogram_t *ptHist, uint32_t ulValue)
+{
+    uint16_t usBucket = GetBucket(ulValue);
+
+    HIST_STORE(ptHist->aulCounts[usBucket], ptHist->aulCounts[usBucket] + 1u);
+    HIST_STORE(ptHist->ullSum, ptHist->ullSum + ulValue);
+
+    if (ulValue > ptHist->ulMax)
+    {
+        HIST_STORE(ptHist->ulMax, ulValue);
+    }
+
+    HIST_STORE(ptHist->ulCount, ptHist->ulCount + 1u);
+}//end mbap_HistRecord
+
+void mbap_HistMerge(LatencyHistogram_t *ptInto, const LatencyHistogram_t *ptFrom)
+{
+    uint32_t ulMax    = HIST_LOAD(ptFrom->ulMax);
+    uint16_t usBucket = 0;
+    uint32_t ulCount  = 0;
+
+    //count is summed from buckets, so percentiles stay consistent with counts
+    for (usBucket = 0; usBucket < HIST_NUM_OF_BUCKETS; usBucket++)
+    {
+        uint32_t ulBucketCount = HIST_LOAD(ptFrom->aulCounts[usBucket]);
+
+        ptInto->aulCounts[usBucket] += ulBucketCount;
+        ulCount                     += ulBucketCount;
+    }
+
+    ptInto->ulCount += ulCount;
+    ptInto->ullSum  += HIST_LOAD(ptFrom->ullSum);
+
+    if (ulMax > ptInto->ulMax)
+    {
+        ptInto->ulMax = ulMax;
+    }
+}//end mbap_HistMerge
+
+uint32_t mbap_HistPercentile(const LatencyHistogram_t *ptHist, uint16_t usPerMille)
+{
+    uint64_t ullRank  = 0;
+    uint64_t ullSeen  = 0;
+    uint16_t usBucket = 0;
+    uint32_t ulCount  = 0;
+
+    for (usBucket = 0; usBucket < HIST_NUM_OF_BUCKETS; usBucket++)
+    {
+        ulCount += ptHist->aulCounts[usBucket];
+    }
+
+    if (0 == ulCount)
+    {
+        return 0;
+    }
+
+    //rank of percentile value, rounded up, at least first value
+    ullRank = (((uint64_t)ulCount * usPerMille) + 999u) / 1000u;
+
+    if (0 == ullRank)
+    {
+        ullRank = 1;
+    }
+
+    for (usBucket = 0; usBucket < HIST_NUM_OF_BUCKETS; usBucket++)
+    {
+        ullSeen += ptHist->aulCounts[usBucket];
+
+        if (ullSeen >= ullRank)
+        {
+            uint32_t ulUpper = GetBucketUpperBound(usBucket);
+
+            //bucket bound may exceed largest value recorded
+            return ((0 != ptHist->ulMax) && (ulUpper > ptHist->ulMax)) ? ptHist->ulMax : ulUpper;
+        }
+    }
+
+    return ptHist->ulMax;
+}//end mbap_HistPercentile
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static uint16_t GetBucket(uint32_t ulValue)
+{
+    uint8_t ucMsb = 0;
+
+    if (ulValue < HIST_SUB_BUCKETS)
+    {
+        return (uint16_t)ulValue;
+    }
+
+    ucMsb = (uint8_t)(31 - __builtin_clz(ulValue));
+
+    //one group of sub buckets per power of two above HIST_SUB_BUCKETS
+    return (uint16_t)(((ucMsb - HIST_SUB_BUCKET_BITS + 1u) * HIST_SUB_BUCKETS) +
+                      ((ulValue >> (ucMsb - HIST_SUB_BUCKET_BITS)) & (HIST_SUB_BUCKETS - 1u)));
+}//end GetBucket
+
+static uint32_t GetBucketUpperBound(uint16_t usBucket)
+{
+    uint16_t usGroup = usBucket / HIST_SUB_BUCKETS;
+    uint16_t usSub   = usBucket % HIST_SUB_BUCKETS;
+    uint8_t  ucShift = 0;
+
+    if (0 == usGroup)
+    {
+        return usBucket;
+    }
+
+    ucShift = (uint8_t)(usGroup - 1u);
+
+    return ((((uint32_t)HIST_SUB_BUCKETS + usSub + 1u) << ucShift) - 1u);
+}//end GetBucketUpperBound
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
@@ -0,0 +1,73 @@
+//! @addtogroup ModbusTCPHistogram
+//! @{
+//
+//****************************************************************************
+//! @file mbap_hist.h
+//! @brief This contains the prototypes, macros, constants or global variables
+//!        for latency histograms
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//
+//****************************************************************************
+#ifndef MBAP_HIST_H
+#define MBAP_HIST_H
+
+//****************************************************************************
+//                           Includes
+//****************************************************************************
+
+//****************************************************************************
+//                           Constants and typedefs
+//****************************************************************************
+//! @brief Sub buckets per power of two, values are kept with 12.5% precision
+#define HIST_SUB_BUCKET_BITS              (3u)
+#define HIST_SUB_BUCKETS                  (1u << HIST_SUB_BUCKET_BITS)
+//! @brief Number of buckets covering all 32 bit values
+#define HIST_NUM_OF_BUCKETS               ((32u - HIST_SUB_BUCKET_BITS + 1u) * HIST_SUB_BUCKETS)
+
+//! @brief Latency histogram with logarithmic buckets.
+//!        Written by one thread, may be read by other threads.
+typedef struct LatencyHistogram
+{
+    uint32_t aulCounts[HIST_NUM_OF_BUCKETS];    //!<Number of values per bucket
+    uint32_t ulCount;                           //!<Number of values
+    uint32_t ulMax;                             //!<Largest value
+    uint64_t ullSum;                            //!<Sum of values
+} LatencyHistogram_t;
+
+//****************************************************************************
+//                           Global variables
+//****************************************************************************
+
+//****************************************************************************
+//                           Global Functions
+//****************************************************************************
+//
+//! @brief Record a value, only one thread may record into a histogram
+//! @param[in]  ptHist   Histogram
+//! @param[in]  ulValue  Value, e.g. latency in us
+//! @return     None
+//
+void mbap_HistRecord(LatencyHistogram_t *ptHist, uint32_t ulValue);
+
+//
+//! @brief Add histogram to another, source may be recorded into meanwhile
+//! @param[in,out]  ptInto  Histogram to add to
+//! @param[in]      ptFrom  Histogram added
+//! @return         None
+//
+void mbap_HistMerge(LatencyHistogram_t *ptInto, const LatencyHistogram_t *ptFrom);
+
+//
+//! @brief Value below which given share of recorded values is
+//! @param[in]  ptHist      Histogram
+//! @param[in]  usPerMille  Share in 1/1000, e.g. 990 for 99th percentile
+//! @return     uint32_t    Upper bound of bucket holding percentile, 0 if empty
+//
+uint32_t mbap_HistPercentile(const LatencyHistogram_t *ptHist, uint16_t usPerMille);
+
+#endif // MBAP_HIST_H
+//****************************************************************************
+//                             End of file
+//****************************************************************************
+//! @}
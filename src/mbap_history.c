@@ -0,0 +1,603 @@
+//! @addtogroup ModbusTCPHistory
+//! @brief History of sampled register ranges
+//! @{
+//!
+//****************************************************************************/
+//! @file mbap_history.c
+//! @brief Samples register ranges into rings of delta encoded blocks and
+//!        encodes samples since a sequence for Read History. One thread
+//!        samples, readers copy a block and retry when it was written
+//!        meanwhile, so neither side takes a lock.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+//user defined header files
+#include "mbap_conf.h"
+#include "mbap.h"
+#include "mbap_unit.h"
+#include "mbap_history.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+//Largest encoded sample: time(32 bit varint) and registers(zigzag 16 bit varint)
+#define MAX_SAMPLE_LEN              (5u + (HISTORY_MAX_REGISTERS * 3u))
+//Reader gives up on a block written this often while it was copied
+#define MAX_READ_TRIES              (8u)
+//Read query passed to user functions for sampling
+#define SAMPLE_QUERY_LEN            (12u)
+
+//! @brief Block of samples, ulVersion is odd while block is written
+typedef struct HistoryBlock
+{
+    uint32_t ulVersion;                             //!<Written by sampler, odd while written
+    uint32_t ulFirstSequence;                       //!<Sequence of first sample
+    uint64_t ullFirstTime;                          //!<Time of first sample, ms
+    uint16_t usNumOfSamples;                        //!<Samples in block
+    uint16_t usLen;                                 //!<Bytes of encoded samples
+    uint8_t  aucData[HISTORY_BLOCK_LEN];            //!<Encoded samples
+} HistoryBlock_t;
+
+//! @brief Sampled range
+typedef struct HistoryRange
+{
+    uint8_t        ucUnitId;                        //!<Unit without extension key
+    uint8_t        ucTable;                         //!<Register table
+    uint8_t        ucMode;                          //!<enum HistoryMode
+    uint16_t       usStartAddress;                  //!<First register relative to table start
+    uint16_t       usNumOfData;                     //!<Registers
+    uint32_t       ulPeriodMs;                      //!<Sampling period
+    HistoryBlock_t *ptBlocks;                       //!<Ring of blocks
+    uint16_t       usNumOfBlocks;                   //!<Blocks of ring
+    uint16_t       usHead;                          //!<Sampler, block written
+    uint32_t       ulNextSequence;                  //!<Sequence of next sample, read by readers
+    uint64_t       ullDueTime;                      //!<Sampler, time of next sample
+    uint64_t       ullLastTime;                     //!<Sampler, time of last sample stored
+    uint16_t       ausLast[HISTORY_MAX_REGISTERS];  //!<Sampler, values of last sample stored
+    bool           bHasSample;                      //!<Sampler, a sample is stored
+} HistoryRange_t;
+
+//! @brief Delta coder state, previous sample
+typedef struct HistoryCoder
+{
+    uint64_t ullTime;                               //!<Time of previous sample
+    uint16_t ausValues[HISTORY_MAX_REGISTERS];      //!<Values of previous sample
+} HistoryCoder_t;
+
+//****************************************************************************/
+//                           Private Functions
+//****************************************************************************/
+//
+//! @brief Encode sample as difference to previous sample of coder
+//! @param[in,out]  ptCoder      Coder, takes sample as previous
+//! @param[in]      ullTime      Time of sample
+//! @param[in]      pusValues    Values of sample
+//! @param[in]      usNumOfData  Registers
+//! @param[out]     pucBuf       Buffer, at least MAX_SAMPLE_LEN bytes
+//! @return         uint16_t     Bytes of encoded sample
+//
+static uint16_t EncodeSample(HistoryCoder_t *ptCoder,
+                             uint64_t ullTime,
+                             const uint16_t *pusValues,
+                             uint16_t usNumOfData,
+                             uint8_t *pucBuf);
+
+//
+//! @brief Decode sample following previous sample of coder
+//! @param[in,out]  ptCoder      Coder, holds decoded sample afterwards
+//! @param[in]      usNumOfData  Registers
+//! @param[in]      pucBuf       Encoded samples
+//! @param[in]      usLen        Bytes of pucBuf
+//! @return         uint16_t     Bytes of decoded sample, 0 - truncated
+//
+static uint16_t DecodeSample(HistoryCoder_t *ptCoder, uint16_t usNumOfData, const uint8_t *pucBuf, uint16_t usLen);
+
+//
+//! @brief Write unsigned LEB128 varint
+//! @param[in]   ulValue   Value
+//! @param[out]  pucBuf    Buffer, at least 5 bytes
+//! @return      uint16_t  Bytes written
+//
+static uint16_t PutVarint(uint32_t ulValue, uint8_t *pucBuf);
+
+//
+//! @brief Read unsigned LEB128 varint
+//! @param[out]  pulValue  Value
+//! @param[in]   pucBuf    Buffer
+//! @param[in]   usLen     Bytes of pucBuf
+//! @return      uint16_t  Bytes read, 0 - truncated
+//
+static uint16_t GetVarint(uint32_t *pulValue, const uint8_t *pucBuf, uint16_t usLen);
+
+//
+//! @brief Read range from its unit and store sample if due
+//! @param[in,out]  ptRange    Range
+//! @param[in]      ullTimeMs  Current time
+//! @return         None
+//
+static void SampleRange(HistoryRange_t *ptRange, uint64_t ullTimeMs);
+
+//
+//! @brief Append sample to block written, starts next block if it is full
+//! @param[in,out]  ptRange    Range
+//! @param[in]      ullTime    Time of sample
+//! @param[in]      pusValues  Values of sample
+//! @return         None
+//
+static void StoreSample(HistoryRange_t *ptRange, uint64_t ullTime, const uint16_t *pusValues);
+
+//
+//! @brief Copy block which sampler may write meanwhile
+//! @param[in]   ptBlock   Block of ring
+//! @param[out]  ptCopy    Copy
+//! @param[in]   bData     true - copy samples too, false - header only
+//! @return      bool      true - consistent copy
+//
+static bool CopyBlock(const HistoryBlock_t *ptBlock, HistoryBlock_t *ptCopy, bool bData);
+
+//****************************************************************************/
+//                           Private variables
+//****************************************************************************/
+static HistoryBlock_t m_atBlocks[HISTORY_POOL_BLOCKS];
+static HistoryRange_t m_atRanges[HISTORY_RANGES];
+static uint16_t       m_usNumOfBlocksUsed;
+static uint8_t        m_ucNumOfRanges;
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+void mbap_HistoryInit(void)
+{
+    memset(m_atRanges, 0, sizeof(m_atRanges));
+    m_usNumOfBlocksUsed = 0;
+    m_ucNumOfRanges     = 0;
+}//end mbap_HistoryInit
+
+uint8_t mbap_HistoryAdd(uint8_t ucUnitId,
+                        uint8_t ucTable,
+                        uint16_t usStartAddress,
+                        uint16_t usNumOfData,
+                        uint32_t ulPeriodMs,
+                        uint8_t ucMode,
+                        uint16_t usNumOfBlocks)
+{
+    const ModbusUnit_t *ptUnit  = mbap_UnitFind(0, ucUnitId);
+    HistoryRange_t     *ptRange = NULL;
+    uint16_t           usMax    = 0;
+    ModbusRequest_t    tSample;
+
+    if ((NULL == ptUnit) || (m_ucNumOfRanges >= HISTORY_RANGES) ||
+        (0 == usNumOfData) || (usNumOfData > HISTORY_MAX_REGISTERS) || (0 == ulPeriodMs) ||
+        (usNumOfBlocks < 2u) || (usNumOfBlocks > (HISTORY_POOL_BLOCKS - m_usNumOfBlocksUsed)))
+    {
+        return HISTORY_NO_RANGE;
+    }
+
+    if (eTABLE_INPUT_REGISTERS == ucTable)
+    {
+        usMax = ptUnit->ptModbusData->usMaxInputRegisters;
+    }
+    else if (eTABLE_HOLDING_REGISTERS == ucTable)
+    {
+        usMax = ptUnit->ptModbusData->usMaxHoldingRegisters;
+    }
+
+    if ((uint32_t)usStartAddress + usNumOfData > usMax)
+    {
+        return HISTORY_NO_RANGE;
+    }
+
+    memset(&tSample, 0, sizeof(tSample));
+    tSample.ptUnit         = ptUnit;
+    tSample.ucTable        = ucTable;
+    tSample.usStartAddress = usStartAddress;
+    tSample.usNumOfData    = usNumOfData;
+
+    //sampler thread reads without serving thread, copy on write pages of a
+    //profile unit and ranges deferred by asynchronous access are not safe
+    if ((NULL != ptUnit->ptProfile) || mbap_IsAsyncRange(&tSample))
+    {
+        return HISTORY_NO_RANGE;
+    }
+
+    ptRange                 = &m_atRanges[m_ucNumOfRanges];
+    memset(ptRange, 0, sizeof(HistoryRange_t));
+    ptRange->ucUnitId       = ucUnitId;
+    ptRange->ucTable        = ucTable;
+    ptRange->ucMode         = ucMode;
+    ptRange->usStartAddress = usStartAddress;
+    ptRange->usNumOfData    = usNumOfData;
+    ptRange->ulPeriodMs     = ulPeriodMs;
+    ptRange->ptBlocks       = &m_atBlocks[m_usNumOfBlocksUsed];
+    ptRange->usNumOfBlocks  = usNumOfBlocks;
+    memset(ptRange->ptBlocks, 0, usNumOfBlocks * sizeof(HistoryBlock_t));
+
+    m_usNumOfBlocksUsed += usNumOfBlocks;
+
+    return m_ucNumOfRanges++;
+}//end mbap_HistoryAdd
+
+void mbap_HistorySample(uint64_t ullTimeMs)
+{
+    uint8_t ucRange = 0;
+
+    for (ucRange = 0; ucRange < m_ucNumOfRanges; ucRange++)
+    {
+        if (ullTimeMs >= m_atRanges[ucRange].ullDueTime)
+        {
+            SampleRange(&m_atRanges[ucRange], ullTimeMs);
+        }
+    }
+}//end mbap_HistorySample
+
+uint16_t mbap_HistoryRead(const ModbusUnit_t *ptUnit,
+                          uint8_t ucRange,
+                          uint32_t ulSince,
+                          uint8_t *pucBuf,
+                          uint16_t usBufLen)
+{
+    const HistoryRange_t *ptRange       = NULL;
+    HistoryBlock_t       tBlock;
+    HistoryCoder_t       tDecoder;
+    HistoryCoder_t       tEncoder;
+    uint8_t              aucSample[MAX_SAMPLE_LEN];
+    uint64_t             ullFirstTime   = 0;
+    uint32_t             ulFirst        = 0;
+    uint32_t             ulSequence     = 0;
+    uint16_t             usBlock        = 0;
+    uint16_t             usStart        = 0;
+    uint16_t             usSample       = 0;
+    uint16_t             usPos          = 0;
+    uint16_t             usLen          = 0;
+    uint16_t             usOut          = HISTORY_RESPONSE_HEADER_LEN;
+    uint8_t              ucNumOfSamples = 0;
+    bool                 bFound         = false;
+    bool                 bFull          = false;
+
+    if ((ucRange >= m_ucNumOfRanges) || (ptUnit != mbap_UnitFind(0, m_atRanges[ucRange].ucUnitId)))
+    {
+        return 0;
+    }
+
+    ptRange = &m_atRanges[ucRange];
+
+    //sequences rise along the ring, the block with the lowest first sequence
+    //of those holding samples not older than ulSince holds ulSince or the
+    //oldest sample after it
+    for (usBlock = 0; usBlock < ptRange->usNumOfBlocks; usBlock++)
+    {
+        if (CopyBlock(&ptRange->ptBlocks[usBlock], &tBlock, false) && (0 != tBlock.usNumOfSamples) &&
+            (tBlock.ulFirstSequence + tBlock.usNumOfSamples > ulSince) &&
+            (!bFound || (tBlock.ulFirstSequence < ulFirst)))
+        {
+            bFound  = true;
+            usStart = usBlock;
+            ulFirst = tBlock.ulFirstSequence;
+        }
+    }
+
+    memset(&tEncoder, 0, sizeof(tEncoder));
+
+    for (usBlock = 0; bFound && !bFull && (usBlock < ptRange->usNumOfBlocks); usBlock++)
+    {
+        //block overwritten or not yet written, client asks again
+        if (!CopyBlock(&ptRange->ptBlocks[(usStart + usBlock) % ptRange->usNumOfBlocks], &tBlock, true) ||
+            (0 == tBlock.usNumOfSamples) ||
+            ((0 != ucNumOfSamples) && (tBlock.ulFirstSequence != ulSince)))
+        {
+            break;
+        }
+
+        memset(&tDecoder, 0, sizeof(tDecoder));
+        tDecoder.ullTime = tBlock.ullFirstTime;
+        usPos            = 0;
+
+        for (usSample = 0; usSample < tBlock.usNumOfSamples; usSample++)
+        {
+            usLen = DecodeSample(&tDecoder, ptRange->usNumOfData, &tBlock.aucData[usPos], tBlock.usLen - usPos);
+
+            if (0 == usLen)
+            {
+                break;
+            }
+
+            usPos      += usLen;
+            ulSequence  = tBlock.ulFirstSequence + usSample;
+
+            if (ulSequence < ulSince)
+            {
+                continue;
+            }
+
+            //first sample returned is encoded against time of response header and zero
+            if (0 == ucNumOfSamples)
+            {
+                ulFirst          = ulSequence;
+                ullFirstTime     = tDecoder.ullTime;
+                tEncoder.ullTime = tDecoder.ullTime;
+            }
+
+            usLen = EncodeSample(&tEncoder, tDecoder.ullTime, tDecoder.ausValues, ptRange->usNumOfData, aucSample);
+
+            if ((usOut + usLen > usBufLen) || (UINT8_MAX == ucNumOfSamples))
+            {
+                bFull = true;
+                break;
+            }
+
+            memcpy(&pucBuf[usOut], aucSample, usLen);
+            usOut   += usLen;
+            ulSince  = ulSequence + 1u;
+            ucNumOfSamples++;
+        }
+    }
+
+    //nothing new, client continues with sequence of next sample
+    if (0 == ucNumOfSamples)
+    {
+        ulFirst = __atomic_load_n(&ptRange->ulNextSequence, __ATOMIC_ACQUIRE);
+    }
+
+    pucBuf[0] = ucRange;
+    pucBuf[1] = (uint8_t)ptRange->usNumOfData;
+    pucBuf[2] = (uint8_t)(ulFirst >> 24);
+    pucBuf[3] = (uint8_t)(ulFirst >> 16);
+    pucBuf[4] = (uint8_t)(ulFirst >> 8);
+    pucBuf[5] = (uint8_t)(ulFirst);
+    pucBuf[6] = ucNumOfSamples;
+
+    for (usPos = 0; usPos < 8u; usPos++)
+    {
+        pucBuf[7u + usPos] = (uint8_t)(ullFirstTime >> (56u - (usPos * 8u)));
+    }
+
+    return usOut;
+}//end mbap_HistoryRead
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static uint16_t EncodeSample(HistoryCoder_t *ptCoder,
+                             uint64_t ullTime,
+                             const uint16_t *pusValues,
+                             uint16_t usNumOfData,
+                             uint8_t *pucBuf)
+{
+    uint16_t usLen   = 0;
+    uint16_t usIndex = 0;
+    int16_t  sDelta  = 0;
+
+    usLen = PutVarint((uint32_t)(ullTime - ptCoder->ullTime), pucBuf);
+
+    for (usIndex = 0; usIndex < usNumOfData; usIndex++)
+    {
+        //zigzag keeps small negative differences small
+        sDelta  = (int16_t)(uint16_t)(pusValues[usIndex] - ptCoder->ausValues[usIndex]);
+        usLen  += PutVarint((uint16_t)((uint16_t)(sDelta << 1) ^ (uint16_t)(sDelta >> 15)), &pucBuf[usLen]);
+        ptCoder->ausValues[usIndex] = pusValues[usIndex];
+    }
+
+    ptCoder->ullTime = ullTime;
+
+    return usLen;
+}//end EncodeSample
+
+static uint16_t DecodeSample(HistoryCoder_t *ptCoder, uint16_t usNumOfData, const uint8_t *pucBuf, uint16_t usLen)
+{
+    uint32_t ulValue = 0;
+    uint16_t usPos   = 0;
+    uint16_t usRead  = 0;
+    uint16_t usIndex = 0;
+
+    usRead = GetVarint(&ulValue, pucBuf, usLen);
+
+    if (0 == usRead)
+    {
+        return 0;
+    }
+
+    ptCoder->ullTime += ulValue;
+    usPos             = usRead;
+
+    for (usIndex = 0; usIndex < usNumOfData; usIndex++)
+    {
+        usRead = GetVarint(&ulValue, &pucBuf[usPos], usLen - usPos);
+
+        if (0 == usRead)
+        {
+            return 0;
+        }
+
+        usPos                       += usRead;
+        ptCoder->ausValues[usIndex] += (uint16_t)((ulValue >> 1) ^ (0u - (ulValue & 1u)));
+    }
+
+    return usPos;
+}//end DecodeSample
+
+static uint16_t PutVarint(uint32_t ulValue, uint8_t *pucBuf)
+{
+    uint16_t usLen = 0;
+
+    while (ulValue >= 0x80u)
+    {
+        pucBuf[usLen++] = (uint8_t)(ulValue | 0x80u);
+        ulValue       >>= 7;
+    }
+
+    pucBuf[usLen++] = (uint8_t)ulValue;
+
+    return usLen;
+}//end PutVarint
+
+static uint16_t GetVarint(uint32_t *pulValue, const uint8_t *pucBuf, uint16_t usLen)
+{
+    uint16_t usPos   = 0;
+    uint32_t ulValue = 0;
+
+    while ((usPos < usLen) && (usPos < 5u))
+    {
+        ulValue |= (uint32_t)(pucBuf[usPos] & 0x7Fu) << (7u * usPos);
+
+        if (0 == (pucBuf[usPos++] & 0x80u))
+        {
+            *pulValue = ulValue;
+            return usPos;
+        }
+    }
+
+    return 0;
+}//end GetVarint
+
+static void SampleRange(HistoryRange_t *ptRange, uint64_t ullTimeMs)
+{
+    ModbusRequest_t tRequest;
+    uint8_t         aucQuery[SAMPLE_QUERY_LEN] = {0};
+    uint8_t         aucData[HISTORY_MAX_REGISTERS * 2u];
+    uint16_t        ausValues[HISTORY_MAX_REGISTERS];
+    uint16_t        usIndex    = 0;
+    bool            bChanged   = !ptRange->bHasSample;
+
+    //missed periods are skipped, not sampled late
+    ptRange->ullDueTime = ptRange->bHasSample ? (ptRange->ullDueTime + ptRange->ulPeriodMs) : ullTimeMs;
+
+    if (ptRange->ullDueTime <= ullTimeMs)
+    {
+        ptRange->ullDueTime = ullTimeMs + ptRange->ulPeriodMs;
+    }
+
+    //sampling is a read of the range, seen by probes as such
+    aucQuery[7]  = (eTABLE_INPUT_REGISTERS == ptRange->ucTable) ? eFC_READ_INPUT_REGISTERS : eFC_READ_HOLDING_REGISTERS;
+    aucQuery[8]  = (uint8_t)(ptRange->usStartAddress >> 8);
+    aucQuery[9]  = (uint8_t)(ptRange->usStartAddress);
+    aucQuery[11] = (uint8_t)(ptRange->usNumOfData);
+
+    memset(&tRequest, 0, sizeof(tRequest));
+    tRequest.pucQuery       = aucQuery;
+    tRequest.usQueryLen     = SAMPLE_QUERY_LEN;
+    tRequest.ptUnit         = mbap_UnitFind(0, ptRange->ucUnitId);
+    tRequest.ucTable        = ptRange->ucTable;
+    tRequest.usStartAddress = ptRange->usStartAddress;
+    tRequest.usNumOfData    = ptRange->usNumOfData;
+    tRequest.pucReadData    = aucData;
+
+    if ((NULL == tRequest.ptUnit) || (eNO_EXCEPTION != mbap_AccessRequestData(&tRequest)))
+    {
+        return;
+    }
+
+    for (usIndex = 0; usIndex < ptRange->usNumOfData; usIndex++)
+    {
+        ausValues[usIndex] = (uint16_t)((aucData[usIndex * 2u] << 8) | aucData[(usIndex * 2u) + 1u]);
+        bChanged           = bChanged || (ausValues[usIndex] != ptRange->ausLast[usIndex]);
+    }
+
+    if ((eHISTORY_PERIODIC == ptRange->ucMode) || bChanged)
+    {
+        StoreSample(ptRange, ullTimeMs, ausValues);
+    }
+}//end SampleRange
+
+static void StoreSample(HistoryRange_t *ptRange, uint64_t ullTime, const uint16_t *pusValues)
+{
+    HistoryBlock_t *ptBlock = &ptRange->ptBlocks[ptRange->usHead];
+    HistoryCoder_t tCoder;
+    uint8_t        aucSample[MAX_SAMPLE_LEN];
+    uint16_t       usLen    = 0;
+
+    tCoder.ullTime = ptRange->ullLastTime;
+    memcpy(tCoder.ausValues, ptRange->ausLast, sizeof(tCoder.ausValues));
+    usLen = EncodeSample(&tCoder, ullTime, pusValues, ptRange->usNumOfData, aucSample);
+
+    //full block or time difference beyond varint, sample starts next block
+    if ((0 != ptBlock->usNumOfSamples) &&
+        ((ptBlock->usLen + usLen > HISTORY_BLOCK_LEN) || (ullTime - ptRange->ullLastTime > UINT32_MAX)))
+    {
+        ptRange->usHead = (uint16_t)((ptRange->usHead + 1u) % ptRange->usNumOfBlocks);
+        ptBlock         = &ptRange->ptBlocks[ptRange->usHead];
+
+        //readers of the reused block see it changing and retry
+        __atomic_store_n(&ptBlock->ulVersion, ptBlock->ulVersion + 1u, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        ptBlock->usNumOfSamples = 0;
+        ptBlock->usLen          = 0;
+        __atomic_store_n(&ptBlock->ulVersion, ptBlock->ulVersion + 1u, __ATOMIC_RELEASE);
+    }
+
+    //first sample of block is encoded against block time and zero
+    if (0 == ptBlock->usNumOfSamples)
+    {
+        memset(&tCoder, 0, sizeof(tCoder));
+        tCoder.ullTime = ullTime;
+        usLen          = EncodeSample(&tCoder, ullTime, pusValues, ptRange->usNumOfData, aucSample);
+    }
+
+    __atomic_store_n(&ptBlock->ulVersion, ptBlock->ulVersion + 1u, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (0 == ptBlock->usNumOfSamples)
+    {
+        ptBlock->ulFirstSequence = ptRange->ulNextSequence;
+        ptBlock->ullFirstTime    = ullTime;
+    }
+
+    memcpy(&ptBlock->aucData[ptBlock->usLen], aucSample, usLen);
+    ptBlock->usLen += usLen;
+    ptBlock->usNumOfSamples++;
+    __atomic_store_n(&ptBlock->ulVersion, ptBlock->ulVersion + 1u, __ATOMIC_RELEASE);
+    __atomic_store_n(&ptRange->ulNextSequence, ptRange->ulNextSequence + 1u, __ATOMIC_RELEASE);
+
+    ptRange->ullLastTime = ullTime;
+    ptRange->bHasSample  = true;
+    memcpy(ptRange->ausLast, pusValues, ptRange->usNumOfData * sizeof(uint16_t));
+}//end StoreSample
+
+static bool CopyBlock(const HistoryBlock_t *ptBlock, HistoryBlock_t *ptCopy, bool bData)
+{
+    uint32_t ulVersion = 0;
+    uint32_t ulTries   = 0;
+
+    for (ulTries = 0; ulTries < MAX_READ_TRIES; ulTries++)
+    {
+        ulVersion = __atomic_load_n(&ptBlock->ulVersion, __ATOMIC_ACQUIRE);
+
+        if (ulVersion & 1u)
+        {
+            continue;
+        }
+
+        ptCopy->ulFirstSequence = ptBlock->ulFirstSequence;
+        ptCopy->ullFirstTime    = ptBlock->ullFirstTime;
+        ptCopy->usNumOfSamples  = ptBlock->usNumOfSamples;
+        ptCopy->usLen           = ptBlock->usLen;
+
+        if (bData)
+        {
+            memcpy(ptCopy->aucData, ptBlock->aucData, sizeof(ptCopy->aucData));
+        }
+
+        //data reads must be done before version is read again
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if ((__atomic_load_n(&ptBlock->ulVersion, __ATOMIC_RELAXED) == ulVersion) &&
+            (ptCopy->usLen <= HISTORY_BLOCK_LEN))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}//end CopyBlock
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
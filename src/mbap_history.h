@@ -0,0 +1,116 @@
+//! @addtogroup ModbusTCPHistory
+//! @{
+//
+//****************************************************************************
+//! @file mbap_history.h
+//! @brief This contains the prototypes, macros, constants or global variables
+//!        for the history of sampled register ranges.
+//!
+//!        Every range keeps a ring of blocks. A sample is stored as time
+//!        difference to the previous sample of the block in ms, then for
+//!        every register the difference to its previous value(modulo 2^16,
+//!        zigzag encoded), all as unsigned LEB128 varints. The first sample of
+//!        a block has time difference 0 to the block time and differences to
+//!        all zero values.
+//!
+//!        Read History(function code 65) returns samples in the same
+//!        encoding. Query PDU is function code, range(1 byte) and sequence of
+//!        first sample wanted(4 bytes). Response PDU is function code,
+//!        range(1 byte), registers per sample(1 byte), sequence of first
+//!        sample returned(4 bytes), number of samples(1 byte), time of first
+//!        sample(8 bytes, ms) and the samples. Sequence of first sample above
+//!        the sequence asked for tells that older samples were overwritten.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//
+//****************************************************************************
+#ifndef MBAP_HISTORY_H
+#define MBAP_HISTORY_H
+
+//****************************************************************************
+//                           Includes
+//****************************************************************************
+
+//****************************************************************************
+//                           Constants and typedefs
+//****************************************************************************
+//! @brief Bytes of encoded samples in a block
+#define HISTORY_BLOCK_LEN                 (256u)
+//! @brief Registers of a range
+#define HISTORY_MAX_REGISTERS             (32u)
+//! @brief Bytes before samples in response data
+#define HISTORY_RESPONSE_HEADER_LEN       (15u)
+//! @brief Result of mbap_HistoryAdd() when range is not added
+#define HISTORY_NO_RANGE                  (0xFFu)
+
+//! @brief When a range is sampled
+enum HistoryMode
+{
+    eHISTORY_PERIODIC  = 0,         //!< Every period
+    eHISTORY_ON_CHANGE = 1          //!< Every period if a register changed
+};
+
+//****************************************************************************
+//                           Global variables
+//****************************************************************************
+
+//****************************************************************************
+//                           Global Functions
+//****************************************************************************
+//
+//! @brief Remove all ranges and release their blocks
+//! @param[in]  None
+//! @return     None
+//
+void mbap_HistoryInit(void);
+
+//
+//! @brief Add range sampled into a ring of blocks taken from the block pool.
+//!        Ranges are added before requests are served. Sampling thread reads
+//!        with synchronous user functions, so profile units and ranges
+//!        deferred by asynchronous access function of unit are rejected.
+//! @param[in]  ucUnitId        Unit id of unit served by user functions
+//! @param[in]  ucTable         eTABLE_INPUT_REGISTERS or eTABLE_HOLDING_REGISTERS
+//! @param[in]  usStartAddress  First register relative to table start
+//! @param[in]  usNumOfData     Registers, at most HISTORY_MAX_REGISTERS
+//! @param[in]  ulPeriodMs      Sampling period in ms
+//! @param[in]  ucMode          enum HistoryMode
+//! @param[in]  usNumOfBlocks   Blocks of ring, at least 2
+//! @return     uint8_t         Range, HISTORY_NO_RANGE - invalid or no blocks left
+//
+uint8_t mbap_HistoryAdd(uint8_t ucUnitId,
+                        uint8_t ucTable,
+                        uint16_t usStartAddress,
+                        uint16_t usNumOfData,
+                        uint32_t ulPeriodMs,
+                        uint8_t ucMode,
+                        uint16_t usNumOfBlocks);
+
+//
+//! @brief Sample ranges which are due, only one thread may sample
+//! @param[in]  ullTimeMs  Current time in ms, e.g. since Unix epoch
+//! @return     None
+//
+void mbap_HistorySample(uint64_t ullTimeMs);
+
+//
+//! @brief Encode samples of range starting with sequence as response data of
+//!        Read History, may be called from any thread while sampling
+//! @param[in]   ptUnit    Unit addressed by query, must own range
+//! @param[in]   ucRange   Range
+//! @param[in]   ulSince   Sequence of first sample wanted
+//! @param[out]  pucBuf    Response data following function code
+//! @param[in]   usBufLen  Bytes of pucBuf, larger than HISTORY_RESPONSE_HEADER_LEN
+//! @return      uint16_t  Bytes of response data, 0 - no such range of unit
+//
+uint16_t mbap_HistoryRead(const ModbusUnit_t *ptUnit,
+                          uint8_t ucRange,
+                          uint32_t ulSince,
+                          uint8_t *pucBuf,
+                          uint16_t usBufLen);
+
+#endif // MBAP_HISTORY_H
+//****************************************************************************
+//                             End of file
+//****************************************************************************
+//! @}
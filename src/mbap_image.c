@@ -0,0 +1,735 @@
+//! @addtogroup ModbusTCPImage
+//! @brief Register image in memory mapped file
+//! @{
+//!
+//****************************************************************************/
+//! @file mbap_image.c
+//! @brief Register image in a memory mapped file. Opening an image maps it
+//!        and compares header and region entries with the expected layout,
+//!        region contents are used in place without parsing.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sched.h>
+//user defined header files
+#include "mbap_image.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+#define BOOT_ID_PATH         "/proc/sys/kernel/random/boot_id"
+#define CRC32_POLYNOMIAL     0xEDB88320u
+#define ALIGN(x)             (((x) + MBAP_IMAGE_ALIGN - 1u) & ~(uint32_t)(MBAP_IMAGE_ALIGN - 1u))
+//spins before reader takes data of a region left odd or writer takes over
+//region of a writer which died while writing
+#define READER_SPINS         (1u << 16)
+#define WRITER_SPINS         (1u << 20)
+//written by syncing thread only, read by any thread
+#define STATS_ADD(x, v)      __atomic_store_n(&(x), (x) + (v), __ATOMIC_RELAXED)
+
+//layout of file is part of its format
+typedef char HeaderSizeCheck_t[(64u == sizeof(ImageHeader_t)) ? 1 : -1];
+typedef char RegionSizeCheck_t[(64u == sizeof(ImageRegion_t)) ? 1 : -1];
+
+//****************************************************************************/
+//                           Local Functions
+//****************************************************************************/
+//
+//! @brief Map image of opened file or shared memory object, created with
+//!        defaults if empty or of other layout
+//! @param[in]  iFile           File or shared memory object
+//! @param[in]  pulLengths      Bytes of each region
+//! @param[in]  ppvDefaults     Contents of each region in new image
+//! @param[in]  ucNumOfRegions  Number of regions
+//! @return     uint8_t         Result(enum ImageStatus)
+//
+static uint8_t OpenImage(int iFile, const uint32_t *pulLengths,
+                         const void * const *ppvDefaults, uint8_t ucNumOfRegions);
+
+//
+//! @brief Map image of opened file or shared memory object
+//! @param[in]  iFile   File or shared memory object
+//! @param[in]  ulSize  Bytes to map
+//! @return     bool    true - mapped
+//
+static bool MapImage(int iFile, uint32_t ulSize);
+
+//
+//! @brief Check header and region entries against expected layout
+//! @param[in]  ptExpected  Header of expected layout
+//! @param[in]  ptRegions   Region entries of expected layout
+//! @return     bool        true - image has expected layout
+//
+static bool IsLayoutValid(const ImageHeader_t *ptExpected, const ImageRegion_t *ptRegions);
+
+//
+//! @brief Check region entries of an attached image written by another process
+//! @param[in]  None
+//! @return     bool  true - live regions and slots lie aligned within image
+//
+static bool AreRegionsValid(void);
+
+//
+//! @brief Check a range of an attached image
+//! @param[in]  ulOffset  Start of range
+//! @param[in]  ulLength  Bytes of range
+//! @return     bool      true - range is aligned and lies behind region entries
+//!                       within image
+//
+static bool IsRangeValid(uint32_t ulOffset, uint32_t ulLength);
+
+//
+//! @brief Write header, region entries, defaults and checkpoints of a new image
+//! @param[in]  ptExpected   Header of expected layout
+//! @param[in]  ptRegions    Region entries of expected layout
+//! @param[in]  ppvDefaults  Contents of each region
+//! @return     None
+//
+static void CreateImage(const ImageHeader_t *ptExpected, const ImageRegion_t *ptRegions,
+                        const void * const *ppvDefaults);
+
+//
+//! @brief Roll back a region to its newest valid checkpoint, defaults if none
+//! @param[in]  ucRegion    Region index
+//! @param[in]  pvDefault   Contents of region in new image
+//! @return     None
+//
+static void RecoverRegion(uint8_t ucRegion, const void *pvDefault);
+
+//
+//! @brief Newer of two checkpoint slots
+//! @param[in]  ptRegion  Region entry
+//! @return     uint8_t   Slot index
+//
+static uint8_t NewestSlot(const ImageRegion_t *ptRegion);
+
+//
+//! @brief Sync pages of a range of mapping to disk
+//! @param[in]  ulOffset  Start of range
+//! @param[in]  ulLength  Bytes of range
+//! @return     None
+//
+static void SyncRange(uint32_t ulOffset, uint32_t ulLength);
+
+//
+//! @brief Read boot id of running system
+//! @param[out] pcBootId  Boot id, empty if not known
+//! @return     None
+//
+static void ReadBootId(char *pcBootId);
+
+//
+//! @brief Build table of CRC-32
+//! @param[in]  None
+//! @return     None
+//
+static void BuildCrcTable(void);
+
+//
+//! @brief CRC-32 of data
+//! @param[in]  pucData   Data
+//! @param[in]  ulLength  Bytes of data
+//! @return     uint32_t  CRC
+//
+static uint32_t Crc32(const uint8_t *pucData, uint32_t ulLength);
+
+//****************************************************************************/
+//                           Local variables
+//****************************************************************************/
+static uint8_t       *m_pucImage;
+static uint32_t      m_ulImageSize;
+static int           m_iFile = -1;
+static ImageHeader_t *m_ptHeader;
+static ImageRegion_t *m_ptRegions;
+static uint8_t       m_ucNumOfRegions;
+static ImageStats_t  m_tStats;
+static uint32_t      m_aulCrcTable[256];
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+uint8_t mbap_ImageOpen(const char *pcPath, const uint32_t *pulLengths,
+                       const void * const *ppvDefaults, uint8_t ucNumOfRegions)
+{
+    if (NULL != m_pucImage)
+    {
+        return eIMAGE_ERROR;
+    }
+
+    return OpenImage(open(pcPath, O_RDWR | O_CREAT, 0644), pulLengths, ppvDefaults, ucNumOfRegions);
+}//end mbap_ImageOpen
+
+uint8_t mbap_ImageOpenShared(const char *pcName, const uint32_t *pulLengths,
+                             const void * const *ppvDefaults, uint8_t ucNumOfRegions)
+{
+    if (NULL != m_pucImage)
+    {
+        return eIMAGE_ERROR;
+    }
+
+    //object is gone after system restart, image is then created again
+    return OpenImage(shm_open(pcName, O_RDWR | O_CREAT, 0660), pulLengths, ppvDefaults, ucNumOfRegions);
+}//end mbap_ImageOpenShared
+
+bool mbap_ImageAttach(const char *pcName)
+{
+    struct stat tFileStat;
+    int         iFile = -1;
+
+    if (NULL != m_pucImage)
+    {
+        return false;
+    }
+
+    iFile = shm_open(pcName, O_RDWR, 0);
+
+    if ((iFile < 0) || (0 != fstat(iFile, &tFileStat)) || ((size_t)tFileStat.st_size < sizeof(ImageHeader_t)) ||
+        !MapImage(iFile, (uint32_t)tFileStat.st_size))
+    {
+        if (iFile >= 0)
+        {
+            (void)close(iFile);
+        }
+
+        return false;
+    }
+
+    //layout is taken from header written by server
+    if ((0 != memcmp(m_ptHeader->acMagic, MBAP_IMAGE_MAGIC, sizeof(m_ptHeader->acMagic))) ||
+        (MBAP_IMAGE_VERSION != m_ptHeader->usVersion) || (MBAP_IMAGE_BYTE_ORDER != m_ptHeader->usByteOrder) ||
+        (0 == m_ptHeader->usNumOfRegions) || (m_ptHeader->usNumOfRegions > MBAP_IMAGE_MAX_REGIONS) ||
+        (m_ptHeader->ulFileSize != m_ulImageSize) || !AreRegionsValid())
+    {
+        mbap_ImageClose();
+        return false;
+    }
+
+    m_ucNumOfRegions = (uint8_t)m_ptHeader->usNumOfRegions;
+
+    return true;
+}//end mbap_ImageAttach
+
+uint32_t mbap_ImageRegionLength(uint8_t ucRegion)
+{
+    if ((NULL == m_pucImage) || (ucRegion >= m_ucNumOfRegions))
+    {
+        return 0;
+    }
+
+    return m_ptRegions[ucRegion].ulLength;
+}//end mbap_ImageRegionLength
+
+const uint32_t *mbap_ImageSequence(uint8_t ucRegion)
+{
+    if ((NULL == m_pucImage) || (ucRegion >= m_ucNumOfRegions))
+    {
+        return NULL;
+    }
+
+    return &m_ptRegions[ucRegion].ulSequence;
+}//end mbap_ImageSequence
+
+uint32_t mbap_ImageReadBegin(uint8_t ucRegion)
+{
+    uint32_t ulSequence = 0;
+    uint32_t ulSpins    = 0;
+
+    if ((NULL == m_pucImage) || (ucRegion >= m_ucNumOfRegions))
+    {
+        return 0;
+    }
+
+    //wait for writer, data of a writer which died is taken as it is
+    while (((ulSequence = __atomic_load_n(&m_ptRegions[ucRegion].ulSequence, __ATOMIC_ACQUIRE)) & 1u) &&
+           (ulSpins++ < READER_SPINS))
+    {
+        if (0 == (ulSpins % 1024u))
+        {
+            (void)sched_yield();
+        }
+    }
+
+    return ulSequence;
+}//end mbap_ImageReadBegin
+
+bool mbap_ImageReadRetry(uint8_t ucRegion, uint32_t ulSequence)
+{
+    if ((NULL == m_pucImage) || (ucRegion >= m_ucNumOfRegions))
+    {
+        return false;
+    }
+
+    //data reads must be done before sequence is read again
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return (ulSequence & 1u) || (__atomic_load_n(&m_ptRegions[ucRegion].ulSequence, __ATOMIC_RELAXED) != ulSequence);
+}//end mbap_ImageReadRetry
+
+static uint8_t OpenImage(int iFile, const uint32_t *pulLengths,
+                         const void * const *ppvDefaults, uint8_t ucNumOfRegions)
+{
+    ImageHeader_t tExpected;
+    ImageRegion_t atRegions[MBAP_IMAGE_MAX_REGIONS];
+    struct stat   tFileStat;
+    char          acBootId[MBAP_IMAGE_BOOT_ID_LEN];
+    uint32_t      ulOffset = 0;
+    uint8_t       ucCount  = 0;
+    uint8_t       ucStatus = eIMAGE_RESTORED;
+    bool          bSized   = false;
+
+    if ((iFile < 0) || (0 == ucNumOfRegions) || (ucNumOfRegions > MBAP_IMAGE_MAX_REGIONS))
+    {
+        if (iFile >= 0)
+        {
+            (void)close(iFile);
+        }
+
+        return eIMAGE_ERROR;
+    }
+
+    //expected layout, live regions first and checkpoint slots after them
+    memset(&tExpected, 0, sizeof(tExpected));
+    memset(atRegions, 0, sizeof(atRegions));
+    memcpy(tExpected.acMagic, MBAP_IMAGE_MAGIC, sizeof(tExpected.acMagic));
+    tExpected.usVersion      = MBAP_IMAGE_VERSION;
+    tExpected.usHeaderLen    = (uint16_t)(sizeof(ImageHeader_t) + (ucNumOfRegions * sizeof(ImageRegion_t)));
+    tExpected.usNumOfRegions = ucNumOfRegions;
+    tExpected.usByteOrder    = MBAP_IMAGE_BYTE_ORDER;
+    ulOffset                 = ALIGN(tExpected.usHeaderLen);
+
+    for (ucCount = 0; ucCount < ucNumOfRegions; ucCount++)
+    {
+        atRegions[ucCount].ulOffset = ulOffset;
+        atRegions[ucCount].ulLength = pulLengths[ucCount];
+        ulOffset                    = ALIGN(ulOffset + pulLengths[ucCount]);
+    }
+
+    for (ucCount = 0; ucCount < ucNumOfRegions; ucCount++)
+    {
+        atRegions[ucCount].aulSlotOffset[0] = ulOffset;
+        atRegions[ucCount].aulSlotOffset[1] = ALIGN(ulOffset + pulLengths[ucCount]);
+        ulOffset                            = ALIGN(atRegions[ucCount].aulSlotOffset[1] + pulLengths[ucCount]);
+    }
+
+    tExpected.ulFileSize = ulOffset;
+
+    BuildCrcTable();
+
+    if (0 != fstat(iFile, &tFileStat))
+    {
+        (void)close(iFile);
+        return eIMAGE_ERROR;
+    }
+
+    bSized = ((uint32_t)tFileStat.st_size == tExpected.ulFileSize);
+
+    if ((!bSized && (0 != ftruncate(iFile, tExpected.ulFileSize))) || !MapImage(iFile, tExpected.ulFileSize))
+    {
+        (void)close(iFile);
+        return eIMAGE_ERROR;
+    }
+
+    m_ucNumOfRegions = ucNumOfRegions;
+    ReadBootId(acBootId);
+
+    if (!bSized || !IsLayoutValid(&tExpected, atRegions))
+    {
+        CreateImage(&tExpected, atRegions, ppvDefaults);
+        ucStatus = eIMAGE_CREATED;
+    }
+    else if (('\0' != acBootId[0]) && (0 == strncmp(acBootId, m_ptHeader->acBootId, MBAP_IMAGE_BOOT_ID_LEN)))
+    {
+        //page cache survived, regions hold every write of previous process,
+        //a write cut off by a crash is taken as it is and its region released
+        for (ucCount = 0; ucCount < ucNumOfRegions; ucCount++)
+        {
+            m_ptRegions[ucCount].ulSequence = (m_ptRegions[ucCount].ulSequence + 1u) & ~1u;
+        }
+    }
+    else
+    {
+        //writes after last checkpoint may be torn on disk
+        for (ucCount = 0; ucCount < ucNumOfRegions; ucCount++)
+        {
+            RecoverRegion(ucCount, ppvDefaults[ucCount]);
+        }
+
+        ucStatus = eIMAGE_RECOVERED;
+    }
+
+    memcpy(m_ptHeader->acBootId, acBootId, MBAP_IMAGE_BOOT_ID_LEN);
+    SyncRange(0, m_ulImageSize);
+
+    return ucStatus;
+}//end OpenImage
+
+void mbap_ImageClose(void)
+{
+    if (NULL != m_pucImage)
+    {
+        (void)munmap(m_pucImage, m_ulImageSize);
+    }
+
+    if (m_iFile >= 0)
+    {
+        (void)close(m_iFile);
+    }
+
+    m_pucImage       = NULL;
+    m_ulImageSize    = 0;
+    m_iFile          = -1;
+    m_ptHeader       = NULL;
+    m_ptRegions      = NULL;
+    m_ucNumOfRegions = 0;
+}//end mbap_ImageClose
+
+void *mbap_ImageRegion(uint8_t ucRegion)
+{
+    if ((NULL == m_pucImage) || (ucRegion >= m_ucNumOfRegions))
+    {
+        return NULL;
+    }
+
+    return &m_pucImage[m_ptRegions[ucRegion].ulOffset];
+}//end mbap_ImageRegion
+
+void mbap_ImageWriteBegin(uint8_t ucRegion)
+{
+    uint32_t *pulSequence = NULL;
+    uint32_t ulSequence   = 0;
+    uint32_t ulSpins      = 0;
+
+    if ((NULL == m_pucImage) || (ucRegion >= m_ucNumOfRegions))
+    {
+        return;
+    }
+
+    pulSequence = &m_ptRegions[ucRegion].ulSequence;
+
+    //odd sequence locks region against other writers of any process
+    while (1)
+    {
+        ulSequence = __atomic_load_n(pulSequence, __ATOMIC_RELAXED);
+
+        if ((0 == (ulSequence & 1u)) &&
+            __atomic_compare_exchange_n(pulSequence, &ulSequence, ulSequence + 1u, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            break;
+        }
+
+        if (++ulSpins >= WRITER_SPINS)
+        {
+            //writer died while writing, region stays odd until this write ends
+            break;
+        }
+
+        if (0 == (ulSpins % 1024u))
+        {
+            (void)sched_yield();
+        }
+    }//end while
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}//end mbap_ImageWriteBegin
+
+void mbap_ImageWriteEnd(uint8_t ucRegion)
+{
+    uint32_t ulSequence = 0;
+
+    if ((NULL == m_pucImage) || (ucRegion >= m_ucNumOfRegions))
+    {
+        return;
+    }
+
+    ulSequence = __atomic_load_n(&m_ptRegions[ucRegion].ulSequence, __ATOMIC_RELAXED);
+
+    //even if server released region of a writer taken for dead meanwhile
+    if (ulSequence & 1u)
+    {
+        __atomic_store_n(&m_ptRegions[ucRegion].ulSequence, ulSequence + 1u, __ATOMIC_RELEASE);
+    }
+}//end mbap_ImageWriteEnd
+
+uint32_t mbap_ImageSync(void)
+{
+    uint32_t ulNumOfCopied = 0;
+    uint8_t  ucCount       = 0;
+
+    if (NULL == m_pucImage)
+    {
+        return 0;
+    }
+
+    for (ucCount = 0; ucCount < m_ucNumOfRegions; ucCount++)
+    {
+        ImageRegion_t *ptRegion   = &m_ptRegions[ucCount];
+        uint8_t       ucSlot      = (uint8_t)(1u - NewestSlot(ptRegion));
+        uint32_t      ulSequence  = __atomic_load_n(&ptRegion->ulSequence, __ATOMIC_ACQUIRE);
+        uint8_t       *pucSlot    = &m_pucImage[ptRegion->aulSlotOffset[ucSlot]];
+
+        if ((ulSequence & 1u) || (ulSequence == ptRegion->aulSlotSequence[1u - ucSlot]))
+        {
+            //being written or unchanged
+            continue;
+        }
+
+        memcpy(pucSlot, &m_pucImage[ptRegion->ulOffset], ptRegion->ulLength);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&ptRegion->ulSequence, __ATOMIC_RELAXED) != ulSequence)
+        {
+            //written while copied, slot stays older one
+            continue;
+        }
+
+        //slot must be on disk before its entry names it newest
+        SyncRange(ptRegion->aulSlotOffset[ucSlot], ptRegion->ulLength);
+        ptRegion->aulSlotChecksum[ucSlot] = Crc32(pucSlot, ptRegion->ulLength);
+        ptRegion->aulSlotSequence[ucSlot] = ulSequence;
+        SyncRange(0, m_ptHeader->usHeaderLen);
+        STATS_ADD(m_tStats.ulNumOfCheckpoints, 1);
+        ulNumOfCopied++;
+    }//end for
+
+    return ulNumOfCopied;
+}//end mbap_ImageSync
+
+void mbap_ImageGetStats(ImageStats_t *ptStats)
+{
+    ptStats->ulNumOfCheckpoints = __atomic_load_n(&m_tStats.ulNumOfCheckpoints, __ATOMIC_RELAXED);
+    ptStats->ulNumOfRolledBack  = __atomic_load_n(&m_tStats.ulNumOfRolledBack, __ATOMIC_RELAXED);
+    ptStats->ulNumOfReset       = __atomic_load_n(&m_tStats.ulNumOfReset, __ATOMIC_RELAXED);
+}//end mbap_ImageGetStats
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static bool MapImage(int iFile, uint32_t ulSize)
+{
+    void *pvImage = mmap(NULL, ulSize, PROT_READ | PROT_WRITE, MAP_SHARED, iFile, 0);
+
+    if (MAP_FAILED == pvImage)
+    {
+        return false;
+    }
+
+    m_iFile       = iFile;
+    m_pucImage    = (uint8_t *)pvImage;
+    m_ulImageSize = ulSize;
+    m_ptHeader    = (ImageHeader_t *)m_pucImage;
+    m_ptRegions   = (ImageRegion_t *)&m_pucImage[sizeof(ImageHeader_t)];
+
+    return true;
+}//end MapImage
+
+static bool IsLayoutValid(const ImageHeader_t *ptExpected, const ImageRegion_t *ptRegions)
+{
+    uint8_t ucCount = 0;
+
+    if ((0 != memcmp(m_ptHeader->acMagic, ptExpected->acMagic, sizeof(ptExpected->acMagic))) ||
+        (m_ptHeader->usVersion != ptExpected->usVersion) ||
+        (m_ptHeader->usHeaderLen != ptExpected->usHeaderLen) ||
+        (m_ptHeader->usNumOfRegions != ptExpected->usNumOfRegions) ||
+        (m_ptHeader->usByteOrder != ptExpected->usByteOrder) ||
+        (m_ptHeader->ulFileSize != ptExpected->ulFileSize))
+    {
+        return false;
+    }
+
+    for (ucCount = 0; ucCount < ptExpected->usNumOfRegions; ucCount++)
+    {
+        if ((m_ptRegions[ucCount].ulOffset != ptRegions[ucCount].ulOffset) ||
+            (m_ptRegions[ucCount].ulLength != ptRegions[ucCount].ulLength) ||
+            (m_ptRegions[ucCount].aulSlotOffset[0] != ptRegions[ucCount].aulSlotOffset[0]) ||
+            (m_ptRegions[ucCount].aulSlotOffset[1] != ptRegions[ucCount].aulSlotOffset[1]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}//end IsLayoutValid
+
+static bool AreRegionsValid(void)
+{
+    uint8_t ucCount = 0;
+
+    //region entries must be within image before they are read
+    if ((m_ptHeader->usHeaderLen != sizeof(ImageHeader_t) + (m_ptHeader->usNumOfRegions * sizeof(ImageRegion_t))) ||
+        (m_ptHeader->usHeaderLen > m_ulImageSize))
+    {
+        return false;
+    }
+
+    for (ucCount = 0; ucCount < m_ptHeader->usNumOfRegions; ucCount++)
+    {
+        const ImageRegion_t *ptRegion = &m_ptRegions[ucCount];
+
+        if (!IsRangeValid(ptRegion->ulOffset, ptRegion->ulLength) ||
+            !IsRangeValid(ptRegion->aulSlotOffset[0], ptRegion->ulLength) ||
+            !IsRangeValid(ptRegion->aulSlotOffset[1], ptRegion->ulLength))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}//end AreRegionsValid
+
+static bool IsRangeValid(uint32_t ulOffset, uint32_t ulLength)
+{
+    //written without overflow for any offset and length
+    return (0 == (ulOffset % MBAP_IMAGE_ALIGN)) && (ulOffset >= m_ptHeader->usHeaderLen) &&
+           (ulOffset <= m_ulImageSize) && (ulLength <= m_ulImageSize - ulOffset);
+}//end IsRangeValid
+
+static void CreateImage(const ImageHeader_t *ptExpected, const ImageRegion_t *ptRegions,
+                        const void * const *ppvDefaults)
+{
+    uint8_t ucCount = 0;
+
+    memset(m_pucImage, 0, m_ulImageSize);
+    memcpy(m_ptHeader, ptExpected, sizeof(ImageHeader_t));
+    memcpy(m_ptRegions, ptRegions, ptExpected->usNumOfRegions * sizeof(ImageRegion_t));
+
+    for (ucCount = 0; ucCount < ptExpected->usNumOfRegions; ucCount++)
+    {
+        ImageRegion_t *ptRegion  = &m_ptRegions[ucCount];
+        uint32_t      ulChecksum = Crc32((const uint8_t *)ppvDefaults[ucCount], ptRegion->ulLength);
+
+        memcpy(&m_pucImage[ptRegion->ulOffset], ppvDefaults[ucCount], ptRegion->ulLength);
+        memcpy(&m_pucImage[ptRegion->aulSlotOffset[0]], ppvDefaults[ucCount], ptRegion->ulLength);
+        memcpy(&m_pucImage[ptRegion->aulSlotOffset[1]], ppvDefaults[ucCount], ptRegion->ulLength);
+        ptRegion->aulSlotChecksum[0] = ulChecksum;
+        ptRegion->aulSlotChecksum[1] = ulChecksum;
+    }
+}//end CreateImage
+
+static void RecoverRegion(uint8_t ucRegion, const void *pvDefault)
+{
+    ImageRegion_t *ptRegion = &m_ptRegions[ucRegion];
+    uint8_t       *pucLive  = &m_pucImage[ptRegion->ulOffset];
+    uint8_t       ucNewest  = NewestSlot(ptRegion);
+    uint8_t       aucOrder[2];
+    uint8_t       ucCount   = 0;
+
+    aucOrder[0] = ucNewest;
+    aucOrder[1] = (uint8_t)(1u - ucNewest);
+
+    for (ucCount = 0; ucCount < 2u; ucCount++)
+    {
+        uint8_t       ucSlot  = aucOrder[ucCount];
+        const uint8_t *pucSlot = &m_pucImage[ptRegion->aulSlotOffset[ucSlot]];
+
+        if (Crc32(pucSlot, ptRegion->ulLength) != ptRegion->aulSlotChecksum[ucSlot])
+        {
+            //slot torn by restart while it was synced
+            continue;
+        }
+
+        if (0 != memcmp(pucLive, pucSlot, ptRegion->ulLength))
+        {
+            memcpy(pucLive, pucSlot, ptRegion->ulLength);
+            STATS_ADD(m_tStats.ulNumOfRolledBack, 1);
+        }
+
+        ptRegion->ulSequence = ptRegion->aulSlotSequence[ucSlot];
+        return;
+    }
+
+    //no valid checkpoint, start again from defaults
+    memcpy(pucLive, pvDefault, ptRegion->ulLength);
+    memcpy(&m_pucImage[ptRegion->aulSlotOffset[0]], pvDefault, ptRegion->ulLength);
+    memcpy(&m_pucImage[ptRegion->aulSlotOffset[1]], pvDefault, ptRegion->ulLength);
+    ptRegion->aulSlotChecksum[0] = Crc32(pucLive, ptRegion->ulLength);
+    ptRegion->aulSlotChecksum[1] = ptRegion->aulSlotChecksum[0];
+    ptRegion->aulSlotSequence[0] = 0;
+    ptRegion->aulSlotSequence[1] = 0;
+    ptRegion->ulSequence         = 0;
+    STATS_ADD(m_tStats.ulNumOfReset, 1);
+}//end RecoverRegion
+
+static uint8_t NewestSlot(const ImageRegion_t *ptRegion)
+{
+    //sequences wrap around
+    return ((int32_t)(ptRegion->aulSlotSequence[1] - ptRegion->aulSlotSequence[0]) > 0) ? 1u : 0u;
+}//end NewestSlot
+
+static void SyncRange(uint32_t ulOffset, uint32_t ulLength)
+{
+    uint32_t ulPageSize = (uint32_t)sysconf(_SC_PAGESIZE);
+    uint32_t ulStart    = ulOffset - (ulOffset % ulPageSize);
+
+    (void)msync(&m_pucImage[ulStart], (ulOffset - ulStart) + ulLength, MS_SYNC);
+}//end SyncRange
+
+static void ReadBootId(char *pcBootId)
+{
+    FILE *ptFile = fopen(BOOT_ID_PATH, "r");
+
+    memset(pcBootId, 0, MBAP_IMAGE_BOOT_ID_LEN);
+
+    if (NULL == ptFile)
+    {
+        //restart is not detected, images are always rolled back to checkpoint
+        return;
+    }
+
+    if (NULL == fgets(pcBootId, MBAP_IMAGE_BOOT_ID_LEN, ptFile))
+    {
+        pcBootId[0] = '\0';
+    }
+
+    fclose(ptFile);
+}//end ReadBootId
+
+static void BuildCrcTable(void)
+{
+    uint32_t ulCount = 0;
+
+    for (ulCount = 0; ulCount < 256u; ulCount++)
+    {
+        uint32_t ulValue = ulCount;
+        uint8_t  ucBit   = 0;
+
+        for (ucBit = 0; ucBit < 8u; ucBit++)
+        {
+            ulValue = (ulValue & 1u) ? ((ulValue >> 1) ^ CRC32_POLYNOMIAL) : (ulValue >> 1);
+        }
+
+        m_aulCrcTable[ulCount] = ulValue;
+    }
+}//end BuildCrcTable
+
+static uint32_t Crc32(const uint8_t *pucData, uint32_t ulLength)
+{
+    uint32_t ulCrc   = 0xFFFFFFFFu;
+    uint32_t ulCount = 0;
+
+    for (ulCount = 0; ulCount < ulLength; ulCount++)
+    {
+        ulCrc = m_aulCrcTable[(ulCrc ^ pucData[ulCount]) & 0xFFu] ^ (ulCrc >> 8);
+    }
+
+    return ulCrc ^ 0xFFFFFFFFu;
+}//end Crc32
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
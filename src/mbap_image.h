@@ -0,0 +1,223 @@
+//! @addtogroup ModbusTCPImage
+//! @{
+//
+//****************************************************************************
+//! @file mbap_image.h
+//! @brief This contains the prototypes, macros, constants or global variables
+//!        for the register image kept in a memory mapped file or a named
+//!        POSIX shared memory object.
+//!
+//!        Layout of file, host byte order, all offsets from start of file:
+//!        - ImageHeader_t(64 bytes)
+//!        - ImageRegion_t(64 bytes) per region
+//!        - live regions, served and written in place
+//!        - two checkpoint slots per region
+//!        Regions and slots start at MBAP_IMAGE_ALIGN. A region is written
+//!        between mbap_ImageWriteBegin() and mbap_ImageWriteEnd(), which make
+//!        its sequence odd while writing. mbap_ImageSync() copies changed
+//!        regions into their older checkpoint slot and syncs slot and header
+//!        to disk, so writes themselves never wait for the disk.
+//!
+//!        On open, live regions are taken over as they are if the system has
+//!        not restarted since the image was last mapped, the page cache then
+//!        still holds every write of a crashed process. After a restart live
+//!        regions are rolled back to their newest checkpoint with a valid
+//!        checksum, so writes after the last sync are lost but no region is
+//!        torn.
+//!
+//!        A shared memory image is created by the server with
+//!        mbap_ImageOpenShared() and attached by other processes with
+//!        mbap_ImageAttach(), which take the layout from the header. Every
+//!        process reads and writes live regions in place:
+//!        - writer: mbap_ImageWriteBegin(), write, mbap_ImageWriteEnd(). The
+//!          sequence is made odd by compare and swap, so writers of all
+//!          processes are serialised. A region left odd by a writer which died
+//!          is taken over after a bounded wait.
+//!        - reader: ulSeq = mbap_ImageReadBegin(), copy, repeat while
+//!          mbap_ImageReadRetry(ulSeq). Readers never block writers.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//
+//****************************************************************************
+#ifndef MBAP_IMAGE_H
+#define MBAP_IMAGE_H
+
+//****************************************************************************
+//                           Includes
+//****************************************************************************
+
+//****************************************************************************
+//                           Constants and typedefs
+//****************************************************************************
+#define MBAP_IMAGE_MAGIC           "MBIM"
+#define MBAP_IMAGE_VERSION         (1u)
+//! @brief Written in host byte order, image of other byte order is not taken over
+#define MBAP_IMAGE_BYTE_ORDER      (0x0102u)
+#define MBAP_IMAGE_MAX_REGIONS     (8u)
+//! @brief Alignment of header entries, regions and checkpoint slots
+#define MBAP_IMAGE_ALIGN           (64u)
+#define MBAP_IMAGE_BOOT_ID_LEN     (40u)
+
+//! @brief Result of opening an image
+enum ImageStatus
+{
+    eIMAGE_ERROR     = 0,           //!< File not opened or mapped
+    eIMAGE_CREATED   = 1,           //!< New file or other layout, regions hold defaults
+    eIMAGE_RESTORED  = 2,           //!< Regions taken over as left by previous process
+    eIMAGE_RECOVERED = 3,           //!< System restarted, regions rolled back to last checkpoint
+};
+
+//! @brief Header at start of file
+typedef struct ImageHeader
+{
+    char     acMagic[4];                            //!<MBAP_IMAGE_MAGIC
+    uint16_t usVersion;                             //!<MBAP_IMAGE_VERSION
+    uint16_t usHeaderLen;                           //!<Header and region entries in bytes
+    uint16_t usNumOfRegions;                        //!<Number of region entries
+    uint16_t usByteOrder;                           //!<MBAP_IMAGE_BYTE_ORDER
+    uint32_t ulFileSize;                            //!<Size of file
+    char     acBootId[MBAP_IMAGE_BOOT_ID_LEN];      //!<Boot of system which mapped image last
+    uint8_t  aucReserved[8];                        //!<Zero
+} ImageHeader_t;
+
+//! @brief Entry of a region following header
+typedef struct ImageRegion
+{
+    uint32_t ulOffset;                              //!<Live region
+    uint32_t ulLength;                              //!<Bytes of region and of each slot
+    uint32_t ulSequence;                            //!<Incremented before and after each write, odd while writing
+    uint32_t ulReserved;                            //!<Zero
+    uint32_t aulSlotOffset[2];                      //!<Checkpoint slots
+    uint32_t aulSlotSequence[2];                    //!<Sequence of region copied into slot, higher is newer
+    uint32_t aulSlotChecksum[2];                    //!<CRC-32 of slot
+    uint8_t  aucReserved[24];                       //!<Zero
+} ImageRegion_t;
+
+//! @brief Statistics of image
+typedef struct ImageStats
+{
+    uint32_t ulNumOfCheckpoints;                    //!<Regions copied into a checkpoint slot
+    uint32_t ulNumOfRolledBack;                     //!<Regions which lost writes when rolled back on open
+    uint32_t ulNumOfReset;                          //!<Regions without valid checkpoint set to defaults on open
+} ImageStats_t;
+
+//****************************************************************************
+//                           Global variables
+//****************************************************************************
+
+//****************************************************************************
+//                           Global Functions
+//****************************************************************************
+//
+//! @brief Map image file, created with default contents if missing or of
+//!        other layout. Only one image is open at a time.
+//! @param[in]  pcPath          File path
+//! @param[in]  pulLengths      Bytes of each region
+//! @param[in]  ppvDefaults     Contents of each region in new image
+//! @param[in]  ucNumOfRegions  Number of regions, 1 to MBAP_IMAGE_MAX_REGIONS
+//! @return     uint8_t         Result(enum ImageStatus)
+//
+uint8_t mbap_ImageOpen(const char *pcPath, const uint32_t *pulLengths,
+                       const void * const *ppvDefaults, uint8_t ucNumOfRegions);
+
+//
+//! @brief Map image in named POSIX shared memory object for other processes,
+//!        created with default contents if missing or of other layout.
+//!        Contents are lost with system restart.
+//! @param[in]  pcName          Object name, "/name"
+//! @param[in]  pulLengths      Bytes of each region
+//! @param[in]  ppvDefaults     Contents of each region in new image
+//! @param[in]  ucNumOfRegions  Number of regions, 1 to MBAP_IMAGE_MAX_REGIONS
+//! @return     uint8_t         Result(enum ImageStatus)
+//
+uint8_t mbap_ImageOpenShared(const char *pcName, const uint32_t *pulLengths,
+                             const void * const *ppvDefaults, uint8_t ucNumOfRegions);
+
+//
+//! @brief Map shared memory image created by another process, layout is
+//!        taken from its header
+//! @param[in]  pcName  Object name
+//! @return     bool    true - attached, false - missing or not an image
+//
+bool mbap_ImageAttach(const char *pcName);
+
+//
+//! @brief Unmap image without checkpoint, call mbap_ImageSync() before to
+//!        keep last writes over a system restart
+//! @param[in]  None
+//! @return     None
+//
+void mbap_ImageClose(void);
+
+//
+//! @brief Live region of open image
+//! @param[in]  ucRegion  Region index
+//! @return     void*     Region, NULL if no image is open
+//
+void *mbap_ImageRegion(uint8_t ucRegion);
+
+//
+//! @brief Bytes of region of open image
+//! @param[in]  ucRegion  Region index
+//! @return     uint32_t  Length, 0 if no such region
+//
+uint32_t mbap_ImageRegionLength(uint8_t ucRegion);
+
+//
+//! @brief Sequence of a region, moved by every write of any process
+//! @param[in]  ucRegion  Region index
+//! @return     const uint32_t*  Sequence, valid while image is open, NULL if no such region
+//
+const uint32_t *mbap_ImageSequence(uint8_t ucRegion);
+
+//
+//! @brief Start reading a region, waits for a writer to end
+//! @param[in]  ucRegion  Region index
+//! @return     uint32_t  Sequence to pass to mbap_ImageReadRetry()
+//
+uint32_t mbap_ImageReadBegin(uint8_t ucRegion);
+
+//
+//! @brief Check whether region was written while it was read
+//! @param[in]  ucRegion    Region index
+//! @param[in]  ulSequence  Sequence returned by mbap_ImageReadBegin()
+//! @return     bool        true - read again
+//
+bool mbap_ImageReadRetry(uint8_t ucRegion, uint32_t ulSequence);
+
+//
+//! @brief Start writing a region, writers of a region in all processes are
+//!        serialised. Does nothing if no image is open.
+//! @param[in]  ucRegion  Region index
+//! @return     None
+//
+void mbap_ImageWriteBegin(uint8_t ucRegion);
+
+//
+//! @brief End writing a region
+//! @param[in]  ucRegion  Region index
+//! @return     None
+//
+void mbap_ImageWriteEnd(uint8_t ucRegion);
+
+//
+//! @brief Copy regions changed since last checkpoint into a checkpoint slot
+//!        and sync them to disk. Called periodically by one thread, a region
+//!        being written is taken at next call.
+//! @param[in]  None
+//! @return     uint32_t  Number of regions copied
+//
+uint32_t mbap_ImageSync(void);
+
+//
+//! @brief Read statistics of image
+//! @param[out] ptStats  Statistics
+//! @return     None
+//
+void mbap_ImageGetStats(ImageStats_t *ptStats);
+
+#endif // MBAP_IMAGE_H
+//****************************************************************************
+//                             End of file
+//****************************************************************************
+//! @}
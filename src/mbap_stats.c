@@ -0,0 +1,332 @@
+//! @addtogroup ModbusTCPStatistics
+//! @brief Per function code statistics of the modbus application
+//! @{
+//!
+//****************************************************************************/
+//! @file mbap_stats.c
+//! @brief Per function code request, exception and byte counters and
+//!        latency histograms. Every thread counts into its own block, blocks
+//!        are merged when a snapshot is taken, so counting takes no lock.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+//user defined header files
+#include "mbap_conf.h"
+#include "mbap.h"
+#include "mbap_hist.h"
+#include "mbap_stats.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+#define FUNCTION_CODE_OFFSET                        (7u)
+#define EXCEPTION_TYPE_OFFSET                       (8u)
+#define EXCEPTION_START_FUNCTION_CODE               (0x80)
+//slot 0 counts function codes without own slot
+#define OTHER_SLOT                                  (0u)
+
+//Counter of a thread block, written by its thread only
+#define STATS_ADD(x, v)      __atomic_store_n(&(x), (x) + (v), __ATOMIC_RELAXED)
+#define STATS_LOAD(x)        __atomic_load_n(&(x), __ATOMIC_RELAXED)
+
+//! @brief Statistics of a thread
+typedef struct ThreadStats
+{
+    FunctionCodeStats_t atSlots[STATS_FC_SLOTS];    //!<Statistics by function code slot
+} ThreadStats_t;
+
+//****************************************************************************/
+//                           Private Functions
+//****************************************************************************/
+//
+//! @brief Statistics of calling thread, taken on first use
+//! @param[in]  None
+//! @return     ThreadStats_t*  Statistics, NULL if no block is free
+//
+static ThreadStats_t *GetThreadStats(void);
+
+//
+//! @brief Slot of a function code, assigned on first use
+//! @param[in]  ucFunctionCode  Function code
+//! @return     uint8_t         Slot
+//
+static uint8_t GetSlot(uint8_t ucFunctionCode);
+
+//****************************************************************************/
+//                           external variables
+//****************************************************************************/
+
+//****************************************************************************/
+//                           Private variables
+//****************************************************************************/
+static ThreadStats_t         m_atThreadStats[STATS_THREADS];
+static uint32_t              m_ulNumOfThreads;
+static __thread ThreadStats_t *m_ptThreadStats;
+//slot + 1 of function code, 0 - no slot yet
+static uint8_t               m_aucSlotOfFunctionCode[256];
+static uint8_t               m_aucFunctionCodeOfSlot[STATS_FC_SLOTS];
+static uint32_t              m_ulNumOfSlots = 1;
+static uint32_t              m_ulDropped;
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+uint64_t mbap_StatsTime(void)
+{
+    struct timespec tNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &tNow);
+
+    return ((uint64_t)tNow.tv_sec * 1000000000u) + (uint64_t)tNow.tv_nsec;
+}//end mbap_StatsTime
+
+void mbap_StatsRecord(const ModbusRequest_t *ptRequest)
+{
+    ThreadStats_t       *ptThreadStats  = GetThreadStats();
+    FunctionCodeStats_t *ptSlot         = NULL;
+    uint8_t             ucFunctionCode  = STATS_OTHER_FUNCTION_CODES;
+    uint8_t             ucException     = 0;
+
+    if (NULL == ptThreadStats)
+    {
+        __atomic_fetch_add(&m_ulDropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    if (ptRequest->usQueryLen > FUNCTION_CODE_OFFSET)
+    {
+        ucFunctionCode = ptRequest->pucQuery[FUNCTION_CODE_OFFSET];
+    }
+
+    ptSlot = &ptThreadStats->atSlots[GetSlot(ucFunctionCode)];
+
+    STATS_ADD(ptSlot->ulRequests, 1u);
+    STATS_ADD(ptSlot->ullBytesIn, ptRequest->usQueryLen);
+    STATS_ADD(ptSlot->ullBytesOut, ptRequest->usResponseLen);
+
+    if (0 == ptRequest->usResponseLen)
+    {
+        STATS_ADD(ptSlot->ulNoResponse, 1u);
+    }
+    else
+    {
+        if (ptRequest->pucResponse[FUNCTION_CODE_OFFSET] & EXCEPTION_START_FUNCTION_CODE)
+        {
+            ucException = ptRequest->pucResponse[EXCEPTION_TYPE_OFFSET];
+        }
+
+        if (ucException < STATS_MAX_EXCEPTION)
+        {
+            STATS_ADD(ptSlot->aulExceptions[ucException], 1u);
+        }
+    }
+
+    if (0 != ptRequest->ullStartTime)
+    {
+        uint64_t ullLatency = mbap_StatsTime() - ptRequest->ullStartTime;
+
+        mbap_HistRecord(&ptSlot->tLatency, (ullLatency > 0xFFFFFFFFu) ? 0xFFFFFFFFu : (uint32_t)ullLatency);
+    }
+}//end mbap_StatsRecord
+
+void mbap_StatsSnapshot(ModbusStats_t *ptStats)
+{
+    uint32_t ulNumOfThreads = __atomic_load_n(&m_ulNumOfThreads, __ATOMIC_ACQUIRE);
+    uint32_t ulNumOfSlots   = __atomic_load_n(&m_ulNumOfSlots, __ATOMIC_ACQUIRE);
+    uint32_t ulSlot         = 0;
+
+    memset(ptStats, 0, sizeof(ModbusStats_t));
+
+    if (ulNumOfSlots > STATS_FC_SLOTS)
+    {
+        ulNumOfSlots = STATS_FC_SLOTS;
+    }
+
+    for (ulSlot = 0; ulSlot < ulNumOfSlots; ulSlot++)
+    {
+        FunctionCodeStats_t *ptEntry        = &ptStats->atEntries[ptStats->ucNumOfEntries];
+        uint8_t             ucFunctionCode  = __atomic_load_n(&m_aucFunctionCodeOfSlot[ulSlot], __ATOMIC_ACQUIRE);
+        uint32_t            ulThread        = 0;
+        uint8_t             ucCount         = 0;
+
+        //slot lost a race for its function code and is never counted into
+        if ((OTHER_SLOT != ulSlot) &&
+            (__atomic_load_n(&m_aucSlotOfFunctionCode[ucFunctionCode], __ATOMIC_ACQUIRE) != (ulSlot + 1u)))
+        {
+            continue;
+        }
+
+        ptEntry->ucFunctionCode = (OTHER_SLOT == ulSlot) ? STATS_OTHER_FUNCTION_CODES : ucFunctionCode;
+
+        for (ulThread = 0; ulThread < ulNumOfThreads; ulThread++)
+        {
+            const FunctionCodeStats_t *ptSlot = &m_atThreadStats[ulThread].atSlots[ulSlot];
+
+            ptEntry->ulRequests   += STATS_LOAD(ptSlot->ulRequests);
+            ptEntry->ulNoResponse += STATS_LOAD(ptSlot->ulNoResponse);
+            ptEntry->ullBytesIn   += STATS_LOAD(ptSlot->ullBytesIn);
+            ptEntry->ullBytesOut  += STATS_LOAD(ptSlot->ullBytesOut);
+
+            for (ucCount = 0; ucCount < STATS_MAX_EXCEPTION; ucCount++)
+            {
+                ptEntry->aulExceptions[ucCount] += STATS_LOAD(ptSlot->aulExceptions[ucCount]);
+            }
+
+            mbap_HistMerge(&ptEntry->tLatency, &ptSlot->tLatency);
+        }
+
+        //other function codes entry is kept only if used
+        if ((OTHER_SLOT != ulSlot) || (0 != ptEntry->ulRequests))
+        {
+            ptStats->ucNumOfEntries++;
+        }
+        else
+        {
+            memset(ptEntry, 0, sizeof(FunctionCodeStats_t));
+        }
+    }//end for
+
+    ptStats->ulDropped = __atomic_load_n(&m_ulDropped, __ATOMIC_RELAXED);
+}//end mbap_StatsSnapshot
+
+const FunctionCodeStats_t *mbap_StatsFind(const ModbusStats_t *ptStats, uint8_t ucFunctionCode)
+{
+    uint8_t ucCount = 0;
+
+    for (ucCount = 0; ucCount < ptStats->ucNumOfEntries; ucCount++)
+    {
+        if (ptStats->atEntries[ucCount].ucFunctionCode == ucFunctionCode)
+        {
+            return &ptStats->atEntries[ucCount];
+        }
+    }
+
+    return NULL;
+}//end mbap_StatsFind
+
+uint32_t mbap_StatsDump(const ModbusStats_t *ptStats, char *pcBuf, uint32_t ulBufSize)
+{
+    uint32_t ulLen   = 0;
+    uint8_t  ucCount = 0;
+    uint8_t  ucCode  = 0;
+
+    if (0 == ulBufSize)
+    {
+        return 0;
+    }
+
+    pcBuf[0] = '\0';
+
+    for (ucCount = 0; (ucCount < ptStats->ucNumOfEntries) && (ulLen < ulBufSize); ucCount++)
+    {
+        const FunctionCodeStats_t *ptEntry = &ptStats->atEntries[ucCount];
+
+        ulLen += (uint32_t)snprintf(&pcBuf[ulLen], ulBufSize - ulLen,
+                                    "fc %u: requests %lu, no response %lu, bytes in %llu out %llu, "
+                                    "latency ns p50 %lu p90 %lu p99 %lu p99.9 %lu max %lu, exceptions",
+                                    ptEntry->ucFunctionCode,
+                                    (unsigned long)ptEntry->ulRequests,
+                                    (unsigned long)ptEntry->ulNoResponse,
+                                    (unsigned long long)ptEntry->ullBytesIn,
+                                    (unsigned long long)ptEntry->ullBytesOut,
+                                    (unsigned long)mbap_HistPercentile(&ptEntry->tLatency, 500),
+                                    (unsigned long)mbap_HistPercentile(&ptEntry->tLatency, 900),
+                                    (unsigned long)mbap_HistPercentile(&ptEntry->tLatency, 990),
+                                    (unsigned long)mbap_HistPercentile(&ptEntry->tLatency, 999),
+                                    (unsigned long)ptEntry->tLatency.ulMax);
+
+        for (ucCode = 1; (ucCode < STATS_MAX_EXCEPTION) && (ulLen < ulBufSize); ucCode++)
+        {
+            if (0 != ptEntry->aulExceptions[ucCode])
+            {
+                ulLen += (uint32_t)snprintf(&pcBuf[ulLen], ulBufSize - ulLen, " %u:%lu",
+                                            ucCode, (unsigned long)ptEntry->aulExceptions[ucCode]);
+            }
+        }
+
+        if (ulLen < ulBufSize)
+        {
+            ulLen += (uint32_t)snprintf(&pcBuf[ulLen], ulBufSize - ulLen, "\n");
+        }
+    }//end for
+
+    return (ulLen < ulBufSize) ? ulLen : (ulBufSize - 1u);
+}//end mbap_StatsDump
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static ThreadStats_t *GetThreadStats(void)
+{
+    uint32_t ulIndex = 0;
+
+    if (NULL != m_ptThreadStats)
+    {
+        return m_ptThreadStats;
+    }
+
+    ulIndex = __atomic_load_n(&m_ulNumOfThreads, __ATOMIC_ACQUIRE);
+
+    //count never passes number of entries, threads without entry only read it
+    while (ulIndex < STATS_THREADS)
+    {
+        if (__atomic_compare_exchange_n(&m_ulNumOfThreads, &ulIndex, ulIndex + 1u, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            m_ptThreadStats = &m_atThreadStats[ulIndex];
+            break;
+        }
+    }
+
+    return m_ptThreadStats;
+}//end GetThreadStats
+
+static uint8_t GetSlot(uint8_t ucFunctionCode)
+{
+    uint8_t  ucSlot = __atomic_load_n(&m_aucSlotOfFunctionCode[ucFunctionCode], __ATOMIC_ACQUIRE);
+    uint8_t  ucNone = 0;
+    uint32_t ulNew  = 0;
+
+    if (STATS_OTHER_FUNCTION_CODES == ucFunctionCode)
+    {
+        return OTHER_SLOT;
+    }
+
+    if (0 != ucSlot)
+    {
+        return (uint8_t)(ucSlot - 1u);
+    }
+
+    ulNew = __atomic_fetch_add(&m_ulNumOfSlots, 1, __ATOMIC_ACQ_REL);
+
+    if (ulNew >= STATS_FC_SLOTS)
+    {
+        return OTHER_SLOT;
+    }
+
+    __atomic_store_n(&m_aucFunctionCodeOfSlot[ulNew], ucFunctionCode, __ATOMIC_RELEASE);
+
+    //other thread may have assigned a slot meanwhile, new slot stays unused then
+    if (!__atomic_compare_exchange_n(&m_aucSlotOfFunctionCode[ucFunctionCode], &ucNone,
+                                     (uint8_t)(ulNew + 1u), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        return (uint8_t)(ucNone - 1u);
+    }
+
+    return (uint8_t)ulNew;
+}//end GetSlot
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
@@ -0,0 +1,97 @@
+//! @addtogroup ModbusTCPStatistics
+//! @{
+//
+//****************************************************************************
+//! @file mbap_stats.h
+//! @brief This contains the prototypes, macros, constants or global variables
+//!        for the per function code statistics of the modbus application
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//
+//****************************************************************************
+#ifndef MBAP_STATS_H
+#define MBAP_STATS_H
+
+//****************************************************************************
+//                           Includes
+//****************************************************************************
+
+//****************************************************************************
+//                           Constants and typedefs
+//****************************************************************************
+//! @brief Exception codes counted, 0 - no exception
+#define STATS_MAX_EXCEPTION               (12u)
+//! @brief Function code of entry counting function codes without own entry
+#define STATS_OTHER_FUNCTION_CODES        (0u)
+
+//! @brief Statistics of a function code
+typedef struct FunctionCodeStats
+{
+    uint8_t            ucFunctionCode;                      //!<Function code, STATS_OTHER_FUNCTION_CODES - others
+    uint32_t           ulRequests;                          //!<Number of requests
+    uint32_t           ulNoResponse;                        //!<Invalid queries not answered
+    uint32_t           aulExceptions[STATS_MAX_EXCEPTION];  //!<Responses by exception code, 0 - normal response
+    uint64_t           ullBytesIn;                          //!<Query bytes
+    uint64_t           ullBytesOut;                         //!<Response bytes
+    LatencyHistogram_t tLatency;                            //!<Processing time, ns
+} FunctionCodeStats_t;
+
+//! @brief Snapshot of statistics of all threads
+typedef struct ModbusStats
+{
+    uint8_t             ucNumOfEntries;                     //!<Number of function code entries
+    FunctionCodeStats_t atEntries[STATS_FC_SLOTS];          //!<Function code entries
+    uint32_t            ulDropped;                          //!<Requests not counted, too many threads
+} ModbusStats_t;
+
+//****************************************************************************
+//                           Global variables
+//****************************************************************************
+
+//****************************************************************************
+//                           Global Functions
+//****************************************************************************
+//
+//! @brief Time for latency measurement
+//! @param[in]  None
+//! @return     uint64_t  Monotonic time, ns
+//
+uint64_t mbap_StatsTime(void);
+
+//
+//! @brief Count finished request in statistics of calling thread
+//! @param[in]  ptRequest  Request with response, processing time is counted
+//!                        if ullStartTime is not 0
+//! @return     None
+//
+void mbap_StatsRecord(const ModbusRequest_t *ptRequest);
+
+//
+//! @brief Merge statistics of all threads, may be called from any thread
+//! @param[out] ptStats  Snapshot
+//! @return     None
+//
+void mbap_StatsSnapshot(ModbusStats_t *ptStats);
+
+//
+//! @brief Find entry of a function code in snapshot
+//! @param[in]  ptStats         Snapshot
+//! @param[in]  ucFunctionCode  Function code
+//! @return     const FunctionCodeStats_t*  Entry, NULL if function code was not seen
+//
+const FunctionCodeStats_t *mbap_StatsFind(const ModbusStats_t *ptStats, uint8_t ucFunctionCode);
+
+//
+//! @brief Write snapshot as text, one line per function code
+//! @param[in]  ptStats    Snapshot
+//! @param[out] pcBuf      Text buffer
+//! @param[in]  ulBufSize  Size of text buffer
+//! @return     uint32_t   Length of text, text is truncated to buffer size
+//
+uint32_t mbap_StatsDump(const ModbusStats_t *ptStats, char *pcBuf, uint32_t ulBufSize);
+
+#endif // MBAP_STATS_H
+//****************************************************************************
+//                             End of file
+//****************************************************************************
+//! @}
@@ -0,0 +1,497 @@
+//! @addtogroup ModbusTCPSubscription
+//! @brief Subscriptions to changes of data ranges
+//! @{
+//!
+//****************************************************************************/
+//! @file mbap_subscription.c
+//! @brief Keeps data last reported to subscribers and pushes notifications of
+//!        changed ranges. A range is read again only when its change version
+//!        moved, so that an idle server costs one counter load per poll.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+//user defined header files
+#include "mbap_conf.h"
+#include "mbap.h"
+#include "mbap_unit.h"
+#include "mbap_change.h"
+#include "mbap_subscription.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+#define MBAP_HEADER_LEN             (7u)
+#define MBAP_LEN_OFFSET             (4u)
+//function code follows MBAP header
+#define DATA_OFFSET                 (MBAP_HEADER_LEN + 1u)
+//Largest data of a range, registers or packed bits
+#define MAX_DATA_LEN                (SUBSCRIPTION_MAX_REGISTERS * 2u)
+//Read query passed to user functions for reading a range
+#define READ_QUERY_LEN              (12u)
+//No changed data in range
+#define NO_CHANGE                   (0xFFFFu)
+
+//! @brief Subscription of a connection
+typedef struct Subscription
+{
+    const void         *pvConnection;               //!<Connection of subscriber, NULL - free
+    const ModbusUnit_t *ptUnit;                     //!<Unit addressed by subscribe query
+    uint8_t            aucHeader[MBAP_HEADER_LEN];  //!<MBAP header of subscribe query
+    uint8_t            ucTable;                     //!<Table(enum DataTable)
+    uint16_t           usStartAddress;              //!<First data relative to table start
+    uint16_t           usAddress;                   //!<First data as addressed by client
+    uint16_t           usNumOfData;                 //!<Number of data
+    uint16_t           usDeadband;                  //!<Register change reported above
+    uint16_t           usMinIntervalMs;             //!<Minimum time between notifications
+    uint32_t           ulVersion;                   //!<Change version when range was last read
+    uint64_t           ullLastSent;                 //!<Time of last notification, 0 - not polled yet
+    bool               bDue;                        //!<Change waits for interval or send buffer
+    uint8_t            aucReported[MAX_DATA_LEN];   //!<Data last reported
+} Subscription_t;
+
+//****************************************************************************/
+//                           Private Functions
+//****************************************************************************/
+//
+//! @brief Read data of range as read function codes return it
+//! @param[in]   ptSub    Subscription
+//! @param[out]  pucData  Data
+//! @return      bool     true - read
+//
+static bool ReadRange(const Subscription_t *ptSub, uint8_t *pucData);
+
+//
+//! @brief Send notification of subscription when range changed and it is due
+//! @param[in,out]  ptSub      Subscription
+//! @param[in]      ullTimeMs  Current time
+//! @return         bool       true - nothing left to report, false - change
+//!                            waits for interval or send buffer
+//
+static bool PollSubscription(Subscription_t *ptSub, uint64_t ullTimeMs);
+
+//
+//! @brief Find first and last data differing from data last reported
+//! @param[in]   ptSub     Subscription
+//! @param[in]   pucData   Current data
+//! @param[out]  pusLast   Last changed data
+//! @return      uint16_t  First changed data, NO_CHANGE - none
+//
+static uint16_t FindChange(const Subscription_t *ptSub, const uint8_t *pucData, uint16_t *pusLast);
+
+//
+//! @brief Encode address, number of data and data of window
+//! @param[in]   ptSub     Subscription
+//! @param[in]   pucData   Current data of range
+//! @param[in]   usFirst   First data of window
+//! @param[in]   usLast    Last data of window
+//! @param[out]  pucBuf    Data following subscription id
+//! @return      uint16_t  Bytes encoded
+//
+static uint16_t EncodeWindow(const Subscription_t *ptSub, const uint8_t *pucData,
+                             uint16_t usFirst, uint16_t usLast, uint8_t *pucBuf);
+
+//
+//! @brief Take data of window as reported
+//! @param[in,out]  ptSub    Subscription
+//! @param[in]      pucData  Current data of range
+//! @param[in]      usFirst  First data of window
+//! @param[in]      usLast   Last data of window
+//! @return         None
+//
+static void TakeReported(Subscription_t *ptSub, const uint8_t *pucData, uint16_t usFirst, uint16_t usLast);
+
+//
+//! @brief Check if table holds coils or discrete inputs
+//! @param[in]  ucTable  Table
+//! @return     bool     true - bits
+//
+static bool IsBitTable(uint8_t ucTable);
+
+//****************************************************************************/
+//                           Private variables
+//****************************************************************************/
+static Subscription_t m_atSubscriptions[SUBSCRIPTIONS];
+static uint16_t       m_usNumOfSubscriptions;
+static pfnNotify      m_ptfnNotify;
+//change count at last poll, ranges are not checked while it stays
+static uint32_t       m_ulChanges;
+//a change waits for interval or send buffer, ranges are checked anyway
+static bool           m_bDeferred;
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+void mbap_SubscriptionInit(pfnNotify ptfnNotify)
+{
+    memset(m_atSubscriptions, 0, sizeof(m_atSubscriptions));
+    m_usNumOfSubscriptions = 0;
+    m_ptfnNotify           = ptfnNotify;
+    m_ulChanges            = mbap_ChangeCount();
+    m_bDeferred            = false;
+}//end mbap_SubscriptionInit
+
+uint8_t mbap_SubscriptionAdd(const ModbusRequest_t *ptRequest,
+                             uint8_t ucTable,
+                             uint16_t usAddress,
+                             uint16_t usNumOfData,
+                             uint16_t usDeadband,
+                             uint16_t usMinIntervalMs,
+                             uint8_t *pucBuf,
+                             uint16_t *pusLen)
+{
+    const ModbusData_t *ptData = ptRequest->ptUnit->ptModbusData;
+    Subscription_t     *ptSub  = NULL;
+    uint16_t           usMax   = IsBitTable(ucTable) ? SUBSCRIPTION_MAX_BITS : SUBSCRIPTION_MAX_REGISTERS;
+    uint16_t           usIndex = 0;
+    ModbusRequest_t    tRange;
+
+    //changes can only be pushed on a connection of a transport
+    if ((NULL == m_ptfnNotify) || (NULL == ptRequest->pvConnection))
+    {
+        return eILLEGAL_FUNCTION_CODE;
+    }
+
+    if ((0 == usNumOfData) || (usNumOfData > usMax))
+    {
+        return eILLEGAL_DATA_VALUE;
+    }
+
+    for (usIndex = 0; usIndex < SUBSCRIPTIONS; usIndex++)
+    {
+        if (NULL == m_atSubscriptions[usIndex].pvConnection)
+        {
+            ptSub = &m_atSubscriptions[usIndex];
+            break;
+        }
+    }
+
+    //client may subscribe again after others cancelled
+    if (NULL == ptSub)
+    {
+        return eSERVER_BUSY;
+    }
+
+    memset(ptSub, 0, sizeof(*ptSub));
+    memcpy(ptSub->aucHeader, ptRequest->pucQuery, MBAP_HEADER_LEN);
+    ptSub->ptUnit          = ptRequest->ptUnit;
+    ptSub->ucTable         = ucTable;
+    ptSub->usAddress       = usAddress;
+    ptSub->usNumOfData     = usNumOfData;
+    ptSub->usDeadband      = usDeadband;
+    ptSub->usMinIntervalMs = usMinIntervalMs;
+
+    switch (ucTable)
+    {
+    case eTABLE_COILS:
+        ptSub->usStartAddress = (uint16_t)(usAddress - ptData->usCoilsStartAddress);
+        break;
+
+    case eTABLE_DISCRETE_INPUTS:
+        ptSub->usStartAddress = (uint16_t)(usAddress - ptData->usDiscreteInputStartAddress);
+        break;
+
+    case eTABLE_HOLDING_REGISTERS:
+        ptSub->usStartAddress = (uint16_t)(usAddress - ptData->usHoldingRegisterStartAddress);
+        break;
+
+    default:
+        ptSub->usStartAddress = (uint16_t)(usAddress - ptData->usInputRegisterStartAddress);
+        break;
+    }//end switch
+
+    //ranges are polled with synchronous functions by thread submitting requests,
+    //a range the asynchronous access function would defer cannot be subscribed
+    tRange                = *ptRequest;
+    tRange.ucTable        = ucTable;
+    tRange.usStartAddress = ptSub->usStartAddress;
+    tRange.usNumOfData    = usNumOfData;
+
+    if (mbap_IsAsyncRange(&tRange))
+    {
+        return eILLEGAL_FUNCTION_CODE;
+    }
+
+    //version before data, a write while reading is reported by next poll
+    ptSub->ulVersion = mbap_ChangeVersion(ptSub->ptUnit, ucTable, ptSub->usStartAddress, usNumOfData);
+
+    if (!ReadRange(ptSub, ptSub->aucReported))
+    {
+        return eSERVER_DEVICE_FAILURE;
+    }
+
+    //whole range is the first report
+    pucBuf[0] = (uint8_t)usIndex;
+    *pusLen   = (uint16_t)(1u + EncodeWindow(ptSub, ptSub->aucReported, 0, (uint16_t)(usNumOfData - 1u), &pucBuf[1]));
+
+    ptSub->pvConnection = ptRequest->pvConnection;
+    m_usNumOfSubscriptions++;
+
+    //time of subscription is taken by next poll
+    m_bDeferred = true;
+
+    return eNO_EXCEPTION;
+}//end mbap_SubscriptionAdd
+
+bool mbap_SubscriptionCancel(const void *pvConnection, uint8_t ucId)
+{
+    //other connections cannot cancel subscriptions they do not own
+    if ((ucId >= SUBSCRIPTIONS) || (NULL == pvConnection) ||
+        (pvConnection != m_atSubscriptions[ucId].pvConnection))
+    {
+        return false;
+    }
+
+    m_atSubscriptions[ucId].pvConnection = NULL;
+    m_usNumOfSubscriptions--;
+
+    return true;
+}//end mbap_SubscriptionCancel
+
+void mbap_SubscriptionDrop(const void *pvConnection)
+{
+    uint16_t usIndex = 0;
+
+    for (usIndex = 0; (usIndex < SUBSCRIPTIONS) && (0 != m_usNumOfSubscriptions); usIndex++)
+    {
+        if ((NULL != pvConnection) && (pvConnection == m_atSubscriptions[usIndex].pvConnection))
+        {
+            m_atSubscriptions[usIndex].pvConnection = NULL;
+            m_usNumOfSubscriptions--;
+        }
+    }
+}//end mbap_SubscriptionDrop
+
+void mbap_SubscriptionPoll(uint64_t ullTimeMs)
+{
+    uint32_t ulChanges = mbap_ChangeCount();
+    uint16_t usIndex   = 0;
+    bool     bDeferred = false;
+
+    if ((0 == m_usNumOfSubscriptions) || ((ulChanges == m_ulChanges) && !m_bDeferred))
+    {
+        return;
+    }
+
+    m_ulChanges = ulChanges;
+
+    //notification may close connection and drop its subscriptions meanwhile
+    for (usIndex = 0; usIndex < SUBSCRIPTIONS; usIndex++)
+    {
+        Subscription_t *ptSub = &m_atSubscriptions[usIndex];
+
+        if ((NULL != ptSub->pvConnection) && !PollSubscription(ptSub, ullTimeMs))
+        {
+            bDeferred = true;
+        }
+    }
+
+    m_bDeferred = bDeferred;
+}//end mbap_SubscriptionPoll
+
+uint16_t mbap_SubscriptionCount(void)
+{
+    return m_usNumOfSubscriptions;
+}//end mbap_SubscriptionCount
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static bool ReadRange(const Subscription_t *ptSub, uint8_t *pucData)
+{
+    static const uint8_t s_aucReadCodes[] = {eFC_READ_COILS, eFC_READ_DISCRETE_INPUTS,
+                                             eFC_READ_HOLDING_REGISTERS, eFC_READ_INPUT_REGISTERS};
+    ModbusRequest_t tRequest;
+    uint8_t         aucQuery[READ_QUERY_LEN] = {0};
+
+    //reading a range is a read of it, seen by probes as such
+    memcpy(aucQuery, ptSub->aucHeader, MBAP_HEADER_LEN);
+    aucQuery[7]  = s_aucReadCodes[ptSub->ucTable];
+    aucQuery[8]  = (uint8_t)(ptSub->usAddress >> 8);
+    aucQuery[9]  = (uint8_t)(ptSub->usAddress);
+    aucQuery[10] = (uint8_t)(ptSub->usNumOfData >> 8);
+    aucQuery[11] = (uint8_t)(ptSub->usNumOfData);
+
+    memset(&tRequest, 0, sizeof(tRequest));
+    tRequest.pucQuery       = aucQuery;
+    tRequest.usQueryLen     = READ_QUERY_LEN;
+    tRequest.ptUnit         = ptSub->ptUnit;
+    tRequest.ucTable        = ptSub->ucTable;
+    tRequest.usStartAddress = ptSub->usStartAddress;
+    tRequest.usNumOfData    = ptSub->usNumOfData;
+    tRequest.pucReadData    = pucData;
+
+    return (eNO_EXCEPTION == mbap_AccessRequestData(&tRequest));
+}//end ReadRange
+
+static bool PollSubscription(Subscription_t *ptSub, uint64_t ullTimeMs)
+{
+    uint8_t  aucData[MAX_DATA_LEN];
+    uint8_t  aucAdu[DATA_OFFSET + SUBSCRIPTION_HEADER_LEN + MAX_DATA_LEN];
+    uint32_t ulVersion = mbap_ChangeVersion(ptSub->ptUnit, ptSub->ucTable, ptSub->usStartAddress, ptSub->usNumOfData);
+    uint16_t usFirst   = 0;
+    uint16_t usLast    = 0;
+    uint16_t usLen     = 0;
+
+    if (0 == ptSub->ullLastSent)
+    {
+        //first notification is at least the interval after subscribe response
+        ptSub->ullLastSent = ullTimeMs;
+    }
+
+    if ((ulVersion == ptSub->ulVersion) && !ptSub->bDue)
+    {
+        return true;
+    }
+
+    if (ullTimeMs < (ptSub->ullLastSent + ptSub->usMinIntervalMs))
+    {
+        ptSub->bDue = true;
+        return false;
+    }
+
+    ptSub->ulVersion = ulVersion;
+    ptSub->bDue      = false;
+
+    if (!ReadRange(ptSub, aucData))
+    {
+        return true;
+    }
+
+    usFirst = FindChange(ptSub, aucData, &usLast);
+
+    //written with same value or change within deadband
+    if (NO_CHANGE == usFirst)
+    {
+        return true;
+    }
+
+    memcpy(aucAdu, ptSub->aucHeader, MBAP_HEADER_LEN);
+    aucAdu[MBAP_HEADER_LEN] = eFC_SUBSCRIBE;
+    aucAdu[DATA_OFFSET]     = (uint8_t)(ptSub - m_atSubscriptions);
+
+    usLen = (uint16_t)(DATA_OFFSET + 1u + EncodeWindow(ptSub, aucData, usFirst, usLast, &aucAdu[DATA_OFFSET + 1u]));
+    aucAdu[MBAP_LEN_OFFSET]      = (uint8_t)((usLen - 6u) >> 8);
+    aucAdu[MBAP_LEN_OFFSET + 1u] = (uint8_t)(usLen - 6u);
+
+    //window is taken as reported only when it is sent
+    if (!m_ptfnNotify((void *)ptSub->pvConnection, aucAdu, usLen))
+    {
+        ptSub->bDue = true;
+        return false;
+    }
+
+    TakeReported(ptSub, aucData, usFirst, usLast);
+    ptSub->ullLastSent = ullTimeMs;
+
+    return true;
+}//end PollSubscription
+
+static uint16_t FindChange(const Subscription_t *ptSub, const uint8_t *pucData, uint16_t *pusLast)
+{
+    uint16_t usFirst = NO_CHANGE;
+    uint16_t usIndex = 0;
+
+    for (usIndex = 0; usIndex < ptSub->usNumOfData; usIndex++)
+    {
+        bool bChanged = false;
+
+        if (IsBitTable(ptSub->ucTable))
+        {
+            bChanged = (0 != ((pucData[usIndex / 8u] ^ ptSub->aucReported[usIndex / 8u]) & (1u << (usIndex % 8u))));
+        }
+        else
+        {
+            uint16_t usValue    = (uint16_t)((pucData[usIndex * 2u] << 8) | pucData[(usIndex * 2u) + 1u]);
+            uint16_t usReported = (uint16_t)((ptSub->aucReported[usIndex * 2u] << 8) |
+                                             ptSub->aucReported[(usIndex * 2u) + 1u]);
+
+            bChanged = (uint16_t)((usValue > usReported) ? (usValue - usReported) : (usReported - usValue)) >
+                       ptSub->usDeadband;
+        }
+
+        if (bChanged)
+        {
+            usFirst  = (NO_CHANGE == usFirst) ? usIndex : usFirst;
+            *pusLast = usIndex;
+        }
+    }//end for
+
+    return usFirst;
+}//end FindChange
+
+static uint16_t EncodeWindow(const Subscription_t *ptSub, const uint8_t *pucData,
+                             uint16_t usFirst, uint16_t usLast, uint8_t *pucBuf)
+{
+    uint16_t usNumOfData = (uint16_t)(usLast - usFirst + 1u);
+    uint16_t usAddress   = (uint16_t)(ptSub->usAddress + usFirst);
+    uint16_t usByteCount = 0;
+    uint16_t usIndex     = 0;
+
+    pucBuf[0] = (uint8_t)(usAddress >> 8);
+    pucBuf[1] = (uint8_t)usAddress;
+    pucBuf[2] = (uint8_t)(usNumOfData >> 8);
+    pucBuf[3] = (uint8_t)usNumOfData;
+
+    if (!IsBitTable(ptSub->ucTable))
+    {
+        usByteCount = (uint16_t)(usNumOfData * 2u);
+        memcpy(&pucBuf[5], &pucData[usFirst * 2u], usByteCount);
+    }
+    else
+    {
+        //window starts at bit 0 of first byte as for Read Coils
+        usByteCount = (uint16_t)((usNumOfData + 7u) / 8u);
+        memset(&pucBuf[5], 0, usByteCount);
+
+        for (usIndex = 0; usIndex < usNumOfData; usIndex++)
+        {
+            uint16_t usBit = (uint16_t)(usFirst + usIndex);
+
+            if (0 != (pucData[usBit / 8u] & (1u << (usBit % 8u))))
+            {
+                pucBuf[5u + (usIndex / 8u)] |= (uint8_t)(1u << (usIndex % 8u));
+            }
+        }
+    }
+
+    pucBuf[4] = (uint8_t)usByteCount;
+
+    return (uint16_t)(SUBSCRIPTION_HEADER_LEN - 1u + usByteCount);
+}//end EncodeWindow
+
+static void TakeReported(Subscription_t *ptSub, const uint8_t *pucData, uint16_t usFirst, uint16_t usLast)
+{
+    uint16_t usBit = 0;
+
+    if (!IsBitTable(ptSub->ucTable))
+    {
+        memcpy(&ptSub->aucReported[usFirst * 2u], &pucData[usFirst * 2u], (usLast - usFirst + 1u) * 2u);
+        return;
+    }
+
+    for (usBit = usFirst; usBit <= usLast; usBit++)
+    {
+        uint8_t ucMask = (uint8_t)(1u << (usBit % 8u));
+
+        ptSub->aucReported[usBit / 8u] = (uint8_t)((ptSub->aucReported[usBit / 8u] & ~ucMask) |
+                                                   (pucData[usBit / 8u] & ucMask));
+    }
+}//end TakeReported
+
+static bool IsBitTable(uint8_t ucTable)
+{
+    return (eTABLE_COILS == ucTable) || (eTABLE_DISCRETE_INPUTS == ucTable);
+}//end IsBitTable
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
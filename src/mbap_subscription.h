@@ -0,0 +1,129 @@
+//! @addtogroup ModbusTCPSubscription
+//! @{
+//
+//****************************************************************************
+//! @file mbap_subscription.h
+//! @brief This contains the prototypes, macros, constants or global variables
+//!        for subscriptions to changes of data ranges.
+//!
+//!        Subscribe(function code 66) query PDU is function code, table(1
+//!        byte, enum DataTable), start address(2 bytes), number of data(2
+//!        bytes), deadband(2 bytes) and minimum interval in ms(2 bytes).
+//!        Response PDU is function code, subscription id(1 byte), start
+//!        address(2 bytes), number of data(2 bytes), byte count(1 byte) and
+//!        data of the whole range as for read function codes.
+//!
+//!        Changes are pushed on the connection of the subscriber as ADUs of
+//!        the same layout with the transaction id of the subscribe query.
+//!        They hold the data from the first to the last changed register or
+//!        coil of the range. A register is changed when it differs from the
+//!        value last reported by more than the deadband(unsigned values),
+//!        coils and discrete inputs when they differ. Notifications of a
+//!        subscription are at least the minimum interval apart.
+//!
+//!        Cancel Subscription(function code 67) query and response PDU are
+//!        function code and subscription id(1 byte). Subscriptions of a
+//!        connection end with the connection.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//
+//****************************************************************************
+#ifndef MBAP_SUBSCRIPTION_H
+#define MBAP_SUBSCRIPTION_H
+
+//****************************************************************************
+//                           Includes
+//****************************************************************************
+
+//****************************************************************************
+//                           Constants and typedefs
+//****************************************************************************
+//! @brief Registers of a subscribed range, notification fits into an ADU
+#define SUBSCRIPTION_MAX_REGISTERS        (120u)
+//! @brief Coils or discrete inputs of a subscribed range
+#define SUBSCRIPTION_MAX_BITS             (1920u)
+//! @brief Bytes before data in response data of Subscribe
+#define SUBSCRIPTION_HEADER_LEN           (6u)
+
+//! @brief Send notification ADU on connection of subscriber
+//! @param[in]  pvConnection  Connection of subscribe query(ModbusRequest_t)
+//! @param[in]  pucAdu        Notification
+//! @param[in]  usLen         Bytes of notification
+//! @return     bool          true - sent or connection closed, false - send
+//!                           buffer full, change is reported later
+typedef bool(*pfnNotify)(void *pvConnection, const uint8_t *pucAdu, uint16_t usLen);
+
+//****************************************************************************
+//                           Global variables
+//****************************************************************************
+
+//****************************************************************************
+//                           Global Functions
+//****************************************************************************
+//
+//! @brief Remove all subscriptions and set function sending notifications.
+//!        Subscribe is rejected with illegal function while it is NULL.
+//! @param[in]  ptfnNotify  Notification function of transport, NULL - none
+//! @return     None
+//
+void mbap_SubscriptionInit(pfnNotify ptfnNotify);
+
+//
+//! @brief Add subscription of connection of request and encode data of range
+//!        as response data of Subscribe. Subscriptions are added, cancelled,
+//!        dropped and polled by the thread submitting requests, ranges
+//!        deferred by asynchronous access function of unit are rejected.
+//! @param[in]   ptRequest        Subscribe request with unit and connection
+//! @param[in]   ucTable          Table(enum DataTable)
+//! @param[in]   usAddress        First data as addressed by query
+//! @param[in]   usNumOfData      Number of data, range validated against table
+//! @param[in]   usDeadband       Register change reported above, 0 - any change
+//! @param[in]   usMinIntervalMs  Minimum time between notifications
+//! @param[out]  pucBuf           Response data following function code
+//! @param[out]  pusLen           Bytes of response data
+//! @return      uint8_t          eNO_EXCEPTION or exception code for response
+//
+uint8_t mbap_SubscriptionAdd(const ModbusRequest_t *ptRequest,
+                             uint8_t ucTable,
+                             uint16_t usAddress,
+                             uint16_t usNumOfData,
+                             uint16_t usDeadband,
+                             uint16_t usMinIntervalMs,
+                             uint8_t *pucBuf,
+                             uint16_t *pusLen);
+
+//
+//! @brief Cancel subscription of a connection
+//! @param[in]  pvConnection  Connection of cancel query
+//! @param[in]  ucId          Subscription id
+//! @return     bool          true - cancelled, false - no such subscription
+//
+bool mbap_SubscriptionCancel(const void *pvConnection, uint8_t ucId);
+
+//
+//! @brief Drop subscriptions of a closed connection
+//! @param[in]  pvConnection  Connection
+//! @return     None
+//
+void mbap_SubscriptionDrop(const void *pvConnection);
+
+//
+//! @brief Send notifications of changed ranges which are due. Ranges are read
+//!        only when change tracking shows writes since they were last read.
+//! @param[in]  ullTimeMs  Current time in ms, monotonic
+//! @return     None
+//
+void mbap_SubscriptionPoll(uint64_t ullTimeMs);
+
+//
+//! @brief Number of subscriptions, transport polls while there are any
+//! @param[in]  None
+//! @return     uint16_t  Number of subscriptions
+//
+uint16_t mbap_SubscriptionCount(void);
+
+#endif // MBAP_SUBSCRIPTION_H
+//****************************************************************************
+//                             End of file
+//****************************************************************************
+//! @}
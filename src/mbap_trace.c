@@ -0,0 +1,173 @@
+//! @addtogroup ModbusTCPTrace
+//! @brief Binary trace of debug messages
+//! @{
+//!
+//****************************************************************************/
+//! @file mbap_trace.c
+//! @brief Binary trace of debug messages. Each thread records fixed size
+//!        records into its own ring, a drainer formats them later. Recording
+//!        takes no lock and does no I/O.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+//user defined header files
+#include "mbap_debug.h"
+#include "mbap_trace.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+#define TRACE_RING_MASK                             (MBT_CONF_TRACE_RING_SIZE - 1u)
+
+#if (MBT_CONF_TRACE_RING_SIZE & TRACE_RING_MASK)
+#error "MBT_CONF_TRACE_RING_SIZE must be a power of two"
+#endif
+
+//! @brief Trace ring of a thread, written by its thread, read by drainer
+typedef struct TraceRing
+{
+    uint32_t      ulHead;                           //!<Records written
+    uint32_t      ulTail;                           //!<Records read
+    TraceRecord_t atRecords[MBT_CONF_TRACE_RING_SIZE];//!<Records
+} TraceRing_t;
+
+//****************************************************************************/
+//                           Private Functions
+//****************************************************************************/
+//
+//! @brief Trace ring of calling thread, taken on first use
+//! @param[in]  None
+//! @return     TraceRing_t*  Ring, NULL if no ring is free
+//
+static TraceRing_t *GetRing(void);
+
+//****************************************************************************/
+//                           external variables
+//****************************************************************************/
+
+//****************************************************************************/
+//                           Private variables
+//****************************************************************************/
+static TraceRing_t     m_atRings[MBT_CONF_TRACE_THREADS];
+static uint32_t        m_ulNumOfRings;
+static uint32_t        m_ulDropped;
+static __thread TraceRing_t *m_ptRing;
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+void mbap_TraceRecord(uint8_t ucLevel, const char *pcMessage, uint32_t ulArg0, uint32_t ulArg1)
+{
+    TraceRing_t     *ptRing  = GetRing();
+    TraceRecord_t   *ptRecord = NULL;
+    struct timespec tNow;
+    uint32_t        ulHead   = 0;
+
+    if (NULL == ptRing)
+    {
+        __atomic_fetch_add(&m_ulDropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    ulHead = ptRing->ulHead;
+
+    if ((ulHead - __atomic_load_n(&ptRing->ulTail, __ATOMIC_ACQUIRE)) >= MBT_CONF_TRACE_RING_SIZE)
+    {
+        __atomic_fetch_add(&m_ulDropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &tNow);
+
+    ptRecord             = &ptRing->atRecords[ulHead & TRACE_RING_MASK];
+    ptRecord->ullTime    = ((uint64_t)tNow.tv_sec * 1000000000u) + (uint64_t)tNow.tv_nsec;
+    ptRecord->pcMessage  = pcMessage;
+    ptRecord->aulArgs[0] = ulArg0;
+    ptRecord->aulArgs[1] = ulArg1;
+    ptRecord->ucLevel    = ucLevel;
+    ptRecord->ucThread   = (uint8_t)(ptRing - m_atRings);
+
+    //publish record to drainer
+    __atomic_store_n(&ptRing->ulHead, ulHead + 1u, __ATOMIC_RELEASE);
+}//end mbap_TraceRecord
+
+uint32_t mbap_TraceDrain(pfnTraceOutput ptfnOutput)
+{
+    uint32_t ulNumOfRings   = __atomic_load_n(&m_ulNumOfRings, __ATOMIC_ACQUIRE);
+    uint32_t ulNumOfRecords = 0;
+    uint32_t ulCount        = 0;
+
+    for (ulCount = 0; ulCount < ulNumOfRings; ulCount++)
+    {
+        TraceRing_t *ptRing = &m_atRings[ulCount];
+        uint32_t    ulHead  = __atomic_load_n(&ptRing->ulHead, __ATOMIC_ACQUIRE);
+        uint32_t    ulTail  = ptRing->ulTail;
+
+        while (ulTail != ulHead)
+        {
+            ptfnOutput(&ptRing->atRecords[ulTail & TRACE_RING_MASK]);
+            ulTail++;
+            ulNumOfRecords++;
+        }
+
+        //free records for writer
+        __atomic_store_n(&ptRing->ulTail, ulTail, __ATOMIC_RELEASE);
+    }
+
+    return ulNumOfRecords;
+}//end mbap_TraceDrain
+
+uint32_t mbap_TraceDropped(void)
+{
+    return __atomic_load_n(&m_ulDropped, __ATOMIC_RELAXED);
+}//end mbap_TraceDropped
+
+void mbap_TracePrint(const TraceRecord_t *ptRecord)
+{
+    printf("[%lu.%06lu] ",
+           (unsigned long)(ptRecord->ullTime / 1000000000u),
+           (unsigned long)((ptRecord->ullTime % 1000000000u) / 1000u));
+    printf(ptRecord->pcMessage, (unsigned)ptRecord->aulArgs[0], (unsigned)ptRecord->aulArgs[1]);
+}//end mbap_TracePrint
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static TraceRing_t *GetRing(void)
+{
+    uint32_t ulIndex = 0;
+
+    if (NULL != m_ptRing)
+    {
+        return m_ptRing;
+    }
+
+    ulIndex = __atomic_load_n(&m_ulNumOfRings, __ATOMIC_ACQUIRE);
+
+    //count never passes number of rings, threads without ring only read it
+    while (ulIndex < MBT_CONF_TRACE_THREADS)
+    {
+        if (__atomic_compare_exchange_n(&m_ulNumOfRings, &ulIndex, ulIndex + 1u, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            m_ptRing = &m_atRings[ulIndex];
+            break;
+        }
+    }
+
+    return m_ptRing;
+}//end GetRing
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
@@ -0,0 +1,77 @@
+//! @addtogroup ModbusTCPTrace
+//! @{
+//
+//****************************************************************************
+//! @file mbap_trace.h
+//! @brief This contains the prototypes, macros, constants or global variables
+//!        for the binary trace of debug messages
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//
+//****************************************************************************
+#ifndef MBAP_TRACE_H
+#define MBAP_TRACE_H
+
+//****************************************************************************
+//                           Includes
+//****************************************************************************
+
+//****************************************************************************
+//                           Constants and typedefs
+//****************************************************************************
+//! @brief Trace record, message is kept as pointer to its format string
+typedef struct TraceRecord
+{
+    uint64_t   ullTime;             //!<Monotonic time, ns
+    const char *pcMessage;          //!<printf format of message, takes two unsigned arguments
+    uint32_t   aulArgs[2];          //!<Arguments of message
+    uint8_t    ucLevel;             //!<Debug level
+    uint8_t    ucThread;            //!<Trace ring of recording thread
+} TraceRecord_t;
+
+typedef void(*pfnTraceOutput)(const TraceRecord_t *ptRecord);
+
+//****************************************************************************
+//                           Global variables
+//****************************************************************************
+
+//****************************************************************************
+//                           Global Functions
+//****************************************************************************
+//
+//! @brief Record message into trace ring of calling thread without locking,
+//!        message is dropped if ring is full
+//! @param[in]  ucLevel    Debug level
+//! @param[in]  pcMessage  printf format of message, must stay valid(string literal)
+//! @param[in]  ulArg0     First argument
+//! @param[in]  ulArg1     Second argument
+//! @return     None
+//
+void mbap_TraceRecord(uint8_t ucLevel, const char *pcMessage, uint32_t ulArg0, uint32_t ulArg1);
+
+//
+//! @brief Take records of all trace rings, only one thread may drain
+//! @param[in]  ptfnOutput  Called for each record, oldest first per thread
+//! @return     uint32_t    Number of records taken
+//
+uint32_t mbap_TraceDrain(pfnTraceOutput ptfnOutput);
+
+//
+//! @brief Number of records dropped because a ring was full or no ring was free
+//! @param[in]  None
+//! @return     uint32_t  Number of records
+//
+uint32_t mbap_TraceDropped(void);
+
+//
+//! @brief Print trace record with printf, output function for mbap_TraceDrain
+//! @param[in]  ptRecord  Trace record
+//! @return     None
+//
+void mbap_TracePrint(const TraceRecord_t *ptRecord);
+
+#endif // MBAP_TRACE_H
+//****************************************************************************
+//                             End of file
+//****************************************************************************
+//! @}
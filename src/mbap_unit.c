@@ -0,0 +1,605 @@
+//! @addtogroup ModbusTCPUnitRouting
+//! @brief Route modbus requests to units and keep copy-on-write register images
+//! @{
+//!
+//****************************************************************************/
+//! @file mbap_unit.c
+//! @brief Unit routing and copy-on-write register images of profile units
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+//user defined header files
+#include "mbap_conf.h"
+#include "mbap.h"
+#include "mbap_unit.h"
+#include "mbap_debug.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+#define MAX_UNIT_IDS                                (256u)
+#define MAX_UNITS                                   (MAX_UNIT_IDS + MAX_EXT_UNITS)
+//Hash table is kept half empty so that linear probing stays short
+#define PAGE_HASH_SIZE                              (UNIT_PAGE_POOL_SIZE * 2u)
+//Page key: unit index(16 bits) + table(2 bits) + page number(14 bits)
+#define PAGE_KEY(usIndex, ucTable, usPage)          (((uint32_t)(usIndex) << 16) | \
+                                                     ((uint32_t)(ucTable) << 14) | \
+                                                     ((uint32_t)(usPage) & 0x3FFFu))
+#define NO_PAGE                                     (0xFFFFu)
+#define NO_UNIT                                     (0xFFFFu)
+
+//! @brief Unit behind an extension key
+typedef struct ExtUnit
+{
+    uint32_t ulKey;     //!<Extension key(upper 16 bits) + unit id(lower 8 bits)
+    uint16_t usIndex;   //!<Unit index
+} ExtUnit_t;
+
+//! @brief Private page of a profile unit
+typedef struct UnitPage
+{
+    uint32_t ulKey;                                 //!<Page key
+    union
+    {
+        int16_t asRegisters[UNIT_PAGE_REGISTERS];   //!<Registers
+        uint8_t aucBits[UNIT_PAGE_BITS / 8u];       //!<Packed bits
+    } uData;
+} UnitPage_t;
+
+//****************************************************************************/
+//                           Private Functions
+//****************************************************************************/
+//
+//! @brief Allocate a unit entry
+//! @param[in]  ptModbusData  Modbus data of unit
+//! @param[in]  ptProfile     Device profile, NULL if unit uses user functions
+//! @return     uint16_t      Unit index, NO_UNIT if all entries in use
+//
+static uint16_t AllocateUnit(const ModbusData_t *ptModbusData, const ModbusProfile_t *ptProfile);
+
+//
+//! @brief Insert unit into unit id table or extension key table
+//! @param[in]  usExtKey  Extension key
+//! @param[in]  ucUnitId  Unit id
+//! @param[in]  ptModbusData  Modbus data of unit
+//! @param[in]  ptProfile     Device profile, NULL if unit uses user functions
+//! @return     bool      true - added, false - unit exists or no free entry
+//
+static bool AddUnit(uint16_t usExtKey,
+                    uint8_t ucUnitId,
+                    const ModbusData_t *ptModbusData,
+                    const ModbusProfile_t *ptProfile);
+
+//
+//! @brief Find index of extension key in sorted extension key table
+//! @param[in]  ulKey     Extension key + unit id
+//! @param[out] pusPos    Position of key or insert position
+//! @return     bool      true - key found, false - not found
+//
+static bool FindExtKey(uint32_t ulKey, uint16_t *pusPos);
+
+//
+//! @brief Find private page of a unit
+//! @param[in]  ulKey        Page key
+//! @return     UnitPage_t*  Page, NULL if unit still shares template page
+//
+static UnitPage_t *FindPage(uint32_t ulKey);
+
+//
+//! @brief Find private page or copy template page into a new private page
+//! @param[in]  ptUnit       Profile unit
+//! @param[in]  ucTable      Data table
+//! @param[in]  usPage       Page number
+//! @return     UnitPage_t*  Page, NULL if page pool exhausted
+//
+static UnitPage_t *GetWritablePage(const ModbusUnit_t *ptUnit, uint8_t ucTable, uint16_t usPage);
+
+//
+//! @brief Check that enough free pages exist for a write
+//! @param[in]  ptUnit       Profile unit
+//! @param[in]  ucTable      Data table
+//! @param[in]  usFirstPage  First page touched by write
+//! @param[in]  usLastPage   Last page touched by write
+//! @return     bool         true - write fits in page pool
+//
+static bool PagesAvailable(const ModbusUnit_t *ptUnit,
+                           uint8_t ucTable,
+                           uint16_t usFirstPage,
+                           uint16_t usLastPage);
+
+//
+//! @brief Template register table of profile
+//! @param[in]  ptProfile  Device profile
+//! @param[in]  ucTable    Data table
+//! @return     const int16_t*  Template registers, NULL for all zero
+//
+static const int16_t *TemplateRegisters(const ModbusProfile_t *ptProfile, uint8_t ucTable);
+
+//
+//! @brief Template bit table of profile
+//! @param[in]  ptProfile  Device profile
+//! @param[in]  ucTable    Data table
+//! @return     const uint8_t*  Template bits, NULL for all zero
+//
+static const uint8_t *TemplateBits(const ModbusProfile_t *ptProfile, uint8_t ucTable);
+
+//****************************************************************************/
+//                           external variables
+//****************************************************************************/
+
+//****************************************************************************/
+//                           Private variables
+//****************************************************************************/
+static ModbusUnit_t m_atUnits[MAX_UNITS];
+static uint16_t     m_usNumOfUnits;
+//unit index + 1 for each unit id, 0 - no unit
+static uint16_t     m_ausUnitIdTable[MAX_UNIT_IDS];
+#if MAX_EXT_UNITS
+static ExtUnit_t    m_atExtUnits[MAX_EXT_UNITS];
+#endif
+static uint16_t     m_usNumOfExtUnits;
+static UnitPage_t   m_atPages[UNIT_PAGE_POOL_SIZE];
+static uint16_t     m_usNumOfPages;
+//page index + 1 for each hash slot, 0 - empty slot
+static uint16_t     m_ausPageHash[PAGE_HASH_SIZE];
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+void mbap_UnitInit(void)
+{
+    m_usNumOfUnits    = 0;
+    m_usNumOfExtUnits = 0;
+    m_usNumOfPages    = 0;
+    memset(m_ausUnitIdTable, 0, sizeof(m_ausUnitIdTable));
+    memset(m_ausPageHash, 0, sizeof(m_ausPageHash));
+}//end mbap_UnitInit
+
+bool mbap_UnitAdd(uint16_t usExtKey, uint8_t ucUnitId, const ModbusData_t *ptModbusData)
+{
+    return AddUnit(usExtKey, ucUnitId, ptModbusData, NULL);
+}//end mbap_UnitAdd
+
+bool mbap_UnitAddProfile(uint16_t usExtKey, uint8_t ucUnitId, const ModbusProfile_t *ptProfile)
+{
+    return AddUnit(usExtKey, ucUnitId, &ptProfile->tModbusData, ptProfile);
+}//end mbap_UnitAddProfile
+
+const ModbusUnit_t *mbap_UnitFind(uint16_t usExtKey, uint8_t ucUnitId)
+{
+    const ModbusUnit_t *ptUnit = NULL;
+
+    if (0 == usExtKey)
+    {
+        if (0 != m_ausUnitIdTable[ucUnitId])
+        {
+            ptUnit = &m_atUnits[m_ausUnitIdTable[ucUnitId] - 1];
+        }
+    }
+#if MAX_EXT_UNITS
+    else
+    {
+        uint16_t usPos = 0;
+
+        if (FindExtKey(((uint32_t)usExtKey << 16) | ucUnitId, &usPos))
+        {
+            ptUnit = &m_atUnits[m_atExtUnits[usPos].usIndex];
+        }
+    }
+#endif
+
+    return (ptUnit);
+}//end mbap_UnitFind
+
+void mbap_UnitReadRegisters(const ModbusUnit_t *ptUnit,
+                            uint8_t ucTable,
+                            uint16_t usStartAddress,
+                            uint16_t usNumOfData,
+                            uint8_t *pucRecBuf)
+{
+    const int16_t    *psTemplate = TemplateRegisters(ptUnit->ptProfile, ucTable);
+    const UnitPage_t *ptPage     = NULL;
+    uint16_t         usPage      = NO_PAGE;
+
+    while (usNumOfData > 0)
+    {
+        int16_t sValue = 0;
+
+        //look up private page only when crossing a page boundary
+        if (usPage != (usStartAddress / UNIT_PAGE_REGISTERS))
+        {
+            usPage = usStartAddress / UNIT_PAGE_REGISTERS;
+            ptPage = FindPage(PAGE_KEY(ptUnit->usIndex, ucTable, usPage));
+        }
+
+        if (NULL != ptPage)
+        {
+            sValue = ptPage->uData.asRegisters[usStartAddress % UNIT_PAGE_REGISTERS];
+        }
+        else if (NULL != psTemplate)
+        {
+            sValue = psTemplate[usStartAddress];
+        }
+
+        *pucRecBuf++ = (uint8_t)((uint16_t)sValue >> 8);
+        *pucRecBuf++ = (uint8_t)((uint16_t)sValue & 0xFF);
+        usStartAddress++;
+        usNumOfData--;
+    }
+}//end mbap_UnitReadRegisters
+
+bool mbap_UnitWriteRegisters(const ModbusUnit_t *ptUnit,
+                             uint8_t ucTable,
+                             uint16_t usStartAddress,
+                             uint16_t usNumOfData,
+                             const uint8_t *pucWriteBuf)
+{
+    UnitPage_t *ptPage = NULL;
+    uint16_t   usPage  = NO_PAGE;
+
+    if (0 == usNumOfData)
+    {
+        return true;
+    }
+
+    if (!PagesAvailable(ptUnit,
+                        ucTable,
+                        usStartAddress / UNIT_PAGE_REGISTERS,
+                        (usStartAddress + usNumOfData - 1) / UNIT_PAGE_REGISTERS))
+    {
+        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Unit page pool exhausted\r\n");
+        return false;
+    }
+
+    while (usNumOfData > 0)
+    {
+        uint16_t usValue = 0;
+
+        if (usPage != (usStartAddress / UNIT_PAGE_REGISTERS))
+        {
+            usPage = usStartAddress / UNIT_PAGE_REGISTERS;
+            ptPage = GetWritablePage(ptUnit, ucTable, usPage);
+        }
+
+        usValue  = (uint16_t)(*pucWriteBuf++ << 8);
+        usValue |= (uint16_t)(*pucWriteBuf++);
+        ptPage->uData.asRegisters[usStartAddress % UNIT_PAGE_REGISTERS] = (int16_t)usValue;
+
+        usStartAddress++;
+        usNumOfData--;
+    }
+
+    return true;
+}//end mbap_UnitWriteRegisters
+
+void mbap_UnitReadBits(const ModbusUnit_t *ptUnit,
+                       uint8_t ucTable,
+                       uint16_t usStartAddress,
+                       uint16_t usNumOfData,
+                       uint8_t *pucRecBuf)
+{
+    const uint8_t    *pucTemplate = TemplateBits(ptUnit->ptProfile, ucTable);
+    const UnitPage_t *ptPage      = NULL;
+    uint16_t         usPage       = NO_PAGE;
+    uint16_t         usBit        = 0;
+
+    memset(pucRecBuf, 0, (usNumOfData + 7u) / 8u);
+
+    for (usBit = 0; usBit < usNumOfData; usBit++)
+    {
+        uint16_t usAddress = usStartAddress + usBit;
+        uint8_t  ucByte    = 0;
+
+        if (usPage != (usAddress / UNIT_PAGE_BITS))
+        {
+            usPage = usAddress / UNIT_PAGE_BITS;
+            ptPage = FindPage(PAGE_KEY(ptUnit->usIndex, ucTable, usPage));
+        }
+
+        if (NULL != ptPage)
+        {
+            ucByte = ptPage->uData.aucBits[(usAddress % UNIT_PAGE_BITS) / 8u];
+        }
+        else if (NULL != pucTemplate)
+        {
+            ucByte = pucTemplate[usAddress / 8u];
+        }
+
+        if (ucByte & (1u << (usAddress % 8u)))
+        {
+            pucRecBuf[usBit / 8u] |= (uint8_t)(1u << (usBit % 8u));
+        }
+    }
+}//end mbap_UnitReadBits
+
+bool mbap_UnitWriteBits(const ModbusUnit_t *ptUnit,
+                        uint8_t ucTable,
+                        uint16_t usStartAddress,
+                        uint16_t usNumOfData,
+                        const uint8_t *pucWriteBuf)
+{
+    UnitPage_t *ptPage = NULL;
+    uint16_t   usPage  = NO_PAGE;
+    uint16_t   usBit   = 0;
+
+    if (0 == usNumOfData)
+    {
+        return true;
+    }
+
+    if (!PagesAvailable(ptUnit,
+                        ucTable,
+                        usStartAddress / UNIT_PAGE_BITS,
+                        (usStartAddress + usNumOfData - 1) / UNIT_PAGE_BITS))
+    {
+        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Unit page pool exhausted\r\n");
+        return false;
+    }
+
+    for (usBit = 0; usBit < usNumOfData; usBit++)
+    {
+        uint16_t usAddress = usStartAddress + usBit;
+        uint8_t  ucMask    = (uint8_t)(1u << (usAddress % 8u));
+        uint8_t  *pucByte  = NULL;
+
+        if (usPage != (usAddress / UNIT_PAGE_BITS))
+        {
+            usPage = usAddress / UNIT_PAGE_BITS;
+            ptPage = GetWritablePage(ptUnit, ucTable, usPage);
+        }
+
+        pucByte = &ptPage->uData.aucBits[(usAddress % UNIT_PAGE_BITS) / 8u];
+
+        if (pucWriteBuf[usBit / 8u] & (1u << (usBit % 8u)))
+        {
+            *pucByte |= ucMask;
+        }
+        else
+        {
+            *pucByte &= (uint8_t)~ucMask;
+        }
+    }
+
+    return true;
+}//end mbap_UnitWriteBits
+
+uint16_t mbap_UnitPagesInUse(void)
+{
+    return m_usNumOfPages;
+}//end mbap_UnitPagesInUse
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static uint16_t AllocateUnit(const ModbusData_t *ptModbusData, const ModbusProfile_t *ptProfile)
+{
+    uint16_t usIndex = NO_UNIT;
+
+    if (m_usNumOfUnits < MAX_UNITS)
+    {
+        usIndex                          = m_usNumOfUnits++;
+        m_atUnits[usIndex].ptModbusData  = ptModbusData;
+        m_atUnits[usIndex].ptProfile     = ptProfile;
+        m_atUnits[usIndex].usIndex       = usIndex;
+    }
+
+    return usIndex;
+}//end AllocateUnit
+
+static bool AddUnit(uint16_t usExtKey,
+                    uint8_t ucUnitId,
+                    const ModbusData_t *ptModbusData,
+                    const ModbusProfile_t *ptProfile)
+{
+    uint16_t usIndex = 0;
+
+    if (NULL != mbap_UnitFind(usExtKey, ucUnitId))
+    {
+        MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "Unit already added\r\n");
+        return false;
+    }
+
+    if (0 == usExtKey)
+    {
+        usIndex = AllocateUnit(ptModbusData, ptProfile);
+
+        if (NO_UNIT == usIndex)
+        {
+            return false;
+        }
+
+        m_ausUnitIdTable[ucUnitId] = usIndex + 1;
+
+        return true;
+    }
+
+#if MAX_EXT_UNITS
+    if (m_usNumOfExtUnits < MAX_EXT_UNITS)
+    {
+        uint32_t ulKey = ((uint32_t)usExtKey << 16) | ucUnitId;
+        uint16_t usPos = 0;
+
+        usIndex = AllocateUnit(ptModbusData, ptProfile);
+
+        if (NO_UNIT == usIndex)
+        {
+            return false;
+        }
+
+        (void)FindExtKey(ulKey, &usPos);
+
+        //keep extension keys sorted for binary search
+        memmove(&m_atExtUnits[usPos + 1],
+                &m_atExtUnits[usPos],
+                (m_usNumOfExtUnits - usPos) * sizeof(ExtUnit_t));
+        m_atExtUnits[usPos].ulKey   = ulKey;
+        m_atExtUnits[usPos].usIndex = usIndex;
+        m_usNumOfExtUnits++;
+
+        return true;
+    }
+#endif
+
+    MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_WARNING, "No free extension unit\r\n");
+
+    return false;
+}//end AddUnit
+
+static bool FindExtKey(uint32_t ulKey, uint16_t *pusPos)
+{
+#if MAX_EXT_UNITS
+    uint16_t usLow  = 0;
+    uint16_t usHigh = m_usNumOfExtUnits;
+
+    while (usLow < usHigh)
+    {
+        uint16_t usMid = (uint16_t)((usLow + usHigh) / 2u);
+
+        if (m_atExtUnits[usMid].ulKey < ulKey)
+        {
+            usLow = usMid + 1;
+        }
+        else
+        {
+            usHigh = usMid;
+        }
+    }
+
+    *pusPos = usLow;
+
+    return ((usLow < m_usNumOfExtUnits) && (m_atExtUnits[usLow].ulKey == ulKey));
+#else
+    *pusPos = 0;
+
+    return false;
+#endif
+}//end FindExtKey
+
+static UnitPage_t *FindPage(uint32_t ulKey)
+{
+    uint32_t ulSlot = (ulKey * 2654435761u) % PAGE_HASH_SIZE;
+
+    while (0 != m_ausPageHash[ulSlot])
+    {
+        UnitPage_t *ptPage = &m_atPages[m_ausPageHash[ulSlot] - 1];
+
+        if (ptPage->ulKey == ulKey)
+        {
+            return ptPage;
+        }
+
+        ulSlot = (ulSlot + 1u) % PAGE_HASH_SIZE;
+    }
+
+    return NULL;
+}//end FindPage
+
+static UnitPage_t *GetWritablePage(const ModbusUnit_t *ptUnit, uint8_t ucTable, uint16_t usPage)
+{
+    uint32_t   ulKey  = PAGE_KEY(ptUnit->usIndex, ucTable, usPage);
+    uint32_t   ulSlot = 0;
+    UnitPage_t *ptPage = FindPage(ulKey);
+
+    if ((NULL != ptPage) || (m_usNumOfPages >= UNIT_PAGE_POOL_SIZE))
+    {
+        return ptPage;
+    }
+
+    ptPage        = &m_atPages[m_usNumOfPages];
+    ptPage->ulKey = ulKey;
+
+    //copy template page so that unwritten registers keep their profile value
+    if ((eTABLE_HOLDING_REGISTERS == ucTable) || (eTABLE_INPUT_REGISTERS == ucTable))
+    {
+        const int16_t *psTemplate = TemplateRegisters(ptUnit->ptProfile, ucTable);
+        uint32_t      ulFirst     = (uint32_t)usPage * UNIT_PAGE_REGISTERS;
+        uint32_t      ulMax       = (eTABLE_HOLDING_REGISTERS == ucTable) ?
+                                    ptUnit->ptModbusData->usMaxHoldingRegisters :
+                                    ptUnit->ptModbusData->usMaxInputRegisters;
+        uint32_t      ulCount     = 0;
+
+        memset(&ptPage->uData, 0, sizeof(ptPage->uData));
+
+        if ((NULL != psTemplate) && (ulFirst < ulMax))
+        {
+            ulCount = ulMax - ulFirst;
+            ulCount = (ulCount > UNIT_PAGE_REGISTERS) ? UNIT_PAGE_REGISTERS : ulCount;
+            memcpy(ptPage->uData.asRegisters, &psTemplate[ulFirst], ulCount * sizeof(int16_t));
+        }
+    }
+    else
+    {
+        const uint8_t *pucTemplate = TemplateBits(ptUnit->ptProfile, ucTable);
+        uint32_t      ulFirst      = (uint32_t)usPage * (UNIT_PAGE_BITS / 8u);
+        uint32_t      ulMax        = (eTABLE_COILS == ucTable) ?
+                                     ptUnit->ptModbusData->usMaxCoils :
+                                     ptUnit->ptModbusData->usMaxDiscreteInputs;
+        uint32_t      ulCount      = 0;
+
+        ulMax = (ulMax + 7u) / 8u;
+
+        memset(&ptPage->uData, 0, sizeof(ptPage->uData));
+
+        if ((NULL != pucTemplate) && (ulFirst < ulMax))
+        {
+            ulCount = ulMax - ulFirst;
+            ulCount = (ulCount > (UNIT_PAGE_BITS / 8u)) ? (UNIT_PAGE_BITS / 8u) : ulCount;
+            memcpy(ptPage->uData.aucBits, &pucTemplate[ulFirst], ulCount);
+        }
+    }
+
+    ulSlot = (ulKey * 2654435761u) % PAGE_HASH_SIZE;
+
+    while (0 != m_ausPageHash[ulSlot])
+    {
+        ulSlot = (ulSlot + 1u) % PAGE_HASH_SIZE;
+    }
+
+    m_usNumOfPages++;
+    m_ausPageHash[ulSlot] = m_usNumOfPages;
+
+    return ptPage;
+}//end GetWritablePage
+
+static bool PagesAvailable(const ModbusUnit_t *ptUnit,
+                           uint8_t ucTable,
+                           uint16_t usFirstPage,
+                           uint16_t usLastPage)
+{
+    uint16_t usNeeded = 0;
+    uint16_t usPage   = 0;
+
+    for (usPage = usFirstPage; usPage <= usLastPage; usPage++)
+    {
+        if (NULL == FindPage(PAGE_KEY(ptUnit->usIndex, ucTable, usPage)))
+        {
+            usNeeded++;
+        }
+    }
+
+    return ((m_usNumOfPages + usNeeded) <= UNIT_PAGE_POOL_SIZE);
+}//end PagesAvailable
+
+static const int16_t *TemplateRegisters(const ModbusProfile_t *ptProfile, uint8_t ucTable)
+{
+    return (eTABLE_HOLDING_REGISTERS == ucTable) ? ptProfile->psHoldingRegisters :
+                                                   ptProfile->psInputRegisters;
+}//end TemplateRegisters
+
+static const uint8_t *TemplateBits(const ModbusProfile_t *ptProfile, uint8_t ucTable)
+{
+    return (eTABLE_COILS == ucTable) ? ptProfile->pucCoils : ptProfile->pucDiscreteInputs;
+}//end TemplateBits
+
+/******************************************************************************
+ *                             End of file
+ ******************************************************************************/
+/** @}*/
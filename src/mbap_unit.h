@@ -0,0 +1,171 @@
+//! @addtogroup ModbusTCPUnitRouting
+//! @{
+//
+//****************************************************************************
+//! @file mbap_unit.h
+//! @brief This contains the prototypes, macros, constants or global variables
+//!        for routing modbus requests to units by unit id
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//
+//****************************************************************************
+#ifndef MBAP_UNIT_H
+#define MBAP_UNIT_H
+
+//****************************************************************************
+//                           Includes
+//****************************************************************************
+
+//****************************************************************************
+//                           Constants and typedefs
+//****************************************************************************
+//! @brief Number of registers in a copy-on-write page
+#define UNIT_PAGE_REGISTERS               (16u)
+//! @brief Number of coils or discrete inputs in a copy-on-write page
+#define UNIT_PAGE_BITS                    (UNIT_PAGE_REGISTERS * 16u)
+
+//! @brief Device profile shared by all virtual units built from it.
+//!        Template values are read only and copied page wise into a
+//!        unit only when that unit writes into the page.
+typedef struct ModbusProfile
+{
+    ModbusData_t   tModbusData;                 //!<Register layout and holding register limits
+    const int16_t  *psInputRegisters;           //!<Template Input Registers, NULL for all zero
+    const int16_t  *psHoldingRegisters;         //!<Template Holding Registers, NULL for all zero
+    const uint8_t  *pucDiscreteInputs;          //!<Template Discrete Inputs(packed bits), NULL for all zero
+    const uint8_t  *pucCoils;                   //!<Template Coils(packed bits), NULL for all zero
+} ModbusProfile_t;
+
+//! @brief Routing entry of a unit
+typedef struct ModbusUnit
+{
+    const ModbusData_t    *ptModbusData;        //!<Register layout, limits and user functions
+    const ModbusProfile_t *ptProfile;           //!<Device profile, NULL if unit uses user functions
+    uint16_t              usIndex;              //!<Unit index, key of private pages
+} ModbusUnit_t;
+
+//****************************************************************************
+//                           Global variables
+//****************************************************************************
+
+//****************************************************************************
+//                           Global Functions
+//****************************************************************************
+//
+//! @brief Remove all units and release all private pages
+//! @param[in]  None
+//! @return     None
+//
+void mbap_UnitInit(void);
+
+//
+//! @brief Add a unit served by user functions
+//! @param[in]  usExtKey      Extension key, 0 - unit id table
+//! @param[in]  ucUnitId      Unit id
+//! @param[in]  ptModbusData  Modbus data of unit, must stay valid while unit is added
+//! @return     bool          true - unit added, false - unit exists or no free entry
+//
+bool mbap_UnitAdd(uint16_t usExtKey, uint8_t ucUnitId, const ModbusData_t *ptModbusData);
+
+//
+//! @brief Add a virtual unit with copy-on-write register image of a device profile
+//! @param[in]  usExtKey   Extension key, 0 - unit id table
+//! @param[in]  ucUnitId   Unit id
+//! @param[in]  ptProfile  Device profile, must stay valid while unit is added
+//! @return     bool       true - unit added, false - unit exists or no free entry
+//
+bool mbap_UnitAddProfile(uint16_t usExtKey, uint8_t ucUnitId, const ModbusProfile_t *ptProfile);
+
+//
+//! @brief Find unit by extension key and unit id
+//! @param[in]  usExtKey  Extension key, 0 - unit id table
+//! @param[in]  ucUnitId  Unit id
+//! @return     const ModbusUnit_t*  Unit, NULL if not found
+//
+const ModbusUnit_t *mbap_UnitFind(uint16_t usExtKey, uint8_t ucUnitId);
+
+//
+//! @brief Read registers of a profile unit
+//! @param[in]   ptUnit          Profile unit
+//! @param[in]   ucTable         eTABLE_HOLDING_REGISTERS or eTABLE_INPUT_REGISTERS
+//! @param[in]   usStartAddress  Start address relative to table start
+//! @param[in]   usNumOfData     Number of registers
+//! @param[out]  pucRecBuf       Registers in modbus byte order
+//! @return      None
+//
+void mbap_UnitReadRegisters(const ModbusUnit_t *ptUnit,
+                            uint8_t ucTable,
+                            uint16_t usStartAddress,
+                            uint16_t usNumOfData,
+                            uint8_t *pucRecBuf);
+
+//
+//! @brief Write registers of a profile unit
+//! @param[in]  ptUnit          Profile unit
+//! @param[in]  ucTable         eTABLE_HOLDING_REGISTERS or eTABLE_INPUT_REGISTERS
+//! @param[in]  usStartAddress  Start address relative to table start
+//! @param[in]  usNumOfData     Number of registers
+//! @param[in]  pucWriteBuf     Registers in modbus byte order
+//! @return     bool            true - written, false - no free page, nothing written
+//
+bool mbap_UnitWriteRegisters(const ModbusUnit_t *ptUnit,
+                             uint8_t ucTable,
+                             uint16_t usStartAddress,
+                             uint16_t usNumOfData,
+                             const uint8_t *pucWriteBuf);
+
+//
+//! @brief Read coils or discrete inputs of a profile unit
+//! @param[in]   ptUnit          Profile unit
+//! @param[in]   ucTable         eTABLE_COILS or eTABLE_DISCRETE_INPUTS
+//! @param[in]   usStartAddress  Start address relative to table start
+//! @param[in]   usNumOfData     Number of bits
+//! @param[out]  pucRecBuf       Packed bits, first bit in LSB of first byte
+//! @return      None
+//
+void mbap_UnitReadBits(const ModbusUnit_t *ptUnit,
+                       uint8_t ucTable,
+                       uint16_t usStartAddress,
+                       uint16_t usNumOfData,
+                       uint8_t *pucRecBuf);
+
+//
+//! @brief Write coils or discrete inputs of a profile unit
+//! @param[in]  ptUnit          Profile unit
+//! @param[in]  ucTable         eTABLE_COILS or eTABLE_DISCRETE_INPUTS
+//! @param[in]  usStartAddress  Start address relative to table start
+//! @param[in]  usNumOfData     Number of bits
+//! @param[in]  pucWriteBuf     Packed bits, first bit in LSB of first byte
+//! @return     bool            true - written, false - no free page, nothing written
+//
+bool mbap_UnitWriteBits(const ModbusUnit_t *ptUnit,
+                        uint8_t ucTable,
+                        uint16_t usStartAddress,
+                        uint16_t usNumOfData,
+                        const uint8_t *pucWriteBuf);
+
+//
+//! @brief Number of private pages in use by all profile units
+//! @param[in]  None
+//! @return     uint16_t  Number of pages
+//
+uint16_t mbap_UnitPagesInUse(void);
+
+//
+//! @brief Process Modbus TCP Application request for a unit behind an extension key
+//! @param[in]   usExtKey      Extension key, 0 - unit id table
+//! @param[in]   pucQuery      Pointer to Modbus TCP Query buffer
+//! @param[in]   ucQueryLen    Modbus TCP Query Length
+//! @param[out]  pucResponse   Pointer to Modbus TCP Response buffer
+//! @return      uint16_t      Modbus TCP Response Length
+//
+uint16_t mbap_ProcessUnitRequest(uint16_t usExtKey,
+                                 const uint8_t *pucQuery,
+                                 uint8_t ucQueryLen,
+                                 uint8_t *pucResponse);
+
+#endif // MBAP_UNIT_H
+//****************************************************************************
+//                             End of file
+//****************************************************************************
+//! @}
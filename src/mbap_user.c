@@ -21,10 +21,15 @@
 #include "mbap_user.h"
 #include "mbap_debug.h"
 #include "mbap_conf.h"
+#include "mbap.h"
+#include "mbap_image.h"
+#include "mbap_change.h"
 
 //****************************************************************************/
 //                           Defines and typedefs
 //****************************************************************************/
+//tries before a read of a region written all the time is served as it is
+#define MAX_READ_TRIES                    (8u)
 
 //****************************************************************************/
 //                           external variables
@@ -39,6 +44,11 @@ uint8_t g_ucCoilsBuf[COILS_BUF_SIZE]                        = {5};
 //****************************************************************************/
 static int16_t g_sHoldingRegsLowerLimitBuf[MAX_HOLDING_REGISTERS]  = {0, 0, 0};
 static int16_t g_sHoldingRegsHigherLimitBuf[MAX_HOLDING_REGISTERS] = {200, 200, 200};
+//tables served, buffers above or regions of mapped register image
+static int16_t *m_psInputRegs        = g_sInputRegsBuf;
+static int16_t *m_psHoldingRegs      = g_sHoldingRegsBuf;
+static uint8_t *m_pucDiscreteInputs  = g_ucDiscreteInputsBuf;
+static uint8_t *m_pucCoils           = g_ucCoilsBuf;
 
 //****************************************************************************/
 //                           Local Functions
@@ -106,6 +116,13 @@ static void WriteCoils(uint16_t usStartAddress,
                        int16_t sNumOfData,
                        const uint8_t *pucWriteBuf);
 
+//
+//! @brief Serve register tables from regions of opened image
+//! @param[in]   ucStatus  Result of opening image(enum ImageStatus)
+//! @return      uint8_t   ucStatus
+//
+static uint8_t ServeImage(uint8_t ucStatus);
+
 //****************************************************************************/
 //                    G L O B A L  F U N C T I O N S
 //****************************************************************************/
@@ -130,99 +147,243 @@ void mu_Init(void)
     tModbusData.ptfnReadCoils                 = ReadCoils;
     tModbusData.ptfnWriteHoldingRegisters     = WriteHoldingRegisters;
     tModbusData.ptfnWriteCoils                = WriteCoils;
+    tModbusData.ptfnAsyncAccess               = NULL;
+    tModbusData.ptfnIsAsyncRange              = NULL;
 
     //pass modbus data data pointer to modbus tcp application
     mbap_DataInit(tModbusData);
 }
 
+uint8_t mu_MapImage(const char *pcPath)
+{
+    static const uint32_t aulLengths[eNUM_OF_REGIONS] = {sizeof(g_sInputRegsBuf), sizeof(g_sHoldingRegsBuf),
+                                                         sizeof(g_ucDiscreteInputsBuf), sizeof(g_ucCoilsBuf)};
+    static const void * const apvDefaults[eNUM_OF_REGIONS] = {g_sInputRegsBuf, g_sHoldingRegsBuf,
+                                                              g_ucDiscreteInputsBuf, g_ucCoilsBuf};
+
+    return ServeImage(mbap_ImageOpen(pcPath, aulLengths, apvDefaults, eNUM_OF_REGIONS));
+}//end mu_MapImage
+
+uint8_t mu_MapSharedImage(const char *pcName)
+{
+    static const uint32_t aulLengths[eNUM_OF_REGIONS] = {sizeof(g_sInputRegsBuf), sizeof(g_sHoldingRegsBuf),
+                                                         sizeof(g_ucDiscreteInputsBuf), sizeof(g_ucCoilsBuf)};
+    static const void * const apvDefaults[eNUM_OF_REGIONS] = {g_sInputRegsBuf, g_sHoldingRegsBuf,
+                                                              g_ucDiscreteInputsBuf, g_ucCoilsBuf};
+
+    static const uint8_t aucTables[eNUM_OF_REGIONS] = {eTABLE_INPUT_REGISTERS, eTABLE_HOLDING_REGISTERS,
+                                                       eTABLE_DISCRETE_INPUTS, eTABLE_COILS};
+    uint8_t ucStatus = ServeImage(mbap_ImageOpenShared(pcName, aulLengths, apvDefaults, eNUM_OF_REGIONS));
+    uint8_t ucRegion = 0;
+
+    //producers of other processes do not mark their writes, every write moves the region sequence
+    for (ucRegion = 0; (eIMAGE_ERROR != ucStatus) && (ucRegion < eNUM_OF_REGIONS); ucRegion++)
+    {
+        mbap_ChangeWatch(aucTables[ucRegion], mbap_ImageSequence(ucRegion));
+    }
+
+    return ucStatus;
+}//end mu_MapSharedImage
+
+void *mu_GetTable(uint8_t ucRegion, uint32_t *pulLength)
+{
+    void     *apvTables[eNUM_OF_REGIONS] = {m_psInputRegs, m_psHoldingRegs, m_pucDiscreteInputs, m_pucCoils};
+    uint32_t aulLengths[eNUM_OF_REGIONS] = {sizeof(g_sInputRegsBuf), sizeof(g_sHoldingRegsBuf),
+                                            sizeof(g_ucDiscreteInputsBuf), sizeof(g_ucCoilsBuf)};
+
+    if (ucRegion >= eNUM_OF_REGIONS)
+    {
+        *pulLength = 0;
+        return NULL;
+    }
+
+    *pulLength = aulLengths[ucRegion];
+
+    return apvTables[ucRegion];
+}//end mu_GetTable
+
+void mu_MarkTable(uint8_t ucRegion, uint32_t ulOffset, uint32_t ulLength)
+{
+    static const uint8_t aucTables[eNUM_OF_REGIONS] = {eTABLE_INPUT_REGISTERS, eTABLE_HOLDING_REGISTERS,
+                                                       eTABLE_DISCRETE_INPUTS, eTABLE_COILS};
+    uint32_t ulFirst = 0;
+    uint32_t ulEnd   = 0;
+
+    if ((ucRegion >= eNUM_OF_REGIONS) || (0 == ulLength))
+    {
+        return;
+    }
+
+    //registers are 2 bytes, bits are packed 8 per byte
+    if ((eREGION_INPUT_REGISTERS == ucRegion) || (eREGION_HOLDING_REGISTERS == ucRegion))
+    {
+        ulFirst = ulOffset / 2u;
+        ulEnd   = (ulOffset + ulLength + 1u) / 2u;
+    }
+    else
+    {
+        ulFirst = ulOffset * 8u;
+        ulEnd   = (ulOffset + ulLength) * 8u;
+    }
+
+    mbap_ChangeMark(NULL, aucTables[ucRegion], (uint16_t)ulFirst, (uint16_t)(ulEnd - ulFirst));
+}//end mu_MarkTable
+
+void mu_SetReadOnly(bool bReadOnly)
+{
+    //checked before units are accessed, units added later are covered as well
+    mbap_SetReadOnly(bReadOnly);
+}//end mu_SetReadOnly
+
 //****************************************************************************/
 //                           L O C A L  F U N C T I O N S
 //****************************************************************************/
+static uint8_t ServeImage(uint8_t ucStatus)
+{
+    if (eIMAGE_ERROR != ucStatus)
+    {
+        m_psInputRegs       = (int16_t *)mbap_ImageRegion(eREGION_INPUT_REGISTERS);
+        m_psHoldingRegs     = (int16_t *)mbap_ImageRegion(eREGION_HOLDING_REGISTERS);
+        m_pucDiscreteInputs = (uint8_t *)mbap_ImageRegion(eREGION_DISCRETE_INPUTS);
+        m_pucCoils          = (uint8_t *)mbap_ImageRegion(eREGION_COILS);
+    }
+
+    return ucStatus;
+}//end ServeImage
+
 static void ReadInputRegisters(uint16_t usStartAddress,
                                uint16_t usNumOfData,
                                uint8_t *pucRecBuf)
 {
+    uint32_t ulSequence = 0;
+    uint8_t  ucTries    = 0;
+
     MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Read Input Registers User function\r\n");
 
-    while (usNumOfData > 0)
+    //read again if another process wrote region meanwhile
+    do
     {
-        *pucRecBuf++ = (uint8_t)(g_sInputRegsBuf[usStartAddress] >> 8);
-        *pucRecBuf++ = (uint8_t)(g_sInputRegsBuf[usStartAddress] & 0xFF);
-        usStartAddress++;
-        usNumOfData--;
-    }
+        uint16_t usAddress = usStartAddress;
+        uint16_t usCount   = usNumOfData;
+        uint8_t  *pucBuf   = pucRecBuf;
+
+        ulSequence = mbap_ImageReadBegin(eREGION_INPUT_REGISTERS);
+
+        while (usCount > 0)
+        {
+            *pucBuf++ = (uint8_t)(m_psInputRegs[usAddress] >> 8);
+            *pucBuf++ = (uint8_t)(m_psInputRegs[usAddress] & 0xFF);
+            usAddress++;
+            usCount--;
+        }
+    } while (mbap_ImageReadRetry(eREGION_INPUT_REGISTERS, ulSequence) && (++ucTries < MAX_READ_TRIES));
 }//end ReadInputRegisters
 
 static void ReadDiscreteInputs(uint16_t usStartAddress,
                                int16_t sNumOfData,
                                uint8_t *pucRecBuf)
 {
+    uint32_t ulSequence = 0;
+    uint8_t  ucTries    = 0;
+
     MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Read Discrete Inputs User function\r\n");
 
-    while (sNumOfData > 0)
+    do
     {
-        uint16_t  usTmpBuf;
-        uint16_t  usMask;
-        uint16_t  usByteOffset;
-        uint16_t  usNPreBits;
+        uint16_t usAddress = usStartAddress;
+        int16_t  sCount    = sNumOfData;
+        uint8_t  *pucBuf   = pucRecBuf;
 
-        usByteOffset = usStartAddress  / 8 ;
-        usNPreBits   = usStartAddress - usByteOffset * 8;
-        usMask       = (1 << sNumOfData)  - 1 ;
-        usTmpBuf     = g_ucDiscreteInputsBuf[usByteOffset];
-        usTmpBuf    |= g_ucDiscreteInputsBuf[usByteOffset + 1] << 8;
-        // throw away unneeded bits
-        usTmpBuf     = usTmpBuf >> usNPreBits;
-        // mask away bits above the requested bitfield
-        usTmpBuf     = usTmpBuf & usMask;
-        *pucRecBuf++ = (uint8_t)usTmpBuf;
-
-        sNumOfData     = sNumOfData - 8;
-        usStartAddress = usStartAddress - 8;
-    }
+        ulSequence = mbap_ImageReadBegin(eREGION_DISCRETE_INPUTS);
+
+        while (sCount > 0)
+        {
+            uint16_t  usTmpBuf;
+            uint16_t  usMask;
+            uint16_t  usByteOffset;
+            uint16_t  usNPreBits;
+
+            usByteOffset = usAddress  / 8 ;
+            usNPreBits   = usAddress - usByteOffset * 8;
+            usMask       = (1 << sCount)  - 1 ;
+            usTmpBuf     = m_pucDiscreteInputs[usByteOffset];
+            usTmpBuf    |= m_pucDiscreteInputs[usByteOffset + 1] << 8;
+            // throw away unneeded bits
+            usTmpBuf     = usTmpBuf >> usNPreBits;
+            // mask away bits above the requested bitfield
+            usTmpBuf     = usTmpBuf & usMask;
+            *pucBuf++    = (uint8_t)usTmpBuf;
+
+            sCount    = sCount - 8;
+            usAddress = usAddress - 8;
+        }
+    } while (mbap_ImageReadRetry(eREGION_DISCRETE_INPUTS, ulSequence) && (++ucTries < MAX_READ_TRIES));
 }//end ReadDiscreteInputs
 
 static void ReadCoils(uint16_t usStartAddress,
                       int16_t sNumOfData,
                       uint8_t *pucRecBuf)
 {
+    uint32_t ulSequence = 0;
+    uint8_t  ucTries    = 0;
+
     MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Read Coils User function\r\n");
 
-    while (sNumOfData > 0)
+    do
     {
-        uint16_t  usTmpBuf;
-        uint16_t  usMask;
-        uint16_t  usByteOffset;
-        uint16_t  usNPreBits;
+        int16_t sCount  = sNumOfData;
+        uint8_t *pucBuf = pucRecBuf;
 
-        usByteOffset = usStartAddress / 8;
-        usNPreBits   = usStartAddress - usByteOffset * 8;
-        usMask       = (1 << sNumOfData) - 1;
-        usTmpBuf     = g_ucCoilsBuf[usByteOffset];
-        usTmpBuf    |= g_ucCoilsBuf[usByteOffset + 1] << 8;
-
-        // throw away unneeded bits
-        usTmpBuf = usTmpBuf >> usNPreBits;
-        // mask away bits above the requested bitfield
-        usTmpBuf     = usTmpBuf & usMask;
-        *pucRecBuf++ = (uint8_t)usTmpBuf;
-        sNumOfData   = sNumOfData - 8;
-    }
+        ulSequence = mbap_ImageReadBegin(eREGION_COILS);
+
+        while (sCount > 0)
+        {
+            uint16_t  usTmpBuf;
+            uint16_t  usMask;
+            uint16_t  usByteOffset;
+            uint16_t  usNPreBits;
+
+            usByteOffset = usStartAddress / 8;
+            usNPreBits   = usStartAddress - usByteOffset * 8;
+            usMask       = (1 << sCount) - 1;
+            usTmpBuf     = m_pucCoils[usByteOffset];
+            usTmpBuf    |= m_pucCoils[usByteOffset + 1] << 8;
+
+            // throw away unneeded bits
+            usTmpBuf = usTmpBuf >> usNPreBits;
+            // mask away bits above the requested bitfield
+            usTmpBuf  = usTmpBuf & usMask;
+            *pucBuf++ = (uint8_t)usTmpBuf;
+            sCount    = sCount - 8;
+        }
+    } while (mbap_ImageReadRetry(eREGION_COILS, ulSequence) && (++ucTries < MAX_READ_TRIES));
 }//end ReadCoils
 
 static void ReadHoldingRegisters(uint16_t usStartAddress,
                                  uint16_t usNumOfData,
                                  uint8_t *pucRecBuf)
 {
+    uint32_t ulSequence = 0;
+    uint8_t  ucTries    = 0;
+
     MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Read Holding Registers User function\r\n");
 
-    while (usNumOfData > 0)
+    do
     {
-        *pucRecBuf++ = (uint8_t)(g_sHoldingRegsBuf[usStartAddress] >> 8);
-        *pucRecBuf++ = (uint8_t)(g_sHoldingRegsBuf[usStartAddress] & 0xFF);
-        usStartAddress++;
-        usNumOfData--;
-    }
+        uint16_t usAddress = usStartAddress;
+        uint16_t usCount   = usNumOfData;
+        uint8_t  *pucBuf   = pucRecBuf;
+
+        ulSequence = mbap_ImageReadBegin(eREGION_HOLDING_REGISTERS);
+
+        while (usCount > 0)
+        {
+            *pucBuf++ = (uint8_t)(m_psHoldingRegs[usAddress] >> 8);
+            *pucBuf++ = (uint8_t)(m_psHoldingRegs[usAddress] & 0xFF);
+            usAddress++;
+            usCount--;
+        }
+    } while (mbap_ImageReadRetry(eREGION_HOLDING_REGISTERS, ulSequence) && (++ucTries < MAX_READ_TRIES));
 }//end ReadHoldingRegisters
 
 static void WriteHoldingRegisters(uint16_t usStartAddress,
@@ -233,6 +394,8 @@ static void WriteHoldingRegisters(uint16_t usStartAddress,
 
     uint8_t  ucCount = 0;
 
+    mbap_ImageWriteBegin(eREGION_HOLDING_REGISTERS);
+
     while (usNumOfData > 0)
     {
         uint16_t usValue = 0;
@@ -240,22 +403,26 @@ static void WriteHoldingRegisters(uint16_t usStartAddress,
         usValue  = (uint16_t)(pucWriteBuf[ucCount] << 8);
         ucCount++;
         usValue |= (uint16_t)(pucWriteBuf[ucCount]);
-        g_sHoldingRegsBuf[usStartAddress] = (int16_t)usValue;
+        m_psHoldingRegs[usStartAddress] = (int16_t)usValue;
 
         ucCount++;
         usStartAddress++;
         usNumOfData--;
     }
+
+    mbap_ImageWriteEnd(eREGION_HOLDING_REGISTERS);
 }//end WriteHoldingRegisters
 
 static void WriteCoils(uint16_t usStartAddress,
                        int16_t sNumOfData,
                        const uint8_t *pucWriteBuf)
 {
-    uint8_t ucCount = 0;
+    uint16_t usCount = 0;
 
     MBT_DEBUGF(MBT_CONF_DEBUG_LEVEL_MSG, "Write Coils User function\r\n");
 
+    mbap_ImageWriteBegin(eREGION_COILS);
+
     while (sNumOfData > 0)
     {
         uint16_t  usTmp;
@@ -292,7 +459,7 @@ static void WriteCoils(uint16_t usStartAddress,
         }
         else
         {
-            usCoilValue = (uint16_t)pucWriteBuf[ucCount];
+            usCoilValue = (uint16_t)pucWriteBuf[usCount];
         }
 
         // Move bit field into position over bits to set
@@ -303,20 +470,22 @@ static void WriteCoils(uint16_t usStartAddress,
         usMask <<= usStartAddress - usByteOffset * 8;
 
         // copy bits into temporary storage
-        usTmp  = g_ucCoilsBuf[usByteOffset];
-        usTmp |= g_ucCoilsBuf[usByteOffset + 1] << 8;
+        usTmp  = m_pucCoils[usByteOffset];
+        usTmp |= m_pucCoils[usByteOffset + 1] << 8;
 
         // Zero out bit field bits and then or value bits into them
         usTmp = (usTmp & (~usMask)) | usCoilValue;
 
         // move bits back into storage
-        g_ucCoilsBuf[usByteOffset]     = (uint8_t)(usTmp & 0xFF);
-        g_ucCoilsBuf[usByteOffset + 1] = (uint8_t)(usTmp >> 8);
+        m_pucCoils[usByteOffset]     = (uint8_t)(usTmp & 0xFF);
+        m_pucCoils[usByteOffset + 1] = (uint8_t)(usTmp >> 8);
 
         sNumOfData = sNumOfData - 8;
 
-        ucCount++;
+        usCount++;
     }
+
+    mbap_ImageWriteEnd(eREGION_COILS);
 }//end WriteCoils
 //****************************************************************************/
 //                             End of file
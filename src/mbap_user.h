@@ -31,6 +31,16 @@
 #define DISCRETE_INPUT_BUF_SIZE           (MAX_DISCRETE_INPUTS / 8u + 1u)
 #define COILS_BUF_SIZE                    (MAX_COILS / 8u + 1u)
 
+//! @brief Regions of register image, tables in buffer layout below
+enum UserRegion
+{
+    eREGION_INPUT_REGISTERS   = 0,      //!< int16_t[MAX_INPUT_REGISTERS]
+    eREGION_HOLDING_REGISTERS = 1,      //!< int16_t[MAX_HOLDING_REGISTERS]
+    eREGION_DISCRETE_INPUTS   = 2,      //!< Bits, LSB of first byte is first input
+    eREGION_COILS             = 3,      //!< Bits, LSB of first byte is first coil
+    eNUM_OF_REGIONS
+};
+
 //****************************************************************************
 //                           Global variables
 //****************************************************************************
@@ -50,6 +60,55 @@ extern uint8_t g_ucCoilsBuf[COILS_BUF_SIZE];
 //
 void mu_Init(void);
 
+//
+//! @brief Serve register tables from a memory mapped image file, so that
+//!        writes survive restart. Buffers above are defaults of a new image
+//!        and are no longer served once the image is mapped. Call
+//!        mbap_ImageSync() periodically to checkpoint written tables.
+//! @param[in]   pcPath   Image file, created if missing
+//! @return      uint8_t  Result(enum ImageStatus), eIMAGE_ERROR - buffers stay served
+//
+uint8_t mu_MapImage(const char *pcPath);
+
+//
+//! @brief Serve register tables from a named POSIX shared memory image, read
+//!        and written in place by other processes attached with
+//!        mbap_ImageAttach(). Contents are lost with system restart.
+//! @param[in]   pcName   Object name, "/name", created if missing
+//! @return      uint8_t  Result(enum ImageStatus), eIMAGE_ERROR - buffers stay served
+//
+uint8_t mu_MapSharedImage(const char *pcName);
+
+//
+//! @brief Table served for a region, buffer above or region of mapped image.
+//!        Written between mbap_ImageWriteBegin() and mbap_ImageWriteEnd(),
+//!        followed by mu_MarkTable() so that subscribers see the change.
+//! @param[in]   ucRegion   Region(enum UserRegion)
+//! @param[out]  pulLength  Bytes of table
+//! @return      void*      Table, NULL for invalid region
+//
+void *mu_GetTable(uint8_t ucRegion, uint32_t *pulLength);
+
+//
+//! @brief Report bytes of a table written in place by a producer of this
+//!        process to change tracking. Writes of other processes attached to
+//!        a shared image are seen through the region sequence.
+//! @param[in]   ucRegion   Region(enum UserRegion)
+//! @param[in]   ulOffset   First byte written
+//! @param[in]   ulLength   Bytes written
+//! @return      None
+//
+void mu_MarkTable(uint8_t ucRegion, uint32_t ulOffset, uint32_t ulLength);
+
+//
+//! @brief Reject writes of clients to all units with illegal function
+//!        exception, e.g. on a standby server. May be set and cleared from
+//!        any thread.
+//! @param[in]   bReadOnly  true - reject writes
+//! @return      None
+//
+void mu_SetReadOnly(bool bReadOnly);
+
 #endif // MBAP_USER_H
 //****************************************************************************
 //                             End of file
@@ -0,0 +1,312 @@
+//! @addtogroup TCPServerCapture
+//! @brief Capture of client traffic
+//! @{
+//!
+//****************************************************************************/
+//! @file capture.c
+//! @brief Capture of accepted connections and query ADUs into a compact
+//!        binary log for later replay. Server thread copies records into a
+//!        single producer single consumer ring, a writer thread writes the
+//!        ring into the file.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+//user defined header files
+#include "capture.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+//ring is written into file at least this often
+#define FLUSH_PERIOD_US      (10000u)
+#define STATS_ADD(x, v)      __atomic_store_n(&(x), (x) + (v), __ATOMIC_RELAXED)
+
+//****************************************************************************/
+//                           Local Functions
+//****************************************************************************/
+//
+//! @brief Write ring into capture file until capture is stopped
+//! @param[in]  pvArg  Not used
+//! @return     void*  Not used
+//
+static void *WriterThread(void *pvArg);
+
+//
+//! @brief Write records from ring into capture file
+//! @param[in]  None
+//! @return     bool  false - write error
+//
+static bool WriteRing(void);
+
+//
+//! @brief Copy bytes into ring at position, wrapping at end of ring
+//! @param[in]  ullPosition  Position in ring stream
+//! @param[in]  pucData      Data
+//! @param[in]  ulLen        Length of data
+//! @return     None
+//
+static void CopyToRing(uint64_t ullPosition, const uint8_t *pucData, uint32_t ulLen);
+
+//
+//! @brief Current time of clock
+//! @param[in]  iClock    Clock id
+//! @return     uint64_t  Time in us
+//
+static uint64_t GetTimeUs(int iClock);
+
+//****************************************************************************/
+//                           external variables
+//****************************************************************************/
+
+//****************************************************************************/
+//                           Local variables
+//****************************************************************************/
+static uint8_t   m_aucRing[CP_RING_SIZE];
+//bytes put into ring by server thread
+static uint64_t  m_ullHead;
+//bytes written into file by writer thread
+static uint64_t  m_ullTail;
+static bool      m_bActive;
+static int       m_iFile = -1;
+static pthread_t m_tWriter;
+//used by server thread only
+static uint64_t  m_ullLastUs;
+static uint64_t  m_ullRecords;
+static uint64_t  m_ullDropped;
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+bool cp_Start(const char *pcPath)
+{
+    uint8_t  aucHeader[CP_FILE_HEADER_LEN];
+    uint64_t ullStart = GetTimeUs(CLOCK_REALTIME);
+    uint8_t  ucCount  = 0;
+
+    if (m_bActive)
+    {
+        return false;
+    }
+
+    m_iFile = open(pcPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (-1 == m_iFile)
+    {
+        printf("Error in capture file creation");
+        return false;
+    }
+
+    memcpy(aucHeader, CP_MAGIC, 4);
+    aucHeader[4] = (uint8_t)(CP_VERSION >> 8);
+    aucHeader[5] = (uint8_t)CP_VERSION;
+    aucHeader[6] = (uint8_t)(CP_FILE_HEADER_LEN >> 8);
+    aucHeader[7] = (uint8_t)CP_FILE_HEADER_LEN;
+
+    for (ucCount = 0; ucCount < 8; ucCount++)
+    {
+        aucHeader[8 + ucCount] = (uint8_t)(ullStart >> (56 - (8 * ucCount)));
+    }
+
+    if (write(m_iFile, aucHeader, CP_FILE_HEADER_LEN) != (ssize_t)CP_FILE_HEADER_LEN)
+    {
+        printf("Error in capture file write");
+        close(m_iFile);
+        m_iFile = -1;
+        return false;
+    }
+
+    m_ullHead    = 0;
+    m_ullTail    = 0;
+    m_ullLastUs  = GetTimeUs(CLOCK_MONOTONIC);
+    m_ullRecords = 0;
+    m_ullDropped = 0;
+    __atomic_store_n(&m_bActive, true, __ATOMIC_RELEASE);
+
+    if (0 != pthread_create(&m_tWriter, NULL, WriterThread, NULL))
+    {
+        printf("Error in capture thread creation");
+        __atomic_store_n(&m_bActive, false, __ATOMIC_RELEASE);
+        close(m_iFile);
+        m_iFile = -1;
+        return false;
+    }
+
+    return true;
+}//end cp_Start
+
+void cp_Stop(void)
+{
+    if (!m_bActive)
+    {
+        return;
+    }
+
+    __atomic_store_n(&m_bActive, false, __ATOMIC_RELEASE);
+    (void)pthread_join(m_tWriter, NULL);
+    close(m_iFile);
+    m_iFile = -1;
+}//end cp_Stop
+
+void cp_Record(uint64_t ullTimeUs, uint32_t ulConnectionId, uint8_t ucEvent, const uint8_t *pucData, uint16_t usLen)
+{
+    uint8_t  aucHeader[CP_RECORD_HEADER_LEN];
+    uint64_t ullHead  = m_ullHead;
+    uint64_t ullDelta = 0;
+
+    if (!__atomic_load_n(&m_bActive, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+
+    if ((CP_RING_SIZE - (ullHead - __atomic_load_n(&m_ullTail, __ATOMIC_ACQUIRE))) <
+        (CP_RECORD_HEADER_LEN + (uint32_t)usLen))
+    {
+        //writer falls behind, server thread never waits for it
+        STATS_ADD(m_ullDropped, 1);
+        return;
+    }
+
+    //queries are recorded with arrival time, which may be older than
+    //previous record taken from an other connection
+    if (ullTimeUs > m_ullLastUs)
+    {
+        ullDelta    = ullTimeUs - m_ullLastUs;
+        m_ullLastUs = ullTimeUs;
+    }
+
+    if (ullDelta > 0xFFFFFFFFu)
+    {
+        ullDelta = 0xFFFFFFFFu;
+    }
+
+    aucHeader[0]  = (uint8_t)(ullDelta >> 24);
+    aucHeader[1]  = (uint8_t)(ullDelta >> 16);
+    aucHeader[2]  = (uint8_t)(ullDelta >> 8);
+    aucHeader[3]  = (uint8_t)ullDelta;
+    aucHeader[4]  = (uint8_t)(ulConnectionId >> 24);
+    aucHeader[5]  = (uint8_t)(ulConnectionId >> 16);
+    aucHeader[6]  = (uint8_t)(ulConnectionId >> 8);
+    aucHeader[7]  = (uint8_t)ulConnectionId;
+    aucHeader[8]  = ucEvent;
+    aucHeader[9]  = (uint8_t)(usLen >> 8);
+    aucHeader[10] = (uint8_t)usLen;
+
+    CopyToRing(ullHead, aucHeader, CP_RECORD_HEADER_LEN);
+    CopyToRing(ullHead + CP_RECORD_HEADER_LEN, pucData, usLen);
+    __atomic_store_n(&m_ullHead, ullHead + CP_RECORD_HEADER_LEN + usLen, __ATOMIC_RELEASE);
+    STATS_ADD(m_ullRecords, 1);
+}//end cp_Record
+
+bool cp_GetStats(uint64_t *pullRecords, uint64_t *pullDropped)
+{
+    *pullRecords = __atomic_load_n(&m_ullRecords, __ATOMIC_RELAXED);
+    *pullDropped = __atomic_load_n(&m_ullDropped, __ATOMIC_RELAXED);
+
+    return __atomic_load_n(&m_bActive, __ATOMIC_RELAXED);
+}//end cp_GetStats
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static void *WriterThread(void *pvArg)
+{
+    (void)pvArg;
+
+    while (__atomic_load_n(&m_bActive, __ATOMIC_ACQUIRE))
+    {
+        if (!WriteRing())
+        {
+            break;
+        }
+
+        usleep(FLUSH_PERIOD_US);
+    }
+
+    //records put into ring before capture was stopped
+    (void)WriteRing();
+
+    return NULL;
+}//end WriterThread
+
+static bool WriteRing(void)
+{
+    uint64_t ullHead = __atomic_load_n(&m_ullHead, __ATOMIC_ACQUIRE);
+    uint64_t ullTail = m_ullTail;
+
+    while (ullTail != ullHead)
+    {
+        uint32_t ulOffset = (uint32_t)(ullTail % CP_RING_SIZE);
+        uint32_t ulLen    = (uint32_t)(ullHead - ullTail);
+        ssize_t  sReturn  = 0;
+
+        if (ulLen > (CP_RING_SIZE - ulOffset))
+        {
+            ulLen = CP_RING_SIZE - ulOffset;
+        }
+
+        sReturn = write(m_iFile, &m_aucRing[ulOffset], ulLen);
+
+        if (sReturn < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+
+            printf("Error in capture file write");
+            return false;
+        }
+
+        ullTail += (uint64_t)sReturn;
+        __atomic_store_n(&m_ullTail, ullTail, __ATOMIC_RELEASE);
+    }
+
+    return true;
+}//end WriteRing
+
+static void CopyToRing(uint64_t ullPosition, const uint8_t *pucData, uint32_t ulLen)
+{
+    uint32_t ulOffset = (uint32_t)(ullPosition % CP_RING_SIZE);
+    uint32_t ulFirst  = ulLen;
+
+    if (0 == ulLen)
+    {
+        return;
+    }
+
+    if (ulFirst > (CP_RING_SIZE - ulOffset))
+    {
+        ulFirst = CP_RING_SIZE - ulOffset;
+    }
+
+    memcpy(&m_aucRing[ulOffset], pucData, ulFirst);
+    memcpy(m_aucRing, &pucData[ulFirst], ulLen - ulFirst);
+}//end CopyToRing
+
+static uint64_t GetTimeUs(int iClock)
+{
+    struct timespec tNow;
+
+    clock_gettime(iClock, &tNow);
+
+    return ((uint64_t)tNow.tv_sec * 1000000u) + ((uint64_t)tNow.tv_nsec / 1000u);
+}//end GetTimeUs
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
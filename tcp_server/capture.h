@@ -0,0 +1,94 @@
+//! @addtogroup TCPServerCapture
+//! @{
+//
+//****************************************************************************
+//! @file capture.h
+//! @brief This contains the prototypes, macros, constants or global variables
+//!        for capturing client traffic into a binary log
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//
+//****************************************************************************
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+//****************************************************************************
+//                           Includes
+//****************************************************************************
+
+//****************************************************************************
+//                           Constants and typedefs
+//****************************************************************************
+//! @brief Capture file layout, all fields in network byte order.
+//!        File header:
+//!          magic "MBCP"(4), version(2), header length(2), start time in
+//!          us since epoch(8)
+//!        Record header followed by data:
+//!          time since previous record in us(4), 0 if event is older than
+//!          previous record, connection id(4),
+//!          event(1), data length(2)
+//!        eCAPTURE_OPEN carries client IPv4 address, eCAPTURE_QUERY the ADU,
+//!        eCAPTURE_CLOSE no data.
+#define CP_MAGIC               "MBCP"
+#define CP_VERSION             (1u)
+#define CP_FILE_HEADER_LEN     (16u)
+#define CP_RECORD_HEADER_LEN   (11u)
+//! @brief Size of ring between server thread and writer thread
+#define CP_RING_SIZE           (1024u * 1024u)
+
+//! @brief Event of a capture record
+enum CaptureEvent
+{
+    eCAPTURE_OPEN  = 1,                         //!<Connection accepted
+    eCAPTURE_QUERY = 2,                         //!<Query ADU taken from receive buffer
+    eCAPTURE_CLOSE = 3                          //!<Connection closed
+};
+
+//****************************************************************************
+//                           Global variables
+//****************************************************************************
+
+//****************************************************************************
+//                           Global Functions
+//****************************************************************************
+//
+//! @brief Start capture into a file. Records are copied into a ring and
+//!        written by an own thread, the server thread never writes the file.
+//! @param[in]  pcPath  Capture file, truncated
+//! @return     bool    true - capture started, false - error
+//
+bool cp_Start(const char *pcPath);
+
+//
+//! @brief Stop capture, write remaining records and close file
+//! @param[in]  None
+//! @return     None
+//
+void cp_Stop(void);
+
+//
+//! @brief Record an event, nothing is done while capture is stopped.
+//!        Must be called by the server thread only. Record is dropped if
+//!        ring is full.
+//! @param[in]  ullTimeUs       Time of event, us of monotonic clock
+//! @param[in]  ulConnectionId  Connection id
+//! @param[in]  ucEvent         enum CaptureEvent
+//! @param[in]  pucData         Data of event
+//! @param[in]  usLen           Length of data
+//! @return     None
+//
+void cp_Record(uint64_t ullTimeUs, uint32_t ulConnectionId, uint8_t ucEvent, const uint8_t *pucData, uint16_t usLen);
+
+//
+//! @brief Read capture counters
+//! @param[out] pullRecords  Records written into ring
+//! @param[out] pullDropped  Records dropped because ring was full
+//! @return     bool         true - capture running
+//
+bool cp_GetStats(uint64_t *pullRecords, uint64_t *pullDropped);
+
+#endif // CAPTURE_H
+//****************************************************************************
+//                             End of file
+//****************************************************************************
+//! @}
@@ -17,15 +17,39 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
 //user defined files
 #include "mbap_conf.h"
+#include "mbap.h"
+#include "mbap_unit.h"
+#include "mbap_history.h"
 #include "mbap_user.h"
+#include "mbap_debug.h"
+#include "mbap_image.h"
+#include "mbap_change.h"
 
+#include "../tcp_server/pool.h"
 #include "../tcp_server/tcp.h"
+#include "../tcp_server/metrics.h"
+#include "../tcp_server/capture.h"
+#include "../tcp_server/replica.h"
 
 //****************************************************************************/
 //                           Defines and typedefs
 //****************************************************************************/
+#define TRACE_DRAIN_PERIOD_US    10000
+//written registers are lost on system restart for at most this period
+#define IMAGE_SYNC_PERIOD_US     1000000
+#define MAX_HOST_LEN             64
+//ranges are checked for due samples this often
+#define HISTORY_TICK_US          1000
+//unit served by user functions
+#define HISTORY_UNIT_ID          1
+//block pool is split evenly between ranges
+#define HISTORY_BLOCKS           (MBT_CONF_HISTORY_POOL_BLOCKS / MBT_CONF_HISTORY_RANGES)
 
 //****************************************************************************/
 //                           external variables
@@ -34,22 +58,169 @@
 //****************************************************************************/
 //                           Local variables
 //****************************************************************************/
+static bool m_bHistory = false;
 
 //****************************************************************************/
 //                           Local Functions
 //****************************************************************************/
+#if MBT_CONF_DEBUG_TRACE
+//
+//! @brief Print debug messages recorded by server threads
+//! @param[in]  pvArg  Not used
+//! @return     void*  Not used
+//
+static void *TraceDrainer(void *pvArg);
+#endif//MBT_CONF_DEBUG_TRACE
+
+//
+//! @brief Checkpoint written tables of register image periodically
+//! @param[in]  pvArg  Not used
+//! @return     void*  Not used
+//
+static void *ImageSyncer(void *pvArg);
+
+//
+//! @brief Map register image file and start checkpoints
+//! @param[in]  pcPath  Image file
+//! @return     None
+//
+static void StartImage(const char *pcPath);
+
+//
+//! @brief Sample history ranges
+//! @param[in]  pvArg  Not used
+//! @return     void*  Not used
+//
+static void *HistorySampler(void *pvArg);
+
+//
+//! @brief Add history range
+//! @param[in]  pcRange  "<i|h>:<address>:<count>:<period ms>[:c]", c - sample on change only
+//! @return     None
+//
+static void AddHistory(const char *pcRange);
+
+//
+//! @brief Route connections to a local address to units behind extension key
+//! @param[in]  pcRoute  "<local address>=<extension key>"
+//! @return     None
+//
+static void AddExtKey(const char *pcRoute);
+
+//
+//! @brief Start replication as primary or as standby of a primary
+//! @param[in]  pcPrimary  Primary "<address>:<port>" followed as standby, NULL - none
+//! @param[in]  usPort     Replication port served as primary, or after promotion
+//!                        of a standby, 0 - none
+//! @return     None
+//
+static void StartReplica(const char *pcPrimary, uint16_t usPort);
+
+//
+//! @brief Promote standby on SIGUSR1
+//! @param[in]  iSignal  Signal
+//! @return     None
+//
+static void OnPromote(int iSignal);
 
 //****************************************************************************/
 //                    G L O B A L  F U N C T I O N S
 //****************************************************************************/
 //
 //! @brief main function
-//! @param[in]  None
+//! @param[in]  iArgc    Number of arguments
+//! @param[in]  ppcArgv  Arguments, -c <file> captures client traffic into file,
+//!                      -i <file> serves registers from image file kept over restart,
+//!                      -m </name> serves registers from shared memory image of other processes,
+//!                      -H <i|h>:<address>:<count>:<period ms>[:c] keeps history of registers,
+//!                      -p <port> Modbus TCP port, -M <port> metrics port,
+//!                      -E <port> serves extended framing on trusted local links,
+//!                      -K <address>=<key> routes connections to local address to
+//!                      units behind extension key,
+//!                      -r <port> serves replication to standbys,
+//!                      -s <address:port> follows primary as read only standby,
+//!                      promoted by SIGUSR1
 //! @return     int
 //
-int main(void)
+int main(int iArgc, char **ppcArgv)
 {
+    pthread_t  tSampler;
+    const char *pcPrimary     = NULL;
+    uint16_t   usMetricsPort  = MT_DEFAULT_PORT;
+    uint16_t   usReplicaPort  = 0;
+    int        iOption        = 0;
+
+#if MBT_CONF_DEBUG_TRACE
+    pthread_t tDrainer;
+
+    if (0 != pthread_create(&tDrainer, NULL, TraceDrainer, NULL))
+    {
+        printf("Error in trace drainer creation");
+    }
+#endif//MBT_CONF_DEBUG_TRACE
+
     mu_Init();
+    //versions held by clients do not match versions after a restart by chance
+    mbap_ChangeSetEpoch((uint32_t)time(NULL) ^ ((uint32_t)getpid() << 16));
+
+    while (-1 != (iOption = getopt(iArgc, ppcArgv, "c:i:m:p:E:H:K:M:r:s:")))
+    {
+        if (('c' == iOption) && !cp_Start(optarg))
+        {
+            printf("Capture not started\n");
+        }
+        else if ('i' == iOption)
+        {
+            StartImage(optarg);
+        }
+        else if ('m' == iOption)
+        {
+            //memory only, nothing to checkpoint
+            printf("Shared register image %s\n", (eIMAGE_ERROR != mu_MapSharedImage(optarg)) ? "mapped" : "not mapped");
+        }
+        else if ('p' == iOption)
+        {
+            tcp_SetPort((uint16_t)atoi(optarg));
+        }
+        else if ('E' == iOption)
+        {
+            tcp_SetExtendedPort((uint16_t)atoi(optarg));
+        }
+        else if ('H' == iOption)
+        {
+            AddHistory(optarg);
+        }
+        else if ('K' == iOption)
+        {
+            AddExtKey(optarg);
+        }
+        else if ('M' == iOption)
+        {
+            usMetricsPort = (uint16_t)atoi(optarg);
+        }
+        else if ('r' == iOption)
+        {
+            usReplicaPort = (uint16_t)atoi(optarg);
+        }
+        else if ('s' == iOption)
+        {
+            pcPrimary = optarg;
+        }
+    }
+
+    if (m_bHistory && (0 != pthread_create(&tSampler, NULL, HistorySampler, NULL)))
+    {
+        printf("Error in history sampler creation");
+    }
+
+    //tables are replicated from wherever they are served
+    StartReplica(pcPrimary, usReplicaPort);
+
+    if (!mt_Init(usMetricsPort))
+    {
+        printf("Metrics endpoint not started\n");
+    }
+
     tcp_Init();
 
     return 0;
@@ -58,6 +229,142 @@ int main(void)
 //****************************************************************************/
 //                           L O C A L  F U N C T I O N S
 //****************************************************************************/
+#if MBT_CONF_DEBUG_TRACE
+static void *TraceDrainer(void *pvArg)
+{
+    while (1)
+    {
+        if (0 != mbap_TraceDrain(mbap_TracePrint))
+        {
+            fflush(stdout);
+        }
+
+        usleep(TRACE_DRAIN_PERIOD_US);
+    }
+
+    return NULL;
+}//end TraceDrainer
+#endif//MBT_CONF_DEBUG_TRACE
+
+static void *ImageSyncer(void *pvArg)
+{
+    while (1)
+    {
+        usleep(IMAGE_SYNC_PERIOD_US);
+        (void)mbap_ImageSync();
+    }
+
+    return NULL;
+}//end ImageSyncer
+
+static void StartImage(const char *pcPath)
+{
+    static const char * const apcResults[] = {"not mapped", "created", "restored", "recovered from checkpoint"};
+    pthread_t tSyncer;
+    uint8_t   ucStatus = mu_MapImage(pcPath);
+
+    printf("Register image %s\n", apcResults[ucStatus]);
+
+    if ((eIMAGE_ERROR != ucStatus) && (0 != pthread_create(&tSyncer, NULL, ImageSyncer, NULL)))
+    {
+        printf("Error in image sync thread creation");
+    }
+}//end StartImage
+
+static void *HistorySampler(void *pvArg)
+{
+    struct timespec tNow;
+
+    while (1)
+    {
+        //historians want wall clock time of samples
+        clock_gettime(CLOCK_REALTIME, &tNow);
+        mbap_HistorySample(((uint64_t)tNow.tv_sec * 1000u) + ((uint64_t)tNow.tv_nsec / 1000000u));
+        usleep(HISTORY_TICK_US);
+    }
+
+    return NULL;
+}//end HistorySampler
+
+static void AddHistory(const char *pcRange)
+{
+    unsigned uAddress = 0;
+    unsigned uCount   = 0;
+    unsigned uPeriod  = 0;
+    char     cTable   = 0;
+    char     cMode    = 0;
+    uint8_t  ucRange  = HISTORY_NO_RANGE;
+
+    if ((sscanf(pcRange, "%c:%u:%u:%u:%c", &cTable, &uAddress, &uCount, &uPeriod, &cMode) >= 4) &&
+        (('i' == cTable) || ('h' == cTable)) && ((0 == cMode) || ('c' == cMode)) &&
+        (uAddress <= UINT16_MAX) && (uCount <= HISTORY_MAX_REGISTERS))
+    {
+        ucRange = mbap_HistoryAdd(HISTORY_UNIT_ID,
+                                  ('i' == cTable) ? eTABLE_INPUT_REGISTERS : eTABLE_HOLDING_REGISTERS,
+                                  (uint16_t)uAddress, (uint16_t)uCount, uPeriod,
+                                  ('c' == cMode) ? eHISTORY_ON_CHANGE : eHISTORY_PERIODIC,
+                                  HISTORY_BLOCKS);
+    }
+
+    if (HISTORY_NO_RANGE == ucRange)
+    {
+        printf("History %s not added\n", pcRange);
+    }
+    else
+    {
+        m_bHistory = true;
+        printf("History %s is range %u\n", pcRange, (unsigned)ucRange);
+    }
+}//end AddHistory
+
+static void AddExtKey(const char *pcRoute)
+{
+    unsigned auAddress[4] = {0, 0, 0, 0};
+    unsigned uExtKey      = 0;
+
+    if ((5 != sscanf(pcRoute, "%u.%u.%u.%u=%u", &auAddress[0], &auAddress[1], &auAddress[2], &auAddress[3], &uExtKey)) ||
+        (auAddress[0] > UINT8_MAX) || (auAddress[1] > UINT8_MAX) || (auAddress[2] > UINT8_MAX) ||
+        (auAddress[3] > UINT8_MAX) || (uExtKey > UINT16_MAX) ||
+        !tcp_AddExtKey((auAddress[0] << 24) | (auAddress[1] << 16) | (auAddress[2] << 8) | auAddress[3], (uint16_t)uExtKey))
+    {
+        printf("Extension key route %s not added\n", pcRoute);
+    }
+}//end AddExtKey
+
+static void StartReplica(const char *pcPrimary, uint16_t usPort)
+{
+    char       acHost[MAX_HOST_LEN];
+    const char *pcPort = (NULL == pcPrimary) ? NULL : strrchr(pcPrimary, ':');
+
+    if ((NULL != pcPort) && ((size_t)(pcPort - pcPrimary) < sizeof(acHost)))
+    {
+        memcpy(acHost, pcPrimary, (size_t)(pcPort - pcPrimary));
+        acHost[pcPort - pcPrimary] = '\0';
+
+        if (rp_StartStandby(acHost, (uint16_t)atoi(pcPort + 1), usPort))
+        {
+            (void)signal(SIGUSR1, OnPromote);
+            printf("Standby of %s\n", pcPrimary);
+        }
+        else
+        {
+            printf("Standby not started\n");
+        }
+    }
+    else if (NULL != pcPrimary)
+    {
+        printf("Standby not started\n");
+    }
+    else if ((0 != usPort) && !rp_StartPrimary(usPort))
+    {
+        printf("Replication not started\n");
+    }
+}//end StartReplica
+
+static void OnPromote(int iSignal)
+{
+    rp_Promote();
+}//end OnPromote
 
 //****************************************************************************/
 //                             End of file
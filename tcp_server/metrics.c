@@ -0,0 +1,505 @@
+//! @addtogroup TCPServerMetrics
+//! @brief Metrics endpoint in Prometheus text format
+//! @{
+//!
+//****************************************************************************/
+//! @file metrics.c
+//! @brief Minimal HTTP/1.0 responder serving connection counts, query
+//!        counts, lane queue depths, shed counts, per function code counters
+//!        and latency quantiles in Prometheus text exposition format. Scrapes
+//!        are served by an own thread which only reads statistics.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+//user defined header files
+#include "mbap_conf.h"
+#include "mbap.h"
+#include "mbap_hist.h"
+#include "mbap_stats.h"
+#include "mbap_image.h"
+#include "pool.h"
+#include "tcp.h"
+#include "metrics.h"
+#include "capture.h"
+#include "replica.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+#define METRICS_BUFF_SIZE    (32u * 1024u)
+#define HTTP_REQUEST_SIZE    (1024u)
+//slow scraper must not hold metrics thread forever
+#define HTTP_TIMEOUT_SEC     (2)
+
+//! @brief Text buffer being written
+typedef struct TextBuffer
+{
+    char     *pcBuf;                                //!<Text
+    uint32_t ulSize;                                //!<Buffer size
+    uint32_t ulLen;                                 //!<Text length
+} TextBuffer_t;
+
+//****************************************************************************/
+//                           Local Functions
+//****************************************************************************/
+//
+//! @brief Accept scrapes and answer them
+//! @param[in]  pvArg  Listening socket
+//! @return     void*  Not used
+//
+static void *MetricsThread(void *pvArg);
+
+//
+//! @brief Read HTTP request and send metrics
+//! @param[in]  iSocket  Client socket
+//! @return     None
+//
+static void AnswerScrape(int iSocket);
+
+//
+//! @brief Append formatted text, text is truncated to buffer size
+//! @param[in]  ptText      Text buffer
+//! @param[in]  pcFormat    printf format
+//! @return     None
+//
+static void Append(TextBuffer_t *ptText, const char *pcFormat, ...);
+
+//
+//! @brief Append latency quantiles as summary
+//! @param[in]  ptText     Text buffer
+//! @param[in]  pcName     Metric name
+//! @param[in]  pcLabel    Label of series, e.g. lane="0"
+//! @param[in]  ptHist     Latency histogram
+//! @param[in]  ulDivisor  Histogram unit per second
+//! @return     None
+//
+static void AppendSummary(TextBuffer_t *ptText,
+                          const char *pcName,
+                          const char *pcLabel,
+                          const LatencyHistogram_t *ptHist,
+                          uint32_t ulDivisor);
+
+//****************************************************************************/
+//                           external variables
+//****************************************************************************/
+
+//****************************************************************************/
+//                           Local variables
+//****************************************************************************/
+//used by metrics thread only
+static char          m_acMetrics[METRICS_BUFF_SIZE];
+static ModbusStats_t m_tModbusStats;
+//label of enum TimingStage
+static const char    *m_apcStageNames[eNUM_OF_STAGES] = {"socket_queue", "queue", "processing", "transmit", "wire"};
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+bool mt_Init(uint16_t usPort)
+{
+    struct sockaddr_in tAddress;
+    pthread_t          tThread;
+    int                iSocket = socket(AF_INET, SOCK_STREAM, 0);
+    int                iOption = 1;
+
+    if (-1 == iSocket)
+    {
+        printf("Error in metrics socket creation");
+        return false;
+    }
+
+    (void)setsockopt(iSocket, SOL_SOCKET, SO_REUSEADDR, &iOption, sizeof(iOption));
+
+    //metrics are for local scraper only
+    memset(&tAddress, 0, sizeof(tAddress));
+    tAddress.sin_family      = AF_INET;
+    tAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    tAddress.sin_port        = htons(usPort);
+
+    if ((-1 == bind(iSocket, (struct sockaddr*)&tAddress, sizeof(tAddress))) ||
+        (-1 == listen(iSocket, 4)))
+    {
+        printf("Error in metrics binding");
+        close(iSocket);
+        return false;
+    }
+
+    if (0 != pthread_create(&tThread, NULL, MetricsThread, (void *)(intptr_t)iSocket))
+    {
+        printf("Error in metrics thread creation");
+        close(iSocket);
+        return false;
+    }
+
+    (void)pthread_detach(tThread);
+
+    return true;
+}//end mt_Init
+
+uint32_t mt_Render(char *pcBuf, uint32_t ulBufSize)
+{
+    TextBuffer_t   tText      = {pcBuf, ulBufSize, 0};
+    TcpStats_t     tStats;
+    TcpLaneStats_t tLane;
+    PoolStats_t    tPool;
+    ImageStats_t   tImage;
+    ReplicaStats_t tReplica;
+    const char     *pcPool    = NULL;
+    char           acLabel[32];
+    uint8_t        ucCount    = 0;
+    uint8_t        ucCode     = 0;
+    uint64_t       ullRecords = 0;
+    uint64_t       ullDropped = 0;
+
+    if (0 == ulBufSize)
+    {
+        return 0;
+    }
+
+    pcBuf[0] = '\0';
+    tcp_GetStats(&tStats);
+
+    Append(&tText, "# HELP modbus_connections Open client connections.\n"
+                   "# TYPE modbus_connections gauge\n"
+                   "modbus_connections %lu\n", (unsigned long)tStats.ulNumOfConnections);
+    Append(&tText, "# HELP modbus_connections_accepted_total Accepted client connections.\n"
+                   "# TYPE modbus_connections_accepted_total counter\n"
+                   "modbus_connections_accepted_total %lu\n", (unsigned long)tStats.ulNumOfAccepted);
+    Append(&tText, "# HELP modbus_queries_total Queries received.\n"
+                   "# TYPE modbus_queries_total counter\n"
+                   "modbus_queries_total %lu\n", (unsigned long)tStats.ulNumOfQueries);
+    Append(&tText, "# HELP modbus_pending_requests Requests waiting for asynchronous user functions.\n"
+                   "# TYPE modbus_pending_requests gauge\n"
+                   "modbus_pending_requests %lu\n", (unsigned long)tStats.ulNumOfPending);
+    Append(&tText, "# HELP modbus_rx_buffers Receive buffers attached to connections with unprocessed data.\n"
+                   "# TYPE modbus_rx_buffers gauge\n"
+                   "modbus_rx_buffers %lu\n", (unsigned long)tStats.ulNumOfRxBuffers);
+    Append(&tText, "# HELP modbus_transactions Transactions attached to connections.\n"
+                   "# TYPE modbus_transactions gauge\n"
+                   "modbus_transactions %lu\n", (unsigned long)tStats.ulNumOfTransactions);
+    Append(&tText, "# HELP modbus_notifications_total Change notifications sent to subscribers.\n"
+                   "# TYPE modbus_notifications_total counter\n"
+                   "modbus_notifications_total %lu\n", (unsigned long)tStats.ulNumOfNotifications);
+    Append(&tText, "# HELP modbus_shed_total Requests shed after service deadline expired.\n"
+                   "# TYPE modbus_shed_total counter\n"
+                   "modbus_shed_total{action=\"dropped\"} %lu\n"
+                   "modbus_shed_total{action=\"busy\"} %lu\n",
+                   (unsigned long)tStats.ulNumOfDropped, (unsigned long)tStats.ulNumOfBusy);
+
+    Append(&tText, "# HELP modbus_pool_objects Objects of slab pools handed out or free.\n"
+                   "# TYPE modbus_pool_objects gauge\n");
+
+    for (ucCount = 0; ucCount < eNUM_OF_POOLS; ucCount++)
+    {
+        (void)tcp_GetPoolStats(ucCount, &pcPool, &tPool);
+        Append(&tText, "modbus_pool_objects{pool=\"%s\",state=\"in_use\"} %lu\n"
+                       "modbus_pool_objects{pool=\"%s\",state=\"free\"} %lu\n",
+                       pcPool, (unsigned long)tPool.ulInUse, pcPool, (unsigned long)tPool.ulFree);
+    }
+
+    Append(&tText, "# HELP modbus_pool_slabs_total Slabs taken from heap, constant in steady state.\n"
+                   "# TYPE modbus_pool_slabs_total counter\n");
+
+    for (ucCount = 0; ucCount < eNUM_OF_POOLS; ucCount++)
+    {
+        (void)tcp_GetPoolStats(ucCount, &pcPool, &tPool);
+        Append(&tText, "modbus_pool_slabs_total{pool=\"%s\"} %lu\n", pcPool, (unsigned long)tPool.ulNumOfSlabs);
+    }
+
+    Append(&tText, "# HELP modbus_lane_queue_depth Queries waiting in priority lane.\n"
+                   "# TYPE modbus_lane_queue_depth gauge\n");
+
+    for (ucCount = 0; ucCount < TCP_MAX_LANES; ucCount++)
+    {
+        (void)tcp_GetLaneStats(ucCount, &tLane);
+        Append(&tText, "modbus_lane_queue_depth{lane=\"%u\"} %lu\n", ucCount, (unsigned long)tLane.ulQueueDepth);
+    }
+
+    Append(&tText, "# HELP modbus_lane_latency_seconds Time from arrival of query until response is sent.\n"
+                   "# TYPE modbus_lane_latency_seconds summary\n");
+
+    for (ucCount = 0; ucCount < TCP_MAX_LANES; ucCount++)
+    {
+        (void)tcp_GetLaneStats(ucCount, &tLane);
+        Append(&tText, "modbus_lane_latency_seconds{lane=\"%u\",quantile=\"0.5\"} %.6f\n"
+                       "modbus_lane_latency_seconds{lane=\"%u\",quantile=\"0.9\"} %.6f\n"
+                       "modbus_lane_latency_seconds{lane=\"%u\",quantile=\"0.99\"} %.6f\n"
+                       "modbus_lane_latency_seconds{lane=\"%u\",quantile=\"0.999\"} %.6f\n"
+                       "modbus_lane_latency_seconds_count{lane=\"%u\"} %lu\n",
+                       ucCount, tLane.ulP50 / 1e6, ucCount, tLane.ulP90 / 1e6,
+                       ucCount, tLane.ulP99 / 1e6, ucCount, tLane.ulP999 / 1e6,
+                       ucCount, (unsigned long)tLane.ulNumOfRequests);
+    }
+
+    Append(&tText, "# HELP modbus_stage_latency_seconds Latency of request stages, kernel times if supported.\n"
+                   "# TYPE modbus_stage_latency_seconds summary\n");
+
+    for (ucCount = 0; ucCount < eNUM_OF_STAGES; ucCount++)
+    {
+        (void)tcp_GetStageStats(ucCount, &tLane);
+        Append(&tText, "modbus_stage_latency_seconds{stage=\"%s\",quantile=\"0.5\"} %.6f\n"
+                       "modbus_stage_latency_seconds{stage=\"%s\",quantile=\"0.9\"} %.6f\n"
+                       "modbus_stage_latency_seconds{stage=\"%s\",quantile=\"0.99\"} %.6f\n"
+                       "modbus_stage_latency_seconds{stage=\"%s\",quantile=\"0.999\"} %.6f\n"
+                       "modbus_stage_latency_seconds_count{stage=\"%s\"} %lu\n",
+                       m_apcStageNames[ucCount], tLane.ulP50 / 1e6, m_apcStageNames[ucCount], tLane.ulP90 / 1e6,
+                       m_apcStageNames[ucCount], tLane.ulP99 / 1e6, m_apcStageNames[ucCount], tLane.ulP999 / 1e6,
+                       m_apcStageNames[ucCount], (unsigned long)tLane.ulNumOfRequests);
+    }
+
+    //function code statistics of modbus application
+    mbap_StatsSnapshot(&m_tModbusStats);
+
+    Append(&tText, "# HELP modbus_requests_total Requests by function code, fc 0 - other function codes.\n"
+                   "# TYPE modbus_requests_total counter\n");
+
+    for (ucCount = 0; ucCount < m_tModbusStats.ucNumOfEntries; ucCount++)
+    {
+        const FunctionCodeStats_t *ptEntry = &m_tModbusStats.atEntries[ucCount];
+
+        Append(&tText, "modbus_requests_total{fc=\"%u\"} %lu\n",
+               ptEntry->ucFunctionCode, (unsigned long)ptEntry->ulRequests);
+    }
+
+    Append(&tText, "# HELP modbus_responses_total Responses by function code and exception code, code 0 - normal response.\n"
+                   "# TYPE modbus_responses_total counter\n");
+
+    for (ucCount = 0; ucCount < m_tModbusStats.ucNumOfEntries; ucCount++)
+    {
+        const FunctionCodeStats_t *ptEntry = &m_tModbusStats.atEntries[ucCount];
+
+        for (ucCode = 0; ucCode < STATS_MAX_EXCEPTION; ucCode++)
+        {
+            if ((0 == ucCode) || (0 != ptEntry->aulExceptions[ucCode]))
+            {
+                Append(&tText, "modbus_responses_total{fc=\"%u\",code=\"%u\"} %lu\n",
+                       ptEntry->ucFunctionCode, ucCode, (unsigned long)ptEntry->aulExceptions[ucCode]);
+            }
+        }
+    }
+
+    Append(&tText, "# HELP modbus_bytes_total Query and response bytes by function code.\n"
+                   "# TYPE modbus_bytes_total counter\n");
+
+    for (ucCount = 0; ucCount < m_tModbusStats.ucNumOfEntries; ucCount++)
+    {
+        const FunctionCodeStats_t *ptEntry = &m_tModbusStats.atEntries[ucCount];
+
+        Append(&tText, "modbus_bytes_total{fc=\"%u\",direction=\"in\"} %llu\n"
+                       "modbus_bytes_total{fc=\"%u\",direction=\"out\"} %llu\n",
+                       ptEntry->ucFunctionCode, (unsigned long long)ptEntry->ullBytesIn,
+                       ptEntry->ucFunctionCode, (unsigned long long)ptEntry->ullBytesOut);
+    }
+
+    Append(&tText, "# HELP modbus_processing_seconds Processing time of requests by function code.\n"
+                   "# TYPE modbus_processing_seconds summary\n");
+
+    for (ucCount = 0; ucCount < m_tModbusStats.ucNumOfEntries; ucCount++)
+    {
+        snprintf(acLabel, sizeof(acLabel), "fc=\"%u\"", m_tModbusStats.atEntries[ucCount].ucFunctionCode);
+        AppendSummary(&tText, "modbus_processing_seconds", acLabel,
+                      &m_tModbusStats.atEntries[ucCount].tLatency, 1000000000u);
+    }
+
+    Append(&tText, "# HELP modbus_stats_dropped_total Requests not counted in function code statistics.\n"
+                   "# TYPE modbus_stats_dropped_total counter\n"
+                   "modbus_stats_dropped_total %lu\n", (unsigned long)m_tModbusStats.ulDropped);
+
+    if (cp_GetStats(&ullRecords, &ullDropped))
+    {
+        Append(&tText, "# HELP modbus_capture_records_total Records put into capture ring.\n"
+                       "# TYPE modbus_capture_records_total counter\n"
+                       "modbus_capture_records_total %llu\n"
+                       "# HELP modbus_capture_dropped_total Records dropped because capture writer fell behind.\n"
+                       "# TYPE modbus_capture_dropped_total counter\n"
+                       "modbus_capture_dropped_total %llu\n",
+                       (unsigned long long)ullRecords, (unsigned long long)ullDropped);
+    }
+
+    if (NULL != mbap_ImageRegion(0))
+    {
+        mbap_ImageGetStats(&tImage);
+        Append(&tText, "# HELP modbus_image_checkpoints_total Tables of register image checkpointed to disk.\n"
+                       "# TYPE modbus_image_checkpoints_total counter\n"
+                       "modbus_image_checkpoints_total %lu\n"
+                       "# HELP modbus_image_rolled_back Tables rolled back to checkpoint or reset at start.\n"
+                       "# TYPE modbus_image_rolled_back gauge\n"
+                       "modbus_image_rolled_back{to=\"checkpoint\"} %lu\n"
+                       "modbus_image_rolled_back{to=\"defaults\"} %lu\n",
+                       (unsigned long)tImage.ulNumOfCheckpoints, (unsigned long)tImage.ulNumOfRolledBack,
+                       (unsigned long)tImage.ulNumOfReset);
+    }
+
+    rp_GetStats(&tReplica);
+
+    if (eROLE_NONE != tReplica.ucRole)
+    {
+        Append(&tText, "# HELP modbus_replica_role Replication role, 1 - primary, 2 - standby.\n"
+                       "# TYPE modbus_replica_role gauge\n"
+                       "modbus_replica_role %u\n"
+                       "# HELP modbus_replica_sequence Last delta taken by primary or applied by standby.\n"
+                       "# TYPE modbus_replica_sequence gauge\n"
+                       "modbus_replica_sequence %lu\n"
+                       "# HELP modbus_replica_frames_total Delta and snapshot frames sent or applied.\n"
+                       "# TYPE modbus_replica_frames_total counter\n"
+                       "modbus_replica_frames_total %lu\n"
+                       "# HELP modbus_replica_resyncs_total Standbys resynchronised by snapshot or backlog.\n"
+                       "# TYPE modbus_replica_resyncs_total counter\n"
+                       "modbus_replica_resyncs_total{by=\"snapshot\"} %lu\n"
+                       "modbus_replica_resyncs_total{by=\"backlog\"} %lu\n"
+                       "# HELP modbus_replica_peers Standbys connected to primary, or primary followed by standby.\n"
+                       "# TYPE modbus_replica_peers gauge\n"
+                       "modbus_replica_peers %u\n"
+                       "# HELP modbus_replica_lag_seconds Age of last applied delta on standby.\n"
+                       "# TYPE modbus_replica_lag_seconds gauge\n"
+                       "modbus_replica_lag_seconds %.6f\n"
+                       "modbus_replica_lag_seconds{stat=\"max\"} %.6f\n",
+                       (unsigned)tReplica.ucRole, (unsigned long)tReplica.ulSequence,
+                       (unsigned long)tReplica.ulNumOfFrames, (unsigned long)tReplica.ulNumOfSnapshots,
+                       (unsigned long)tReplica.ulNumOfCatchUps,
+                       (unsigned)((eROLE_PRIMARY == tReplica.ucRole) ? tReplica.ucNumOfStandbys : tReplica.bConnected),
+                       tReplica.ulLagUs / 1e6, tReplica.ulMaxLagUs / 1e6);
+    }
+
+    return tText.ulLen;
+}//end mt_Render
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static void *MetricsThread(void *pvArg)
+{
+    int iListenSocket = (int)(intptr_t)pvArg;
+
+    while (1)
+    {
+        int iSocket = accept(iListenSocket, NULL, NULL);
+
+        if (iSocket >= 0)
+        {
+            AnswerScrape(iSocket);
+            close(iSocket);
+        }
+    }
+
+    return NULL;
+}//end MetricsThread
+
+static void AnswerScrape(int iSocket)
+{
+    struct timeval tTimeout = {HTTP_TIMEOUT_SEC, 0};
+    char           acRequest[HTTP_REQUEST_SIZE];
+    char           acHeader[128];
+    uint32_t       ulRequestLen = 0;
+    uint32_t       ulBodyLen    = 0;
+    int            iHeaderLen   = 0;
+    ssize_t        sReturn      = 0;
+
+    (void)setsockopt(iSocket, SOL_SOCKET, SO_RCVTIMEO, &tTimeout, sizeof(tTimeout));
+    (void)setsockopt(iSocket, SOL_SOCKET, SO_SNDTIMEO, &tTimeout, sizeof(tTimeout));
+
+    //request line and headers end with empty line
+    while (ulRequestLen < (sizeof(acRequest) - 1u))
+    {
+        sReturn = recv(iSocket, &acRequest[ulRequestLen], sizeof(acRequest) - 1u - ulRequestLen, 0);
+
+        if (sReturn <= 0)
+        {
+            return;
+        }
+
+        ulRequestLen += (uint32_t)sReturn;
+        acRequest[ulRequestLen] = '\0';
+
+        if ((NULL != strstr(acRequest, "\r\n\r\n")) || (NULL != strstr(acRequest, "\n\n")))
+        {
+            break;
+        }
+    }
+
+    if ((0 != strncmp(acRequest, "GET /metrics ", 13)) && (0 != strncmp(acRequest, "GET / ", 6)))
+    {
+        static const char acNotFound[] = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+
+        (void)send(iSocket, acNotFound, sizeof(acNotFound) - 1u, MSG_NOSIGNAL);
+        return;
+    }
+
+    ulBodyLen  = mt_Render(m_acMetrics, sizeof(m_acMetrics));
+    iHeaderLen = snprintf(acHeader, sizeof(acHeader),
+                          "HTTP/1.0 200 OK\r\n"
+                          "Content-Type: text/plain; version=0.0.4\r\n"
+                          "Content-Length: %lu\r\n\r\n", (unsigned long)ulBodyLen);
+
+    if (send(iSocket, acHeader, (size_t)iHeaderLen, MSG_NOSIGNAL) == iHeaderLen)
+    {
+        (void)send(iSocket, m_acMetrics, ulBodyLen, MSG_NOSIGNAL);
+    }
+}//end AnswerScrape
+
+static void Append(TextBuffer_t *ptText, const char *pcFormat, ...)
+{
+    va_list tArgs;
+    int     iLen = 0;
+
+    if (ptText->ulLen >= (ptText->ulSize - 1u))
+    {
+        return;
+    }
+
+    va_start(tArgs, pcFormat);
+    iLen = vsnprintf(&ptText->pcBuf[ptText->ulLen], ptText->ulSize - ptText->ulLen, pcFormat, tArgs);
+    va_end(tArgs);
+
+    if (iLen > 0)
+    {
+        ptText->ulLen += (uint32_t)iLen;
+    }
+
+    if (ptText->ulLen >= ptText->ulSize)
+    {
+        ptText->ulLen = ptText->ulSize - 1u;
+    }
+}//end Append
+
+static void AppendSummary(TextBuffer_t *ptText,
+                          const char *pcName,
+                          const char *pcLabel,
+                          const LatencyHistogram_t *ptHist,
+                          uint32_t ulDivisor)
+{
+    static const uint16_t ausPerMille[] = {500, 900, 990, 999};
+    static const char     *apcQuantile[] = {"0.5", "0.9", "0.99", "0.999"};
+    uint8_t               ucCount        = 0;
+
+    for (ucCount = 0; ucCount < (sizeof(ausPerMille) / sizeof(ausPerMille[0])); ucCount++)
+    {
+        Append(ptText, "%s{%s,quantile=\"%s\"} %.9f\n", pcName, pcLabel, apcQuantile[ucCount],
+               (double)mbap_HistPercentile(ptHist, ausPerMille[ucCount]) / ulDivisor);
+    }
+
+    Append(ptText, "%s_sum{%s} %.9f\n%s_count{%s} %lu\n",
+           pcName, pcLabel, (double)ptHist->ullSum / ulDivisor,
+           pcName, pcLabel, (unsigned long)ptHist->ulCount);
+}//end AppendSummary
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
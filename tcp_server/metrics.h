@@ -0,0 +1,53 @@
+//! @addtogroup TCPServerMetrics
+//! @{
+//
+//****************************************************************************
+//! @file metrics.h
+//! @brief This contains the prototypes, macros, constants or global variables
+//!        for the metrics endpoint in Prometheus text format
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//
+//****************************************************************************
+#ifndef METRICS_H
+#define METRICS_H
+
+//****************************************************************************
+//                           Includes
+//****************************************************************************
+
+//****************************************************************************
+//                           Constants and typedefs
+//****************************************************************************
+//! @brief Default port of metrics endpoint
+#define MT_DEFAULT_PORT      (9502u)
+
+//****************************************************************************
+//                           Global variables
+//****************************************************************************
+
+//****************************************************************************
+//                           Global Functions
+//****************************************************************************
+//
+//! @brief Start metrics thread answering HTTP/1.0 GET /metrics on localhost.
+//!        Metrics are read from statistics without taking locks used while
+//!        requests are processed.
+//! @param[in]  usPort  TCP port on 127.0.0.1
+//! @return     bool    true - endpoint started, false - error
+//
+bool mt_Init(uint16_t usPort);
+
+//
+//! @brief Write all metrics in Prometheus text exposition format
+//! @param[out] pcBuf      Text buffer
+//! @param[in]  ulBufSize  Size of text buffer
+//! @return     uint32_t   Length of text, text is truncated to buffer size
+//
+uint32_t mt_Render(char *pcBuf, uint32_t ulBufSize);
+
+#endif // METRICS_H
+//****************************************************************************
+//                             End of file
+//****************************************************************************
+//! @}
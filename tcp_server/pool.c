@@ -0,0 +1,185 @@
+//! @addtogroup TCPServerPool
+//! @brief Slab allocator of connection state and I/O buffers
+//! @{
+//!
+//****************************************************************************/
+//! @file pool.c
+//! @brief Pools of fixed size objects. Objects are carved from slabs which
+//!        are never given back, a free object keeps the next free object in
+//!        its first word. Pools used by one thread take no lock, shared pools
+//!        take a spin lock held for a few instructions only.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+//user defined header files
+#include "pool.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+//objects are aligned for any member type
+#define OBJECT_ALIGN         16u
+//written under lock or by owning thread only, read by any thread
+#define STATS_ADD(x, v)      __atomic_store_n(&(x), (x) + (v), __ATOMIC_RELAXED)
+
+//****************************************************************************/
+//                           external variables
+//****************************************************************************/
+
+//****************************************************************************/
+//                           Local variables
+//****************************************************************************/
+
+//****************************************************************************/
+//                           Local Functions
+//****************************************************************************/
+//
+//! @brief Take a slab from heap and put its objects into free list
+//! @param[in]  ptPool  Pool
+//! @return     bool    true - slab added, false - out of memory
+//
+static bool AddSlab(ObjectPool_t *ptPool);
+
+//
+//! @brief Lock shared pool
+//! @param[in]  ptPool  Pool
+//! @return     None
+//
+static void Lock(ObjectPool_t *ptPool);
+
+//
+//! @brief Unlock shared pool
+//! @param[in]  ptPool  Pool
+//! @return     None
+//
+static void Unlock(ObjectPool_t *ptPool);
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+void pl_Init(ObjectPool_t *ptPool, const char *pcName, size_t ulObjectSize,
+             uint32_t ulObjectsPerSlab, bool bShared)
+{
+    memset(ptPool, 0, sizeof(ObjectPool_t));
+
+    if (ulObjectSize < sizeof(void *))
+    {
+        ulObjectSize = sizeof(void *);
+    }
+
+    ptPool->pcName           = pcName;
+    ptPool->ulObjectSize     = (ulObjectSize + OBJECT_ALIGN - 1u) & ~(size_t)(OBJECT_ALIGN - 1u);
+    ptPool->ulObjectsPerSlab = (0 == ulObjectsPerSlab) ? 1u : ulObjectsPerSlab;
+    ptPool->bShared          = bShared;
+}//end pl_Init
+
+void *pl_Alloc(ObjectPool_t *ptPool)
+{
+    void *pvObject = NULL;
+
+    Lock(ptPool);
+
+    if ((NULL != ptPool->pvFree) || AddSlab(ptPool))
+    {
+        pvObject       = ptPool->pvFree;
+        ptPool->pvFree = *(void **)pvObject;
+        STATS_ADD(ptPool->ulFree, -1);
+        STATS_ADD(ptPool->ulInUse, 1);
+    }
+
+    Unlock(ptPool);
+
+    return pvObject;
+}//end pl_Alloc
+
+void pl_Free(ObjectPool_t *ptPool, void *pvObject)
+{
+    if (NULL == pvObject)
+    {
+        return;
+    }
+
+    Lock(ptPool);
+
+    *(void **)pvObject = ptPool->pvFree;
+    ptPool->pvFree     = pvObject;
+    STATS_ADD(ptPool->ulFree, 1);
+    STATS_ADD(ptPool->ulInUse, -1);
+
+    Unlock(ptPool);
+}//end pl_Free
+
+void pl_GetStats(const ObjectPool_t *ptPool, PoolStats_t *ptStats)
+{
+    ptStats->ulInUse      = __atomic_load_n(&ptPool->ulInUse, __ATOMIC_RELAXED);
+    ptStats->ulFree       = __atomic_load_n(&ptPool->ulFree, __ATOMIC_RELAXED);
+    ptStats->ulNumOfSlabs = __atomic_load_n(&ptPool->ulNumOfSlabs, __ATOMIC_RELAXED);
+    ptStats->ulSlabSize   = (uint32_t)(ptPool->ulObjectSize * ptPool->ulObjectsPerSlab);
+}//end pl_GetStats
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static bool AddSlab(ObjectPool_t *ptPool)
+{
+    uint8_t  *pucSlab = (uint8_t *)malloc(ptPool->ulObjectSize * ptPool->ulObjectsPerSlab);
+    uint32_t ulCount  = 0;
+
+    if (NULL == pucSlab)
+    {
+        return false;
+    }
+
+    //lowest object of slab is handed out first
+    for (ulCount = ptPool->ulObjectsPerSlab; ulCount > 0; ulCount--)
+    {
+        void *pvObject = &pucSlab[(ulCount - 1u) * ptPool->ulObjectSize];
+
+        *(void **)pvObject = ptPool->pvFree;
+        ptPool->pvFree     = pvObject;
+    }
+
+    STATS_ADD(ptPool->ulFree, ptPool->ulObjectsPerSlab);
+    STATS_ADD(ptPool->ulNumOfSlabs, 1);
+
+    return true;
+}//end AddSlab
+
+static void Lock(ObjectPool_t *ptPool)
+{
+    if (!ptPool->bShared)
+    {
+        return;
+    }
+
+    while (__atomic_test_and_set(&ptPool->ucLock, __ATOMIC_ACQUIRE))
+    {
+        //wait until lock looks free before trying again
+        while (__atomic_load_n(&ptPool->ucLock, __ATOMIC_RELAXED))
+        {
+        }
+    }
+}//end Lock
+
+static void Unlock(ObjectPool_t *ptPool)
+{
+    if (ptPool->bShared)
+    {
+        __atomic_clear(&ptPool->ucLock, __ATOMIC_RELEASE);
+    }
+}//end Unlock
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
@@ -0,0 +1,93 @@
+//! @addtogroup TCPServerPool
+//! @{
+//
+//****************************************************************************
+//! @file pool.h
+//! @brief This contains the prototypes, macros, constants or global variables
+//!        for the slab allocator of connection state and I/O buffers
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//
+//****************************************************************************
+#ifndef POOL_H
+#define POOL_H
+
+//****************************************************************************
+//                           Includes
+//****************************************************************************
+
+//****************************************************************************
+//                           Constants and typedefs
+//****************************************************************************
+//! @brief Pool of fixed size objects carved from slabs. Slabs are taken
+//!        from heap when the pool is empty and kept for reuse, so once the
+//!        pool has grown to the peak number of objects no heap call is made.
+typedef struct ObjectPool
+{
+    const char *pcName;                             //!<Name reported in metrics
+    size_t     ulObjectSize;                        //!<Object size rounded up to alignment
+    uint32_t   ulObjectsPerSlab;                    //!<Objects taken from heap at once
+    bool       bShared;                             //!<Used by several threads, access locked
+    uint8_t    ucLock;                              //!<Spin lock of shared pool
+    void       *pvFree;                             //!<Free objects, next pointer in first word
+    uint32_t   ulInUse;                             //!<Objects handed out
+    uint32_t   ulFree;                              //!<Objects in free list
+    uint32_t   ulNumOfSlabs;                        //!<Slabs taken from heap
+} ObjectPool_t;
+
+//! @brief Statistics of a pool
+typedef struct PoolStats
+{
+    uint32_t ulInUse;                               //!<Objects handed out
+    uint32_t ulFree;                                //!<Objects in free list
+    uint32_t ulNumOfSlabs;                          //!<Slabs taken from heap since start
+    uint32_t ulSlabSize;                            //!<Bytes of one slab
+} PoolStats_t;
+
+//****************************************************************************
+//                           Global variables
+//****************************************************************************
+
+//****************************************************************************
+//                           Global Functions
+//****************************************************************************
+//
+//! @brief Initialise an empty pool, no memory is taken until first allocation
+//! @param[in]  ptPool            Pool
+//! @param[in]  pcName            Name reported in metrics
+//! @param[in]  ulObjectSize      Size of an object
+//! @param[in]  ulObjectsPerSlab  Objects taken from heap at once
+//! @param[in]  bShared           true - pool is used by several threads
+//! @return     None
+//
+void pl_Init(ObjectPool_t *ptPool, const char *pcName, size_t ulObjectSize,
+             uint32_t ulObjectsPerSlab, bool bShared);
+
+//
+//! @brief Take an object, contents are undefined
+//! @param[in]  ptPool  Pool
+//! @return     void*   Object, NULL if out of memory
+//
+void *pl_Alloc(ObjectPool_t *ptPool);
+
+//
+//! @brief Give an object back to its pool
+//! @param[in]  ptPool    Pool
+//! @param[in]  pvObject  Object taken from pool, NULL is ignored
+//! @return     None
+//
+void pl_Free(ObjectPool_t *ptPool, void *pvObject);
+
+//
+//! @brief Read statistics of a pool, may be called from any thread
+//! @param[in]  ptPool   Pool
+//! @param[out] ptStats  Statistics
+//! @return     None
+//
+void pl_GetStats(const ObjectPool_t *ptPool, PoolStats_t *ptStats);
+
+#endif // POOL_H
+//****************************************************************************
+//                             End of file
+//****************************************************************************
+//! @}
@@ -0,0 +1,1034 @@
+//! @addtogroup TCPServerReplica
+//! @brief Hot standby replication of the register tables
+//! @{
+//!
+//****************************************************************************/
+//! @file replica.c
+//! @brief Streams changed ranges of the register tables from a primary to
+//!        standby servers and applies them on the standby. The primary takes
+//!        deltas once per RP_PERIOD_US by comparing tables block wise against
+//!        a shadow copy, so each frame batches all writes of a period. The
+//!        shadow holds the tables at the last sequence and is sent as
+//!        snapshot to a standby which cannot catch up from the backlog. Each
+//!        role runs in an own thread, the server loop is not involved.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+//user defined header files
+#include "mbap_image.h"
+#include "mbap_user.h"
+#include "replica.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+#define FRAME_HEADER_LEN     (24u)
+#define RANGE_HEADER_LEN     (6u)
+#define FRAME_SIZE           (FRAME_HEADER_LEN + RP_MAX_PAYLOAD)
+//standby retries connecting to primary this often
+#define RECONNECT_PERIOD_US  (100000u)
+//tries before a table written all the time is taken as it is
+#define MAX_READ_TRIES       (8u)
+//written by replication thread, read by any thread
+#define STATS_SET(x, v)      __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+#define STATS_GET(x)         __atomic_load_n(&(x), __ATOMIC_RELAXED)
+
+//! @brief Encoded frame
+typedef struct Frame
+{
+    uint32_t ulSequence;                            //!<Sequence of delta kept in backlog
+    uint16_t usLen;                                 //!<Bytes of frame
+    uint8_t  aucData[FRAME_SIZE];                   //!<Header and payload
+} Frame_t;
+
+//! @brief Frame being filled with ranges
+typedef struct Batch
+{
+    uint8_t  ucType;                                //!<eFRAME_DELTA or eFRAME_SNAPSHOT
+    uint8_t  ucNumOfRanges;                         //!<Ranges in frame
+    uint16_t usPayloadLen;                          //!<Bytes of ranges
+    uint64_t ullTimeUs;                             //!<Time changes were taken
+    int      iSocket;                               //!<Snapshot receiver, deltas go to all standbys
+} Batch_t;
+
+//! @brief Replicated table
+typedef struct Table
+{
+    uint8_t  *pucTable;                             //!<Table served
+    uint8_t  *pucShadow;                            //!<Table at last sequence
+    uint32_t ulLength;                              //!<Bytes of table
+    uint32_t ulImageSequence;                       //!<Region sequence at last delta, 0 - compare always
+} Table_t;
+
+//! @brief Connected standby
+typedef struct Standby
+{
+    int  iSocket;                                   //!<Socket, -1 - free entry
+    bool bReady;                                    //!<Hello answered, receives deltas
+} Standby_t;
+
+//****************************************************************************/
+//                           Local Functions
+//****************************************************************************/
+//
+//! @brief Take served tables and allocate shadow and scratch copies
+//! @param[in]  None
+//! @return     bool  true - done
+//
+static bool InitTables(void);
+
+//
+//! @brief Open listening socket of primary
+//! @param[in]  usPort  TCP port
+//! @return     bool    true - listening
+//
+static bool Listen(uint16_t usPort);
+
+//
+//! @brief Thread of primary
+//! @param[in]  pvArg  Not used
+//! @return     void*  Not used
+//
+static void *PrimaryThread(void *pvArg);
+
+//
+//! @brief Thread of standby, continues as primary after promotion
+//! @param[in]  pvArg  Not used
+//! @return     void*  Not used
+//
+static void *StandbyThread(void *pvArg);
+
+//
+//! @brief Serve standbys and stream deltas, never returns
+//! @param[in]  None
+//! @return     None
+//
+static void RunPrimary(void);
+
+//
+//! @brief Compare tables against shadow and send changed ranges as deltas
+//! @param[in]  None
+//! @return     None
+//
+static void TakeDeltas(void);
+
+//
+//! @brief Copy a table without a write of another thread or process in between
+//! @param[in]  ucRegion  Region
+//! @param[out] pucCopy   Copy of table
+//! @return     uint32_t  Region sequence of copy, 0 if no image is mapped
+//
+static uint32_t ReadTable(uint8_t ucRegion, uint8_t *pucCopy);
+
+//
+//! @brief Append a range to batch, full frames are sent
+//! @param[in]  ptBatch    Batch
+//! @param[in]  ucRegion   Region
+//! @param[in]  ulOffset   Byte offset in table
+//! @param[in]  ulLength   Bytes of range
+//! @param[in]  pucData    Bytes of range
+//! @return     None
+//
+static void AppendRange(Batch_t *ptBatch, uint8_t ucRegion, uint32_t ulOffset,
+                        uint32_t ulLength, const uint8_t *pucData);
+
+//
+//! @brief Send frame of batch, a delta is kept in backlog and sent to all
+//!        ready standbys
+//! @param[in]  ptBatch  Batch
+//! @return     None
+//
+static void FlushBatch(Batch_t *ptBatch);
+
+//
+//! @brief Accept a standby
+//! @param[in]  None
+//! @return     None
+//
+static void AcceptStandby(void);
+
+//
+//! @brief Read hello of standby and answer with catch-up or snapshot
+//! @param[in]  ptStandby  Standby
+//! @return     None
+//
+static void AnswerHello(Standby_t *ptStandby);
+
+//
+//! @brief Send frame to all ready standbys, failed standbys are dropped
+//! @param[in]  pucFrame  Frame
+//! @param[in]  usLen     Bytes of frame
+//! @return     None
+//
+static void Broadcast(const uint8_t *pucFrame, uint16_t usLen);
+
+//
+//! @brief Close connection of standby
+//! @param[in]  ptStandby  Standby
+//! @return     None
+//
+static void DropStandby(Standby_t *ptStandby);
+
+//
+//! @brief Connect to primary and send hello
+//! @param[in]  None
+//! @return     int  Socket, -1 on error
+//
+static int ConnectPrimary(void);
+
+//
+//! @brief Apply frames of primary until connection is lost or standby is promoted
+//! @param[in]  iSocket  Socket connected to primary
+//! @return     None
+//
+static void Follow(int iSocket);
+
+//
+//! @brief Write ranges of a frame into tables
+//! @param[in]  pucPayload     Ranges
+//! @param[in]  usPayloadLen   Bytes of ranges
+//! @param[in]  ucNumOfRanges  Number of ranges
+//! @return     bool           false - malformed frame, ranges before are written
+//
+static bool ApplyRanges(const uint8_t *pucPayload, uint16_t usPayloadLen, uint8_t ucNumOfRanges);
+
+//
+//! @brief Encode frame header
+//! @param[out] pucFrame       Frame
+//! @param[in]  ucType         Type(enum ReplicaFrame)
+//! @param[in]  ucNumOfRanges  Number of ranges
+//! @param[in]  usPayloadLen   Bytes of payload
+//! @param[in]  ulSequence     Sequence
+//! @param[in]  ullEpoch       Epoch of primary
+//! @param[in]  ullTimeUs      Time changes were taken
+//! @return     None
+//
+static void EncodeHeader(uint8_t *pucFrame, uint8_t ucType, uint8_t ucNumOfRanges, uint16_t usPayloadLen,
+                         uint32_t ulSequence, uint64_t ullEpoch, uint64_t ullTimeUs);
+
+//
+//! @brief Send all bytes
+//! @param[in]  iSocket  Socket
+//! @param[in]  pucData  Bytes
+//! @param[in]  ulLen    Number of bytes
+//! @return     bool     true - sent
+//
+static bool SendAll(int iSocket, const uint8_t *pucData, uint32_t ulLen);
+
+//
+//! @brief Receive all bytes, socket has a receive timeout
+//! @param[in]  iSocket  Socket
+//! @param[out] pucData  Bytes
+//! @param[in]  ulLen    Number of bytes
+//! @return     bool     true - received
+//
+static bool RecvAll(int iSocket, uint8_t *pucData, uint32_t ulLen);
+
+//
+//! @brief Set socket options of replication connection
+//! @param[in]  iSocket  Socket
+//! @return     None
+//
+static void SetSocketOptions(int iSocket);
+
+//
+//! @brief Wall clock time, comparable between processes of a host
+//! @param[in]  None
+//! @return     uint64_t  us since 1970
+//
+static uint64_t NowUs(void);
+
+static void     Put16(uint8_t *pucBuf, uint16_t usValue);
+static void     Put32(uint8_t *pucBuf, uint32_t ulValue);
+static void     Put64(uint8_t *pucBuf, uint64_t ullValue);
+static uint16_t Get16(const uint8_t *pucBuf);
+static uint32_t Get32(const uint8_t *pucBuf);
+static uint64_t Get64(const uint8_t *pucBuf);
+
+//****************************************************************************/
+//                           Local variables
+//****************************************************************************/
+//used by replication thread only after start
+static Table_t            m_atTables[eNUM_OF_REGIONS];
+static uint8_t            *m_pucScratch;
+static Frame_t            m_atBacklog[RP_BACKLOG_FRAMES];
+static Frame_t            m_tFrame;
+static Standby_t          m_atStandbys[RP_MAX_STANDBYS];
+static int                m_iListen = -1;
+static uint64_t           m_ullEpoch;
+static uint64_t           m_ullLastSendUs;
+static struct sockaddr_in m_tPrimary;
+static uint16_t           m_usServePort;
+//set by signal handler
+static volatile bool      m_bPromote;
+static ReplicaStats_t     m_tStats;
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+bool rp_StartPrimary(uint16_t usPort)
+{
+    pthread_t tThread;
+
+    if ((eROLE_NONE != m_tStats.ucRole) || !InitTables() || !Listen(usPort))
+    {
+        return false;
+    }
+
+    STATS_SET(m_tStats.ucRole, eROLE_PRIMARY);
+
+    if (0 != pthread_create(&tThread, NULL, PrimaryThread, NULL))
+    {
+        printf("Error in replication thread creation");
+        return false;
+    }
+
+    return true;
+}//end rp_StartPrimary
+
+bool rp_StartStandby(const char *pcHost, uint16_t usPort, uint16_t usServePort)
+{
+    pthread_t tThread;
+
+    memset(&m_tPrimary, 0, sizeof(m_tPrimary));
+    m_tPrimary.sin_family = AF_INET;
+    m_tPrimary.sin_port   = htons(usPort);
+
+    if ((eROLE_NONE != m_tStats.ucRole) || (1 != inet_pton(AF_INET, pcHost, &m_tPrimary.sin_addr)) ||
+        !InitTables())
+    {
+        return false;
+    }
+
+    m_usServePort = usServePort;
+    STATS_SET(m_tStats.ucRole, eROLE_STANDBY);
+    mu_SetReadOnly(true);
+
+    if (0 != pthread_create(&tThread, NULL, StandbyThread, NULL))
+    {
+        printf("Error in replication thread creation");
+        return false;
+    }
+
+    return true;
+}//end rp_StartStandby
+
+void rp_Promote(void)
+{
+    m_bPromote = true;
+}//end rp_Promote
+
+void rp_GetStats(ReplicaStats_t *ptStats)
+{
+    ptStats->ucRole           = STATS_GET(m_tStats.ucRole);
+    ptStats->ucNumOfStandbys  = STATS_GET(m_tStats.ucNumOfStandbys);
+    ptStats->bConnected       = STATS_GET(m_tStats.bConnected);
+    ptStats->ulSequence       = STATS_GET(m_tStats.ulSequence);
+    ptStats->ulNumOfFrames    = STATS_GET(m_tStats.ulNumOfFrames);
+    ptStats->ulNumOfSnapshots = STATS_GET(m_tStats.ulNumOfSnapshots);
+    ptStats->ulNumOfCatchUps  = STATS_GET(m_tStats.ulNumOfCatchUps);
+    ptStats->ulLagUs          = STATS_GET(m_tStats.ulLagUs);
+    ptStats->ulMaxLagUs       = STATS_GET(m_tStats.ulMaxLagUs);
+}//end rp_GetStats
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static bool InitTables(void)
+{
+    uint32_t ulMaxLength = 0;
+    uint8_t  ucRegion    = 0;
+
+    for (ucRegion = 0; ucRegion < eNUM_OF_REGIONS; ucRegion++)
+    {
+        Table_t *ptTable = &m_atTables[ucRegion];
+
+        ptTable->pucTable  = (uint8_t *)mu_GetTable(ucRegion, &ptTable->ulLength);
+        ptTable->pucShadow = (uint8_t *)calloc(1, ptTable->ulLength);
+
+        //offsets and lengths of ranges are 16 bit
+        if ((NULL == ptTable->pucShadow) || (ptTable->ulLength > UINT16_MAX))
+        {
+            return false;
+        }
+
+        ulMaxLength = (ptTable->ulLength > ulMaxLength) ? ptTable->ulLength : ulMaxLength;
+    }
+
+    m_pucScratch = (uint8_t *)malloc(ulMaxLength);
+
+    return (NULL != m_pucScratch);
+}//end InitTables
+
+static bool Listen(uint16_t usPort)
+{
+    struct sockaddr_in tAddress;
+    int                iOption = 1;
+    uint8_t            ucIndex = 0;
+
+    m_iListen = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (-1 == m_iListen)
+    {
+        printf("Error in replication socket creation");
+        return false;
+    }
+
+    (void)setsockopt(m_iListen, SOL_SOCKET, SO_REUSEADDR, &iOption, sizeof(iOption));
+
+    memset(&tAddress, 0, sizeof(tAddress));
+    tAddress.sin_family      = AF_INET;
+    tAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+    tAddress.sin_port        = htons(usPort);
+
+    if ((-1 == bind(m_iListen, (struct sockaddr*)&tAddress, sizeof(tAddress))) ||
+        (-1 == listen(m_iListen, RP_MAX_STANDBYS)))
+    {
+        printf("Error in replication binding");
+        close(m_iListen);
+        m_iListen = -1;
+        return false;
+    }
+
+    for (ucIndex = 0; ucIndex < RP_MAX_STANDBYS; ucIndex++)
+    {
+        m_atStandbys[ucIndex].iSocket = -1;
+    }
+
+    return true;
+}//end Listen
+
+static void *PrimaryThread(void *pvArg)
+{
+    RunPrimary();
+
+    return NULL;
+}//end PrimaryThread
+
+static void *StandbyThread(void *pvArg)
+{
+    while (!m_bPromote)
+    {
+        int iSocket = ConnectPrimary();
+
+        if (iSocket < 0)
+        {
+            usleep(RECONNECT_PERIOD_US);
+            continue;
+        }
+
+        STATS_SET(m_tStats.bConnected, true);
+        Follow(iSocket);
+        STATS_SET(m_tStats.bConnected, false);
+        close(iSocket);
+    }
+
+    //tables hold last applied sequence, clients may write from now on
+    mu_SetReadOnly(false);
+    printf("Standby promoted at sequence %u\n", (unsigned)m_tStats.ulSequence);
+
+    if ((0 != m_usServePort) && Listen(m_usServePort))
+    {
+        STATS_SET(m_tStats.ucRole, eROLE_PRIMARY);
+        RunPrimary();
+    }
+
+    STATS_SET(m_tStats.ucRole, eROLE_NONE);
+
+    return NULL;
+}//end StandbyThread
+
+static void RunPrimary(void)
+{
+    struct pollfd atPollFds[RP_MAX_STANDBYS + 1];
+    Standby_t     *aptPolled[RP_MAX_STANDBYS + 1];
+    uint8_t       ucRegion = 0;
+
+    //standbys of an earlier primary or of this one before restart get a snapshot
+    m_ullEpoch = NowUs() ^ ((uint64_t)getpid() << 48);
+
+    for (ucRegion = 0; ucRegion < eNUM_OF_REGIONS; ucRegion++)
+    {
+        m_atTables[ucRegion].ulImageSequence = ReadTable(ucRegion, m_atTables[ucRegion].pucShadow);
+    }
+
+    while (1)
+    {
+        nfds_t  ulNumOfFds = 0;
+        nfds_t  ulIndex    = 0;
+        uint8_t ucIndex    = 0;
+
+        atPollFds[ulNumOfFds].fd     = m_iListen;
+        atPollFds[ulNumOfFds].events = POLLIN;
+        aptPolled[ulNumOfFds++]      = NULL;
+
+        for (ucIndex = 0; ucIndex < RP_MAX_STANDBYS; ucIndex++)
+        {
+            if (m_atStandbys[ucIndex].iSocket >= 0)
+            {
+                atPollFds[ulNumOfFds].fd     = m_atStandbys[ucIndex].iSocket;
+                atPollFds[ulNumOfFds].events = POLLIN;
+                aptPolled[ulNumOfFds++]      = &m_atStandbys[ucIndex];
+            }
+        }
+
+        if (poll(atPollFds, ulNumOfFds, RP_PERIOD_US / 1000u) > 0)
+        {
+            for (ulIndex = 0; ulIndex < ulNumOfFds; ulIndex++)
+            {
+                if (0 == atPollFds[ulIndex].revents)
+                {
+                    continue;
+                }
+
+                if (NULL == aptPolled[ulIndex])
+                {
+                    AcceptStandby();
+                }
+                else if (!aptPolled[ulIndex]->bReady)
+                {
+                    AnswerHello(aptPolled[ulIndex]);
+                }
+                else
+                {
+                    //standby sends nothing after hello, data or end of stream drops it
+                    DropStandby(aptPolled[ulIndex]);
+                }
+            }
+        }
+
+        TakeDeltas();
+
+        if ((NowUs() - m_ullLastSendUs) >= (RP_HEARTBEAT_MS * 1000u))
+        {
+            EncodeHeader(m_tFrame.aucData, eFRAME_HEARTBEAT, 0, 0, m_tStats.ulSequence, m_ullEpoch, NowUs());
+            Broadcast(m_tFrame.aucData, FRAME_HEADER_LEN);
+            m_ullLastSendUs = NowUs();
+        }
+    }//end while
+}//end RunPrimary
+
+static void TakeDeltas(void)
+{
+    Batch_t tBatch;
+    uint8_t ucRegion = 0;
+
+    memset(&tBatch, 0, sizeof(tBatch));
+    tBatch.ucType    = eFRAME_DELTA;
+    tBatch.ullTimeUs = NowUs();
+    tBatch.iSocket   = -1;
+
+    for (ucRegion = 0; ucRegion < eNUM_OF_REGIONS; ucRegion++)
+    {
+        Table_t  *ptTable   = &m_atTables[ucRegion];
+        uint32_t ulOffset   = 0;
+        uint32_t ulSequence = mbap_ImageReadBegin(ucRegion);
+
+        //region of mapped image not written since last delta
+        if ((0 != ulSequence) && (ulSequence == ptTable->ulImageSequence))
+        {
+            continue;
+        }
+
+        ptTable->ulImageSequence = ReadTable(ucRegion, m_pucScratch);
+
+        while (ulOffset < ptTable->ulLength)
+        {
+            uint32_t ulStart = ulOffset;
+
+            //adjacent changed blocks make one range
+            while ((ulOffset < ptTable->ulLength) &&
+                   (0 != memcmp(&m_pucScratch[ulOffset], &ptTable->pucShadow[ulOffset],
+                                (ptTable->ulLength - ulOffset < RP_BLOCK_LEN) ? (ptTable->ulLength - ulOffset) : RP_BLOCK_LEN)))
+            {
+                ulOffset += RP_BLOCK_LEN;
+            }
+
+            if (ulOffset > ulStart)
+            {
+                ulOffset = (ulOffset > ptTable->ulLength) ? ptTable->ulLength : ulOffset;
+                memcpy(&ptTable->pucShadow[ulStart], &m_pucScratch[ulStart], ulOffset - ulStart);
+                AppendRange(&tBatch, ucRegion, ulStart, ulOffset - ulStart, &m_pucScratch[ulStart]);
+            }
+            else
+            {
+                ulOffset += RP_BLOCK_LEN;
+            }
+        }//end while
+    }//end for
+
+    FlushBatch(&tBatch);
+}//end TakeDeltas
+
+static uint32_t ReadTable(uint8_t ucRegion, uint8_t *pucCopy)
+{
+    uint32_t ulSequence = 0;
+    uint8_t  ucTries    = 0;
+
+    do
+    {
+        ulSequence = mbap_ImageReadBegin(ucRegion);
+        memcpy(pucCopy, m_atTables[ucRegion].pucTable, m_atTables[ucRegion].ulLength);
+    } while (mbap_ImageReadRetry(ucRegion, ulSequence) && (++ucTries < MAX_READ_TRIES));
+
+    return ulSequence;
+}//end ReadTable
+
+static void AppendRange(Batch_t *ptBatch, uint8_t ucRegion, uint32_t ulOffset,
+                        uint32_t ulLength, const uint8_t *pucData)
+{
+    while (ulLength > 0)
+    {
+        uint8_t  *pucRange = &m_tFrame.aucData[FRAME_HEADER_LEN + ptBatch->usPayloadLen];
+        uint32_t ulChunk   = 0;
+
+        if ((ptBatch->usPayloadLen + RANGE_HEADER_LEN >= RP_MAX_PAYLOAD) || (UINT8_MAX == ptBatch->ucNumOfRanges))
+        {
+            FlushBatch(ptBatch);
+            continue;
+        }
+
+        ulChunk = RP_MAX_PAYLOAD - ptBatch->usPayloadLen - RANGE_HEADER_LEN;
+        ulChunk = (ulLength < ulChunk) ? ulLength : ulChunk;
+
+        pucRange[0] = ucRegion;
+        pucRange[1] = 0;
+        Put16(&pucRange[2], (uint16_t)ulOffset);
+        Put16(&pucRange[4], (uint16_t)ulChunk);
+        memcpy(&pucRange[RANGE_HEADER_LEN], pucData, ulChunk);
+
+        ptBatch->usPayloadLen += (uint16_t)(RANGE_HEADER_LEN + ulChunk);
+        ptBatch->ucNumOfRanges++;
+        ulOffset += ulChunk;
+        ulLength -= ulChunk;
+        pucData  += ulChunk;
+    }//end while
+}//end AppendRange
+
+static void FlushBatch(Batch_t *ptBatch)
+{
+    uint16_t usLen      = FRAME_HEADER_LEN + ptBatch->usPayloadLen;
+    uint32_t ulSequence = m_tStats.ulSequence;
+
+    if (0 == ptBatch->ucNumOfRanges)
+    {
+        return;
+    }
+
+    if (eFRAME_DELTA == ptBatch->ucType)
+    {
+        Frame_t *ptKept = NULL;
+
+        ulSequence++;
+        STATS_SET(m_tStats.ulSequence, ulSequence);
+        EncodeHeader(m_tFrame.aucData, eFRAME_DELTA, ptBatch->ucNumOfRanges, ptBatch->usPayloadLen,
+                     ulSequence, m_ullEpoch, ptBatch->ullTimeUs);
+
+        ptKept             = &m_atBacklog[ulSequence % RP_BACKLOG_FRAMES];
+        ptKept->ulSequence = ulSequence;
+        ptKept->usLen      = usLen;
+        memcpy(ptKept->aucData, m_tFrame.aucData, usLen);
+
+        Broadcast(m_tFrame.aucData, usLen);
+        STATS_SET(m_tStats.ulNumOfFrames, m_tStats.ulNumOfFrames + 1u);
+    }
+    else
+    {
+        //snapshot receiver is dropped by caller on error
+        EncodeHeader(m_tFrame.aucData, eFRAME_SNAPSHOT, ptBatch->ucNumOfRanges, ptBatch->usPayloadLen,
+                     ulSequence, m_ullEpoch, ptBatch->ullTimeUs);
+
+        if (!SendAll(ptBatch->iSocket, m_tFrame.aucData, usLen))
+        {
+            ptBatch->iSocket = -1;
+        }
+    }
+
+    m_ullLastSendUs         = NowUs();
+    ptBatch->ucNumOfRanges  = 0;
+    ptBatch->usPayloadLen   = 0;
+}//end FlushBatch
+
+static void AcceptStandby(void)
+{
+    int     iSocket = accept(m_iListen, NULL, NULL);
+    uint8_t ucIndex = 0;
+
+    if (iSocket < 0)
+    {
+        return;
+    }
+
+    for (ucIndex = 0; ucIndex < RP_MAX_STANDBYS; ucIndex++)
+    {
+        if (m_atStandbys[ucIndex].iSocket < 0)
+        {
+            SetSocketOptions(iSocket);
+            m_atStandbys[ucIndex].iSocket = iSocket;
+            m_atStandbys[ucIndex].bReady  = false;
+            STATS_SET(m_tStats.ucNumOfStandbys, m_tStats.ucNumOfStandbys + 1u);
+            return;
+        }
+    }
+
+    close(iSocket);
+}//end AcceptStandby
+
+static void AnswerHello(Standby_t *ptStandby)
+{
+    uint8_t  aucHello[FRAME_HEADER_LEN];
+    uint32_t ulHeld     = 0;
+    uint32_t ulSequence = m_tStats.ulSequence;
+
+    if (!RecvAll(ptStandby->iSocket, aucHello, FRAME_HEADER_LEN) || (eFRAME_HELLO != aucHello[0]))
+    {
+        DropStandby(ptStandby);
+        return;
+    }
+
+    ulHeld = Get32(&aucHello[4]);
+
+    if ((Get64(&aucHello[8]) == m_ullEpoch) && (ulHeld <= ulSequence) &&
+        ((ulSequence - ulHeld) <= RP_BACKLOG_FRAMES) &&
+        ((ulHeld == ulSequence) || (m_atBacklog[(ulHeld + 1u) % RP_BACKLOG_FRAMES].ulSequence == ulHeld + 1u)))
+    {
+        //catch up from backlog
+        while (ulHeld < ulSequence)
+        {
+            const Frame_t *ptKept = &m_atBacklog[++ulHeld % RP_BACKLOG_FRAMES];
+
+            if (!SendAll(ptStandby->iSocket, ptKept->aucData, ptKept->usLen))
+            {
+                DropStandby(ptStandby);
+                return;
+            }
+        }
+
+        STATS_SET(m_tStats.ulNumOfCatchUps, m_tStats.ulNumOfCatchUps + 1u);
+    }
+    else
+    {
+        Batch_t tBatch;
+        uint8_t ucRegion = 0;
+
+        memset(&tBatch, 0, sizeof(tBatch));
+        tBatch.ucType    = eFRAME_SNAPSHOT;
+        tBatch.ullTimeUs = NowUs();
+        tBatch.iSocket   = ptStandby->iSocket;
+
+        //shadow holds tables at current sequence
+        for (ucRegion = 0; ucRegion < eNUM_OF_REGIONS; ucRegion++)
+        {
+            AppendRange(&tBatch, ucRegion, 0, m_atTables[ucRegion].ulLength, m_atTables[ucRegion].pucShadow);
+        }
+
+        FlushBatch(&tBatch);
+
+        if (tBatch.iSocket < 0)
+        {
+            DropStandby(ptStandby);
+            return;
+        }
+
+        STATS_SET(m_tStats.ulNumOfSnapshots, m_tStats.ulNumOfSnapshots + 1u);
+    }
+
+    ptStandby->bReady = true;
+}//end AnswerHello
+
+static void Broadcast(const uint8_t *pucFrame, uint16_t usLen)
+{
+    uint8_t ucIndex = 0;
+
+    for (ucIndex = 0; ucIndex < RP_MAX_STANDBYS; ucIndex++)
+    {
+        Standby_t *ptStandby = &m_atStandbys[ucIndex];
+
+        if ((ptStandby->iSocket >= 0) && ptStandby->bReady && !SendAll(ptStandby->iSocket, pucFrame, usLen))
+        {
+            DropStandby(ptStandby);
+        }
+    }
+}//end Broadcast
+
+static void DropStandby(Standby_t *ptStandby)
+{
+    close(ptStandby->iSocket);
+    ptStandby->iSocket = -1;
+    ptStandby->bReady  = false;
+    STATS_SET(m_tStats.ucNumOfStandbys, m_tStats.ucNumOfStandbys - 1u);
+}//end DropStandby
+
+static int ConnectPrimary(void)
+{
+    uint8_t aucHello[FRAME_HEADER_LEN];
+    int     iSocket = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (iSocket < 0)
+    {
+        return -1;
+    }
+
+    SetSocketOptions(iSocket);
+    //epoch is 0 before first snapshot, never matches a primary
+    EncodeHeader(aucHello, eFRAME_HELLO, 0, 0, m_tStats.ulSequence, m_ullEpoch, NowUs());
+
+    if ((0 != connect(iSocket, (struct sockaddr *)&m_tPrimary, sizeof(m_tPrimary))) ||
+        !SendAll(iSocket, aucHello, FRAME_HEADER_LEN))
+    {
+        close(iSocket);
+        return -1;
+    }
+
+    return iSocket;
+}//end ConnectPrimary
+
+static void Follow(int iSocket)
+{
+    struct pollfd tPollFd;
+    uint64_t      ullLastUs      = NowUs();
+    uint8_t       ucPreviousType = eFRAME_HELLO;
+
+    tPollFd.fd     = iSocket;
+    tPollFd.events = POLLIN;
+
+    while (!m_bPromote)
+    {
+        uint8_t  ucType       = 0;
+        uint16_t usPayloadLen = 0;
+        uint32_t ulSequence   = 0;
+        uint64_t ullEpoch     = 0;
+        uint64_t ullNowUs     = 0;
+
+        if (poll(&tPollFd, 1, RP_HEARTBEAT_MS) <= 0)
+        {
+            if ((NowUs() - ullLastUs) >= (RP_TIMEOUT_MS * 1000u))
+            {
+                return;
+            }
+
+            continue;
+        }
+
+        if (!RecvAll(iSocket, m_tFrame.aucData, FRAME_HEADER_LEN))
+        {
+            return;
+        }
+
+        ucType       = m_tFrame.aucData[0];
+        usPayloadLen = Get16(&m_tFrame.aucData[2]);
+        ulSequence   = Get32(&m_tFrame.aucData[4]);
+        ullEpoch     = Get64(&m_tFrame.aucData[8]);
+
+        if ((usPayloadLen > RP_MAX_PAYLOAD) ||
+            !RecvAll(iSocket, &m_tFrame.aucData[FRAME_HEADER_LEN], usPayloadLen))
+        {
+            return;
+        }
+
+        if (eFRAME_SNAPSHOT == ucType)
+        {
+            m_ullEpoch = ullEpoch;
+
+            if (eFRAME_SNAPSHOT != ucPreviousType)
+            {
+                STATS_SET(m_tStats.ulNumOfSnapshots, m_tStats.ulNumOfSnapshots + 1u);
+            }
+        }
+        else if ((ullEpoch != m_ullEpoch) ||
+                 ((eFRAME_DELTA == ucType) && (ulSequence != m_tStats.ulSequence + 1u)) ||
+                 ((eFRAME_HEARTBEAT == ucType) && (ulSequence != m_tStats.ulSequence)) ||
+                 ((eFRAME_DELTA != ucType) && (eFRAME_HEARTBEAT != ucType)))
+        {
+            //frame lost or other primary, reconnect for catch-up or snapshot
+            return;
+        }
+
+        if (!ApplyRanges(&m_tFrame.aucData[FRAME_HEADER_LEN], usPayloadLen, m_tFrame.aucData[1]))
+        {
+            return;
+        }
+
+        ullNowUs       = NowUs();
+        ullLastUs      = ullNowUs;
+        ucPreviousType = ucType;
+
+        if (eFRAME_HEARTBEAT != ucType)
+        {
+            uint64_t ullLagUs = ullNowUs - Get64(&m_tFrame.aucData[16]);
+
+            ullLagUs = (ullLagUs > UINT32_MAX) ? 0 : ullLagUs;
+            STATS_SET(m_tStats.ulSequence, ulSequence);
+            STATS_SET(m_tStats.ulNumOfFrames, m_tStats.ulNumOfFrames + 1u);
+            STATS_SET(m_tStats.ulLagUs, (uint32_t)ullLagUs);
+
+            if ((eFRAME_DELTA == ucType) && (ullLagUs > m_tStats.ulMaxLagUs))
+            {
+                STATS_SET(m_tStats.ulMaxLagUs, (uint32_t)ullLagUs);
+            }
+        }
+    }//end while
+}//end Follow
+
+static bool ApplyRanges(const uint8_t *pucPayload, uint16_t usPayloadLen, uint8_t ucNumOfRanges)
+{
+    uint16_t usUsed = 0;
+
+    while (ucNumOfRanges-- > 0)
+    {
+        uint8_t  ucRegion = 0;
+        uint16_t usOffset = 0;
+        uint16_t usLength = 0;
+
+        if (usUsed + RANGE_HEADER_LEN > usPayloadLen)
+        {
+            return false;
+        }
+
+        ucRegion = pucPayload[usUsed];
+        usOffset = Get16(&pucPayload[usUsed + 2u]);
+        usLength = Get16(&pucPayload[usUsed + 4u]);
+        usUsed  += RANGE_HEADER_LEN;
+
+        if ((ucRegion >= eNUM_OF_REGIONS) || ((uint32_t)usUsed + usLength > usPayloadLen) ||
+            ((uint32_t)usOffset + usLength > m_atTables[ucRegion].ulLength))
+        {
+            return false;
+        }
+
+        mbap_ImageWriteBegin(ucRegion);
+        memcpy(&m_atTables[ucRegion].pucTable[usOffset], &pucPayload[usUsed], usLength);
+        mbap_ImageWriteEnd(ucRegion);
+        mu_MarkTable(ucRegion, usOffset, usLength);
+        usUsed += usLength;
+    }//end while
+
+    return true;
+}//end ApplyRanges
+
+static void EncodeHeader(uint8_t *pucFrame, uint8_t ucType, uint8_t ucNumOfRanges, uint16_t usPayloadLen,
+                         uint32_t ulSequence, uint64_t ullEpoch, uint64_t ullTimeUs)
+{
+    pucFrame[0] = ucType;
+    pucFrame[1] = ucNumOfRanges;
+    Put16(&pucFrame[2], usPayloadLen);
+    Put32(&pucFrame[4], ulSequence);
+    Put64(&pucFrame[8], ullEpoch);
+    Put64(&pucFrame[16], ullTimeUs);
+}//end EncodeHeader
+
+static bool SendAll(int iSocket, const uint8_t *pucData, uint32_t ulLen)
+{
+    while (ulLen > 0)
+    {
+        ssize_t lSent = send(iSocket, pucData, ulLen, MSG_NOSIGNAL);
+
+        if (lSent <= 0)
+        {
+            return false;
+        }
+
+        pucData += lSent;
+        ulLen   -= (uint32_t)lSent;
+    }
+
+    return true;
+}//end SendAll
+
+static bool RecvAll(int iSocket, uint8_t *pucData, uint32_t ulLen)
+{
+    while (ulLen > 0)
+    {
+        ssize_t lReceived = recv(iSocket, pucData, ulLen, 0);
+
+        if (lReceived <= 0)
+        {
+            return false;
+        }
+
+        pucData += lReceived;
+        ulLen   -= (uint32_t)lReceived;
+    }
+
+    return true;
+}//end RecvAll
+
+static void SetSocketOptions(int iSocket)
+{
+    struct timeval tTimeout;
+    int            iOption = 1;
+
+    //a stuck peer holds replication thread at most this long
+    tTimeout.tv_sec  = RP_TIMEOUT_MS / 1000u;
+    tTimeout.tv_usec = (RP_TIMEOUT_MS % 1000u) * 1000u;
+
+    (void)setsockopt(iSocket, IPPROTO_TCP, TCP_NODELAY, &iOption, sizeof(iOption));
+    (void)setsockopt(iSocket, SOL_SOCKET, SO_SNDTIMEO, &tTimeout, sizeof(tTimeout));
+    (void)setsockopt(iSocket, SOL_SOCKET, SO_RCVTIMEO, &tTimeout, sizeof(tTimeout));
+}//end SetSocketOptions
+
+static uint64_t NowUs(void)
+{
+    struct timespec tNow;
+
+    clock_gettime(CLOCK_REALTIME, &tNow);
+
+    return ((uint64_t)tNow.tv_sec * 1000000u) + ((uint64_t)tNow.tv_nsec / 1000u);
+}//end NowUs
+
+static void Put16(uint8_t *pucBuf, uint16_t usValue)
+{
+    pucBuf[0] = (uint8_t)(usValue >> 8);
+    pucBuf[1] = (uint8_t)(usValue & 0xFF);
+}//end Put16
+
+static void Put32(uint8_t *pucBuf, uint32_t ulValue)
+{
+    Put16(pucBuf, (uint16_t)(ulValue >> 16));
+    Put16(&pucBuf[2], (uint16_t)(ulValue & 0xFFFF));
+}//end Put32
+
+static void Put64(uint8_t *pucBuf, uint64_t ullValue)
+{
+    Put32(pucBuf, (uint32_t)(ullValue >> 32));
+    Put32(&pucBuf[4], (uint32_t)(ullValue & 0xFFFFFFFFu));
+}//end Put64
+
+static uint16_t Get16(const uint8_t *pucBuf)
+{
+    return (uint16_t)((pucBuf[0] << 8) | pucBuf[1]);
+}//end Get16
+
+static uint32_t Get32(const uint8_t *pucBuf)
+{
+    return ((uint32_t)Get16(pucBuf) << 16) | Get16(&pucBuf[2]);
+}//end Get32
+
+static uint64_t Get64(const uint8_t *pucBuf)
+{
+    return ((uint64_t)Get32(pucBuf) << 32) | Get32(&pucBuf[4]);
+}//end Get64
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
@@ -0,0 +1,127 @@
+//! @addtogroup TCPServerReplica
+//! @{
+//
+//****************************************************************************
+//! @file replica.h
+//! @brief This contains the prototypes, macros, constants or global variables
+//!        for hot standby replication of the register tables.
+//!
+//!        A primary streams changed ranges of the tables to standby servers
+//!        over TCP. Frames start with a header in network byte order:
+//!        - type(1 byte, enum ReplicaFrame), number of ranges(1 byte),
+//!          payload length(2 bytes)
+//!        - sequence(4 bytes), of the last delta contained in the state
+//!        - epoch(8 bytes), chosen by primary at start
+//!        - primary time when changes were taken(8 bytes, us since epoch)
+//!        Payload holds ranges, region(1 byte, enum UserRegion), reserved(1
+//!        byte), byte offset(2 bytes), length(2 bytes) and bytes of table.
+//!
+//!        A standby sends a hello frame with epoch and sequence it holds.
+//!        The primary answers with the deltas after that sequence if it still
+//!        keeps them, else with a snapshot of all tables, then streams deltas.
+//!        Deltas are taken by comparing tables against a shadow copy, so
+//!        writes of clients and of processes sharing the image are replicated.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//
+//****************************************************************************
+#ifndef REPLICA_H
+#define REPLICA_H
+
+//****************************************************************************
+//                           Includes
+//****************************************************************************
+
+//****************************************************************************
+//                           Constants and typedefs
+//****************************************************************************
+//! @brief Period of taking deltas in us, deltas of a period are batched
+#define RP_PERIOD_US             (1000u)
+//! @brief Heartbeat of idle primary in ms
+#define RP_HEARTBEAT_MS          (100u)
+//! @brief Standby reconnects after primary is silent this long in ms
+#define RP_TIMEOUT_MS            (1000u)
+//! @brief Largest payload of a frame
+#define RP_MAX_PAYLOAD           (1024u)
+//! @brief Delta frames kept for catch-up of a reconnecting standby
+#define RP_BACKLOG_FRAMES        (256u)
+//! @brief Standby servers of a primary
+#define RP_MAX_STANDBYS          (4u)
+//! @brief Tables are compared in blocks of this many bytes
+#define RP_BLOCK_LEN             (32u)
+
+//! @brief Role of server
+enum ReplicaRole
+{
+    eROLE_NONE    = 0,              //!< No replication
+    eROLE_PRIMARY = 1,              //!< Streams deltas to standbys
+    eROLE_STANDBY = 2,              //!< Applies deltas, tables read only for clients
+};
+
+//! @brief Type of frame
+enum ReplicaFrame
+{
+    eFRAME_HELLO     = 1,           //!< Standby to primary, held epoch and sequence
+    eFRAME_SNAPSHOT  = 2,           //!< Whole tables at sequence
+    eFRAME_DELTA     = 3,           //!< Changed ranges, sequence is incremented by one
+    eFRAME_HEARTBEAT = 4,           //!< Primary alive, current sequence
+};
+
+//! @brief Replication statistics
+typedef struct ReplicaStats
+{
+    uint8_t  ucRole;                                //!<enum ReplicaRole
+    uint8_t  ucNumOfStandbys;                       //!<Standbys connected to primary
+    bool     bConnected;                            //!<Standby follows a primary
+    uint32_t ulSequence;                            //!<Last delta taken or applied
+    uint32_t ulNumOfFrames;                         //!<Frames sent or applied
+    uint32_t ulNumOfSnapshots;                      //!<Snapshots sent or received
+    uint32_t ulNumOfCatchUps;                       //!<Primary, standbys caught up from backlog
+    uint32_t ulLagUs;                               //!<Standby, age of last applied delta
+    uint32_t ulMaxLagUs;                            //!<Standby, largest age of an applied delta
+} ReplicaStats_t;
+
+//****************************************************************************
+//                           Global variables
+//****************************************************************************
+
+//****************************************************************************
+//                           Global Functions
+//****************************************************************************
+//
+//! @brief Start streaming deltas to standby servers from own thread
+//! @param[in]  usPort  TCP port standbys connect to
+//! @return     bool    true - started, false - error
+//
+bool rp_StartPrimary(uint16_t usPort);
+
+//
+//! @brief Follow a primary from own thread, tables are read only for clients
+//!        until promoted
+//! @param[in]  pcHost        Primary IPv4 address
+//! @param[in]  usPort        Replication port of primary
+//! @param[in]  usServePort   Replication port served after promotion, 0 - none
+//! @return     bool          true - started, false - error
+//
+bool rp_StartStandby(const char *pcHost, uint16_t usPort, uint16_t usServePort);
+
+//
+//! @brief Promote standby to primary with its current tables, async signal safe.
+//!        Takes effect within RP_HEARTBEAT_MS.
+//! @param[in]  None
+//! @return     None
+//
+void rp_Promote(void);
+
+//
+//! @brief Read replication statistics, may be called from any thread
+//! @param[out] ptStats  Statistics
+//! @return     None
+//
+void rp_GetStats(ReplicaStats_t *ptStats);
+
+#endif // REPLICA_H
+//****************************************************************************
+//                             End of file
+//****************************************************************************
+//! @}
@@ -13,25 +13,258 @@
 //                           Includes
 //****************************************************************************/
 //standard header files
-#include "../tcp_server/tcp.h"
-
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+#endif
 //user defined header files
 #include "mbap_conf.h"
+#include "mbap.h"
+#include "mbap_hist.h"
+#include "mbap_subscription.h"
+#include "mbap_debug.h"
+#include "pool.h"
 #include "tcp.h"
+#include "capture.h"
 
 //****************************************************************************/
 //                           Defines and typedefs
 //****************************************************************************/
-#define BUFF_SIZE_IN_BYTES   256
+//MBAP Header(7 bytes) + PDU(253 bytes)
+#define BUFF_SIZE_IN_BYTES   260
+//Receive buffer holds pipelined queries while in flight limit is reached
+#define RX_BUFF_SIZE         (4 * BUFF_SIZE_IN_BYTES)
+//Receive buffer of extended framing holds a query and start of the next one
+#define EXT_RX_BUFF_SIZE     (2u * TCP_EXT_ADU_LEN)
 #define PORT_NUMBER          502
+//connections waiting for accept while server is busy
+#define LISTEN_BACKLOG       SOMAXCONN
+//socket events handled per server loop iteration
+#define MAX_EVENTS           256
+//event ids of listening sockets and completion pipe, connections use their index
+#define LISTEN_EVENT_ID      (TCP_MAX_CONNECTIONS)
+#define COMPLETION_EVENT_ID  (TCP_MAX_CONNECTIONS + 1u)
+#define LISTEN_EXT_EVENT_ID  (TCP_MAX_CONNECTIONS + 2u)
+#define NUM_OF_EVENT_IDS     (TCP_MAX_CONNECTIONS + 3u)
+//objects taken from heap at once when a pool is empty
+#define CONNECTIONS_PER_SLAB 256u
+#define BUFFERS_PER_SLAB     32u
+#define EXT_BUFFERS_PER_SLAB 4u
+//MBAP length field counts bytes following it, header up to length field is 6 bytes
+#define MBAP_LEN_OFFSET      4
+#define MBAP_PREFIX_LEN      6
+//arrival times of received data chunks kept per connection
+#define RX_STAMPS            16
+//token bucket holds tokens scaled by us per second
+#define TOKEN_SCALE          1000000u
+#define UNIT_ID_OFFSET       6
+#define FUNCTION_CODE_OFFSET 7
+//statistics written by server thread only, read by any thread
+#define STATS_ADD(x, v)      __atomic_store_n(&(x), (x) + (v), __ATOMIC_RELAXED)
+//receive and transmit times taken by kernel, else by server
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+#define KERNEL_TIMESTAMPS    1
+#else
+#define KERNEL_TIMESTAMPS    0
+#endif
+//ready sockets are reported by epoll, else poll scans all sockets
+#ifdef __linux__
+#define USE_EPOLL            1
+#else
+#define USE_EPOLL            0
+#endif
+
+//! @brief State of a transaction slot
+enum TransactionState
+{
+    eTRANSACTION_FREE    = 0,
+    eTRANSACTION_QUEUED  = 1,
+    eTRANSACTION_PENDING = 2,
+    eTRANSACTION_DONE    = 3
+};
+
+//! @brief Result of sending a message on a connection
+enum SendResult
+{
+    eSEND_DONE    = 0,              //!< Sent or unsent rest queued for writable socket
+    eSEND_BLOCKED = 1,              //!< Socket buffer full, nothing sent
+    eSEND_FAILED  = 2               //!< Socket error or no memory, connection closed
+};
+
+struct Connection;
+
+//! @brief Transaction in flight on a connection
+typedef struct Transaction
+{
+    struct Connection *ptConnection;                //!<Connection the transaction belongs to
+    struct Transaction *ptNextDone;                 //!<Next in completion stack
+    struct Transaction *ptNextQueued;               //!<Next in lane queue
+    uint8_t           ucSlot;                       //!<Index in transactions of connection
+    uint8_t           ucState;                      //!<enum TransactionState
+    uint32_t          ulSequence;                   //!<Order of arrival on connection
+    uint64_t          ullArrival;                   //!<Arrival time of query, us
+    uint64_t          ullStart;                     //!<Start of processing, us
+    uint8_t           ucLane;                       //!<Priority lane
+    ModbusRequest_t   tRequest;                     //!<Request
+    uint8_t           aucAdu[];                     //!<Query followed by response, sized by pool
+} Transaction_t;
+
+//! @brief Arrival time of received data
+typedef struct RxStamp
+{
+    uint32_t ulRxEnd;                               //!<Received byte count after data
+    uint64_t ullTime;                               //!<Arrival time, us
+} RxStamp_t;
+
+//! @brief Response waiting for its transmit time
+typedef struct TxStamp
+{
+    uint32_t ulTxEnd;                               //!<Sent byte count after response
+    uint64_t ullSent;                               //!<Time response was sent to socket, us
+    uint64_t ullArrival;                            //!<Arrival time of query, us
+} TxStamp_t;
+
+//! @brief Receive buffer, attached while a connection holds unprocessed data
+typedef struct RxBuffer
+{
+    uint8_t   ucRxStampHead;                        //!<Oldest arrival time
+    uint8_t   ucNumOfRxStamps;                      //!<Number of arrival times
+    RxStamp_t atRxStamps[RX_STAMPS];                //!<Arrival times of data in buffer
+    uint8_t   aucData[];                            //!<Received data, sized by pool
+} RxBuffer_t;
+
+//! @brief Unsent rest of a response or notification, attached while the
+//!        socket buffer is full
+typedef struct TxBuffer
+{
+    uint16_t  usOffset;                             //!<First unsent byte
+    uint16_t  usLength;                             //!<Bytes in buffer
+    uint8_t   aucData[];                            //!<Data, sized by pool
+} TxBuffer_t;
+
+//! @brief Responses waiting for transmit time, attached while responses wait
+typedef struct TxStamps
+{
+    uint8_t   ucHead;                               //!<Oldest response
+    uint8_t   ucCount;                              //!<Number of responses
+    TxStamp_t atStamps[TCP_MAX_IN_FLIGHT];          //!<Responses waiting for transmit time
+} TxStamps_t;
+
+//! @brief Socket event
+typedef struct Event
+{
+    uint32_t ulId;                                  //!<Connection index, listening socket or COMPLETION_EVENT_ID
+    short    sEvents;                               //!<POLLIN, POLLHUP and POLLERR
+} Event_t;
+
+//! @brief Token bucket
+typedef struct TokenBucket
+{
+    uint64_t ullTokens;                             //!<Tokens scaled by TOKEN_SCALE
+    uint64_t ullRefillTime;                         //!<Time of last refill, us
+} TokenBucket_t;
+
+//! @brief Rate limit of a client and function code class, fields are
+//!        written and read atomically under sequence m_ulRateLimitSeq
+typedef struct RateLimit
+{
+    uint32_t      ulClientIp;                       //!<Client address, 0 - other clients
+    uint8_t       ucClass;                          //!<Function code class
+    uint32_t      ulRate;                           //!<Queries per second, 0 - free entry
+    uint32_t      ulBurst;                          //!<Bucket size in queries
+    uint32_t      ulSerial;                         //!<Changes when entry is taken by another limit
+} RateLimit_t;
+
+//! @brief Bucket shared by connections of a client with own rate limit
+typedef struct ClientBucket
+{
+    TokenBucket_t tBucket;                          //!<Token bucket
+    uint32_t      ulSerial;                         //!<Serial of rate limit bucket belongs to
+} ClientBucket_t;
+
+//! @brief Priority lane
+typedef struct Lane
+{
+    bool               bStrict;                     //!<Strict priority, else weighted
+    uint8_t            ucWeight;                    //!<Queries per round of weighted lane
+    Transaction_t      *ptHead;                     //!<Oldest queued transaction
+    Transaction_t      *ptTail;                     //!<Newest queued transaction
+    uint32_t           ulCount;                     //!<Number of queued transactions
+    LatencyHistogram_t tLatency;                    //!<Latency until response is sent, us
+} Lane_t;
+
+//! @brief Rule classifying queries into a lane
+typedef struct LaneRule
+{
+    uint32_t ulClientIp;                            //!<Client address, 0 - any
+    uint16_t usUnitId;                              //!<Unit id, TCP_ANY_UNIT_ID - any
+    uint8_t  ucFunctionCode;                        //!<Function code, 0 - any
+    uint8_t  ucLane;                                //!<Lane
+} LaneRule_t;
+
+//! @brief Local address of connections routed to an extension key
+typedef struct ExtKeyRoute
+{
+    uint32_t ulLocalIp;                             //!<Local address, host byte order
+    uint16_t usExtKey;                              //!<Extension key of units
+} ExtKeyRoute_t;
+
+//! @brief Client connection, buffers are attached only while data is in flight
+typedef struct Connection
+{
+    int             iSocket;                        //!<Client socket
+    uint32_t        ulSlot;                         //!<Index in connection table, event id of socket
+    uint32_t        ulConnectionId;                 //!<Number of connection since start, reported by probes
+    uint32_t        ulClientIp;                     //!<Client address, host byte order
+    bool            bInUse;                         //!<Connection slot in use
+    bool            bKernelStamps;                  //!<Kernel takes receive and transmit times
+    bool            bReady;                         //!<Budget used up, queries may wait in receive buffer
+    bool            bQueued;                        //!<In list of connections served without socket event
+    bool            bClosing;                       //!<Socket closed while requests pending
+    bool            bRxPaused;                      //!<Receive buffer full, socket not polled
+    bool            bTxBlocked;                     //!<Socket buffer full, polled for writing
+    bool            bStrictOrder;                   //!<Send responses in order of queries
+    bool            bExtended;                      //!<Accepted on extended framing port
+    uint8_t         ucMaxInFlight;                  //!<Limit of outstanding requests
+    uint8_t         ucNumOfActive;                  //!<Transactions attached
+    uint8_t         ucNumOfPending;                 //!<Transactions waiting for completion
+    uint16_t        usRxLen;                        //!<Bytes in receive buffer
+    uint16_t        usExtKey;                       //!<Extension key of units addressed, 0 - unit id table
+    uint64_t        ullThrottledUntil;              //!<Rate limited until time, us, 0 - not limited
+    TokenBucket_t   atBuckets[eNUM_OF_CLASSES];     //!<Buckets of limits for other clients
+    uint32_t        ulNextSequence;                 //!<Sequence of next query
+    uint32_t        ulSendSequence;                 //!<Sequence of next response in strict order
+    uint32_t        ulRxTotal;                      //!<Bytes received on connection
+    uint32_t        ulTxTotal;                      //!<Bytes sent on connection
+    RxBuffer_t      *ptRxBuf;                       //!<Receive buffer, NULL - no data received
+    TxStamps_t      *ptTxStamps;                    //!<Responses waiting for transmit time, NULL - none
+    TxBuffer_t      *ptTxBuf;                       //!<Unsent rest of a message, NULL - none
+    struct Connection *ptNextReady;                 //!<Next in list of connections served without socket event
+    Transaction_t   *aptTransactions[TCP_MAX_IN_FLIGHT];//!<Transactions in flight, NULL - slot free
+} Connection_t;
+
+//idle connection state must stay within its budget
+typedef char ConnectionBudgetCheck_t[(sizeof(Connection_t) <= TCP_CONNECTION_BUDGET) ? 1 : -1];
+//bytes in receive buffer are counted in 16 bits
+typedef char ExtRxBuffCheck_t[(EXT_RX_BUFF_SIZE <= 0xFFFFu) ? 1 : -1];
 
 //****************************************************************************/
 //                           external variables
@@ -40,108 +273,863 @@
 //****************************************************************************/
 //                           Local variables
 //****************************************************************************/
-
+//connection state is taken from slabs, table holds open connections only
+static Connection_t    *m_aptConnections[TCP_MAX_CONNECTIONS];
+//stack of free connection slots
+static uint32_t        m_aulFreeSlots[TCP_MAX_CONNECTIONS];
+static uint32_t        m_ulNumOfFreeSlots;
+//connections served without socket event, budget used up or rate limited
+static Connection_t    *m_ptReadyHead;
+static Connection_t    *m_ptReadyTail;
+//socket data is read into scratch buffer, copied only if a query is incomplete,
+//sized for extended framing
+static RxBuffer_t      *m_ptScratchBuf;
+//connection state, used by server thread only and not locked
+static ObjectPool_t    m_tConnectionPool;
+//buffers shared by all connections, attached while data is in flight
+static ObjectPool_t    m_tRxBufferPool;
+static ObjectPool_t    m_tTransactionPool;
+static ObjectPool_t    m_tTxStampsPool;
+static ObjectPool_t    m_tTxBufferPool;
+//buffers of connections accepted on extended framing port
+static ObjectPool_t    m_tExtRxBufferPool;
+static ObjectPool_t    m_tExtTransactionPool;
+static ObjectPool_t    m_tExtTxBufferPool;
+#if USE_EPOLL
+static int             m_iEpoll = -1;
+#else
+//index of connection + 3, listening sockets and completion pipe first
+static struct pollfd   m_atPollFds[NUM_OF_EVENT_IDS];
+static nfds_t          m_ulNumOfPollFds;
+#endif
+//settings applied to new connections
+static uint8_t         m_ucMaxInFlight  = TCP_MAX_IN_FLIGHT;
+static bool            m_bStrictOrder   = false;
+static uint8_t         m_ucBudget       = TCP_DEFAULT_BUDGET;
+static uint16_t        m_usPort         = PORT_NUMBER;
+//port of extended framing, 0 - not listening
+static uint16_t        m_usExtPort;
+//rate limits, set from any thread, lock is taken by setters only, server
+//thread reads entries while sequence is even and unchanged
+static pthread_mutex_t m_tRateLimitLock = PTHREAD_MUTEX_INITIALIZER;
+static RateLimit_t     m_atRateLimits[TCP_MAX_RATE_LIMITS];
+static uint8_t         m_ucNumOfRateLimits;
+static uint32_t        m_ulRateLimitSeq;
+static uint32_t        m_ulRateLimitSerial;
+//buckets of rate limit entries, server thread only
+static ClientBucket_t  m_atClientBuckets[TCP_MAX_RATE_LIMITS];
+//service deadline of requests, 0 - no deadline
+static uint64_t        m_ullDeadlineUs;
+static bool            m_bReplyBusy;
+//written by server thread only, read by any thread
+static TcpStats_t      m_tStats;
+//latency of request stages, us
+static LatencyHistogram_t m_atStages[eNUM_OF_STAGES];
+//priority lanes, configured before server starts
+static Lane_t          m_atLanes[TCP_MAX_LANES];
+static LaneRule_t      m_atLaneRules[TCP_MAX_LANE_RULES];
+static uint8_t         m_ucNumOfLaneRules;
+//extension keys of local addresses, configured before server starts
+static ExtKeyRoute_t   m_atExtKeys[TCP_MAX_EXT_KEYS];
+static uint8_t         m_ucNumOfExtKeys;
+//weighted lane served and queries left in its round
+static uint8_t         m_ucWeightedLane;
+static uint8_t         m_ucLaneCredit;
+//completion pipe wakes up server loop, 0 - read end, 1 - write end
+static int             m_aiCompletionPipe[2] = {-1, -1};
+//Lock free stack of transactions completed by user function threads
+static Transaction_t   *m_ptCompleted;
 
 //****************************************************************************/
 //                           Local Functions
 //****************************************************************************/
+//
+//! @brief Open non blocking listening socket
+//! @param[in]  usPort  TCP port
+//! @return     int     Socket, -1 - failed
+//
+static int OpenListener(uint16_t usPort);
+
+//
+//! @brief Find extension key of local address a connection was accepted on
+//! @param[in]  iSocket   Connected socket
+//! @return     uint16_t  Extension key, 0 - unit id table
+//
+static uint16_t FindExtKey(int iSocket);
+
+//
+//! @brief Accept all pending client connections
+//! @param[in]  iListenSocket  Listening socket
+//! @param[in]  bExtended      true - connections use extended framing
+//! @return     None
+//
+static void AcceptConnections(int iListenSocket, bool bExtended);
+
+//
+//! @brief Receive data of a connection and process complete queries
+//! @param[in]  ptConnection  Client connection
+//! @return     None
+//
+static void ReceiveQueries(Connection_t *ptConnection);
+
+//
+//! @brief Queue complete queries of receive buffer into priority lanes until
+//!        in flight limit or budget is reached
+//! @param[in]  ptConnection  Client connection
+//! @return     None
+//
+static void ProcessQueries(Connection_t *ptConnection);
+
+//
+//! @brief Take token of rate limit for query
+//! @param[in]  ptConnection  Client connection
+//! @param[in]  pucQuery      Query
+//! @return     bool          true - query may be processed, false - connection throttled
+//
+static bool TakeToken(Connection_t *ptConnection, const uint8_t *pucQuery);
+
+//
+//! @brief Refill token bucket and take a token
+//! @param[in]  ptBucket  Token bucket
+//! @param[in]  ulRate    Queries per second
+//! @param[in]  ulBurst   Bucket size in queries
+//! @param[in]  ullNow    Current time, us
+//! @return     uint64_t  0 - token taken, else time in us until a token is available
+//
+static uint64_t TakeBucketToken(TokenBucket_t *ptBucket, uint32_t ulRate, uint32_t ulBurst, uint64_t ullNow);
+
+//
+//! @brief Write rate limit entry field by field for readers not taking lock
+//! @param[in]  ucIndex  Entry
+//! @param[in]  ptLimit  Rate limit
+//! @return     None
+//
+static void StoreRateLimit(uint8_t ucIndex, const RateLimit_t *ptLimit);
+
+//
+//! @brief Read rate limit entry field by field, valid if sequence is unchanged
+//! @param[in]   ucIndex  Entry
+//! @param[out]  ptLimit  Rate limit
+//! @return      None
+//
+static void LoadRateLimit(uint8_t ucIndex, RateLimit_t *ptLimit);
+
+//
+//! @brief Poll timeout for connections with work left or rate limit
+//! @param[in]  None
+//! @return     int  Timeout in ms, -1 - wait for events
+//
+static int GetPollTimeout(void);
+
+//
+//! @brief Add connection to list of connections served without socket event
+//! @param[in]  ptConnection  Client connection
+//! @return     None
+//
+static void QueueReady(Connection_t *ptConnection);
+
+//
+//! @brief Serve connections whose budget was used up or whose rate limit expired
+//! @param[in]  None
+//! @return     None
+//
+static void ServeReady(void);
+
+//
+//! @brief Start watching a socket for received data
+//! @param[in]  iSocket  Socket
+//! @param[in]  ulId     Event id
+//! @return     bool     true - socket watched
+//
+static bool WatchSocket(int iSocket, uint32_t ulId);
+
+//
+//! @brief Stop or resume watching a connection for received data, errors are
+//!        still reported
+//! @param[in]  ptConnection  Client connection
+//! @param[in]  bPaused       true - data is not read
+//! @return     None
+//
+static void PauseSocket(Connection_t *ptConnection, bool bPaused);
+
+//
+//! @brief Apply receive pause and blocked transmit of a connection to
+//!        watched socket events
+//! @param[in]  ptConnection  Client connection
+//! @return     None
+//
+static void UpdateSocketEvents(const Connection_t *ptConnection);
+
+//
+//! @brief Stop watching a socket before it is closed
+//! @param[in]  iSocket  Socket
+//! @param[in]  ulId     Event id
+//! @return     None
+//
+static void UnwatchSocket(int iSocket, uint32_t ulId);
+
+//
+//! @brief Wait for socket events
+//! @param[out] ptEvents     Events
+//! @param[in]  iMaxEvents   Size of events
+//! @param[in]  iTimeoutMs   Timeout, -1 - wait forever
+//! @return     int          Number of events, -1 on error
+//
+static int WaitEvents(Event_t *ptEvents, int iMaxEvents, int iTimeoutMs);
+
+//
+//! @brief Size of receive buffer of a connection
+//! @param[in]  ptConnection  Client connection
+//! @return     uint16_t      Size in bytes
+//
+static uint16_t RxBufferSize(const Connection_t *ptConnection);
+
+//
+//! @brief Keep unprocessed data of scratch buffer in an own receive buffer
+//! @param[in]  ptConnection  Client connection
+//! @return     bool          false - no memory, connection closed
+//
+static bool KeepRxBuffer(Connection_t *ptConnection);
+
+//
+//! @brief Detach receive buffer when all data is processed
+//! @param[in]  ptConnection  Client connection
+//! @return     None
+//
+static void ReleaseRxBuffer(Connection_t *ptConnection);
+
+//
+//! @brief Attach a transaction to a free slot of connection
+//! @param[in]  ptConnection    Client connection
+//! @return     Transaction_t*  Transaction, NULL - no memory
+//
+static Transaction_t *AllocTransaction(Connection_t *ptConnection);
+
+//
+//! @brief Detach transaction from its connection
+//! @param[in]  ptTransaction  Transaction
+//! @return     None
+//
+static void FreeTransaction(Transaction_t *ptTransaction);
+
+//
+//! @brief Release all attached buffers, connection and its slot are freed
+//!        when list of connections served without socket event is served
+//! @param[in]  ptConnection  Client connection
+//! @return     None
+//
+static void ReleaseConnection(Connection_t *ptConnection);
+
+//
+//! @brief Free released connection and its slot
+//! @param[in]  ptConnection  Client connection
+//! @return     None
+//
+static void FreeConnection(Connection_t *ptConnection);
+
+//
+//! @brief Raise limit of open files up to hard limit for many connections
+//! @param[in]  None
+//! @return     None
+//
+static void RaiseFileLimit(void);
+
+//
+//! @brief Check if a transaction with same transaction id is in flight
+//! @param[in]  ptConnection  Client connection
+//! @param[in]  pucQuery      Query
+//! @return     bool          true - transaction id in use
+//
+static bool TransactionIdInUse(const Connection_t *ptConnection, const uint8_t *pucQuery);
+
+//
+//! @brief Receive data into receive buffer and record time data waited in socket
+//! @param[in]  ptConnection  Client connection
+//! @param[out] pullArrival   Arrival time of data, us
+//! @return     ssize_t       Result of recvmsg
+//
+static ssize_t ReceiveData(Connection_t *ptConnection, uint64_t *pullArrival);
+
+//
+//! @brief Record arrival time of received data
+//! @param[in]  ptConnection  Client connection
+//! @param[in]  usLength      Number of received bytes
+//! @param[in]  ullArrival    Arrival time, us
+//! @return     None
+//
+static void StampRxData(Connection_t *ptConnection, uint16_t usLength, uint64_t ullArrival);
+
+//
+//! @brief Enable kernel receive and transmit timestamps of a client socket
+//! @param[in]  iSocket  Client socket
+//! @return     bool     true - kernel takes times, false - not supported
+//
+static bool EnableTimestamps(int iSocket);
+
+//
+//! @brief Read transmit times from socket error queue
+//! @param[in]  ptConnection  Client connection
+//! @return     bool          true - error queue held transmit times
+//
+static bool ReadTxStamps(Connection_t *ptConnection);
+
+#if KERNEL_TIMESTAMPS
+//
+//! @brief Record stages of responses transmitted up to a byte count
+//! @param[in]  ptConnection  Client connection
+//! @param[in]  ulTxEnd       Sent byte count after last transmitted byte
+//! @param[in]  ullTxTime     Transmit time, us
+//! @return     None
+//
+static void TakeTxStamp(Connection_t *ptConnection, uint32_t ulTxEnd, uint64_t ullTxTime);
+
+//
+//! @brief Convert kernel time to time of monotonic clock
+//! @param[in]  ptKernelTime  Kernel time, realtime clock
+//! @param[in]  ullNow        Current time of monotonic clock, us
+//! @return     uint64_t      Time of monotonic clock, us
+//
+static uint64_t KernelTimeToUs(const struct timespec *ptKernelTime, uint64_t ullNow);
+#endif//KERNEL_TIMESTAMPS
+
+//
+//! @brief Record latency of a request stage
+//! @param[in]  ucStage  Stage(enum TimingStage)
+//! @param[in]  ullFrom  Start of stage, us
+//! @param[in]  ullTo    End of stage, us
+//! @return     None
+//
+static void RecordStage(uint8_t ucStage, uint64_t ullFrom, uint64_t ullTo);
+
+//
+//! @brief Read percentiles of a latency histogram
+//! @param[in]  ptHist   Latency histogram, written by server thread
+//! @param[out] ptStats  Latency statistics
+//! @return     None
+//
+static void ReadLatency(const LatencyHistogram_t *ptHist, TcpLaneStats_t *ptStats);
+
+//
+//! @brief Take arrival time of query at start of receive buffer
+//! @param[in]  ptConnection  Client connection
+//! @param[in]  usAduLen      Query length
+//! @return     uint64_t      Arrival time of last byte of query, us
+//
+static uint64_t TakeRxTime(Connection_t *ptConnection, uint16_t usAduLen);
+
+//
+//! @brief Classify query into a priority lane
+//! @param[in]  ptConnection  Client connection
+//! @param[in]  pucQuery      Query
+//! @return     uint8_t       Lane
+//
+static uint8_t ClassifyQuery(const Connection_t *ptConnection, const uint8_t *pucQuery);
+
+//
+//! @brief Process queued queries, strict lanes first, then weighted lanes
+//! @param[in]  None
+//! @return     None
+//
+static void DispatchQueries(void);
+
+//
+//! @brief Lane to take next query from
+//! @param[in]  None
+//! @return     Lane_t*  Lane, NULL if all lanes are empty
+//
+static Lane_t *GetNextLane(void);
+
+//
+//! @brief Submit queued transaction to modbus application
+//! @param[in]  ptTransaction  Queued transaction
+//! @return     None
+//
+static void SubmitTransaction(Transaction_t *ptTransaction);
+
+//
+//! @brief Check if query waited longer than service deadline
+//! @param[in]  ptTransaction  Transaction of query
+//! @return     bool           true - deadline expired
+//
+static bool DeadlineExpired(const Transaction_t *ptTransaction);
+
+//
+//! @brief Shed request whose deadline expired
+//! @param[in]  ptRequest  Modbus request
+//! @return     uint16_t   Response Length, 0 - dropped
+//
+static uint16_t ShedRequest(ModbusRequest_t *ptRequest);
+
+//
+//! @brief Current time of monotonic clock
+//! @param[in]  None
+//! @return     uint64_t  Time in us
+//
+static uint64_t GetTimeUs(void);
+
+//
+//! @brief Send responses of done transactions, in order of queries in strict mode
+//! @param[in]  ptConnection  Client connection
+//! @return     None
+//
+static void SendResponses(Connection_t *ptConnection);
+
+//
+//! @brief Send response of a transaction and free transaction slot
+//! @param[in]  ptTransaction  Done transaction
+//! @return     bool           false - socket buffer full, transaction is kept
+//!                            until socket is writable
+//
+static bool SendResponse(Transaction_t *ptTransaction);
+
+//
+//! @brief Send message, unsent rest of a partly sent message is queued and
+//!        socket is watched for writing until it is sent
+//! @param[in]  ptConnection  Client connection
+//! @param[in]  pucData       Message
+//! @param[in]  usLength      Length of message
+//! @return     uint8_t       enum SendResult
+//
+static uint8_t SendData(Connection_t *ptConnection, const uint8_t *pucData, uint16_t usLength);
+
+//
+//! @brief Send queued rest of a message when socket is writable, then
+//!        responses held back meanwhile
+//! @param[in]  ptConnection  Client connection
+//! @return     bool          false - connection closed
+//
+static bool FlushTxBuffer(Connection_t *ptConnection);
+
+//
+//! @brief Set socket non blocking
+//! @param[in]  iSocket  Socket
+//! @return     None
+//
+static void SetNonBlocking(int iSocket);
+
+//
+//! @brief Close client socket, slot is released once no request is pending
+//! @param[in]  ptConnection  Client connection
+//! @return     None
+//
+static void CloseConnection(Connection_t *ptConnection);
+
+//
+//! @brief Capture accepted connection with client address
+//! @param[in]  ptConnection  Connection
+//! @return     None
+//
+static void RecordOpen(const Connection_t *ptConnection);
+
+//
+//! @brief Called by modbus application when a pending request is done,
+//!        may be called from any thread, pushes transaction on completion stack
+//! @param[in]  ptRequest  Completed request
+//! @return     None
+//
+static void RequestDone(ModbusRequest_t *ptRequest);
+
+//
+//! @brief Send responses of requests completed by user functions
+//! @param[in]  None
+//! @return     None
+//
+static void HandleCompletions(void);
+
+//
+//! @brief Send change notification of a subscription, called by modbus
+//!        application while subscriptions are polled by server thread
+//! @param[in]  pvConnection  Connection of subscriber
+//! @param[in]  pucAdu        Notification
+//! @param[in]  usLen         Bytes of notification
+//! @return     bool          true - sent or connection closed, false - socket buffer full
+//
+static bool Notify(void *pvConnection, const uint8_t *pucAdu, uint16_t usLen);
 
 //****************************************************************************/
 //                    G L O B A L  F U N C T I O N S
 //****************************************************************************/
+void tcp_SetTransactionMode(uint8_t ucMaxInFlight, bool bStrictOrder)
+{
+    if (0 == ucMaxInFlight)
+    {
+        ucMaxInFlight = 1;
+    }
+    else if (ucMaxInFlight > TCP_MAX_IN_FLIGHT)
+    {
+        ucMaxInFlight = TCP_MAX_IN_FLIGHT;
+    }
+
+    m_ucMaxInFlight = ucMaxInFlight;
+    m_bStrictOrder  = bStrictOrder;
+}//end tcp_SetTransactionMode
+
+void tcp_SetDeadline(uint32_t ulDeadlineMs, bool bReplyBusy)
+{
+    m_ullDeadlineUs = (uint64_t)ulDeadlineMs * 1000u;
+    m_bReplyBusy    = bReplyBusy;
+}//end tcp_SetDeadline
+
+void tcp_SetBudget(uint8_t ucBudget)
+{
+    m_ucBudget = (0 == ucBudget) ? 1u : ucBudget;
+}//end tcp_SetBudget
+
+void tcp_SetPort(uint16_t usPort)
+{
+    m_usPort = usPort;
+}//end tcp_SetPort
+
+void tcp_SetExtendedPort(uint16_t usPort)
+{
+    m_usExtPort = usPort;
+}//end tcp_SetExtendedPort
+
+bool tcp_AddExtKey(uint32_t ulLocalIp, uint16_t usExtKey)
+{
+    if (m_ucNumOfExtKeys >= TCP_MAX_EXT_KEYS)
+    {
+        return false;
+    }
+
+    m_atExtKeys[m_ucNumOfExtKeys].ulLocalIp = ulLocalIp;
+    m_atExtKeys[m_ucNumOfExtKeys].usExtKey  = usExtKey;
+    m_ucNumOfExtKeys++;
+
+    return true;
+}//end tcp_AddExtKey
+
+bool tcp_SetRateLimit(uint32_t ulClientIp, uint8_t ucClass, uint32_t ulRate, uint32_t ulBurst)
+{
+    RateLimit_t tLimit;
+    uint8_t     ucIndex = TCP_MAX_RATE_LIMITS;
+    uint8_t     ucFree  = TCP_MAX_RATE_LIMITS;
+    uint8_t     ucCount = 0;
+
+    pthread_mutex_lock(&m_tRateLimitLock);
+
+    for (ucCount = 0; ucCount < m_ucNumOfRateLimits; ucCount++)
+    {
+        const RateLimit_t *ptEntry = &m_atRateLimits[ucCount];
+
+        if (0 == ptEntry->ulRate)
+        {
+            ucFree = (TCP_MAX_RATE_LIMITS == ucFree) ? ucCount : ucFree;
+        }
+        else if ((ptEntry->ulClientIp == ulClientIp) && (ptEntry->ucClass == ucClass))
+        {
+            ucIndex = ucCount;
+            break;
+        }
+    }
+
+    if ((TCP_MAX_RATE_LIMITS == ucIndex) && (0 != ulRate))
+    {
+        //entries keep their place, bucket of server thread stays with its limit
+        ucIndex = (TCP_MAX_RATE_LIMITS != ucFree) ? ucFree : m_ucNumOfRateLimits;
+
+        if (ucIndex >= TCP_MAX_RATE_LIMITS)
+        {
+            pthread_mutex_unlock(&m_tRateLimitLock);
+            return false;
+        }
+
+        m_ulRateLimitSerial++;
+    }
+
+    if (TCP_MAX_RATE_LIMITS != ucIndex)
+    {
+        tLimit.ulClientIp = ulClientIp;
+        tLimit.ucClass    = ucClass;
+        tLimit.ulRate     = ulRate;
+        tLimit.ulBurst    = (0 == ulBurst) ? 1u : ulBurst;
+        //new limit gets new serial, its bucket starts full
+        tLimit.ulSerial   = (0 != m_atRateLimits[ucIndex].ulRate) ? m_atRateLimits[ucIndex].ulSerial : m_ulRateLimitSerial;
+
+        //odd sequence while entry is written
+        __atomic_store_n(&m_ulRateLimitSeq, m_ulRateLimitSeq + 1u, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        StoreRateLimit(ucIndex, &tLimit);
+
+        if (ucIndex == m_ucNumOfRateLimits)
+        {
+            __atomic_store_n(&m_ucNumOfRateLimits, (uint8_t)(ucIndex + 1u), __ATOMIC_RELAXED);
+        }
+
+        //removed entries at end are not scanned
+        while ((0 != m_ucNumOfRateLimits) && (0 == m_atRateLimits[m_ucNumOfRateLimits - 1u].ulRate))
+        {
+            __atomic_store_n(&m_ucNumOfRateLimits, (uint8_t)(m_ucNumOfRateLimits - 1u), __ATOMIC_RELAXED);
+        }
+
+        __atomic_store_n(&m_ulRateLimitSeq, m_ulRateLimitSeq + 1u, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&m_tRateLimitLock);
+
+    return true;
+}//end tcp_SetRateLimit
+
+bool tcp_SetLane(uint8_t ucLane, bool bStrict, uint8_t ucWeight)
+{
+    if (ucLane >= TCP_MAX_LANES)
+    {
+        return false;
+    }
+
+    m_atLanes[ucLane].bStrict  = bStrict;
+    m_atLanes[ucLane].ucWeight = ucWeight;
+
+    return true;
+}//end tcp_SetLane
+
+bool tcp_AddLaneRule(uint32_t ulClientIp, uint16_t usUnitId, uint8_t ucFunctionCode, uint8_t ucLane)
+{
+    LaneRule_t *ptRule = NULL;
+
+    if ((ucLane >= TCP_MAX_LANES) || (m_ucNumOfLaneRules >= TCP_MAX_LANE_RULES))
+    {
+        return false;
+    }
+
+    ptRule                 = &m_atLaneRules[m_ucNumOfLaneRules++];
+    ptRule->ulClientIp     = ulClientIp;
+    ptRule->usUnitId       = usUnitId;
+    ptRule->ucFunctionCode = ucFunctionCode;
+    ptRule->ucLane         = ucLane;
+
+    return true;
+}//end tcp_AddLaneRule
+
+bool tcp_GetLaneStats(uint8_t ucLane, TcpLaneStats_t *ptStats)
+{
+    if (ucLane >= TCP_MAX_LANES)
+    {
+        return false;
+    }
+
+    ReadLatency(&m_atLanes[ucLane].tLatency, ptStats);
+    ptStats->ulQueueDepth = __atomic_load_n(&m_atLanes[ucLane].ulCount, __ATOMIC_RELAXED);
+
+    return true;
+}//end tcp_GetLaneStats
+
+bool tcp_GetStageStats(uint8_t ucStage, TcpLaneStats_t *ptStats)
+{
+    if (ucStage >= eNUM_OF_STAGES)
+    {
+        return false;
+    }
+
+    ReadLatency(&m_atStages[ucStage], ptStats);
+    ptStats->ulQueueDepth = 0;
+
+    return true;
+}//end tcp_GetStageStats
+
+void tcp_GetStats(TcpStats_t *ptStats)
+{
+    ptStats->ulNumOfDropped = __atomic_load_n(&m_tStats.ulNumOfDropped, __ATOMIC_RELAXED);
+    ptStats->ulNumOfBusy    = __atomic_load_n(&m_tStats.ulNumOfBusy, __ATOMIC_RELAXED);
+    ptStats->ulNumOfAccepted    = __atomic_load_n(&m_tStats.ulNumOfAccepted, __ATOMIC_RELAXED);
+    ptStats->ulNumOfConnections = __atomic_load_n(&m_tStats.ulNumOfConnections, __ATOMIC_RELAXED);
+    ptStats->ulNumOfQueries     = __atomic_load_n(&m_tStats.ulNumOfQueries, __ATOMIC_RELAXED);
+    ptStats->ulNumOfPending     = __atomic_load_n(&m_tStats.ulNumOfPending, __ATOMIC_RELAXED);
+    ptStats->ulNumOfRxBuffers   = __atomic_load_n(&m_tStats.ulNumOfRxBuffers, __ATOMIC_RELAXED);
+    ptStats->ulNumOfTransactions = __atomic_load_n(&m_tStats.ulNumOfTransactions, __ATOMIC_RELAXED);
+    ptStats->ulNumOfNotifications = __atomic_load_n(&m_tStats.ulNumOfNotifications, __ATOMIC_RELAXED);
+}//end tcp_GetStats
+
+bool tcp_GetPoolStats(uint8_t ucPool, const char **ppcName, PoolStats_t *ptStats)
+{
+    static const ObjectPool_t *aptPools[eNUM_OF_POOLS] = {&m_tConnectionPool, &m_tRxBufferPool,
+                                                          &m_tTransactionPool, &m_tTxStampsPool,
+                                                          &m_tExtRxBufferPool, &m_tExtTransactionPool,
+                                                          &m_tTxBufferPool, &m_tExtTxBufferPool};
+
+    if (ucPool >= eNUM_OF_POOLS)
+    {
+        return false;
+    }
+
+    //pool names are set before server loop starts
+    *ppcName = (NULL == aptPools[ucPool]->pcName) ? "" : aptPools[ucPool]->pcName;
+    pl_GetStats(aptPools[ucPool], ptStats);
+
+    return true;
+}//end tcp_GetPoolStats
+
 void tcp_Init(void)
 {
-    uint8_t pucQuery[BUFF_SIZE_IN_BYTES];
-    uint8_t pucResponse[BUFF_SIZE_IN_BYTES];
-    int16_t sReturn;
-    socklen_t len;
     int sock_desc;
-	int temp_sock_desc;
-    struct sockaddr_in server;
-	struct sockaddr_in client;
+    int iExtSocket = -1;
+    Event_t atEvents[MAX_EVENTS];
+    uint32_t ulIndex = 0;
 
-    memset(&server, 0, sizeof(server));
-    memset(&client, 0, sizeof(client));
+    for (ulIndex = 0; ulIndex < TCP_MAX_CONNECTIONS; ulIndex++)
+    {
+        //lowest slot is taken first
+        m_aulFreeSlots[ulIndex] = TCP_MAX_CONNECTIONS - 1u - ulIndex;
+    }
+
+    m_ulNumOfFreeSlots = TCP_MAX_CONNECTIONS;
+    RaiseFileLimit();
+
+    pl_Init(&m_tConnectionPool, "connection", sizeof(Connection_t), CONNECTIONS_PER_SLAB, false);
+    pl_Init(&m_tRxBufferPool, "rx_buffer", offsetof(RxBuffer_t, aucData) + RX_BUFF_SIZE,
+            BUFFERS_PER_SLAB, true);
+    pl_Init(&m_tTransactionPool, "transaction", offsetof(Transaction_t, aucAdu) + 2u * BUFF_SIZE_IN_BYTES,
+            BUFFERS_PER_SLAB, true);
+    pl_Init(&m_tTxStampsPool, "tx_stamps", sizeof(TxStamps_t), BUFFERS_PER_SLAB, true);
+    pl_Init(&m_tTxBufferPool, "tx_buffer", offsetof(TxBuffer_t, aucData) + BUFF_SIZE_IN_BYTES,
+            BUFFERS_PER_SLAB, true);
+    pl_Init(&m_tExtRxBufferPool, "ext_rx_buffer", offsetof(RxBuffer_t, aucData) + EXT_RX_BUFF_SIZE,
+            EXT_BUFFERS_PER_SLAB, true);
+    pl_Init(&m_tExtTransactionPool, "ext_transaction", offsetof(Transaction_t, aucAdu) + 2u * TCP_EXT_ADU_LEN,
+            EXT_BUFFERS_PER_SLAB, true);
+    pl_Init(&m_tExtTxBufferPool, "ext_tx_buffer", offsetof(TxBuffer_t, aucData) + TCP_EXT_ADU_LEN,
+            EXT_BUFFERS_PER_SLAB, true);
+
+    m_ptScratchBuf = (RxBuffer_t *)malloc(offsetof(RxBuffer_t, aucData) + EXT_RX_BUFF_SIZE);
+
+    if (NULL == m_ptScratchBuf)
+    {
+        printf("Out of memory");
+        return;
+    }
 
-    sock_desc = socket(AF_INET, SOCK_STREAM, 0);
+    sock_desc = OpenListener(m_usPort);
 
     if (sock_desc == -1)
     {
-        printf("Error in socket creation");
         return;
     }
 
-    server.sin_family      = AF_INET;
-    server.sin_addr.s_addr = htonl(INADDR_ANY);
-    server.sin_port        = htons(PORT_NUMBER);
+    if (0 != m_usExtPort)
+    {
+        iExtSocket = OpenListener(m_usExtPort);
 
-    sReturn = bind(sock_desc, (struct sockaddr*)&server, sizeof(server));
+        if (-1 == iExtSocket)
+        {
+            return;
+        }
+    }
 
-    if (-1 == sReturn)
+    if (-1 == pipe(m_aiCompletionPipe))
     {
-        printf("Error in binding");
+        printf("Error in pipe creation");
         return;
     }
 
-    sReturn = listen(sock_desc, 20);
+    SetNonBlocking(m_aiCompletionPipe[0]);
 
-    if (-1 == sReturn)
+#if USE_EPOLL
+    m_iEpoll = epoll_create1(0);
+#else
+    for (ulIndex = 0; ulIndex < NUM_OF_EVENT_IDS; ulIndex++)
     {
-        printf("Error in listening");
+        m_atPollFds[ulIndex].fd = -1;
+    }
+#endif
+
+    if (!WatchSocket(sock_desc, LISTEN_EVENT_ID) || !WatchSocket(m_aiCompletionPipe[0], COMPLETION_EVENT_ID) ||
+        ((-1 != iExtSocket) && !WatchSocket(iExtSocket, LISTEN_EXT_EVENT_ID)))
+    {
+        printf("Error in event setup");
         return;
     }
 
-    len = sizeof(client);
+    //subscriptions are served by this thread like requests
+    mbap_SubscriptionInit(Notify);
 
-    CLIENT_REQUEST:
-    while ( (temp_sock_desc = accept(sock_desc, (struct sockaddr*)&client, &len)) )
+    while (1)
     {
-        printf("\nClient connected\n");
+        bool bAccept      = false;
+        bool bAcceptExt   = false;
+        bool bCompletions = false;
+        int  iNumOfEvents = WaitEvents(atEvents, MAX_EVENTS, GetPollTimeout());
+        int  iCount       = 0;
+
+        if ((iNumOfEvents < 0) && (EINTR != errno))
+        {
+            printf("poll failed");
+            break;
+        }
+
+        //connections queued in previous iteration, after their queries were dispatched
+        ServeReady();
 
-        while (1)
+        //only connections with events are visited
+        for (iCount = 0; iCount < iNumOfEvents; iCount++)
         {
-            uint16_t usResponseLength = 0;
+            Connection_t *ptConnection = NULL;
+            short        sRevents      = atEvents[iCount].sEvents;
 
-            sReturn = recv(temp_sock_desc, pucQuery, BUFF_SIZE_IN_BYTES, 0);
+            if (LISTEN_EVENT_ID == atEvents[iCount].ulId)
+            {
+                bAccept = true;
+                continue;
+            }
 
-            if (0 == sReturn)
+            if (LISTEN_EXT_EVENT_ID == atEvents[iCount].ulId)
             {
-                printf("\nConnection closed\n");
-                close(temp_sock_desc);
-                break;
+                bAcceptExt = true;
+                continue;
             }
-            else if (sReturn < 0)
+
+            if (COMPLETION_EVENT_ID == atEvents[iCount].ulId)
             {
-                printf("\nConnection reset\n");
-                close(temp_sock_desc);
-                break;
+                bCompletions = true;
+                continue;
+            }
+
+            ptConnection = m_aptConnections[atEvents[iCount].ulId];
+
+            //connection released by an earlier event of this iteration
+            if ((NULL == ptConnection) || !ptConnection->bInUse || ptConnection->bClosing)
+            {
+                continue;
             }
-            else
+
+            if ((sRevents & POLLERR) && ptConnection->bKernelStamps && ReadTxStamps(ptConnection))
             {
-                //read successfully
+                //error queue held transmit times, a socket error is reported again
+                sRevents &= (short)~POLLERR;
             }
 
-            usResponseLength = mbap_ProcessRequest(pucQuery, sReturn, pucResponse);
+            if ((sRevents & POLLOUT) && !FlushTxBuffer(ptConnection))
+            {
+                continue;
+            }
 
-            if (0 != usResponseLength)
+            if (sRevents & (POLLIN | POLLHUP | POLLERR))
             {
-                sReturn = send(temp_sock_desc, pucResponse, usResponseLength, 0);
+                ReceiveQueries(ptConnection);
+            }
+        }//end for
 
-                if (sReturn < 0)
-                {
-                    printf("\nsend failed\n");
-                }
-            }//end if
-        }//end while
-    }//end while
+        if (bCompletions)
+        {
+            HandleCompletions();
+        }
 
+        //slots of connections closed above are reused only after their events are handled
+        if (bAccept)
+        {
+            AcceptConnections(sock_desc, false);
+        }
 
-    if (temp_sock_desc < 0)
-    {
-        printf("accpet failed");
-        goto CLIENT_REQUEST;
-    }
+        if (bAcceptExt)
+        {
+            AcceptConnections(iExtSocket, true);
+        }
 
+        //queries of all connections are in lanes now, high priority first
+        DispatchQueries();
+
+        //writes of this iteration and of producers are pushed to subscribers
+        mbap_SubscriptionPoll(GetTimeUs() / 1000u);
+    }//end while
 
     exit(0);
 }//end TcpInit
@@ -149,6 +1137,1564 @@ void tcp_Init(void)
 //****************************************************************************/
 //                           L O C A L  F U N C T I O N S
 //****************************************************************************/
+static int OpenListener(uint16_t usPort)
+{
+    struct sockaddr_in server;
+    int                iSocket = socket(AF_INET, SOCK_STREAM, 0);
+    int                iOption = 1;
+
+    if (iSocket == -1)
+    {
+        printf("Error in socket creation");
+        return -1;
+    }
+
+    (void)setsockopt(iSocket, SOL_SOCKET, SO_REUSEADDR, &iOption, sizeof(iOption));
+    SetNonBlocking(iSocket);
+
+    memset(&server, 0, sizeof(server));
+    server.sin_family      = AF_INET;
+    server.sin_addr.s_addr = htonl(INADDR_ANY);
+    server.sin_port        = htons(usPort);
+
+    if (-1 == bind(iSocket, (struct sockaddr*)&server, sizeof(server)))
+    {
+        printf("Error in binding");
+        close(iSocket);
+        return -1;
+    }
+
+    if (-1 == listen(iSocket, LISTEN_BACKLOG))
+    {
+        printf("Error in listening");
+        close(iSocket);
+        return -1;
+    }
+
+    return iSocket;
+}//end OpenListener
+
+static uint16_t FindExtKey(int iSocket)
+{
+    struct sockaddr_in tLocal;
+    socklen_t          tLen    = sizeof(tLocal);
+    uint8_t            ucCount = 0;
+
+    if ((0 == m_ucNumOfExtKeys) || (0 != getsockname(iSocket, (struct sockaddr *)&tLocal, &tLen)))
+    {
+        return 0;
+    }
+
+    for (ucCount = 0; ucCount < m_ucNumOfExtKeys; ucCount++)
+    {
+        if (m_atExtKeys[ucCount].ulLocalIp == ntohl(tLocal.sin_addr.s_addr))
+        {
+            return m_atExtKeys[ucCount].usExtKey;
+        }
+    }
+
+    return 0;
+}//end FindExtKey
+
+static void AcceptConnections(int iListenSocket, bool bExtended)
+{
+    struct sockaddr_in client;
+    socklen_t          len = sizeof(client);
+    int                temp_sock_desc;
+
+    while ((temp_sock_desc = accept(iListenSocket, (struct sockaddr*)&client, &len)) >= 0)
+    {
+        uint32_t     ulIndex       = 0;
+        Connection_t *ptConnection = NULL;
+
+        if (0 == m_ulNumOfFreeSlots)
+        {
+            printf("\nToo many connections\n");
+            close(temp_sock_desc);
+            continue;
+        }
+
+        ulIndex      = m_aulFreeSlots[m_ulNumOfFreeSlots - 1u];
+        ptConnection = (Connection_t *)pl_Alloc(&m_tConnectionPool);
+
+        SetNonBlocking(temp_sock_desc);
+
+        if (NULL == ptConnection)
+        {
+            printf("\nOut of memory\n");
+            close(temp_sock_desc);
+            continue;
+        }
+
+        if (!WatchSocket(temp_sock_desc, ulIndex))
+        {
+            printf("\nsocket not watched\n");
+            close(temp_sock_desc);
+            pl_Free(&m_tConnectionPool, ptConnection);
+            continue;
+        }
+
+        m_ulNumOfFreeSlots--;
+        m_aptConnections[ulIndex] = ptConnection;
+        memset(ptConnection, 0, sizeof(Connection_t));
+        ptConnection->iSocket       = temp_sock_desc;
+        ptConnection->ulSlot        = ulIndex;
+        ptConnection->ulClientIp    = ntohl(client.sin_addr.s_addr);
+        ptConnection->bInUse        = true;
+        ptConnection->ucMaxInFlight = m_ucMaxInFlight;
+        ptConnection->bStrictOrder  = m_bStrictOrder;
+        ptConnection->bExtended     = bExtended;
+        ptConnection->bKernelStamps = EnableTimestamps(temp_sock_desc);
+        ptConnection->usExtKey      = FindExtKey(temp_sock_desc);
+        STATS_ADD(m_tStats.ulNumOfAccepted, 1);
+        ptConnection->ulConnectionId = m_tStats.ulNumOfAccepted;
+        STATS_ADD(m_tStats.ulNumOfConnections, 1);
+        RecordOpen(ptConnection);
+
+        printf("\nClient connected\n");
+        len = sizeof(client);
+    }
+
+    if ((EAGAIN != errno) && (EWOULDBLOCK != errno))
+    {
+        printf("accpet failed");
+    }
+}//end AcceptConnections
+
+static void ReceiveQueries(Connection_t *ptConnection)
+{
+    ssize_t  sReturn    = 0;
+    uint64_t ullArrival = 0;
+
+    if (ptConnection->bClosing)
+    {
+        return;
+    }
+
+    if (ptConnection->usRxLen >= RxBufferSize(ptConnection))
+    {
+        //client pipelines more than fits while in flight limit is reached,
+        //stop reading until a pending request is done
+        PauseSocket(ptConnection, true);
+        return;
+    }
+
+    if (NULL == ptConnection->ptRxBuf)
+    {
+        //idle connection, complete queries are taken from scratch buffer
+        m_ptScratchBuf->ucRxStampHead   = 0;
+        m_ptScratchBuf->ucNumOfRxStamps = 0;
+        ptConnection->ptRxBuf           = m_ptScratchBuf;
+    }
+
+    sReturn = ReceiveData(ptConnection, &ullArrival);
+
+    if (0 == sReturn)
+    {
+        printf("\nConnection closed\n");
+        CloseConnection(ptConnection);
+        return;
+    }
+    else if (sReturn < 0)
+    {
+        if ((EAGAIN != errno) && (EWOULDBLOCK != errno))
+        {
+            printf("\nConnection reset\n");
+            CloseConnection(ptConnection);
+            return;
+        }
+    }
+    else
+    {
+        //read successfully
+        MBT_PROBE2(rx, ptConnection->ulConnectionId, sReturn);
+        ptConnection->usRxLen += (uint16_t)sReturn;
+        StampRxData(ptConnection, (uint16_t)sReturn, ullArrival);
+        ProcessQueries(ptConnection);
+    }
+
+    if (!ptConnection->bClosing)
+    {
+        (void)KeepRxBuffer(ptConnection);
+    }
+}//end ReceiveQueries
+
+static void ProcessQueries(Connection_t *ptConnection)
+{
+    uint8_t ucNumOfQueries = 0;
+
+    ptConnection->bReady            = false;
+    ptConnection->ullThrottledUntil = 0;
+    //receive buffer is drained below, read socket again
+    PauseSocket(ptConnection, false);
+
+    while (!ptConnection->bClosing &&
+           (ptConnection->ucNumOfActive < ptConnection->ucMaxInFlight) &&
+           (ptConnection->usRxLen >= MBAP_PREFIX_LEN))
+    {
+        Transaction_t   *ptTransaction = NULL;
+        ModbusRequest_t *ptRequest     = NULL;
+        Lane_t          *ptLane        = NULL;
+        uint8_t         *pucRxData     = ptConnection->ptRxBuf->aucData;
+        uint8_t         *pucQuery      = NULL;
+        uint16_t        usMaxAduLen    = ptConnection->bExtended ? TCP_EXT_ADU_LEN : BUFF_SIZE_IN_BYTES;
+        uint16_t        usAduLen       = 0;
+
+        usAduLen  = (uint16_t)(pucRxData[MBAP_LEN_OFFSET] << 8);
+        usAduLen |= (uint16_t)(pucRxData[MBAP_LEN_OFFSET + 1]);
+        usAduLen += MBAP_PREFIX_LEN;
+
+        if ((usAduLen <= MBAP_PREFIX_LEN + 1) || (usAduLen > usMaxAduLen))
+        {
+            printf("\nInvalid frame length\n");
+            CloseConnection(ptConnection);
+            return;
+        }
+
+        if (ptConnection->usRxLen < usAduLen)
+        {
+            //wait for rest of query
+            return;
+        }
+
+        if (TransactionIdInUse(ptConnection, pucRxData))
+        {
+            //client reuses transaction id, wait until response is sent
+            //so that responses stay unambiguous
+            return;
+        }
+
+        if (ucNumOfQueries >= m_ucBudget)
+        {
+            //let other connections go first, continue in next iteration
+            ptConnection->bReady = true;
+            QueueReady(ptConnection);
+            return;
+        }
+
+        if (!TakeToken(ptConnection, pucRxData))
+        {
+            //served again when rate limit expires
+            QueueReady(ptConnection);
+            return;
+        }
+
+        ptTransaction = AllocTransaction(ptConnection);
+
+        if (NULL == ptTransaction)
+        {
+            printf("\nOut of memory\n");
+            CloseConnection(ptConnection);
+            return;
+        }
+
+        ucNumOfQueries++;
+
+        pucQuery                  = ptTransaction->aucAdu;
+        ptTransaction->ullArrival = TakeRxTime(ptConnection, usAduLen);
+        memcpy(pucQuery, pucRxData, usAduLen);
+        cp_Record(ptTransaction->ullArrival, ptConnection->ulConnectionId, eCAPTURE_QUERY,
+                  pucQuery, usAduLen);
+        ptConnection->usRxLen -= usAduLen;
+        memmove(pucRxData, &pucRxData[usAduLen], ptConnection->usRxLen);
+        ReleaseRxBuffer(ptConnection);
+
+        ptTransaction->ulSequence   = ptConnection->ulNextSequence++;
+        ptTransaction->ucState      = eTRANSACTION_QUEUED;
+        ptTransaction->ucLane       = ClassifyQuery(ptConnection, pucQuery);
+        ptConnection->ucNumOfPending++;
+
+        ptRequest = &ptTransaction->tRequest;
+        memset(ptRequest, 0, sizeof(ModbusRequest_t));
+        ptRequest->pucQuery    = pucQuery;
+        ptRequest->pucResponse = &pucQuery[usMaxAduLen];
+        ptRequest->usQueryLen  = usAduLen;
+        ptRequest->usMaxAduLen = ptConnection->bExtended ? TCP_EXT_ADU_LEN : 0;
+        ptRequest->usExtKey    = ptConnection->usExtKey;
+        ptRequest->ptfnDone    = RequestDone;
+        ptRequest->pvContext   = ptTransaction;
+        ptRequest->ulConnectionId = ptConnection->ulConnectionId;
+        ptRequest->pvConnection   = ptConnection;
+
+        MBT_PROBE_QUERY(query__received, ptConnection->ulConnectionId, pucQuery);
+
+        ptLane = &m_atLanes[ptTransaction->ucLane];
+        ptTransaction->ptNextQueued = NULL;
+
+        if (NULL == ptLane->ptTail)
+        {
+            ptLane->ptHead = ptTransaction;
+        }
+        else
+        {
+            ptLane->ptTail->ptNextQueued = ptTransaction;
+        }
+
+        ptLane->ptTail = ptTransaction;
+        STATS_ADD(ptLane->ulCount, 1);
+        STATS_ADD(m_tStats.ulNumOfQueries, 1);
+    }//end while
+}//end ProcessQueries
+
+static uint8_t ClassifyQuery(const Connection_t *ptConnection, const uint8_t *pucQuery)
+{
+    uint8_t ucCount = 0;
+
+    for (ucCount = 0; ucCount < m_ucNumOfLaneRules; ucCount++)
+    {
+        const LaneRule_t *ptRule = &m_atLaneRules[ucCount];
+
+        if (((0 == ptRule->ulClientIp) || (ptRule->ulClientIp == ptConnection->ulClientIp)) &&
+            ((TCP_ANY_UNIT_ID == ptRule->usUnitId) || (ptRule->usUnitId == pucQuery[UNIT_ID_OFFSET])) &&
+            ((0 == ptRule->ucFunctionCode) || (ptRule->ucFunctionCode == pucQuery[FUNCTION_CODE_OFFSET])))
+        {
+            return ptRule->ucLane;
+        }
+    }
+
+    return 0;
+}//end ClassifyQuery
+
+static void DispatchQueries(void)
+{
+    Lane_t *ptLane = NULL;
+
+    while (NULL != (ptLane = GetNextLane()))
+    {
+        Transaction_t *ptTransaction = ptLane->ptHead;
+
+        ptLane->ptHead = ptTransaction->ptNextQueued;
+
+        if (NULL == ptLane->ptHead)
+        {
+            ptLane->ptTail = NULL;
+        }
+
+        STATS_ADD(ptLane->ulCount, -1);
+
+        SubmitTransaction(ptTransaction);
+    }
+}//end DispatchQueries
+
+static Lane_t *GetNextLane(void)
+{
+    uint8_t ucLane = 0;
+
+    for (ucLane = 0; ucLane < TCP_MAX_LANES; ucLane++)
+    {
+        if (m_atLanes[ucLane].bStrict && (0 != m_atLanes[ucLane].ulCount))
+        {
+            return &m_atLanes[ucLane];
+        }
+    }
+
+    //weighted round robin, visit every lane once plus current lane again
+    for (ucLane = 0; ucLane <= TCP_MAX_LANES; ucLane++)
+    {
+        Lane_t *ptLane = &m_atLanes[m_ucWeightedLane];
+
+        if (!ptLane->bStrict && (0 != ptLane->ulCount) && (0 != m_ucLaneCredit))
+        {
+            m_ucLaneCredit--;
+            return ptLane;
+        }
+
+        m_ucWeightedLane = (uint8_t)((m_ucWeightedLane + 1u) % TCP_MAX_LANES);
+        m_ucLaneCredit   = (0 == m_atLanes[m_ucWeightedLane].ucWeight) ? 1u : m_atLanes[m_ucWeightedLane].ucWeight;
+    }
+
+    return NULL;
+}//end GetNextLane
+
+static void SubmitTransaction(Transaction_t *ptTransaction)
+{
+    Connection_t    *ptConnection    = ptTransaction->ptConnection;
+    ModbusRequest_t *ptRequest       = &ptTransaction->tRequest;
+    uint16_t        usResponseLength = 0;
+
+    if (ptConnection->bClosing)
+    {
+        FreeTransaction(ptTransaction);
+        ptConnection->ucNumOfPending--;
+        CloseConnection(ptConnection);
+        return;
+    }
+
+    ptTransaction->ucState  = eTRANSACTION_PENDING;
+    ptTransaction->ullStart = GetTimeUs();
+    RecordStage(eSTAGE_QUEUE, ptTransaction->ullArrival, ptTransaction->ullStart);
+
+    if (DeadlineExpired(ptTransaction))
+    {
+        usResponseLength = ShedRequest(ptRequest);
+    }
+    else
+    {
+        usResponseLength = mbap_SubmitRequest(ptRequest);
+    }
+
+    if (MBAP_RESPONSE_PENDING == usResponseLength)
+    {
+        STATS_ADD(m_tStats.ulNumOfPending, 1);
+    }
+    else
+    {
+        //no response for invalid query, usResponseLen is 0
+        ptRequest->usResponseLen = usResponseLength;
+        ptTransaction->ucState   = eTRANSACTION_DONE;
+        ptConnection->ucNumOfPending--;
+        SendResponses(ptConnection);
+    }
+}//end SubmitTransaction
+
+static bool TakeToken(Connection_t *ptConnection, const uint8_t *pucQuery)
+{
+    uint8_t     ucFunctionCode = pucQuery[FUNCTION_CODE_OFFSET];
+    uint8_t     ucClass        = eCLASS_READ;
+    uint64_t    ullNow         = 0;
+    uint64_t    ullWait        = 0;
+    uint32_t    ulSeq          = 0;
+    uint8_t     ucNumOfLimits  = 0;
+    uint8_t     ucCount        = 0;
+    uint8_t     ucLimit        = TCP_MAX_RATE_LIMITS;
+    bool        bDefault       = false;
+    RateLimit_t tEntry;
+    RateLimit_t tLimit;
+    RateLimit_t tDefault;
+
+    if (0 == __atomic_load_n(&m_ucNumOfRateLimits, __ATOMIC_RELAXED))
+    {
+        return true;
+    }
+
+    if ((5 == ucFunctionCode) || (6 == ucFunctionCode) ||
+        (15 == ucFunctionCode) || (16 == ucFunctionCode))
+    {
+        ucClass = eCLASS_WRITE;
+    }
+
+    //entries are copied without lock, copy is retried when a setter wrote meanwhile
+    do
+    {
+        ulSeq         = __atomic_load_n(&m_ulRateLimitSeq, __ATOMIC_ACQUIRE);
+        ucNumOfLimits = __atomic_load_n(&m_ucNumOfRateLimits, __ATOMIC_RELAXED);
+        ucLimit       = TCP_MAX_RATE_LIMITS;
+        bDefault      = false;
+
+        for (ucCount = 0; ucCount < ucNumOfLimits; ucCount++)
+        {
+            LoadRateLimit(ucCount, &tEntry);
+
+            if ((0 == tEntry.ulRate) || (tEntry.ucClass != ucClass))
+            {
+                continue;
+            }
+
+            if (tEntry.ulClientIp == ptConnection->ulClientIp)
+            {
+                tLimit  = tEntry;
+                ucLimit = ucCount;
+                break;
+            }
+
+            if (0 == tEntry.ulClientIp)
+            {
+                tDefault = tEntry;
+                bDefault = true;
+            }
+        }//end for
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((0 != (ulSeq & 1u)) || (ulSeq != __atomic_load_n(&m_ulRateLimitSeq, __ATOMIC_RELAXED)));
+
+    ullNow = GetTimeUs();
+
+    if (TCP_MAX_RATE_LIMITS != ucLimit)
+    {
+        ClientBucket_t *ptBucket = &m_atClientBuckets[ucLimit];
+
+        if (ptBucket->ulSerial != tLimit.ulSerial)
+        {
+            //entry taken by another limit, its bucket starts full
+            memset(&ptBucket->tBucket, 0, sizeof(TokenBucket_t));
+            ptBucket->ulSerial = tLimit.ulSerial;
+        }
+
+        ullWait = TakeBucketToken(&ptBucket->tBucket, tLimit.ulRate, tLimit.ulBurst, ullNow);
+    }
+    else if (bDefault)
+    {
+        //other clients are limited per connection
+        ullWait = TakeBucketToken(&ptConnection->atBuckets[ucClass], tDefault.ulRate, tDefault.ulBurst, ullNow);
+    }
+
+    if (0 != ullWait)
+    {
+        ptConnection->ullThrottledUntil = ullNow + ullWait;
+        return false;
+    }
+
+    return true;
+}//end TakeToken
+
+static uint64_t TakeBucketToken(TokenBucket_t *ptBucket, uint32_t ulRate, uint32_t ulBurst, uint64_t ullNow)
+{
+    uint64_t ullMaxTokens = (uint64_t)ulBurst * TOKEN_SCALE;
+
+    if (0 == ptBucket->ullRefillTime)
+    {
+        //first use of bucket, starts full
+        ptBucket->ullTokens = ullMaxTokens;
+    }
+    else
+    {
+        ptBucket->ullTokens += (ullNow - ptBucket->ullRefillTime) * ulRate;
+    }
+
+    ptBucket->ullRefillTime = ullNow;
+
+    if (ptBucket->ullTokens > ullMaxTokens)
+    {
+        ptBucket->ullTokens = ullMaxTokens;
+    }
+
+    if (ptBucket->ullTokens < TOKEN_SCALE)
+    {
+        //round up so that token is available when connection is served again
+        return ((TOKEN_SCALE - ptBucket->ullTokens) + ulRate - 1u) / ulRate;
+    }
+
+    ptBucket->ullTokens -= TOKEN_SCALE;
+
+    return 0;
+}//end TakeBucketToken
+
+static void StoreRateLimit(uint8_t ucIndex, const RateLimit_t *ptLimit)
+{
+    RateLimit_t *ptEntry = &m_atRateLimits[ucIndex];
+
+    __atomic_store_n(&ptEntry->ulClientIp, ptLimit->ulClientIp, __ATOMIC_RELAXED);
+    __atomic_store_n(&ptEntry->ucClass, ptLimit->ucClass, __ATOMIC_RELAXED);
+    __atomic_store_n(&ptEntry->ulRate, ptLimit->ulRate, __ATOMIC_RELAXED);
+    __atomic_store_n(&ptEntry->ulBurst, ptLimit->ulBurst, __ATOMIC_RELAXED);
+    __atomic_store_n(&ptEntry->ulSerial, ptLimit->ulSerial, __ATOMIC_RELAXED);
+}//end StoreRateLimit
+
+static void LoadRateLimit(uint8_t ucIndex, RateLimit_t *ptLimit)
+{
+    const RateLimit_t *ptEntry = &m_atRateLimits[ucIndex];
+
+    ptLimit->ulClientIp = __atomic_load_n(&ptEntry->ulClientIp, __ATOMIC_RELAXED);
+    ptLimit->ucClass    = __atomic_load_n(&ptEntry->ucClass, __ATOMIC_RELAXED);
+    ptLimit->ulRate     = __atomic_load_n(&ptEntry->ulRate, __ATOMIC_RELAXED);
+    ptLimit->ulBurst    = __atomic_load_n(&ptEntry->ulBurst, __ATOMIC_RELAXED);
+    ptLimit->ulSerial   = __atomic_load_n(&ptEntry->ulSerial, __ATOMIC_RELAXED);
+}//end LoadRateLimit
+
+static int GetPollTimeout(void)
+{
+    uint64_t           ullNow       = 0;
+    uint64_t           ullEarliest  = 0;
+    const Connection_t *ptConnection = NULL;
+    int                iTimeout     = -1;
+    int                iThrottled   = 0;
+
+    //only connections waiting for budget or rate limit are in list
+    for (ptConnection = m_ptReadyHead; NULL != ptConnection; ptConnection = ptConnection->ptNextReady)
+    {
+        if (!ptConnection->bInUse || ptConnection->bClosing)
+        {
+            //released in next iteration
+            return 0;
+        }
+
+        if (ptConnection->bReady)
+        {
+            return 0;
+        }
+
+        if ((0 != ptConnection->ullThrottledUntil) &&
+            ((0 == ullEarliest) || (ptConnection->ullThrottledUntil < ullEarliest)))
+        {
+            ullEarliest = ptConnection->ullThrottledUntil;
+        }
+    }//end for
+
+    //subscribed ranges are checked periodically while there are subscriptions
+    iTimeout = (0 != mbap_SubscriptionCount()) ? TCP_NOTIFY_PERIOD_MS : -1;
+
+    if (0 == ullEarliest)
+    {
+        return iTimeout;
+    }
+
+    ullNow = GetTimeUs();
+
+    //round up, poll timeout is in ms
+    iThrottled = (ullEarliest <= ullNow) ? 0 : (int)((ullEarliest - ullNow + 999u) / 1000u);
+
+    return ((-1 == iTimeout) || (iThrottled < iTimeout)) ? iThrottled : iTimeout;
+}//end GetPollTimeout
+
+static void QueueReady(Connection_t *ptConnection)
+{
+    if (ptConnection->bQueued)
+    {
+        return;
+    }
+
+    ptConnection->bQueued     = true;
+    ptConnection->ptNextReady = NULL;
+
+    if (NULL == m_ptReadyTail)
+    {
+        m_ptReadyHead = ptConnection;
+    }
+    else
+    {
+        m_ptReadyTail->ptNextReady = ptConnection;
+    }
+
+    m_ptReadyTail = ptConnection;
+}//end QueueReady
+
+static void ServeReady(void)
+{
+    Connection_t *ptConnection = m_ptReadyHead;
+    uint64_t     ullNow        = GetTimeUs();
+
+    //connections queued while serving are served in next iteration
+    m_ptReadyHead = NULL;
+    m_ptReadyTail = NULL;
+
+    while (NULL != ptConnection)
+    {
+        Connection_t *ptNext = ptConnection->ptNextReady;
+
+        ptConnection->bQueued = false;
+
+        if (!ptConnection->bInUse)
+        {
+            //released in previous iteration
+            FreeConnection(ptConnection);
+        }
+        else if (ptConnection->bClosing)
+        {
+        }
+        else if (ptConnection->bReady ||
+                 ((0 != ptConnection->ullThrottledUntil) && (ullNow >= ptConnection->ullThrottledUntil)))
+        {
+            ProcessQueries(ptConnection);
+        }
+        else if (0 != ptConnection->ullThrottledUntil)
+        {
+            QueueReady(ptConnection);
+        }
+
+        ptConnection = ptNext;
+    }//end while
+}//end ServeReady
+
+static bool WatchSocket(int iSocket, uint32_t ulId)
+{
+#if USE_EPOLL
+    struct epoll_event tEvent;
+
+    memset(&tEvent, 0, sizeof(tEvent));
+    tEvent.events   = EPOLLIN;
+    tEvent.data.u32 = ulId;
+
+    return 0 == epoll_ctl(m_iEpoll, EPOLL_CTL_ADD, iSocket, &tEvent);
+#else
+    nfds_t ulIndex = (ulId + 3u) % NUM_OF_EVENT_IDS;
+
+    m_atPollFds[ulIndex].fd     = iSocket;
+    m_atPollFds[ulIndex].events = POLLIN;
+
+    if (ulIndex >= m_ulNumOfPollFds)
+    {
+        m_ulNumOfPollFds = ulIndex + 1u;
+    }
+
+    return true;
+#endif
+}//end WatchSocket
+
+static void PauseSocket(Connection_t *ptConnection, bool bPaused)
+{
+    if (bPaused == ptConnection->bRxPaused)
+    {
+        return;
+    }
+
+    ptConnection->bRxPaused = bPaused;
+    UpdateSocketEvents(ptConnection);
+}//end PauseSocket
+
+static void UpdateSocketEvents(const Connection_t *ptConnection)
+{
+    uint32_t ulId = ptConnection->ulSlot;
+
+#if USE_EPOLL
+    struct epoll_event tEvent;
+
+    memset(&tEvent, 0, sizeof(tEvent));
+    tEvent.events   = (ptConnection->bRxPaused ? 0 : EPOLLIN) | (ptConnection->bTxBlocked ? EPOLLOUT : 0);
+    tEvent.data.u32 = ulId;
+    (void)epoll_ctl(m_iEpoll, EPOLL_CTL_MOD, ptConnection->iSocket, &tEvent);
+#else
+    m_atPollFds[ulId + 3u].events = (short)((ptConnection->bRxPaused ? 0 : POLLIN) |
+                                            (ptConnection->bTxBlocked ? POLLOUT : 0));
+#endif
+}//end UpdateSocketEvents
+
+static void UnwatchSocket(int iSocket, uint32_t ulId)
+{
+#if USE_EPOLL
+    (void)ulId;
+    (void)epoll_ctl(m_iEpoll, EPOLL_CTL_DEL, iSocket, NULL);
+#else
+    (void)iSocket;
+    m_atPollFds[ulId + 3u].fd = -1;
+#endif
+}//end UnwatchSocket
+
+static int WaitEvents(Event_t *ptEvents, int iMaxEvents, int iTimeoutMs)
+{
+#if USE_EPOLL
+    struct epoll_event atEvents[MAX_EVENTS];
+    int                iNumOfEvents = epoll_wait(m_iEpoll, atEvents,
+                                                 (iMaxEvents < MAX_EVENTS) ? iMaxEvents : MAX_EVENTS, iTimeoutMs);
+    int                iCount       = 0;
+
+    for (iCount = 0; iCount < iNumOfEvents; iCount++)
+    {
+        ptEvents[iCount].ulId    = atEvents[iCount].data.u32;
+        ptEvents[iCount].sEvents = (short)(((atEvents[iCount].events & EPOLLIN)  ? POLLIN  : 0) |
+                                           ((atEvents[iCount].events & EPOLLOUT) ? POLLOUT : 0) |
+                                           ((atEvents[iCount].events & EPOLLHUP) ? POLLHUP : 0) |
+                                           ((atEvents[iCount].events & EPOLLERR) ? POLLERR : 0));
+    }
+
+    return iNumOfEvents;
+#else
+    int    iNumOfEvents = 0;
+    nfds_t ulIndex      = 0;
+
+    if (poll(m_atPollFds, m_ulNumOfPollFds, iTimeoutMs) < 0)
+    {
+        return -1;
+    }
+
+    for (ulIndex = 0; (ulIndex < m_ulNumOfPollFds) && (iNumOfEvents < iMaxEvents); ulIndex++)
+    {
+        if ((m_atPollFds[ulIndex].fd >= 0) && (0 != m_atPollFds[ulIndex].revents))
+        {
+            //listening sockets and completion pipe are at index 0 to 2
+            ptEvents[iNumOfEvents].ulId    = (uint32_t)((ulIndex + TCP_MAX_CONNECTIONS) % NUM_OF_EVENT_IDS);
+            ptEvents[iNumOfEvents].sEvents = m_atPollFds[ulIndex].revents;
+            iNumOfEvents++;
+        }
+    }
+
+    return iNumOfEvents;
+#endif
+}//end WaitEvents
+
+static void RaiseFileLimit(void)
+{
+    struct rlimit tLimit;
+
+    if ((0 == getrlimit(RLIMIT_NOFILE, &tLimit)) && (tLimit.rlim_cur < tLimit.rlim_max))
+    {
+        tLimit.rlim_cur = tLimit.rlim_max;
+        (void)setrlimit(RLIMIT_NOFILE, &tLimit);
+    }
+}//end RaiseFileLimit
+
+static bool TransactionIdInUse(const Connection_t *ptConnection, const uint8_t *pucQuery)
+{
+    uint8_t ucCount = 0;
+
+    for (ucCount = 0; ucCount < TCP_MAX_IN_FLIGHT; ucCount++)
+    {
+        const Transaction_t *ptTransaction = ptConnection->aptTransactions[ucCount];
+
+        if ((NULL != ptTransaction) && (0 == memcmp(ptTransaction->tRequest.pucQuery, pucQuery, 2)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}//end TransactionIdInUse
+
+static ssize_t ReceiveData(Connection_t *ptConnection, uint64_t *pullArrival)
+{
+    struct iovec    tIov;
+    struct msghdr   tMsg;
+    ssize_t         sReturn = 0;
+    uint64_t        ullNow  = 0;
+#if KERNEL_TIMESTAMPS
+    struct cmsghdr  *ptCmsg = NULL;
+    union
+    {
+        char           acBuf[CMSG_SPACE(sizeof(struct scm_timestamping))];
+        struct cmsghdr tAlign;
+    } uControl;
+#endif
+
+    memset(&tMsg, 0, sizeof(tMsg));
+    tIov.iov_base    = &ptConnection->ptRxBuf->aucData[ptConnection->usRxLen];
+    tIov.iov_len     = RxBufferSize(ptConnection) - ptConnection->usRxLen;
+    tMsg.msg_iov     = &tIov;
+    tMsg.msg_iovlen  = 1;
+#if KERNEL_TIMESTAMPS
+    tMsg.msg_control    = uControl.acBuf;
+    tMsg.msg_controllen = sizeof(uControl.acBuf);
+#endif
+
+    sReturn      = recvmsg(ptConnection->iSocket, &tMsg, 0);
+    ullNow       = GetTimeUs();
+    *pullArrival = ullNow;
+
+#if KERNEL_TIMESTAMPS
+    //time kernel received last data read
+    for (ptCmsg = CMSG_FIRSTHDR(&tMsg); (sReturn > 0) && (NULL != ptCmsg); ptCmsg = CMSG_NXTHDR(&tMsg, ptCmsg))
+    {
+        if ((SOL_SOCKET == ptCmsg->cmsg_level) && (SCM_TIMESTAMPING == ptCmsg->cmsg_type))
+        {
+            struct scm_timestamping tStamps;
+
+            memcpy(&tStamps, CMSG_DATA(ptCmsg), sizeof(tStamps));
+
+            if ((0 != tStamps.ts[0].tv_sec) || (0 != tStamps.ts[0].tv_nsec))
+            {
+                *pullArrival = KernelTimeToUs(&tStamps.ts[0], ullNow);
+            }
+        }
+    }
+#endif
+
+    if (sReturn > 0)
+    {
+        RecordStage(eSTAGE_SOCKET_QUEUE, *pullArrival, ullNow);
+    }
+
+    return sReturn;
+}//end ReceiveData
+
+static void StampRxData(Connection_t *ptConnection, uint16_t usLength, uint64_t ullArrival)
+{
+    RxBuffer_t *ptRxBuf = ptConnection->ptRxBuf;
+    RxStamp_t  *ptStamp = NULL;
+
+    ptConnection->ulRxTotal += usLength;
+
+    if (ptRxBuf->ucNumOfRxStamps < RX_STAMPS)
+    {
+        ptStamp = &ptRxBuf->atRxStamps[(ptRxBuf->ucRxStampHead + ptRxBuf->ucNumOfRxStamps) % RX_STAMPS];
+        ptStamp->ullTime = ullArrival;
+        ptRxBuf->ucNumOfRxStamps++;
+    }
+    else
+    {
+        //many small chunks, newest time is kept for more data and queries
+        //look older than they are rather than younger
+        ptStamp = &ptRxBuf->atRxStamps[(ptRxBuf->ucRxStampHead + RX_STAMPS - 1u) % RX_STAMPS];
+    }
+
+    ptStamp->ulRxEnd = ptConnection->ulRxTotal;
+}//end StampRxData
+
+static uint64_t TakeRxTime(Connection_t *ptConnection, uint16_t usAduLen)
+{
+    RxBuffer_t *ptRxBuf = ptConnection->ptRxBuf;
+    //received byte count at end of query at start of receive buffer
+    uint32_t ulQueryEnd = ptConnection->ulRxTotal - ptConnection->usRxLen + usAduLen;
+    uint64_t ullTime    = 0;
+    uint8_t  ucCount    = 0;
+
+    for (ucCount = 0; ucCount < ptRxBuf->ucNumOfRxStamps; ucCount++)
+    {
+        const RxStamp_t *ptStamp = &ptRxBuf->atRxStamps[(ptRxBuf->ucRxStampHead + ucCount) % RX_STAMPS];
+
+        if ((int32_t)(ptStamp->ulRxEnd - ulQueryEnd) >= 0)
+        {
+            ullTime = ptStamp->ullTime;
+            break;
+        }
+    }
+
+    //drop times of data consumed with query
+    while ((0 != ptRxBuf->ucNumOfRxStamps) &&
+           ((int32_t)(ptRxBuf->atRxStamps[ptRxBuf->ucRxStampHead].ulRxEnd - ulQueryEnd) <= 0))
+    {
+        ptRxBuf->ucRxStampHead = (uint8_t)((ptRxBuf->ucRxStampHead + 1u) % RX_STAMPS);
+        ptRxBuf->ucNumOfRxStamps--;
+    }
+
+    return ullTime;
+}//end TakeRxTime
+
+static bool DeadlineExpired(const Transaction_t *ptTransaction)
+{
+    return (0 != m_ullDeadlineUs) && ((GetTimeUs() - ptTransaction->ullArrival) > m_ullDeadlineUs);
+}//end DeadlineExpired
+
+static uint16_t ShedRequest(ModbusRequest_t *ptRequest)
+{
+    if (m_bReplyBusy)
+    {
+        __atomic_fetch_add(&m_tStats.ulNumOfBusy, 1, __ATOMIC_RELAXED);
+        return mbap_RejectRequest(ptRequest, eSERVER_BUSY);
+    }
+
+    //client has given up waiting, answering would only add load
+    __atomic_fetch_add(&m_tStats.ulNumOfDropped, 1, __ATOMIC_RELAXED);
+
+    return 0;
+}//end ShedRequest
+
+static uint64_t GetTimeUs(void)
+{
+    struct timespec tNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &tNow);
+
+    return ((uint64_t)tNow.tv_sec * 1000000u) + ((uint64_t)tNow.tv_nsec / 1000u);
+}//end GetTimeUs
+
+static void SendResponses(Connection_t *ptConnection)
+{
+    uint8_t ucCount = 0;
+
+    if (!ptConnection->bStrictOrder)
+    {
+        //responses go out as soon as they are done, client matches transaction id
+        for (ucCount = 0; (ucCount < TCP_MAX_IN_FLIGHT) && !ptConnection->bClosing; ucCount++)
+        {
+            Transaction_t *ptTransaction = ptConnection->aptTransactions[ucCount];
+
+            if ((NULL != ptTransaction) && (eTRANSACTION_DONE == ptTransaction->ucState) &&
+                !SendResponse(ptTransaction))
+            {
+                //rest is sent when socket is writable
+                break;
+            }
+        }
+        return;
+    }
+
+    //strict order, response of oldest query first
+    while (!ptConnection->bClosing && (0 != ptConnection->ucNumOfActive))
+    {
+        Transaction_t *ptOldest = NULL;
+
+        for (ucCount = 0; ucCount < TCP_MAX_IN_FLIGHT; ucCount++)
+        {
+            Transaction_t *ptTransaction = ptConnection->aptTransactions[ucCount];
+
+            if ((NULL != ptTransaction) && (ptTransaction->ulSequence == ptConnection->ulSendSequence))
+            {
+                ptOldest = ptTransaction;
+                break;
+            }
+        }
+
+        if ((NULL == ptOldest) || (eTRANSACTION_DONE != ptOldest->ucState) || !SendResponse(ptOldest))
+        {
+            break;
+        }
+
+        ptConnection->ulSendSequence++;
+    }//end while
+}//end SendResponses
+
+static bool SendResponse(Transaction_t *ptTransaction)
+{
+    Connection_t *ptConnection = ptTransaction->ptConnection;
+    uint16_t     usLength      = ptTransaction->tRequest.usResponseLen;
+    uint64_t     ullSent       = 0;
+
+    if (0 != usLength)
+    {
+        uint8_t ucResult = SendData(ptConnection, ptTransaction->tRequest.pucResponse, usLength);
+
+        if (eSEND_BLOCKED == ucResult)
+        {
+            return false;
+        }
+
+        MBT_PROBE_QUERY_RESULT(response__sent, ptConnection->ulConnectionId, ptTransaction->tRequest.pucQuery,
+                               (eSEND_DONE == ucResult) ? (ssize_t)usLength : -1);
+
+        if (eSEND_FAILED == ucResult)
+        {
+            FreeTransaction(ptTransaction);
+            CloseConnection(ptConnection);
+            return true;
+        }
+
+        mbap_HistRecord(&m_atLanes[ptTransaction->ucLane].tLatency,
+                        (uint32_t)(GetTimeUs() - ptTransaction->ullArrival));
+
+        ullSent = GetTimeUs();
+        RecordStage(eSTAGE_PROCESSING, ptTransaction->ullStart, ullSent);
+        ptConnection->ulTxTotal += usLength;
+
+        if (ptConnection->bKernelStamps && (NULL == ptConnection->ptTxStamps))
+        {
+            //attached until transmit times are read, no stamp if out of memory
+            ptConnection->ptTxStamps = (TxStamps_t *)pl_Alloc(&m_tTxStampsPool);
+
+            if (NULL != ptConnection->ptTxStamps)
+            {
+                ptConnection->ptTxStamps->ucHead  = 0;
+                ptConnection->ptTxStamps->ucCount = 0;
+            }
+        }
+
+        if (ptConnection->bKernelStamps && (NULL != ptConnection->ptTxStamps))
+        {
+            TxStamps_t *ptTxStamps = ptConnection->ptTxStamps;
+            TxStamp_t  *ptStamp    = NULL;
+
+            if (ptTxStamps->ucCount >= TCP_MAX_IN_FLIGHT)
+            {
+                //transmit time of oldest response was lost
+                ptTxStamps->ucHead = (uint8_t)((ptTxStamps->ucHead + 1u) % TCP_MAX_IN_FLIGHT);
+                ptTxStamps->ucCount--;
+            }
+
+            ptStamp = &ptTxStamps->atStamps[(ptTxStamps->ucHead + ptTxStamps->ucCount) % TCP_MAX_IN_FLIGHT];
+            ptStamp->ulTxEnd    = ptConnection->ulTxTotal;
+            ptStamp->ullSent    = ullSent;
+            ptStamp->ullArrival = ptTransaction->ullArrival;
+            ptTxStamps->ucCount++;
+        }
+    }
+
+    FreeTransaction(ptTransaction);
+
+    //queries may wait in receive buffer for a free transaction
+    if (ptConnection->usRxLen >= MBAP_PREFIX_LEN)
+    {
+        ptConnection->bReady = true;
+        QueueReady(ptConnection);
+    }
+
+    return true;
+}//end SendResponse
+
+static uint8_t SendData(Connection_t *ptConnection, const uint8_t *pucData, uint16_t usLength)
+{
+    ObjectPool_t *ptPool  = ptConnection->bExtended ? &m_tExtTxBufferPool : &m_tTxBufferPool;
+    ssize_t      sReturn  = 0;
+
+    //messages are not interleaved with queued rest of another one
+    if (ptConnection->bTxBlocked)
+    {
+        return eSEND_BLOCKED;
+    }
+
+    sReturn = send(ptConnection->iSocket, pucData, usLength, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+    if (sReturn == (ssize_t)usLength)
+    {
+        return eSEND_DONE;
+    }
+
+    if ((sReturn < 0) && (EAGAIN != errno) && (EWOULDBLOCK != errno) && (EINTR != errno))
+    {
+        printf("\nsend failed\n");
+        return eSEND_FAILED;
+    }
+
+    ptConnection->bTxBlocked = true;
+    UpdateSocketEvents(ptConnection);
+
+    if (sReturn <= 0)
+    {
+        return eSEND_BLOCKED;
+    }
+
+    //partly sent message must be completed before anything else is sent
+    ptConnection->ptTxBuf = (TxBuffer_t *)pl_Alloc(ptPool);
+
+    if (NULL == ptConnection->ptTxBuf)
+    {
+        printf("\nOut of memory\n");
+        return eSEND_FAILED;
+    }
+
+    ptConnection->ptTxBuf->usOffset = 0;
+    ptConnection->ptTxBuf->usLength = (uint16_t)(usLength - (uint16_t)sReturn);
+    memcpy(ptConnection->ptTxBuf->aucData, &pucData[sReturn], ptConnection->ptTxBuf->usLength);
+
+    return eSEND_DONE;
+}//end SendData
+
+static bool FlushTxBuffer(Connection_t *ptConnection)
+{
+    TxBuffer_t *ptTxBuf = ptConnection->ptTxBuf;
+
+    if (!ptConnection->bTxBlocked)
+    {
+        return true;
+    }
+
+    while ((NULL != ptTxBuf) && (ptTxBuf->usOffset < ptTxBuf->usLength))
+    {
+        ssize_t sReturn = send(ptConnection->iSocket, &ptTxBuf->aucData[ptTxBuf->usOffset],
+                               ptTxBuf->usLength - ptTxBuf->usOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+        if (sReturn > 0)
+        {
+            ptTxBuf->usOffset += (uint16_t)sReturn;
+        }
+        else if ((sReturn < 0) && ((EAGAIN == errno) || (EWOULDBLOCK == errno) || (EINTR == errno)))
+        {
+            //client still does not read, wait for next writable event
+            return true;
+        }
+        else
+        {
+            printf("\nsend failed\n");
+            CloseConnection(ptConnection);
+            return false;
+        }
+    }
+
+    if (NULL != ptTxBuf)
+    {
+        pl_Free(ptConnection->bExtended ? &m_tExtTxBufferPool : &m_tTxBufferPool, ptTxBuf);
+        ptConnection->ptTxBuf = NULL;
+    }
+
+    ptConnection->bTxBlocked = false;
+    UpdateSocketEvents(ptConnection);
+
+    //responses done while socket was blocked, queries waiting for their
+    //slots are served from list of ready connections
+    SendResponses(ptConnection);
+
+    return !ptConnection->bClosing;
+}//end FlushTxBuffer
+
+static bool EnableTimestamps(int iSocket)
+{
+#if KERNEL_TIMESTAMPS
+    //transmit times are reported with byte count of connection as id
+    int iFlags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE |
+                 SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID;
+    //error queue returns times without copy of sent data, not known by old kernels
+    int iTimesOnly = iFlags | SOF_TIMESTAMPING_OPT_TSONLY;
+
+    return (0 == setsockopt(iSocket, SOL_SOCKET, SO_TIMESTAMPING, &iTimesOnly, sizeof(iTimesOnly))) ||
+           (0 == setsockopt(iSocket, SOL_SOCKET, SO_TIMESTAMPING, &iFlags, sizeof(iFlags)));
+#else
+    (void)iSocket;
+
+    return false;
+#endif
+}//end EnableTimestamps
+
+static bool ReadTxStamps(Connection_t *ptConnection)
+{
+    bool bIsRead = false;
+#if KERNEL_TIMESTAMPS
+    uint8_t aucData[64];
+
+    while (1)
+    {
+        struct msghdr           tMsg;
+        struct iovec            tIov;
+        struct cmsghdr          *ptCmsg     = NULL;
+        struct scm_timestamping tStamps;
+        struct sock_extended_err tError;
+        bool                    bHasTime    = false;
+        bool                    bHasId      = false;
+        union
+        {
+            char           acBuf[512];
+            struct cmsghdr tAlign;
+        } uControl;
+
+        memset(&tMsg, 0, sizeof(tMsg));
+        tIov.iov_base       = aucData;
+        tIov.iov_len        = sizeof(aucData);
+        tMsg.msg_iov        = &tIov;
+        tMsg.msg_iovlen     = 1;
+        tMsg.msg_control    = uControl.acBuf;
+        tMsg.msg_controllen = sizeof(uControl.acBuf);
+
+        if (recvmsg(ptConnection->iSocket, &tMsg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        {
+            break;
+        }
+
+        bIsRead = true;
+
+        for (ptCmsg = CMSG_FIRSTHDR(&tMsg); NULL != ptCmsg; ptCmsg = CMSG_NXTHDR(&tMsg, ptCmsg))
+        {
+            if ((SOL_SOCKET == ptCmsg->cmsg_level) && (SCM_TIMESTAMPING == ptCmsg->cmsg_type))
+            {
+                memcpy(&tStamps, CMSG_DATA(ptCmsg), sizeof(tStamps));
+                bHasTime = true;
+            }
+            else if (((IPPROTO_IP == ptCmsg->cmsg_level) && (IP_RECVERR == ptCmsg->cmsg_type)) ||
+                     ((IPPROTO_IPV6 == ptCmsg->cmsg_level) && (IPV6_RECVERR == ptCmsg->cmsg_type)))
+            {
+                memcpy(&tError, CMSG_DATA(ptCmsg), sizeof(tError));
+                bHasId = (SO_EE_ORIGIN_TIMESTAMPING == tError.ee_origin);
+            }
+        }//end for
+
+        if (bHasTime && bHasId)
+        {
+            //id is byte count of last transmitted byte, counted from 0
+            TakeTxStamp(ptConnection, tError.ee_data + 1u, KernelTimeToUs(&tStamps.ts[0], GetTimeUs()));
+        }
+    }//end while
+#else
+    (void)ptConnection;
+#endif
+
+    return bIsRead;
+}//end ReadTxStamps
+
+#if KERNEL_TIMESTAMPS
+static void TakeTxStamp(Connection_t *ptConnection, uint32_t ulTxEnd, uint64_t ullTxTime)
+{
+    TxStamps_t *ptTxStamps = ptConnection->ptTxStamps;
+
+    if (NULL == ptTxStamps)
+    {
+        return;
+    }
+
+    while ((0 != ptTxStamps->ucCount) &&
+           ((int32_t)(ulTxEnd - ptTxStamps->atStamps[ptTxStamps->ucHead].ulTxEnd) >= 0))
+    {
+        const TxStamp_t *ptStamp = &ptTxStamps->atStamps[ptTxStamps->ucHead];
+
+        RecordStage(eSTAGE_TRANSMIT, ptStamp->ullSent, ullTxTime);
+        RecordStage(eSTAGE_WIRE, ptStamp->ullArrival, ullTxTime);
+
+        ptTxStamps->ucHead = (uint8_t)((ptTxStamps->ucHead + 1u) % TCP_MAX_IN_FLIGHT);
+        ptTxStamps->ucCount--;
+    }
+
+    if (0 == ptTxStamps->ucCount)
+    {
+        pl_Free(&m_tTxStampsPool, ptTxStamps);
+        ptConnection->ptTxStamps = NULL;
+    }
+}//end TakeTxStamp
+
+static uint64_t KernelTimeToUs(const struct timespec *ptKernelTime, uint64_t ullNow)
+{
+    struct timespec tReal;
+    uint64_t        ullRealNow = 0;
+    uint64_t        ullKernel  = 0;
+
+    //kernel times are taken from realtime clock, age is taken over to monotonic clock
+    clock_gettime(CLOCK_REALTIME, &tReal);
+    ullRealNow = ((uint64_t)tReal.tv_sec * 1000000u) + ((uint64_t)tReal.tv_nsec / 1000u);
+    ullKernel  = ((uint64_t)ptKernelTime->tv_sec * 1000000u) + ((uint64_t)ptKernelTime->tv_nsec / 1000u);
+
+    if ((ullKernel >= ullRealNow) || ((ullRealNow - ullKernel) >= ullNow))
+    {
+        return ullNow;
+    }
+
+    return ullNow - (ullRealNow - ullKernel);
+}//end KernelTimeToUs
+#endif//KERNEL_TIMESTAMPS
+
+static void RecordStage(uint8_t ucStage, uint64_t ullFrom, uint64_t ullTo)
+{
+    uint64_t ullLatency = (ullTo > ullFrom) ? (ullTo - ullFrom) : 0u;
+
+    mbap_HistRecord(&m_atStages[ucStage], (ullLatency > 0xFFFFFFFFu) ? 0xFFFFFFFFu : (uint32_t)ullLatency);
+}//end RecordStage
+
+static void ReadLatency(const LatencyHistogram_t *ptHist, TcpLaneStats_t *ptStats)
+{
+    LatencyHistogram_t tLatency;
+
+    //copy, server thread keeps recording
+    memset(&tLatency, 0, sizeof(tLatency));
+    mbap_HistMerge(&tLatency, ptHist);
+
+    ptStats->ulNumOfRequests = tLatency.ulCount;
+    ptStats->ulP50           = mbap_HistPercentile(&tLatency, 500);
+    ptStats->ulP90           = mbap_HistPercentile(&tLatency, 900);
+    ptStats->ulP99           = mbap_HistPercentile(&tLatency, 990);
+    ptStats->ulP999          = mbap_HistPercentile(&tLatency, 999);
+    ptStats->ulMax           = tLatency.ulMax;
+}//end ReadLatency
+
+static void SetNonBlocking(int iSocket)
+{
+    int iFlags = fcntl(iSocket, F_GETFL, 0);
+
+    (void)fcntl(iSocket, F_SETFL, iFlags | O_NONBLOCK);
+}//end SetNonBlocking
+
+static void CloseConnection(Connection_t *ptConnection)
+{
+    if (!ptConnection->bClosing)
+    {
+        UnwatchSocket(ptConnection->iSocket, ptConnection->ulSlot);
+        close(ptConnection->iSocket);
+        ptConnection->bClosing = true;
+        cp_Record(GetTimeUs(), ptConnection->ulConnectionId, eCAPTURE_CLOSE, NULL, 0);
+        mbap_SubscriptionDrop(ptConnection);
+    }
+
+    //user function still owns buffers of pending requests
+    if ((0 == ptConnection->ucNumOfPending) && ptConnection->bInUse)
+    {
+        ptConnection->bInUse = false;
+        STATS_ADD(m_tStats.ulNumOfConnections, -1);
+        ReleaseConnection(ptConnection);
+    }
+}//end CloseConnection
+
+static void ReleaseConnection(Connection_t *ptConnection)
+{
+    uint8_t ucCount = 0;
+
+    //done responses of strict order which were never sent
+    for (ucCount = 0; ucCount < TCP_MAX_IN_FLIGHT; ucCount++)
+    {
+        if (NULL != ptConnection->aptTransactions[ucCount])
+        {
+            FreeTransaction(ptConnection->aptTransactions[ucCount]);
+        }
+    }
+
+    ptConnection->usRxLen = 0;
+    ReleaseRxBuffer(ptConnection);
+    pl_Free(&m_tTxStampsPool, ptConnection->ptTxStamps);
+    ptConnection->ptTxStamps = NULL;
+    pl_Free(ptConnection->bExtended ? &m_tExtTxBufferPool : &m_tTxBufferPool, ptConnection->ptTxBuf);
+    ptConnection->ptTxBuf = NULL;
+
+    //callers up the stack may still read connection, it is freed at start of
+    //next server loop iteration
+    QueueReady(ptConnection);
+}//end ReleaseConnection
+
+static void FreeConnection(Connection_t *ptConnection)
+{
+    m_aptConnections[ptConnection->ulSlot] = NULL;
+    m_aulFreeSlots[m_ulNumOfFreeSlots++]   = ptConnection->ulSlot;
+    pl_Free(&m_tConnectionPool, ptConnection);
+}//end FreeConnection
+
+static uint16_t RxBufferSize(const Connection_t *ptConnection)
+{
+    return ptConnection->bExtended ? EXT_RX_BUFF_SIZE : RX_BUFF_SIZE;
+}//end RxBufferSize
+
+static bool KeepRxBuffer(Connection_t *ptConnection)
+{
+    RxBuffer_t *ptRxBuf = NULL;
+
+    if (m_ptScratchBuf != ptConnection->ptRxBuf)
+    {
+        return true;
+    }
+
+    if (0 == ptConnection->usRxLen)
+    {
+        ptConnection->ptRxBuf = NULL;
+        return true;
+    }
+
+    ptRxBuf = (RxBuffer_t *)pl_Alloc(ptConnection->bExtended ? &m_tExtRxBufferPool : &m_tRxBufferPool);
+
+    if (NULL == ptRxBuf)
+    {
+        printf("\nOut of memory\n");
+        ptConnection->ptRxBuf = NULL;
+        CloseConnection(ptConnection);
+        return false;
+    }
+
+    memcpy(ptRxBuf, m_ptScratchBuf, offsetof(RxBuffer_t, aucData) + ptConnection->usRxLen);
+    ptConnection->ptRxBuf = ptRxBuf;
+    STATS_ADD(m_tStats.ulNumOfRxBuffers, 1);
+
+    return true;
+}//end KeepRxBuffer
+
+static void ReleaseRxBuffer(Connection_t *ptConnection)
+{
+    if ((0 != ptConnection->usRxLen) || (NULL == ptConnection->ptRxBuf))
+    {
+        return;
+    }
+
+    if (m_ptScratchBuf != ptConnection->ptRxBuf)
+    {
+        pl_Free(ptConnection->bExtended ? &m_tExtRxBufferPool : &m_tRxBufferPool, ptConnection->ptRxBuf);
+        STATS_ADD(m_tStats.ulNumOfRxBuffers, -1);
+    }
+
+    ptConnection->ptRxBuf = NULL;
+}//end ReleaseRxBuffer
+
+static Transaction_t *AllocTransaction(Connection_t *ptConnection)
+{
+    Transaction_t *ptTransaction = NULL;
+    uint8_t       ucSlot         = 0;
+
+    for (ucSlot = 0; ucSlot < TCP_MAX_IN_FLIGHT; ucSlot++)
+    {
+        if (NULL == ptConnection->aptTransactions[ucSlot])
+        {
+            break;
+        }
+    }
+
+    ptTransaction = (TCP_MAX_IN_FLIGHT == ucSlot) ? NULL : (Transaction_t *)pl_Alloc(ptConnection->bExtended ? &m_tExtTransactionPool : &m_tTransactionPool);
+
+    if (NULL == ptTransaction)
+    {
+        return NULL;
+    }
+
+    ptTransaction->ptConnection          = ptConnection;
+    ptTransaction->ucSlot                = ucSlot;
+    ptConnection->aptTransactions[ucSlot] = ptTransaction;
+    ptConnection->ucNumOfActive++;
+    STATS_ADD(m_tStats.ulNumOfTransactions, 1);
+
+    return ptTransaction;
+}//end AllocTransaction
+
+static void FreeTransaction(Transaction_t *ptTransaction)
+{
+    Connection_t *ptConnection = ptTransaction->ptConnection;
+
+    ptConnection->aptTransactions[ptTransaction->ucSlot] = NULL;
+    ptConnection->ucNumOfActive--;
+    pl_Free(ptConnection->bExtended ? &m_tExtTransactionPool : &m_tTransactionPool, ptTransaction);
+    STATS_ADD(m_tStats.ulNumOfTransactions, -1);
+}//end FreeTransaction
+
+static void RecordOpen(const Connection_t *ptConnection)
+{
+    uint8_t aucClientIp[4];
+
+    aucClientIp[0] = (uint8_t)(ptConnection->ulClientIp >> 24);
+    aucClientIp[1] = (uint8_t)(ptConnection->ulClientIp >> 16);
+    aucClientIp[2] = (uint8_t)(ptConnection->ulClientIp >> 8);
+    aucClientIp[3] = (uint8_t)ptConnection->ulClientIp;
+
+    cp_Record(GetTimeUs(), ptConnection->ulConnectionId, eCAPTURE_OPEN, aucClientIp, sizeof(aucClientIp));
+}//end RecordOpen
+
+static void RequestDone(ModbusRequest_t *ptRequest)
+{
+    Transaction_t *ptTransaction = (Transaction_t *)ptRequest->pvContext;
+    Transaction_t *ptHead        = __atomic_load_n(&m_ptCompleted, __ATOMIC_RELAXED);
+    uint8_t       ucSignal       = 1;
+
+    do
+    {
+        ptTransaction->ptNextDone = ptHead;
+    } while (!__atomic_compare_exchange_n(&m_ptCompleted, &ptHead, ptTransaction, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    //server loop is woken up once for all completions pushed before it takes the stack
+    if ((NULL == ptHead) && (write(m_aiCompletionPipe[1], &ucSignal, sizeof(ucSignal)) < 0))
+    {
+        printf("\ncompletion signal failed\n");
+    }
+}//end RequestDone
+
+static void HandleCompletions(void)
+{
+    Transaction_t *ptTransaction = NULL;
+    Transaction_t *ptInOrder     = NULL;
+    uint8_t       aucSignal[64];
+
+    //drain wake up signals before taking the stack, a later push signals again
+    while (read(m_aiCompletionPipe[0], aucSignal, sizeof(aucSignal)) > 0)
+    {
+    }
+
+    ptTransaction = __atomic_exchange_n(&m_ptCompleted, NULL, __ATOMIC_ACQUIRE);
+
+    //stack holds newest first, handle in order of completion
+    while (NULL != ptTransaction)
+    {
+        Transaction_t *ptNext = ptTransaction->ptNextDone;
+
+        ptTransaction->ptNextDone = ptInOrder;
+        ptInOrder                 = ptTransaction;
+        ptTransaction             = ptNext;
+    }
+
+    while (NULL != ptInOrder)
+    {
+        Connection_t  *ptConnection  = NULL;
+
+        //slot may be reused and completed again below
+        ptTransaction = ptInOrder;
+        ptInOrder     = ptTransaction->ptNextDone;
+        ptConnection  = ptTransaction->ptConnection;
+
+        ptTransaction->ucState = eTRANSACTION_DONE;
+        ptConnection->ucNumOfPending--;
+        STATS_ADD(m_tStats.ulNumOfPending, -1);
+
+        if (ptConnection->bClosing)
+        {
+            FreeTransaction(ptTransaction);
+            CloseConnection(ptConnection);
+            continue;
+        }
+
+        SendResponses(ptConnection);
+
+        //continue with queries pipelined behind completed request, unless
+        //sending closed connection
+        if (!ptConnection->bClosing)
+        {
+            ProcessQueries(ptConnection);
+        }
+    }
+}//end HandleCompletions
+
+static bool Notify(void *pvConnection, const uint8_t *pucAdu, uint16_t usLen)
+{
+    Connection_t *ptConnection = (Connection_t *)pvConnection;
+    uint8_t      ucResult      = SendData(ptConnection, pucAdu, usLen);
+
+    //notification is not worth waiting for, change is sent with a later poll
+    if (eSEND_BLOCKED == ucResult)
+    {
+        return false;
+    }
+
+    if (eSEND_FAILED == ucResult)
+    {
+        CloseConnection(ptConnection);
+        return true;
+    }
+
+    //transmit times of later responses are matched by byte count of stream
+    ptConnection->ulTxTotal += usLen;
+    STATS_ADD(m_tStats.ulNumOfNotifications, 1);
+
+    return true;
+}//end Notify
 
 //****************************************************************************/
 //                             End of file
@@ -19,7 +19,97 @@
 //****************************************************************************
 //                           Constants and typedefs
 //****************************************************************************
+//! @brief Maximum number of outstanding requests per connection
+#define TCP_MAX_IN_FLIGHT    (8u)
+//! @brief Maximum number of client connections
+#define TCP_MAX_CONNECTIONS  (50000u)
+//! @brief Bytes of server state per idle connection, taken from a slab pool.
+//!        Receive buffer, transactions and transmit times are taken from
+//!        shared pools only while data is in flight, socket buffers of the
+//!        kernel are not counted.
+#define TCP_CONNECTION_BUDGET (192u)
 
+//! @brief Largest ADU of extended framing, MBAP header included. Buffers of
+//!        this size are taken while a query is in flight on an extended
+//!        connection, at most 32767 as two fit in a receive buffer.
+#define TCP_EXT_ADU_LEN      (16384u)
+
+//! @brief Default number of queries handled per connection and server loop iteration
+#define TCP_DEFAULT_BUDGET   (4u)
+//! @brief Period of checking subscribed ranges for changes while there are subscriptions, ms
+#define TCP_NOTIFY_PERIOD_MS (5)
+//! @brief Maximum number of rate limits
+#define TCP_MAX_RATE_LIMITS  (16u)
+
+//! @brief Number of priority lanes
+#define TCP_MAX_LANES        (4u)
+//! @brief Maximum number of lane classification rules
+#define TCP_MAX_LANE_RULES   (16u)
+//! @brief Lane rule matches any unit id
+#define TCP_ANY_UNIT_ID      (0xFFFFu)
+//! @brief Maximum number of local addresses routed to extension keys
+#define TCP_MAX_EXT_KEYS     (16u)
+
+//! @brief Function code classes for rate limits
+enum FunctionClass
+{
+    eCLASS_READ  = 0,               //!< Read and all other function codes
+    eCLASS_WRITE = 1,               //!< Write function codes 5, 6, 15 and 16
+    eNUM_OF_CLASSES
+};
+
+//! @brief Stages of request latency, times are taken by the kernel when
+//!        SO_TIMESTAMPING is supported, else when the server reads or sends
+enum TimingStage
+{
+    eSTAGE_SOCKET_QUEUE = 0,        //!< Data arrival until read by server
+    eSTAGE_QUEUE        = 1,        //!< Query arrival until processing starts
+    eSTAGE_PROCESSING   = 2,        //!< Processing start until response is sent to socket
+    eSTAGE_TRANSMIT     = 3,        //!< Response sent to socket until transmitted by kernel
+    eSTAGE_WIRE         = 4,        //!< Query arrival until response is transmitted by kernel
+    eNUM_OF_STAGES
+};
+
+//! @brief Object pools of the server
+enum TcpPool
+{
+    ePOOL_CONNECTIONS      = 0,     //!< Connection state, used by server thread only
+    ePOOL_RX_BUFFERS       = 1,     //!< Receive buffers of connections with partial queries
+    ePOOL_TRANSACTIONS     = 2,     //!< Queries in flight with their responses
+    ePOOL_TX_STAMPS        = 3,     //!< Responses waiting for transmit time
+    ePOOL_EXT_RX_BUFFERS   = 4,     //!< Receive buffers of extended framing connections
+    ePOOL_EXT_TRANSACTIONS = 5,     //!< Queries in flight on extended framing connections
+    ePOOL_TX_BUFFERS       = 6,     //!< Unsent rest of messages while socket buffer is full
+    ePOOL_EXT_TX_BUFFERS   = 7,     //!< Unsent rest of messages of extended framing connections
+    eNUM_OF_POOLS
+};
+
+//! @brief Transport statistics
+typedef struct TcpStats
+{
+    uint32_t ulNumOfDropped;        //!<Requests dropped after deadline expired
+    uint32_t ulNumOfBusy;           //!<Requests answered with server busy after deadline expired
+    uint32_t ulNumOfAccepted;       //!<Connections accepted
+    uint32_t ulNumOfConnections;    //!<Connections open
+    uint32_t ulNumOfQueries;        //!<Queries received
+    uint32_t ulNumOfPending;        //!<Requests waiting for asynchronous user functions
+    uint32_t ulNumOfRxBuffers;      //!<Receive buffers attached to connections
+    uint32_t ulNumOfTransactions;   //!<Transactions attached to connections
+    uint32_t ulNumOfNotifications;  //!<Change notifications sent to subscribers
+} TcpStats_t;
+
+//! @brief Latency of a priority lane from arrival of query until response
+//!        is sent, in us
+typedef struct TcpLaneStats
+{
+    uint32_t ulNumOfRequests;       //!<Number of responses sent
+    uint32_t ulP50;                 //!<50th percentile
+    uint32_t ulP90;                 //!<90th percentile
+    uint32_t ulP99;                 //!<99th percentile
+    uint32_t ulP999;                //!<99.9th percentile
+    uint32_t ulMax;                 //!<Largest latency
+    uint32_t ulQueueDepth;          //!<Queries waiting in lane, 0 for stages
+} TcpLaneStats_t;
 
 //****************************************************************************
 //                           Global variables
@@ -36,6 +126,133 @@
 //
 void tcp_Init (void);
 
+//
+//! @brief Set handling of pipelined requests for connections accepted afterwards
+//! @param[in]  ucMaxInFlight  Limit of outstanding requests per connection,
+//!                            1 to TCP_MAX_IN_FLIGHT
+//! @param[in]  bStrictOrder   true - responses are sent in order of queries for
+//!                            legacy clients, false - responses are sent as soon
+//!                            as they are done, client matches transaction id
+//! @return     None
+//
+void tcp_SetTransactionMode(uint8_t ucMaxInFlight, bool bStrictOrder);
+
+//
+//! @brief Set service deadline of requests, a request not started within the
+//!        deadline after its arrival is shed
+//! @param[in]  ulDeadlineMs  Deadline in milliseconds, 0 - no deadline
+//! @param[in]  bReplyBusy    true - answer shed request with server busy
+//!                           exception, false - drop shed request silently
+//! @return     None
+//
+void tcp_SetDeadline(uint32_t ulDeadlineMs, bool bReplyBusy);
+
+//
+//! @brief Set number of queries handled per connection in one server loop
+//!        iteration, connections are served round robin
+//! @param[in]  ucBudget  Number of queries, at least 1
+//! @return     None
+//
+void tcp_SetBudget(uint8_t ucBudget);
+
+//
+//! @brief Set Modbus TCP port, call before tcp_Init, default 502
+//! @param[in]  usPort  TCP port
+//! @return     None
+//
+void tcp_SetPort(uint16_t usPort);
+
+//
+//! @brief Set port of extended framing, call before tcp_Init. Connections
+//!        accepted there may send queries up to TCP_EXT_ADU_LEN bytes using
+//!        the full MBAP length field, meant for trusted local links only.
+//! @param[in]  usPort  TCP port, 0 - extended framing off(default)
+//! @return     None
+//
+void tcp_SetExtendedPort(uint16_t usPort);
+
+//
+//! @brief Route connections accepted on a local address to the units behind
+//!        an extension key, call before tcp_Init. A gateway gives the host one
+//!        address per extension key, e.g. 127.0.0.2 and 127.0.0.3, clients
+//!        select the key by the address they connect to. Connections to other
+//!        addresses use the unit id table.
+//! @param[in]  ulLocalIp  Local IPv4 address in host byte order
+//! @param[in]  usExtKey   Extension key of units, 0 - unit id table
+//! @return     bool       true - route added, false - no free entry
+//
+bool tcp_AddExtKey(uint32_t ulLocalIp, uint16_t usExtKey);
+
+//
+//! @brief Set token bucket rate limit of a client and function code class,
+//!        queries over the limit wait until tokens are refilled.
+//!        May be called from any thread.
+//! @param[in]  ulClientIp  Client IPv4 address in host byte order,
+//!                         0 - limit of each connection of other clients
+//! @param[in]  ucClass     Function code class(enum FunctionClass)
+//! @param[in]  ulRate      Queries per second, 0 - remove limit
+//! @param[in]  ulBurst     Bucket size in queries, at least 1
+//! @return     bool        true - limit set, false - no free entry
+//
+bool tcp_SetRateLimit(uint32_t ulClientIp, uint8_t ucClass, uint32_t ulRate, uint32_t ulBurst);
+
+//
+//! @brief Configure priority lane, call before tcp_Init. Queries of strict
+//!        lanes are processed before all others, lower lane first. Weighted
+//!        lanes share the rest round robin by weight. All lanes are weighted
+//!        with weight 1 by default.
+//! @param[in]  ucLane    Lane, less than TCP_MAX_LANES
+//! @param[in]  bStrict   true - strict priority, false - weighted
+//! @param[in]  ucWeight  Queries per round of weighted lane, at least 1
+//! @return     bool      true - lane configured, false - invalid lane
+//
+bool tcp_SetLane(uint8_t ucLane, bool bStrict, uint8_t ucWeight);
+
+//
+//! @brief Add rule classifying queries into a lane, call before tcp_Init.
+//!        First matching rule wins, queries matching no rule go to lane 0.
+//! @param[in]  ulClientIp      Client IPv4 address in host byte order, 0 - any
+//! @param[in]  usUnitId        Unit id, TCP_ANY_UNIT_ID - any
+//! @param[in]  ucFunctionCode  Function code, 0 - any
+//! @param[in]  ucLane          Lane of matching queries
+//! @return     bool            true - rule added, false - invalid lane or no free entry
+//
+bool tcp_AddLaneRule(uint32_t ulClientIp, uint16_t usUnitId, uint8_t ucFunctionCode, uint8_t ucLane);
+
+//
+//! @brief Read latency percentiles of a priority lane, may be called from any thread
+//! @param[in]  ucLane   Lane
+//! @param[out] ptStats  Latency statistics
+//! @return     bool     true - statistics read, false - invalid lane
+//
+bool tcp_GetLaneStats(uint8_t ucLane, TcpLaneStats_t *ptStats);
+
+//
+//! @brief Read latency percentiles of a stage of requests in us, may be
+//!        called from any thread. Transmit and wire stages are only measured
+//!        with kernel timestamps.
+//! @param[in]  ucStage  Stage(enum TimingStage)
+//! @param[out] ptStats  Latency statistics
+//! @return     bool     true - statistics read, false - invalid stage
+//
+bool tcp_GetStageStats(uint8_t ucStage, TcpLaneStats_t *ptStats);
+
+//
+//! @brief Read transport statistics, may be called from any thread
+//! @param[out] ptStats  Statistics
+//! @return     None
+//
+void tcp_GetStats(TcpStats_t *ptStats);
+
+//
+//! @brief Read statistics of an object pool, may be called from any thread
+//! @param[in]  ucPool   Pool(enum TcpPool)
+//! @param[out] ppcName  Name of pool
+//! @param[out] ptStats  Pool statistics
+//! @return     bool     true - statistics read, false - invalid pool
+//
+bool tcp_GetPoolStats(uint8_t ucPool, const char **ppcName, PoolStats_t *ptStats);
+
 #endif // TCP_H
 //****************************************************************************
 //                             End of file
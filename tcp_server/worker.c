@@ -0,0 +1,293 @@
+//! @addtogroup TCPServerWorker
+//! @brief Worker thread pool for blocking user functions
+//! @{
+//!
+//****************************************************************************/
+//! @file worker.c
+//! @brief Worker thread pool running user functions which may block, like
+//!        I2C reads. Each worker has its own queue, idle workers steal
+//!        requests from queues of busy workers.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+//user defined header files
+#include "mbap_conf.h"
+#include "mbap.h"
+#include "mbap_unit.h"
+#include "worker.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+//! @brief Request queue of a worker thread
+typedef struct WorkQueue
+{
+    pthread_mutex_t tLock;                          //!<Protects queue
+    ModbusRequest_t *aptRequests[WK_QUEUE_SIZE];    //!<Queued requests
+    uint16_t        usHead;                         //!<Oldest request
+    uint16_t        usCount;                        //!<Number of queued requests
+} WorkQueue_t;
+
+//! @brief Address block with blocking user functions
+typedef struct WorkBlock
+{
+    uint8_t  ucTable;                               //!<Data table
+    uint32_t ulStartAddress;                        //!<First address
+    uint32_t ulEndAddress;                          //!<Address after block
+} WorkBlock_t;
+
+//****************************************************************************/
+//                           external variables
+//****************************************************************************/
+
+//****************************************************************************/
+//                           Local variables
+//****************************************************************************/
+static WorkQueue_t     m_atQueues[WK_MAX_THREADS];
+static pthread_t       m_atThreads[WK_MAX_THREADS];
+static uint8_t         m_ucNumOfThreads;
+//next queue for round robin, used by submitting thread only
+static uint8_t         m_ucNextQueue;
+//number of queued requests of all queues, idle workers sleep while 0
+static pthread_mutex_t m_tIdleLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  m_tWorkAvailable = PTHREAD_COND_INITIALIZER;
+static uint32_t        m_ulNumOfQueued;
+static WorkBlock_t     m_atBlocks[WK_MAX_BLOCKS];
+static uint8_t         m_ucNumOfBlocks;
+
+//****************************************************************************/
+//                           Local Functions
+//****************************************************************************/
+//
+//! @brief Check if request touches a designated block
+//! @param[in]  ptRequest  Modbus request
+//! @return     bool       true - request may block
+//
+static bool IsBlocking(const ModbusRequest_t *ptRequest);
+
+//
+//! @brief Queue request to a worker, round robin
+//! @param[in]  ptRequest  Modbus request
+//! @return     bool       true - queued, false - all queues full
+//
+static bool QueueRequest(ModbusRequest_t *ptRequest);
+
+//
+//! @brief Take oldest request of own queue or steal newest request of other queue
+//! @param[in]  ucWorker  Worker index
+//! @return     ModbusRequest_t*  Request
+//
+static ModbusRequest_t *TakeRequest(uint8_t ucWorker);
+
+//
+//! @brief Worker thread
+//! @param[in]  pvWorker  Worker index
+//! @return     void*     Not used
+//
+static void *WorkerThread(void *pvWorker);
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+bool wk_Init(uint8_t ucNumOfThreads)
+{
+    uint8_t ucCount = 0;
+
+    if ((0 == ucNumOfThreads) || (ucNumOfThreads > WK_MAX_THREADS) || (0 != m_ucNumOfThreads))
+    {
+        return false;
+    }
+
+    for (ucCount = 0; ucCount < ucNumOfThreads; ucCount++)
+    {
+        pthread_mutex_init(&m_atQueues[ucCount].tLock, NULL);
+    }
+
+    for (ucCount = 0; ucCount < ucNumOfThreads; ucCount++)
+    {
+        if (0 != pthread_create(&m_atThreads[ucCount], NULL, WorkerThread,
+                                (void *)(uintptr_t)ucCount))
+        {
+            printf("\nError in worker creation\n");
+            break;
+        }
+
+        m_ucNumOfThreads++;
+    }
+
+    return (ucCount == ucNumOfThreads);
+}//end wk_Init
+
+bool wk_AddBlock(uint8_t ucTable, uint16_t usStartAddress, uint16_t usNumOfData)
+{
+    WorkBlock_t *ptBlock = NULL;
+
+    if (m_ucNumOfBlocks >= WK_MAX_BLOCKS)
+    {
+        return false;
+    }
+
+    ptBlock                 = &m_atBlocks[m_ucNumOfBlocks];
+    ptBlock->ucTable        = ucTable;
+    ptBlock->ulStartAddress = usStartAddress;
+    ptBlock->ulEndAddress   = (uint32_t)usStartAddress + usNumOfData;
+    m_ucNumOfBlocks++;
+
+    return true;
+}//end wk_AddBlock
+
+uint8_t wk_AsyncAccess(ModbusRequest_t *ptRequest)
+{
+    //unit image is owned by server thread, only user functions are offloaded
+    if (wk_IsAsyncRange(ptRequest) && QueueRequest(ptRequest))
+    {
+        return eASYNC_PENDING;
+    }
+
+    //in memory data or no free queue entry, access in calling thread
+    return mbap_AccessRequestData(ptRequest);
+}//end wk_AsyncAccess
+
+bool wk_IsAsyncRange(const ModbusRequest_t *ptRequest)
+{
+    return (NULL == ptRequest->ptUnit->ptProfile) && IsBlocking(ptRequest);
+}//end wk_IsAsyncRange
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static bool IsBlocking(const ModbusRequest_t *ptRequest)
+{
+    uint32_t ulStart = ptRequest->usStartAddress;
+    uint32_t ulEnd   = ulStart + ptRequest->usNumOfData;
+    uint8_t  ucCount = 0;
+
+    for (ucCount = 0; ucCount < m_ucNumOfBlocks; ucCount++)
+    {
+        const WorkBlock_t *ptBlock = &m_atBlocks[ucCount];
+
+        if ((ptBlock->ucTable == ptRequest->ucTable) &&
+            (ulStart < ptBlock->ulEndAddress) &&
+            (ptBlock->ulStartAddress < ulEnd))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}//end IsBlocking
+
+static bool QueueRequest(ModbusRequest_t *ptRequest)
+{
+    uint8_t ucCount = 0;
+
+    for (ucCount = 0; ucCount < m_ucNumOfThreads; ucCount++)
+    {
+        WorkQueue_t *ptQueue = &m_atQueues[m_ucNextQueue];
+        bool        bQueued  = false;
+
+        m_ucNextQueue = (uint8_t)((m_ucNextQueue + 1u) % m_ucNumOfThreads);
+
+        pthread_mutex_lock(&ptQueue->tLock);
+
+        if (ptQueue->usCount < WK_QUEUE_SIZE)
+        {
+            ptQueue->aptRequests[(ptQueue->usHead + ptQueue->usCount) % WK_QUEUE_SIZE] = ptRequest;
+            ptQueue->usCount++;
+            bQueued = true;
+        }
+
+        pthread_mutex_unlock(&ptQueue->tLock);
+
+        if (bQueued)
+        {
+            pthread_mutex_lock(&m_tIdleLock);
+            m_ulNumOfQueued++;
+            pthread_cond_signal(&m_tWorkAvailable);
+            pthread_mutex_unlock(&m_tIdleLock);
+
+            return true;
+        }
+    }//end for
+
+    return false;
+}//end QueueRequest
+
+static ModbusRequest_t *TakeRequest(uint8_t ucWorker)
+{
+    ModbusRequest_t *ptRequest = NULL;
+    uint8_t         ucCount    = 0;
+
+    //request counted in m_ulNumOfQueued is in one of the queues
+    while (NULL == ptRequest)
+    {
+        for (ucCount = 0; (ucCount < m_ucNumOfThreads) && (NULL == ptRequest); ucCount++)
+        {
+            WorkQueue_t *ptQueue = &m_atQueues[(ucWorker + ucCount) % m_ucNumOfThreads];
+
+            pthread_mutex_lock(&ptQueue->tLock);
+
+            if (0 != ptQueue->usCount)
+            {
+                ptQueue->usCount--;
+
+                if (0 == ucCount)
+                {
+                    //own queue, oldest first
+                    ptRequest       = ptQueue->aptRequests[ptQueue->usHead];
+                    ptQueue->usHead = (uint16_t)((ptQueue->usHead + 1u) % WK_QUEUE_SIZE);
+                }
+                else
+                {
+                    //steal newest, owner keeps order of its oldest requests
+                    ptRequest = ptQueue->aptRequests[(ptQueue->usHead + ptQueue->usCount) % WK_QUEUE_SIZE];
+                }
+            }
+
+            pthread_mutex_unlock(&ptQueue->tLock);
+        }//end for
+    }//end while
+
+    return ptRequest;
+}//end TakeRequest
+
+static void *WorkerThread(void *pvWorker)
+{
+    uint8_t ucWorker = (uint8_t)(uintptr_t)pvWorker;
+
+    while (1)
+    {
+        ModbusRequest_t *ptRequest   = NULL;
+        uint8_t         ucException  = eNO_EXCEPTION;
+
+        pthread_mutex_lock(&m_tIdleLock);
+
+        while (0 == m_ulNumOfQueued)
+        {
+            pthread_cond_wait(&m_tWorkAvailable, &m_tIdleLock);
+        }
+
+        m_ulNumOfQueued--;
+        pthread_mutex_unlock(&m_tIdleLock);
+
+        ptRequest   = TakeRequest(ucWorker);
+        ucException = mbap_AccessRequestData(ptRequest);
+        mbap_CompleteRequest(ptRequest, ucException);
+    }
+
+    return NULL;
+}//end WorkerThread
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
@@ -0,0 +1,76 @@
+//! @addtogroup TCPServerWorker
+//! @{
+//
+//****************************************************************************
+//! @file worker.h
+//! @brief This contains the prototypes, macros, constants or global variables
+//!        for the worker thread pool running blocking user functions
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//
+//****************************************************************************
+#ifndef WORKER_H
+#define WORKER_H
+
+//****************************************************************************
+//                           Includes
+//****************************************************************************
+
+//****************************************************************************
+//                           Constants and typedefs
+//****************************************************************************
+//! @brief Maximum number of worker threads
+#define WK_MAX_THREADS       (8u)
+//! @brief Number of requests queued per worker thread
+#define WK_QUEUE_SIZE        (64u)
+//! @brief Maximum number of designated address blocks
+#define WK_MAX_BLOCKS        (16u)
+
+//****************************************************************************
+//                           Global variables
+//****************************************************************************
+
+//****************************************************************************
+//                           Global Functions
+//****************************************************************************
+//
+//! @brief Start worker threads
+//! @param[in]  ucNumOfThreads  Number of worker threads, 1 to WK_MAX_THREADS
+//! @return     bool            true - threads started, false - error
+//
+bool wk_Init(uint8_t ucNumOfThreads);
+
+//
+//! @brief Designate an address block whose user functions may block,
+//!        requests touching it are run by worker threads
+//! @param[in]  ucTable         Data table(enum DataTable)
+//! @param[in]  usStartAddress  Start address relative to table start
+//! @param[in]  usNumOfData     Number of data, 0xFFFF with start 0 - whole table
+//! @return     bool            true - block added, false - no free entry
+//
+bool wk_AddBlock(uint8_t ucTable, uint16_t usStartAddress, uint16_t usNumOfData);
+
+//
+//! @brief Asynchronous access function for ModbusData_t::ptfnAsyncAccess.
+//!        Requests touching a designated block of a unit served by user
+//!        functions are queued to worker threads, others are accessed
+//!        directly in the calling thread.
+//! @param[in]  ptRequest  Modbus request
+//! @return     uint8_t    eASYNC_PENDING, eNO_EXCEPTION or exception code
+//
+uint8_t wk_AsyncAccess(ModbusRequest_t *ptRequest);
+
+//
+//! @brief Range check for ModbusData_t::ptfnIsAsyncRange of units served by
+//!        wk_AsyncAccess
+//! @param[in]  ptRequest  Modbus request
+//! @return     bool       true - request touches a designated block and may be
+//!                        queued to a worker
+//
+bool wk_IsAsyncRange(const ModbusRequest_t *ptRequest);
+
+#endif // WORKER_H
+//****************************************************************************
+//                             End of file
+//****************************************************************************
+//! @}
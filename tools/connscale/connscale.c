@@ -0,0 +1,589 @@
+//! @addtogroup ConnectionScaling
+//! @brief Connection scaling benchmark
+//! @{
+//!
+//****************************************************************************/
+//! @file connscale.c
+//! @brief Connection scaling benchmark of the tcp server on loopback.
+//!        Measures latency of a few active clients, opens many idle
+//!        connections, optionally sends light traffic on them and measures
+//!        latency of active clients again. Accept rate is taken from the
+//!        metrics endpoint, memory per connection from resident set size of
+//!        the server process. Slabs taken by the server pools during the
+//!        measured phase show whether the server runs without heap calls.
+//!        Results are printed as JSON.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+//user defined header files
+#include "mbap_hist.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+#define MAX_ACTIVE           64
+#define MAX_IDLE             100000
+//connections per loopback source address, below ephemeral port range
+#define IDLE_PER_SOURCE      20000
+#define METRICS_PORT         9502
+#define METRICS_BUFF_SIZE    (64 * 1024)
+#define QUERY_LEN            12
+#define RESPONSE_BUFF_SIZE   512
+//accepted connections are awaited this long
+#define ACCEPT_TIMEOUT_US    30000000u
+
+//! @brief Settings of a run
+typedef struct Settings
+{
+    const char *pcHost;                             //!<Server address
+    uint16_t   usPort;                              //!<Server port
+    uint32_t   ulNumOfIdle;                         //!<Idle connections
+    uint8_t    ucNumOfActive;                       //!<Active connections
+    uint32_t   ulDurationMs;                        //!<Measured time of each phase
+    uint32_t   ulLightRate;                         //!<Queries per second over all idle connections
+    bool       bSplit;                              //!<Light queries sent in two parts, server holds partial query until next one
+    int        iServerPid;                          //!<Server process for resident set size, 0 - not read
+} Settings_t;
+
+//! @brief Latency of active clients in one phase
+typedef struct Phase
+{
+    uint64_t           ullResponses;                //!<Responses of active clients
+    uint64_t           ullLightQueries;             //!<Queries sent on idle connections
+    uint64_t           ullErrors;                   //!<Lost connections
+    LatencyHistogram_t tLatency;                    //!<Latency, us
+} Phase_t;
+
+//****************************************************************************/
+//                           Local Functions
+//****************************************************************************/
+//
+//! @brief Parse command line
+//! @param[in]  iArgc       Number of arguments
+//! @param[in]  ppcArgv     Arguments
+//! @param[out] ptSettings  Settings
+//! @return     bool        true - settings valid
+//
+static bool ParseArgs(int iArgc, char **ppcArgv, Settings_t *ptSettings);
+
+//
+//! @brief Connect to server
+//! @param[in]  ptSettings  Settings
+//! @param[in]  ulSource    Loopback source address index, 0 - any
+//! @return     int         Socket, -1 on error
+//
+static int Connect(const Settings_t *ptSettings, uint32_t ulSource);
+
+//
+//! @brief Measure latency of active clients, each sends next query after response
+//! @param[in]  ptSettings    Settings
+//! @param[in]  ulDurationMs  Duration of phase
+//! @param[out] ptPhase       Results
+//! @return     None
+//
+static void RunPhase(const Settings_t *ptSettings, uint32_t ulDurationMs, Phase_t *ptPhase);
+
+//
+//! @brief Send a light query on next idle connection, response is read on next visit
+//! @param[in]  bSplit   Send first half of query, rest is sent with next query
+//! @param[out] ptPhase  Results
+//! @return     None
+//
+static void SendLightQuery(bool bSplit, Phase_t *ptPhase);
+
+//
+//! @brief Read a value of metrics endpoint, values of all labels are summed
+//! @param[in]  pcName    Metric name, without labels
+//! @return     double    Value, -1 if not read
+//
+static double ReadMetric(const char *pcName);
+
+//
+//! @brief Read resident set size of server
+//! @param[in]  iPid      Server process
+//! @return     long      Resident set size in kB, -1 if not read
+//
+static long ReadRss(int iPid);
+
+//
+//! @brief Print latency of a phase as JSON object
+//! @param[in]  pcName   Phase name
+//! @param[in]  ptPhase  Results
+//! @param[in]  ulDurationMs  Measured time
+//! @return     None
+//
+static void PrintPhase(const char *pcName, const Phase_t *ptPhase, uint32_t ulDurationMs);
+
+//
+//! @brief Current time of monotonic clock
+//! @param[in]  None
+//! @return     uint64_t  Time in us
+//
+static uint64_t GetTimeUs(void);
+
+//****************************************************************************/
+//                           Local variables
+//****************************************************************************/
+static int      m_aiActive[MAX_ACTIVE];
+static int      m_aiIdle[MAX_IDLE];
+static uint32_t m_ulNumOfIdle;
+static uint32_t m_ulNextIdle;
+//idle connection holding first half of a split query, -1 - none
+static int      m_iPartial = -1;
+static Phase_t  m_tBaseline;
+static Phase_t  m_tWarmup;
+static Phase_t  m_tLoaded;
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+int main(int iArgc, char **ppcArgv)
+{
+    Settings_t    tSettings;
+    struct rlimit tLimit;
+    double        dAccepted   = 0;
+    double        dBaseline   = 0;
+    long          lRssBefore  = 0;
+    long          lRssAfter   = 0;
+    uint64_t      ullStart    = 0;
+    uint64_t      ullConnected = 0;
+    uint64_t      ullAccepted = 0;
+    double        dSlabs      = 0;
+    uint8_t       ucCount     = 0;
+
+    if (!ParseArgs(iArgc, ppcArgv, &tSettings))
+    {
+        fprintf(stderr,
+                "usage: %s [-h host] [-p port] [-n idle connections] [-a active connections]\n"
+                "          [-t seconds per phase] [-l light queries per second] [-s] [-P server pid]\n",
+                ppcArgv[0]);
+        return 1;
+    }
+
+    //idle connections need one descriptor each
+    if ((0 == getrlimit(RLIMIT_NOFILE, &tLimit)) && (tLimit.rlim_cur < tLimit.rlim_max))
+    {
+        tLimit.rlim_cur = tLimit.rlim_max;
+        (void)setrlimit(RLIMIT_NOFILE, &tLimit);
+    }
+
+    for (ucCount = 0; ucCount < tSettings.ucNumOfActive; ucCount++)
+    {
+        m_aiActive[ucCount] = Connect(&tSettings, 0);
+
+        if (m_aiActive[ucCount] < 0)
+        {
+            fprintf(stderr, "connect failed: %s\n", strerror(errno));
+            return 1;
+        }
+    }
+
+    RunPhase(&tSettings, tSettings.ulDurationMs, &m_tBaseline);
+    lRssBefore = ReadRss(tSettings.iServerPid);
+    dBaseline  = ReadMetric("modbus_connections_accepted_total");
+
+    ullStart = GetTimeUs();
+
+    for (m_ulNumOfIdle = 0; m_ulNumOfIdle < tSettings.ulNumOfIdle; m_ulNumOfIdle++)
+    {
+        m_aiIdle[m_ulNumOfIdle] = Connect(&tSettings, 1u + (m_ulNumOfIdle / IDLE_PER_SOURCE));
+
+        if (m_aiIdle[m_ulNumOfIdle] < 0)
+        {
+            fprintf(stderr, "connect %lu failed: %s\n", (unsigned long)m_ulNumOfIdle, strerror(errno));
+            break;
+        }
+    }
+
+    ullConnected = GetTimeUs();
+    ullAccepted  = ullConnected;
+
+    //connect returns before server accepts, wait until server counts all
+    while ((dBaseline >= 0) && (GetTimeUs() < (ullConnected + ACCEPT_TIMEOUT_US)))
+    {
+        dAccepted   = ReadMetric("modbus_connections_accepted_total");
+        ullAccepted = GetTimeUs();
+
+        if ((dAccepted - dBaseline) >= m_ulNumOfIdle)
+        {
+            break;
+        }
+
+        usleep(1000);
+    }
+
+    //let server settle before memory is read
+    usleep(200000);
+    lRssAfter = ReadRss(tSettings.iServerPid);
+
+    //pools grow to peak use of loaded phase during warmup, no heap call after
+    RunPhase(&tSettings, tSettings.ulDurationMs / 5u, &m_tWarmup);
+    dSlabs = ReadMetric("modbus_pool_slabs_total");
+    RunPhase(&tSettings, tSettings.ulDurationMs, &m_tLoaded);
+
+    printf("{\n"
+           "  \"idle_connections\": %lu,\n"
+           "  \"active_connections\": %u,\n"
+           "  \"light_rate\": %lu,\n"
+           "  \"connect_per_sec\": %.1f,\n"
+           "  \"accept_per_sec\": %.1f,\n"
+           "  \"server_connections\": %.0f,\n"
+           "  \"server_rx_buffers\": %.0f,\n"
+           "  \"server_transactions\": %.0f,\n"
+           "  \"rss_before_kb\": %ld,\n"
+           "  \"rss_after_kb\": %ld,\n"
+           "  \"rss_per_connection_bytes\": %.1f,\n"
+           "  \"slabs_taken_under_load\": %.0f,\n",
+           (unsigned long)m_ulNumOfIdle,
+           tSettings.ucNumOfActive,
+           (unsigned long)tSettings.ulLightRate,
+           m_ulNumOfIdle / ((ullConnected - ullStart + 1u) / 1e6),
+           m_ulNumOfIdle / ((ullAccepted - ullStart + 1u) / 1e6),
+           ReadMetric("modbus_connections"),
+           ReadMetric("modbus_rx_buffers"),
+           ReadMetric("modbus_transactions"),
+           lRssBefore,
+           lRssAfter,
+           ((lRssBefore < 0) || (lRssAfter < 0) || (0 == m_ulNumOfIdle)) ?
+           0.0 : (((lRssAfter - lRssBefore) * 1024.0) / m_ulNumOfIdle),
+           (dSlabs < 0) ? -1.0 : (ReadMetric("modbus_pool_slabs_total") - dSlabs));
+    PrintPhase("baseline", &m_tBaseline, tSettings.ulDurationMs);
+    printf(",\n");
+    PrintPhase("with_idle", &m_tLoaded, tSettings.ulDurationMs);
+    printf("\n}\n");
+
+    return 0;
+}//end main
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static bool ParseArgs(int iArgc, char **ppcArgv, Settings_t *ptSettings)
+{
+    int iOption = 0;
+
+    memset(ptSettings, 0, sizeof(Settings_t));
+    ptSettings->pcHost        = "127.0.0.1";
+    ptSettings->usPort        = 502;
+    ptSettings->ulNumOfIdle   = 5000;
+    ptSettings->ucNumOfActive = 4;
+    ptSettings->ulDurationMs  = 3000;
+
+    while (-1 != (iOption = getopt(iArgc, ppcArgv, "h:p:n:a:t:l:sP:")))
+    {
+        switch (iOption)
+        {
+        case 'h': ptSettings->pcHost        = optarg;                             break;
+        case 'p': ptSettings->usPort        = (uint16_t)atoi(optarg);             break;
+        case 'n': ptSettings->ulNumOfIdle   = (uint32_t)atol(optarg);             break;
+        case 'a': ptSettings->ucNumOfActive = (uint8_t)atoi(optarg);              break;
+        case 't': ptSettings->ulDurationMs  = (uint32_t)(atof(optarg) * 1000.0);  break;
+        case 'l': ptSettings->ulLightRate   = (uint32_t)atol(optarg);             break;
+        case 's': ptSettings->bSplit        = true;                               break;
+        case 'P': ptSettings->iServerPid    = atoi(optarg);                       break;
+        default:
+            return false;
+        }
+    }
+
+    return (ptSettings->ulNumOfIdle <= MAX_IDLE) && (0 != ptSettings->ucNumOfActive) &&
+           (ptSettings->ucNumOfActive <= MAX_ACTIVE) && (0 != ptSettings->ulDurationMs);
+}//end ParseArgs
+
+static int Connect(const Settings_t *ptSettings, uint32_t ulSource)
+{
+    struct sockaddr_in tAddress;
+    int                iSocket = socket(AF_INET, SOCK_STREAM, 0);
+    int                iOption = 1;
+
+    if (iSocket < 0)
+    {
+        return -1;
+    }
+
+    if (0 != ulSource)
+    {
+        //127.0.0.x source addresses give more ephemeral ports towards one server port
+        memset(&tAddress, 0, sizeof(tAddress));
+        tAddress.sin_family      = AF_INET;
+        tAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK + ulSource - 1u);
+
+        if (0 != bind(iSocket, (struct sockaddr *)&tAddress, sizeof(tAddress)))
+        {
+            close(iSocket);
+            return -1;
+        }
+    }
+
+    memset(&tAddress, 0, sizeof(tAddress));
+    tAddress.sin_family = AF_INET;
+    tAddress.sin_port   = htons(ptSettings->usPort);
+
+    if ((1 != inet_pton(AF_INET, ptSettings->pcHost, &tAddress.sin_addr)) ||
+        (0 != connect(iSocket, (struct sockaddr *)&tAddress, sizeof(tAddress))))
+    {
+        close(iSocket);
+        return -1;
+    }
+
+    (void)setsockopt(iSocket, IPPROTO_TCP, TCP_NODELAY, &iOption, sizeof(iOption));
+
+    return iSocket;
+}//end Connect
+
+static void RunPhase(const Settings_t *ptSettings, uint32_t ulDurationMs, Phase_t *ptPhase)
+{
+    static const uint8_t aucQuery[QUERY_LEN] = {0, 1, 0, 0, 0, 6, 1, 3, 0, 0, 0, 10};
+    struct pollfd tPollFds[MAX_ACTIVE];
+    uint64_t      aullSent[MAX_ACTIVE];
+    uint64_t      ullEnd       = GetTimeUs() + ((uint64_t)ulDurationMs * 1000u);
+    uint64_t      ullNextLight = GetTimeUs();
+    uint64_t      ullInterval  = (0 == ptSettings->ulLightRate) ? 0 : (1000000u / ptSettings->ulLightRate);
+    uint8_t       ucCount      = 0;
+
+    for (ucCount = 0; ucCount < ptSettings->ucNumOfActive; ucCount++)
+    {
+        tPollFds[ucCount].fd     = m_aiActive[ucCount];
+        tPollFds[ucCount].events = POLLIN;
+        aullSent[ucCount]        = GetTimeUs();
+
+        if (send(m_aiActive[ucCount], aucQuery, QUERY_LEN, MSG_NOSIGNAL) != QUERY_LEN)
+        {
+            ptPhase->ullErrors++;
+        }
+    }
+
+    while (GetTimeUs() < ullEnd)
+    {
+        int iTimeoutMs = 10;
+
+        while ((0 != m_ulNumOfIdle) && (0 != ullInterval) && (ullNextLight <= GetTimeUs()))
+        {
+            SendLightQuery(ptSettings->bSplit, ptPhase);
+            ullNextLight += ullInterval;
+        }
+
+        if (0 != ullInterval)
+        {
+            uint64_t ullNow = GetTimeUs();
+
+            iTimeoutMs = (ullNextLight <= ullNow) ? 0 : (int)((ullNextLight - ullNow) / 1000u);
+        }
+
+        if (poll(tPollFds, ptSettings->ucNumOfActive, iTimeoutMs) <= 0)
+        {
+            continue;
+        }
+
+        for (ucCount = 0; ucCount < ptSettings->ucNumOfActive; ucCount++)
+        {
+            uint8_t  aucResponse[RESPONSE_BUFF_SIZE];
+            uint64_t ullNow = 0;
+
+            if ((tPollFds[ucCount].fd < 0) || !(tPollFds[ucCount].revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                continue;
+            }
+
+            //one query in flight, a response arrives in one segment on loopback
+            if (recv(tPollFds[ucCount].fd, aucResponse, sizeof(aucResponse), 0) <= 0)
+            {
+                ptPhase->ullErrors++;
+                tPollFds[ucCount].fd = -1;
+                continue;
+            }
+
+            ullNow = GetTimeUs();
+            mbap_HistRecord(&ptPhase->tLatency, (uint32_t)(ullNow - aullSent[ucCount]));
+            ptPhase->ullResponses++;
+            aullSent[ucCount] = ullNow;
+
+            if (send(tPollFds[ucCount].fd, aucQuery, QUERY_LEN, MSG_NOSIGNAL) != QUERY_LEN)
+            {
+                ptPhase->ullErrors++;
+                tPollFds[ucCount].fd = -1;
+            }
+        }//end for
+    }//end while
+
+    //take responses of last queries so that next phase starts clean
+    for (ucCount = 0; ucCount < ptSettings->ucNumOfActive; ucCount++)
+    {
+        uint8_t aucResponse[RESPONSE_BUFF_SIZE];
+
+        if ((tPollFds[ucCount].fd >= 0) && (poll(&tPollFds[ucCount], 1, 1000) > 0))
+        {
+            (void)recv(tPollFds[ucCount].fd, aucResponse, sizeof(aucResponse), 0);
+        }
+    }
+}//end RunPhase
+
+static void SendLightQuery(bool bSplit, Phase_t *ptPhase)
+{
+    static const uint8_t aucQuery[QUERY_LEN] = {0, 2, 0, 0, 0, 6, 1, 4, 0, 0, 0, 2};
+    uint8_t              aucResponse[RESPONSE_BUFF_SIZE];
+    ssize_t              sLen    = bSplit ? (QUERY_LEN / 2) : QUERY_LEN;
+    int                  iSocket = m_aiIdle[m_ulNextIdle];
+
+    m_ulNextIdle = (m_ulNextIdle + 1u) % m_ulNumOfIdle;
+
+    if (-1 != m_iPartial)
+    {
+        //server kept first half in a receive buffer until now
+        if (send(m_iPartial, &aucQuery[QUERY_LEN / 2], QUERY_LEN / 2, MSG_NOSIGNAL) != (QUERY_LEN / 2))
+        {
+            ptPhase->ullErrors++;
+        }
+
+        m_iPartial = -1;
+    }
+
+    //response of previous visit
+    while (recv(iSocket, aucResponse, sizeof(aucResponse), MSG_DONTWAIT) > 0)
+    {
+    }
+
+    if (send(iSocket, aucQuery, (size_t)sLen, MSG_NOSIGNAL) == sLen)
+    {
+        ptPhase->ullLightQueries++;
+        m_iPartial = bSplit ? iSocket : -1;
+    }
+    else
+    {
+        ptPhase->ullErrors++;
+    }
+}//end SendLightQuery
+
+static double ReadMetric(const char *pcName)
+{
+    static char        acBuf[METRICS_BUFF_SIZE];
+    struct sockaddr_in tAddress;
+    const char         *pcLine  = acBuf;
+    size_t             ulLen    = 0;
+    size_t             ulName   = strlen(pcName);
+    ssize_t            sReturn  = 0;
+    int                iSocket  = socket(AF_INET, SOCK_STREAM, 0);
+    const char         *pcGet   = "GET /metrics HTTP/1.0\r\n\r\n";
+    double             dValue   = -1;
+
+    memset(&tAddress, 0, sizeof(tAddress));
+    tAddress.sin_family      = AF_INET;
+    tAddress.sin_port        = htons(METRICS_PORT);
+    tAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ((iSocket < 0) || (0 != connect(iSocket, (struct sockaddr *)&tAddress, sizeof(tAddress))) ||
+        (send(iSocket, pcGet, strlen(pcGet), MSG_NOSIGNAL) < 0))
+    {
+        if (iSocket >= 0)
+        {
+            close(iSocket);
+        }
+        return -1;
+    }
+
+    while ((ulLen < (sizeof(acBuf) - 1u)) &&
+           ((sReturn = recv(iSocket, &acBuf[ulLen], sizeof(acBuf) - 1u - ulLen, 0)) > 0))
+    {
+        ulLen += (size_t)sReturn;
+    }
+
+    close(iSocket);
+    acBuf[ulLen] = '\0';
+
+    while (NULL != (pcLine = strchr(pcLine, '\n')))
+    {
+        pcLine++;
+
+        if ((0 == strncmp(pcLine, pcName, ulName)) && ((' ' == pcLine[ulName]) || ('{' == pcLine[ulName])))
+        {
+            const char *pcValue = strchr(&pcLine[ulName], ' ');
+
+            dValue = (dValue < 0) ? 0 : dValue;
+            dValue += (NULL == pcValue) ? 0 : atof(pcValue);
+        }
+    }
+
+    return dValue;
+}//end ReadMetric
+
+static long ReadRss(int iPid)
+{
+    char acPath[64];
+    char acLine[128];
+    long lRss   = -1;
+    FILE *ptFile = NULL;
+
+    if (0 == iPid)
+    {
+        return -1;
+    }
+
+    snprintf(acPath, sizeof(acPath), "/proc/%d/status", iPid);
+    ptFile = fopen(acPath, "r");
+
+    if (NULL == ptFile)
+    {
+        return -1;
+    }
+
+    while (NULL != fgets(acLine, sizeof(acLine), ptFile))
+    {
+        if (1 == sscanf(acLine, "VmRSS: %ld kB", &lRss))
+        {
+            break;
+        }
+    }
+
+    fclose(ptFile);
+
+    return lRss;
+}//end ReadRss
+
+static void PrintPhase(const char *pcName, const Phase_t *ptPhase, uint32_t ulDurationMs)
+{
+    const LatencyHistogram_t *ptLatency = &ptPhase->tLatency;
+
+    printf("  \"%s\": {\"requests_per_sec\": %.1f, \"light_queries\": %llu, \"errors\": %llu, "
+           "\"latency_us\": {\"p50\": %lu, \"p99\": %lu, \"p999\": %lu, \"max\": %lu}}",
+           pcName,
+           ptPhase->ullResponses / (ulDurationMs / 1e3),
+           (unsigned long long)ptPhase->ullLightQueries,
+           (unsigned long long)ptPhase->ullErrors,
+           (unsigned long)mbap_HistPercentile(ptLatency, 500),
+           (unsigned long)mbap_HistPercentile(ptLatency, 990),
+           (unsigned long)mbap_HistPercentile(ptLatency, 999),
+           (unsigned long)ptLatency->ulMax);
+}//end PrintPhase
+
+static uint64_t GetTimeUs(void)
+{
+    struct timespec tNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &tNow);
+
+    return ((uint64_t)tNow.tv_sec * 1000000u) + ((uint64_t)tNow.tv_nsec / 1000u);
+}//end GetTimeUs
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
@@ -0,0 +1,646 @@
+//! @addtogroup LoadGenerator
+//! @brief Modbus TCP load generator
+//! @{
+//!
+//****************************************************************************/
+//! @file loadgen.c
+//! @brief Load generator for end to end benchmarks of the tcp server on
+//!        loopback. Opens N connections with a pipelining depth and sends a
+//!        weighted mix of queries.
+//!        Closed loop: every response triggers next query, measures throughput.
+//!        Open loop: queries are due at a constant rate, latency is measured
+//!        from the due time, so a stalled server is not hidden by queries
+//!        which were never sent(coordinated omission).
+//!        Results are printed as JSON.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+//user defined header files
+#include "mbap_hist.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+#define MAX_CONNECTIONS      1024
+#define MAX_DEPTH            64
+#define MAX_OPERATIONS       16
+//due times of queries not sent yet per connection in open loop
+#define BACKLOG_SIZE         1024
+#define BUFF_SIZE_IN_BYTES   260
+#define RX_BUFF_SIZE         (4 * BUFF_SIZE_IN_BYTES)
+#define MBAP_PREFIX_LEN      6
+#define MBAP_HEADER_LEN      7
+//outstanding slot is kept in low bits of transaction id
+#define SLOT_BITS            6
+#define SLOT_MASK            ((1u << SLOT_BITS) - 1u)
+//responses are awaited this long after end of run
+#define DRAIN_TIME_US        1000000u
+
+//! @brief Query of the mix
+typedef struct Operation
+{
+    uint8_t  ucFunctionCode;                        //!<Function code
+    uint16_t usAddress;                             //!<Start address
+    uint16_t usCount;                               //!<Number of data, value for single writes
+    uint8_t  ucWeight;                              //!<Share of mix
+} Operation_t;
+
+//! @brief Query waiting for response
+typedef struct Outstanding
+{
+    bool     bInUse;                                //!<Slot in use
+    uint64_t ullStart;                              //!<Due time of query, us
+} Outstanding_t;
+
+//! @brief Client connection
+typedef struct Client
+{
+    int           iSocket;                          //!<Socket
+    uint16_t      usGeneration;                     //!<Upper bits of transaction id
+    uint8_t       ucNumOfOutstanding;               //!<Queries waiting for response
+    Outstanding_t atOutstanding[MAX_DEPTH];         //!<Queries waiting for response
+    uint16_t      usBacklogHead;                    //!<Oldest due query
+    uint16_t      usNumOfBacklog;                   //!<Due queries not sent yet
+    uint64_t      aullBacklog[BACKLOG_SIZE];        //!<Due times, us
+    uint16_t      usRxLen;                          //!<Bytes in receive buffer
+    uint8_t       aucRxBuf[RX_BUFF_SIZE];           //!<Receive buffer
+} Client_t;
+
+//! @brief Settings of a run
+typedef struct Settings
+{
+    const char    *pcHost;                          //!<Server address
+    uint16_t      usPort;                           //!<Server port
+    uint16_t      usNumOfConnections;               //!<Number of connections
+    uint8_t       ucDepth;                          //!<Queries in flight per connection
+    uint32_t      ulDurationMs;                     //!<Measured run time
+    uint32_t      ulWarmupMs;                       //!<Run time before measurement
+    uint32_t      ulRate;                           //!<Queries per second, 0 - closed loop
+    uint8_t       ucUnitId;                         //!<Unit id of queries
+    uint8_t       ucNumOfOperations;                //!<Number of queries in mix
+    Operation_t   atOperations[MAX_OPERATIONS];     //!<Mix
+} Settings_t;
+
+//! @brief Results of a run
+typedef struct Results
+{
+    uint64_t           ullSent;                     //!<Queries sent
+    uint64_t           ullResponses;                //!<Responses measured
+    uint64_t           ullExceptions;               //!<Exception responses measured
+    uint64_t           ullErrors;                   //!<Unexpected responses or lost connections
+    uint64_t           ullBacklogOverflows;         //!<Due queries not kept, open loop only
+    LatencyHistogram_t tLatency;                    //!<Latency, us
+} Results_t;
+
+//****************************************************************************/
+//                           Local Functions
+//****************************************************************************/
+//
+//! @brief Parse command line
+//! @param[in]  iArgc       Number of arguments
+//! @param[in]  ppcArgv     Arguments
+//! @param[out] ptSettings  Settings
+//! @return     bool        true - settings valid
+//
+static bool ParseArgs(int iArgc, char **ppcArgv, Settings_t *ptSettings);
+
+//
+//! @brief Parse mix, fc:address:count[:weight] separated by comma
+//! @param[in]  pcMix       Mix
+//! @param[out] ptSettings  Settings
+//! @return     bool        true - mix valid
+//
+static bool ParseMix(const char *pcMix, Settings_t *ptSettings);
+
+//
+//! @brief Connect a client
+//! @param[in]  ptSettings  Settings
+//! @return     int         Socket, -1 on error
+//
+static int Connect(const Settings_t *ptSettings);
+
+//
+//! @brief Send next query of mix
+//! @param[in]  ptClient    Client
+//! @param[in]  ptSettings  Settings
+//! @param[in]  ullStart    Due time of query, us
+//! @return     bool        true - sent
+//
+static bool SendQuery(Client_t *ptClient, const Settings_t *ptSettings, uint64_t ullStart);
+
+//
+//! @brief Receive responses of a client
+//! @param[in]  ptClient    Client
+//! @param[in]  ullMeasure  Responses of queries due from this time are measured, us
+//! @param[out] ptResults   Results
+//! @return     bool        false - connection lost
+//
+static bool ReceiveResponses(Client_t *ptClient, uint64_t ullMeasure, Results_t *ptResults);
+
+//
+//! @brief Print results as JSON
+//! @param[in]  ptSettings  Settings
+//! @param[in]  ptResults   Results
+//! @param[in]  ullTimeUs   Measured run time, us
+//! @return     None
+//
+static void PrintResults(const Settings_t *ptSettings, const Results_t *ptResults, uint64_t ullTimeUs);
+
+//
+//! @brief Current time of monotonic clock
+//! @param[in]  None
+//! @return     uint64_t  Time in us
+//
+static uint64_t GetTimeUs(void);
+
+//****************************************************************************/
+//                           Local variables
+//****************************************************************************/
+static Client_t      m_atClients[MAX_CONNECTIONS];
+static struct pollfd m_atPollFds[MAX_CONNECTIONS];
+static Results_t     m_tResults;
+//order of operations by weight
+static uint8_t       m_aucSchedule[MAX_OPERATIONS * 255];
+static uint16_t      m_usScheduleLen;
+static uint16_t      m_usNextOperation;
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+int main(int iArgc, char **ppcArgv)
+{
+    Settings_t tSettings;
+    uint64_t   ullStart     = 0;
+    uint64_t   ullMeasure   = 0;
+    uint64_t   ullEnd       = 0;
+    uint64_t   ullNextDue   = 0;
+    uint64_t   ullInterval  = 0;
+    uint64_t   ullNow       = 0;
+    uint32_t   ulOutstanding = 0;
+    uint16_t   usNextClient = 0;
+    uint16_t   usCount      = 0;
+
+    if (!ParseArgs(iArgc, ppcArgv, &tSettings))
+    {
+        fprintf(stderr,
+                "usage: %s [-h host] [-p port] [-c connections] [-d depth] [-t seconds]\n"
+                "          [-w warmup seconds] [-r rate] [-u unit id] [-m fc:addr:count[:weight],...]\n"
+                "rate 0 - closed loop, else open loop with queries per second of all connections\n",
+                ppcArgv[0]);
+        return 1;
+    }
+
+    for (usCount = 0; usCount < tSettings.usNumOfConnections; usCount++)
+    {
+        m_atClients[usCount].iSocket = Connect(&tSettings);
+
+        if (m_atClients[usCount].iSocket < 0)
+        {
+            fprintf(stderr, "connect failed: %s\n", strerror(errno));
+            return 1;
+        }
+
+        m_atPollFds[usCount].fd     = m_atClients[usCount].iSocket;
+        m_atPollFds[usCount].events = POLLIN;
+    }
+
+    ullStart    = GetTimeUs();
+    ullMeasure  = ullStart + ((uint64_t)tSettings.ulWarmupMs * 1000u);
+    ullEnd      = ullMeasure + ((uint64_t)tSettings.ulDurationMs * 1000u);
+    ullNextDue  = ullStart;
+    ullInterval = (0 == tSettings.ulRate) ? 0 : (1000000u / tSettings.ulRate);
+
+    if ((0 != tSettings.ulRate) && (0 == ullInterval))
+    {
+        ullInterval = 1;
+    }
+
+    while (1)
+    {
+        int iTimeoutMs = 100;
+
+        ullNow = GetTimeUs();
+
+        if ((ullNow >= ullEnd) && ((0 == ulOutstanding) || (ullNow >= ullEnd + DRAIN_TIME_US)))
+        {
+            break;
+        }
+
+        //open loop, queries become due at constant rate regardless of responses
+        while ((0 != ullInterval) && (ullNextDue <= ullNow) && (ullNextDue < ullEnd))
+        {
+            Client_t *ptClient = &m_atClients[usNextClient];
+
+            if (ptClient->usNumOfBacklog < BACKLOG_SIZE)
+            {
+                ptClient->aullBacklog[(ptClient->usBacklogHead + ptClient->usNumOfBacklog) % BACKLOG_SIZE] = ullNextDue;
+                ptClient->usNumOfBacklog++;
+            }
+            else if (ullNextDue >= ullMeasure)
+            {
+                m_tResults.ullBacklogOverflows++;
+            }
+
+            ullNextDue  += ullInterval;
+            usNextClient = (uint16_t)((usNextClient + 1u) % tSettings.usNumOfConnections);
+        }
+
+        for (usCount = 0; usCount < tSettings.usNumOfConnections; usCount++)
+        {
+            Client_t *ptClient = &m_atClients[usCount];
+
+            while ((ptClient->iSocket >= 0) && (ptClient->ucNumOfOutstanding < tSettings.ucDepth))
+            {
+                uint64_t ullDue = ullNow;
+
+                if (0 != ullInterval)
+                {
+                    if (0 == ptClient->usNumOfBacklog)
+                    {
+                        break;
+                    }
+
+                    ullDue = ptClient->aullBacklog[ptClient->usBacklogHead];
+                    ptClient->usBacklogHead = (uint16_t)((ptClient->usBacklogHead + 1u) % BACKLOG_SIZE);
+                    ptClient->usNumOfBacklog--;
+                }
+                else if (ullNow >= ullEnd)
+                {
+                    break;
+                }
+
+                if (!SendQuery(ptClient, &tSettings, ullDue))
+                {
+                    m_tResults.ullErrors++;
+                    close(ptClient->iSocket);
+                    ptClient->iSocket          = -1;
+                    m_atPollFds[usCount].fd    = -1;
+                    break;
+                }
+
+                if (ullDue >= ullMeasure)
+                {
+                    m_tResults.ullSent++;
+                }
+            }//end while
+        }//end for
+
+        if ((0 != ullInterval) && (ullNextDue < ullEnd))
+        {
+            //wake up when next query is due, 0 spins for high rates
+            iTimeoutMs = (ullNextDue <= ullNow) ? 0 : (int)((ullNextDue - ullNow) / 1000u);
+        }
+
+        if ((poll(m_atPollFds, tSettings.usNumOfConnections, iTimeoutMs) < 0) && (EINTR != errno))
+        {
+            fprintf(stderr, "poll failed: %s\n", strerror(errno));
+            return 1;
+        }
+
+        ulOutstanding = 0;
+
+        for (usCount = 0; usCount < tSettings.usNumOfConnections; usCount++)
+        {
+            Client_t *ptClient = &m_atClients[usCount];
+
+            if ((ptClient->iSocket >= 0) && (m_atPollFds[usCount].revents & (POLLIN | POLLHUP | POLLERR)) &&
+                !ReceiveResponses(ptClient, ullMeasure, &m_tResults))
+            {
+                m_tResults.ullErrors += ptClient->ucNumOfOutstanding;
+                close(ptClient->iSocket);
+                ptClient->iSocket          = -1;
+                ptClient->ucNumOfOutstanding = 0;
+                m_atPollFds[usCount].fd    = -1;
+            }
+
+            ulOutstanding += ptClient->ucNumOfOutstanding;
+        }
+    }//end while
+
+    PrintResults(&tSettings, &m_tResults, ullEnd - ullMeasure);
+
+    return 0;
+}//end main
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static bool ParseArgs(int iArgc, char **ppcArgv, Settings_t *ptSettings)
+{
+    int iOption = 0;
+
+    memset(ptSettings, 0, sizeof(Settings_t));
+    ptSettings->pcHost             = "127.0.0.1";
+    ptSettings->usPort             = 502;
+    ptSettings->usNumOfConnections = 1;
+    ptSettings->ucDepth            = 1;
+    ptSettings->ulDurationMs       = 10000;
+    ptSettings->ucUnitId           = 1;
+
+    while (-1 != (iOption = getopt(iArgc, ppcArgv, "h:p:c:d:t:w:r:u:m:")))
+    {
+        switch (iOption)
+        {
+        case 'h': ptSettings->pcHost             = optarg;                                     break;
+        case 'p': ptSettings->usPort             = (uint16_t)atoi(optarg);                     break;
+        case 'c': ptSettings->usNumOfConnections = (uint16_t)atoi(optarg);                     break;
+        case 'd': ptSettings->ucDepth            = (uint8_t)atoi(optarg);                      break;
+        case 't': ptSettings->ulDurationMs       = (uint32_t)(atof(optarg) * 1000.0);          break;
+        case 'w': ptSettings->ulWarmupMs         = (uint32_t)(atof(optarg) * 1000.0);          break;
+        case 'r': ptSettings->ulRate             = (uint32_t)atol(optarg);                     break;
+        case 'u': ptSettings->ucUnitId           = (uint8_t)atoi(optarg);                      break;
+        case 'm':
+            if (!ParseMix(optarg, ptSettings))
+            {
+                return false;
+            }
+            break;
+        default:
+            return false;
+        }
+    }//end while
+
+    if (0 == ptSettings->ucNumOfOperations)
+    {
+        //default mix reads 10 holding registers
+        (void)ParseMix("3:0:10", ptSettings);
+    }
+
+    return (0 != ptSettings->usNumOfConnections) && (ptSettings->usNumOfConnections <= MAX_CONNECTIONS) &&
+           (0 != ptSettings->ucDepth) && (ptSettings->ucDepth <= MAX_DEPTH) && (0 != ptSettings->ulDurationMs);
+}//end ParseArgs
+
+static bool ParseMix(const char *pcMix, Settings_t *ptSettings)
+{
+    const char *pcEntry = pcMix;
+
+    ptSettings->ucNumOfOperations = 0;
+    m_usScheduleLen               = 0;
+
+    while ((NULL != pcEntry) && ('\0' != *pcEntry))
+    {
+        Operation_t *ptOperation = NULL;
+        unsigned    uFunctionCode = 0;
+        unsigned    uAddress      = 0;
+        unsigned    uCount        = 0;
+        unsigned    uWeight       = 1;
+        unsigned    uCountWeight  = 0;
+
+        if ((ptSettings->ucNumOfOperations >= MAX_OPERATIONS) ||
+            (sscanf(pcEntry, "%u:%u:%u:%u", &uFunctionCode, &uAddress, &uCount, &uWeight) < 3) ||
+            (0 == uWeight) || (uWeight > 255))
+        {
+            return false;
+        }
+
+        ptOperation                 = &ptSettings->atOperations[ptSettings->ucNumOfOperations];
+        ptOperation->ucFunctionCode = (uint8_t)uFunctionCode;
+        ptOperation->usAddress      = (uint16_t)uAddress;
+        ptOperation->usCount        = (uint16_t)uCount;
+        ptOperation->ucWeight       = (uint8_t)uWeight;
+
+        for (uCountWeight = 0; uCountWeight < uWeight; uCountWeight++)
+        {
+            m_aucSchedule[m_usScheduleLen++] = ptSettings->ucNumOfOperations;
+        }
+
+        ptSettings->ucNumOfOperations++;
+        pcEntry = strchr(pcEntry, ',');
+
+        if (NULL != pcEntry)
+        {
+            pcEntry++;
+        }
+    }//end while
+
+    return (0 != ptSettings->ucNumOfOperations);
+}//end ParseMix
+
+static int Connect(const Settings_t *ptSettings)
+{
+    struct sockaddr_in tServer;
+    int                iSocket  = socket(AF_INET, SOCK_STREAM, 0);
+    int                iOption  = 1;
+
+    if (iSocket < 0)
+    {
+        return -1;
+    }
+
+    memset(&tServer, 0, sizeof(tServer));
+    tServer.sin_family = AF_INET;
+    tServer.sin_port   = htons(ptSettings->usPort);
+
+    if ((1 != inet_pton(AF_INET, ptSettings->pcHost, &tServer.sin_addr)) ||
+        (0 != connect(iSocket, (struct sockaddr *)&tServer, sizeof(tServer))))
+    {
+        close(iSocket);
+        return -1;
+    }
+
+    (void)setsockopt(iSocket, IPPROTO_TCP, TCP_NODELAY, &iOption, sizeof(iOption));
+
+    return iSocket;
+}//end Connect
+
+static bool SendQuery(Client_t *ptClient, const Settings_t *ptSettings, uint64_t ullStart)
+{
+    const Operation_t *ptOperation = &ptSettings->atOperations[m_aucSchedule[m_usNextOperation]];
+    uint8_t           aucQuery[BUFF_SIZE_IN_BYTES];
+    uint16_t          usPduLen     = 5;
+    uint16_t          usTid        = 0;
+    uint8_t           ucSlot       = 0;
+
+    m_usNextOperation = (uint16_t)((m_usNextOperation + 1u) % m_usScheduleLen);
+
+    for (ucSlot = 0; ucSlot < MAX_DEPTH; ucSlot++)
+    {
+        if (!ptClient->atOutstanding[ucSlot].bInUse)
+        {
+            break;
+        }
+    }
+
+    usTid = (uint16_t)((ptClient->usGeneration++ << SLOT_BITS) | ucSlot);
+
+    memset(aucQuery, 0, sizeof(aucQuery));
+    aucQuery[0] = (uint8_t)(usTid >> 8);
+    aucQuery[1] = (uint8_t)usTid;
+    aucQuery[6] = ptSettings->ucUnitId;
+    aucQuery[7] = ptOperation->ucFunctionCode;
+    aucQuery[8] = (uint8_t)(ptOperation->usAddress >> 8);
+    aucQuery[9] = (uint8_t)ptOperation->usAddress;
+
+    if (5 == ptOperation->ucFunctionCode)
+    {
+        //count 0 switches coil off, else on
+        aucQuery[10] = (0 != ptOperation->usCount) ? 0xFF : 0x00;
+    }
+    else
+    {
+        aucQuery[10] = (uint8_t)(ptOperation->usCount >> 8);
+        aucQuery[11] = (uint8_t)ptOperation->usCount;
+    }
+
+    if ((15 == ptOperation->ucFunctionCode) || (16 == ptOperation->ucFunctionCode))
+    {
+        uint16_t usNumOfBytes = (15 == ptOperation->ucFunctionCode) ?
+                                (uint16_t)((ptOperation->usCount + 7u) / 8u) : (uint16_t)(ptOperation->usCount * 2u);
+
+        if (usNumOfBytes > (BUFF_SIZE_IN_BYTES - MBAP_HEADER_LEN - 6u))
+        {
+            usNumOfBytes = BUFF_SIZE_IN_BYTES - MBAP_HEADER_LEN - 6u;
+        }
+
+        //data bytes stay 0, valid for any register limits including 0
+        aucQuery[12] = (uint8_t)usNumOfBytes;
+        usPduLen    += (uint16_t)(1u + usNumOfBytes);
+    }
+
+    aucQuery[4] = (uint8_t)((usPduLen + 1u) >> 8);
+    aucQuery[5] = (uint8_t)(usPduLen + 1u);
+
+    if (send(ptClient->iSocket, aucQuery, MBAP_HEADER_LEN + usPduLen, MSG_NOSIGNAL) != (ssize_t)(MBAP_HEADER_LEN + usPduLen))
+    {
+        return false;
+    }
+
+    ptClient->atOutstanding[ucSlot].bInUse   = true;
+    ptClient->atOutstanding[ucSlot].ullStart = ullStart;
+    ptClient->ucNumOfOutstanding++;
+
+    return true;
+}//end SendQuery
+
+static bool ReceiveResponses(Client_t *ptClient, uint64_t ullMeasure, Results_t *ptResults)
+{
+    ssize_t  sReturn = recv(ptClient->iSocket, &ptClient->aucRxBuf[ptClient->usRxLen],
+                            RX_BUFF_SIZE - ptClient->usRxLen, MSG_DONTWAIT);
+    uint64_t ullNow  = GetTimeUs();
+
+    if (0 == sReturn)
+    {
+        return false;
+    }
+
+    if (sReturn < 0)
+    {
+        return (EAGAIN == errno) || (EWOULDBLOCK == errno) || (EINTR == errno);
+    }
+
+    ptClient->usRxLen += (uint16_t)sReturn;
+
+    while (ptClient->usRxLen >= MBAP_PREFIX_LEN)
+    {
+        uint16_t      usAduLen      = (uint16_t)(((ptClient->aucRxBuf[4] << 8) | ptClient->aucRxBuf[5]) + MBAP_PREFIX_LEN);
+        uint16_t      usTid         = (uint16_t)((ptClient->aucRxBuf[0] << 8) | ptClient->aucRxBuf[1]);
+        Outstanding_t *ptOutstanding = &ptClient->atOutstanding[usTid & SLOT_MASK];
+
+        if (usAduLen > BUFF_SIZE_IN_BYTES)
+        {
+            return false;
+        }
+
+        if (ptClient->usRxLen < usAduLen)
+        {
+            break;
+        }
+
+        if (!ptOutstanding->bInUse)
+        {
+            ptResults->ullErrors++;
+        }
+        else
+        {
+            ptOutstanding->bInUse = false;
+            ptClient->ucNumOfOutstanding--;
+
+            if (ptOutstanding->ullStart >= ullMeasure)
+            {
+                uint64_t ullLatency = ullNow - ptOutstanding->ullStart;
+
+                mbap_HistRecord(&ptResults->tLatency, (ullLatency > 0xFFFFFFFFu) ? 0xFFFFFFFFu : (uint32_t)ullLatency);
+                ptResults->ullResponses++;
+
+                if (ptClient->aucRxBuf[MBAP_HEADER_LEN] & 0x80)
+                {
+                    ptResults->ullExceptions++;
+                }
+            }
+        }
+
+        ptClient->usRxLen -= usAduLen;
+        memmove(ptClient->aucRxBuf, &ptClient->aucRxBuf[usAduLen], ptClient->usRxLen);
+    }//end while
+
+    return true;
+}//end ReceiveResponses
+
+static void PrintResults(const Settings_t *ptSettings, const Results_t *ptResults, uint64_t ullTimeUs)
+{
+    const LatencyHistogram_t *ptLatency = &ptResults->tLatency;
+
+    printf("{\n"
+           "  \"mode\": \"%s\",\n"
+           "  \"connections\": %u,\n"
+           "  \"depth\": %u,\n"
+           "  \"rate\": %lu,\n"
+           "  \"duration_s\": %.3f,\n"
+           "  \"sent\": %llu,\n"
+           "  \"responses\": %llu,\n"
+           "  \"exceptions\": %llu,\n"
+           "  \"errors\": %llu,\n"
+           "  \"backlog_overflows\": %llu,\n"
+           "  \"requests_per_sec\": %.1f,\n"
+           "  \"latency_us\": {\"p50\": %lu, \"p90\": %lu, \"p99\": %lu, \"p999\": %lu, \"max\": %lu, \"mean\": %.1f}\n"
+           "}\n",
+           (0 == ptSettings->ulRate) ? "closed" : "open",
+           ptSettings->usNumOfConnections,
+           ptSettings->ucDepth,
+           (unsigned long)ptSettings->ulRate,
+           ullTimeUs / 1e6,
+           (unsigned long long)ptResults->ullSent,
+           (unsigned long long)ptResults->ullResponses,
+           (unsigned long long)ptResults->ullExceptions,
+           (unsigned long long)ptResults->ullErrors,
+           (unsigned long long)ptResults->ullBacklogOverflows,
+           ptResults->ullResponses / (ullTimeUs / 1e6),
+           (unsigned long)mbap_HistPercentile(ptLatency, 500),
+           (unsigned long)mbap_HistPercentile(ptLatency, 900),
+           (unsigned long)mbap_HistPercentile(ptLatency, 990),
+           (unsigned long)mbap_HistPercentile(ptLatency, 999),
+           (unsigned long)ptLatency->ulMax,
+           (0 == ptLatency->ulCount) ? 0.0 : ((double)ptLatency->ullSum / ptLatency->ulCount));
+}//end PrintResults
+
+static uint64_t GetTimeUs(void)
+{
+    struct timespec tNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &tNow);
+
+    return ((uint64_t)tNow.tv_sec * 1000000u) + ((uint64_t)tNow.tv_nsec / 1000u);
+}//end GetTimeUs
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
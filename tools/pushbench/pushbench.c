@@ -0,0 +1,398 @@
+//! @addtogroup PushBenchmark
+//! @brief Change notifications against polling
+//! @{
+//!
+//****************************************************************************/
+//! @file pushbench.c
+//! @brief In process comparison of bandwidth and server CPU of clients which
+//!        poll a range of holding registers against clients subscribed to
+//!        it. A producer changes random registers at a fixed rate over
+//!        simulated time. Polling reads all registers with Read Holding
+//!        Registers every poll period, push subscribes once and gets
+//!        notifications from mbap_SubscriptionPoll(), called every notify
+//!        period as tcp_server does while there are subscriptions. Each
+//!        phase replays the same producer writes, server CPU is thread CPU
+//!        time of a phase less that of the producer alone. Wire bytes count
+//!        one TCP segment with Ethernet, IP and TCP headers per ADU, acks are
+//!        not counted. Results are printed as JSON.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+//user defined header files
+#include "mbap_conf.h"
+#include "mbap.h"
+#include "mbap_change.h"
+#include "mbap_subscription.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+#define BUFF_SIZE_IN_BYTES   260
+#define UNIT_ID              1
+#define MAX_POINTS           10000
+//registers of a Read Holding Registers query
+#define MAX_READ_REGISTERS   125
+//Ethernet(14), IPv4(20) and TCP with timestamps(32) headers of a segment
+#define SEGMENT_OVERHEAD     66
+//period of mbap_SubscriptionPoll() in tcp_server
+#define NOTIFY_PERIOD_MS     5
+#define READ_QUERY_LEN       12
+#define SUBSCRIBE_QUERY_LEN  17
+
+//! @brief Settings taken from command line
+typedef struct Settings
+{
+    uint16_t usNumOfPoints;                         //!<Registers read or subscribed
+    uint32_t ulPollPeriodMs;                        //!<Period of polling clients
+    uint32_t ulChangeRate;                          //!<Register changes per second
+    uint16_t usDeadband;                            //!<Deadband of subscriptions
+    uint16_t usMinIntervalMs;                       //!<Minimum interval of subscriptions
+    uint32_t ulDurationMs;                          //!<Simulated time
+} Settings_t;
+
+//! @brief Traffic and server CPU of a phase
+typedef struct Result
+{
+    uint64_t ullAdus;                               //!<Queries, responses and notifications
+    uint64_t ullAduBytes;                           //!<Bytes of ADUs
+    uint64_t ullCpuNs;                              //!<Thread CPU time of phase
+} Result_t;
+
+//! @brief Phase of run
+enum Phase
+{
+    ePHASE_PRODUCER = 0,                            //!< Producer writes only
+    ePHASE_POLL     = 1,                            //!< Producer writes and polling clients
+    ePHASE_PUSH     = 2                             //!< Producer writes and subscribed clients
+};
+
+//****************************************************************************/
+//                           Local Functions
+//****************************************************************************/
+//
+//! @brief Parse command line
+//! @param[in]  iArgc       Number of arguments
+//! @param[in]  ppcArgv     Arguments
+//! @param[out] ptSettings  Settings
+//! @return     bool        true - valid
+//
+static bool ParseArgs(int iArgc, char **ppcArgv, Settings_t *ptSettings);
+
+//
+//! @brief Run simulated time of a phase with same producer writes
+//! @param[in]  ptSettings  Settings
+//! @param[in]  ucPhase     enum Phase
+//! @param[out] ptResult    Traffic and CPU time
+//! @return     None
+//
+static void RunPhase(const Settings_t *ptSettings, uint8_t ucPhase, Result_t *ptResult);
+
+//
+//! @brief Read all points with Read Holding Registers queries
+//! @param[in]      ptSettings  Settings
+//! @param[in,out]  ptResult    Traffic
+//! @return         None
+//
+static void Poll(const Settings_t *ptSettings, Result_t *ptResult);
+
+//
+//! @brief Subscribe to all points on connection of client
+//! @param[in]      ptSettings  Settings
+//! @param[in,out]  ptResult    Traffic
+//! @return         bool        true - subscribed
+//
+static bool Subscribe(const Settings_t *ptSettings, Result_t *ptResult);
+
+//
+//! @brief Count notification as sent on connection of client
+//! @param[in]  pvConnection  Connection
+//! @param[in]  pucAdu        Notification
+//! @param[in]  usLen         Bytes of notification
+//! @return     bool          true - sent
+//
+static bool Notify(void *pvConnection, const uint8_t *pucAdu, uint16_t usLen);
+
+//
+//! @brief Read holding registers of server
+//! @param[in]   usStartAddress  First register
+//! @param[in]   usNumOfData     Registers
+//! @param[out]  pucRecBuf       Data
+//! @return      None
+//
+static void ReadHoldingRegisters(uint16_t usStartAddress, uint16_t usNumOfData, uint8_t *pucRecBuf);
+
+//
+//! @brief Thread CPU time
+//! @param[in]  None
+//! @return     uint64_t  Time, ns
+//
+static uint64_t GetCpuNs(void);
+
+//****************************************************************************/
+//                           Local variables
+//****************************************************************************/
+static uint16_t m_ausRegisters[MAX_POINTS];
+//subscriptions are sent on this connection
+static int      m_iConnection;
+static Result_t *m_ptPushResult;
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+int main(int iArgc, char **ppcArgv)
+{
+    Settings_t   tSettings;
+    ModbusData_t tModbusData;
+    Result_t     atResults[3];
+    uint64_t     ullPollCpu = 0;
+    uint64_t     ullPushCpu = 0;
+    uint64_t     ullPollWire = 0;
+    uint64_t     ullPushWire = 0;
+    uint8_t      ucPhase    = 0;
+
+    if (!ParseArgs(iArgc, ppcArgv, &tSettings))
+    {
+        fprintf(stderr, "Usage: %s [-n points] [-p poll period ms] [-r changes/s] [-b deadband] "
+                        "[-i min interval ms] [-t seconds]\n", ppcArgv[0]);
+        return 1;
+    }
+
+    memset(&tModbusData, 0, sizeof(tModbusData));
+    tModbusData.usMaxHoldingRegisters    = tSettings.usNumOfPoints;
+    tModbusData.ptfnReadHoldingRegisters = ReadHoldingRegisters;
+    mbap_DataInit(tModbusData);
+
+    for (ucPhase = ePHASE_PRODUCER; ucPhase <= ePHASE_PUSH; ucPhase++)
+    {
+        RunPhase(&tSettings, ucPhase, &atResults[ucPhase]);
+    }
+
+    ullPollCpu  = (atResults[ePHASE_POLL].ullCpuNs > atResults[ePHASE_PRODUCER].ullCpuNs) ?
+                  (atResults[ePHASE_POLL].ullCpuNs - atResults[ePHASE_PRODUCER].ullCpuNs) : 0;
+    ullPushCpu  = (atResults[ePHASE_PUSH].ullCpuNs > atResults[ePHASE_PRODUCER].ullCpuNs) ?
+                  (atResults[ePHASE_PUSH].ullCpuNs - atResults[ePHASE_PRODUCER].ullCpuNs) : 0;
+    ullPollWire = atResults[ePHASE_POLL].ullAduBytes + (atResults[ePHASE_POLL].ullAdus * SEGMENT_OVERHEAD);
+    ullPushWire = atResults[ePHASE_PUSH].ullAduBytes + (atResults[ePHASE_PUSH].ullAdus * SEGMENT_OVERHEAD);
+
+    printf("{\n"
+           "  \"points\": %u,\n"
+           "  \"duration_s\": %.3f,\n"
+           "  \"changes_per_s\": %lu,\n"
+           "  \"poll_period_ms\": %lu,\n"
+           "  \"deadband\": %u,\n"
+           "  \"min_interval_ms\": %u,\n"
+           "  \"poll\": {\"adus\": %llu, \"adu_bytes\": %llu, \"wire_bytes\": %llu, \"server_cpu_us\": %.1f},\n"
+           "  \"push\": {\"adus\": %llu, \"adu_bytes\": %llu, \"wire_bytes\": %llu, \"server_cpu_us\": %.1f},\n"
+           "  \"wire_bytes_ratio\": %.4f,\n"
+           "  \"server_cpu_ratio\": %.4f\n"
+           "}\n",
+           tSettings.usNumOfPoints,
+           tSettings.ulDurationMs / 1e3,
+           (unsigned long)tSettings.ulChangeRate,
+           (unsigned long)tSettings.ulPollPeriodMs,
+           tSettings.usDeadband,
+           tSettings.usMinIntervalMs,
+           (unsigned long long)atResults[ePHASE_POLL].ullAdus,
+           (unsigned long long)atResults[ePHASE_POLL].ullAduBytes,
+           (unsigned long long)ullPollWire,
+           ullPollCpu / 1e3,
+           (unsigned long long)atResults[ePHASE_PUSH].ullAdus,
+           (unsigned long long)atResults[ePHASE_PUSH].ullAduBytes,
+           (unsigned long long)ullPushWire,
+           ullPushCpu / 1e3,
+           (0 == ullPollWire) ? 0.0 : ((double)ullPushWire / ullPollWire),
+           (0 == ullPollCpu) ? 0.0 : ((double)ullPushCpu / ullPollCpu));
+
+    return 0;
+}//end main
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static bool ParseArgs(int iArgc, char **ppcArgv, Settings_t *ptSettings)
+{
+    int iOption = 0;
+
+    memset(ptSettings, 0, sizeof(Settings_t));
+    ptSettings->usNumOfPoints  = 1000;
+    ptSettings->ulPollPeriodMs = 100;
+    ptSettings->ulChangeRate   = 100;
+    ptSettings->ulDurationMs   = 60000;
+
+    while (-1 != (iOption = getopt(iArgc, ppcArgv, "n:p:r:b:i:t:")))
+    {
+        switch (iOption)
+        {
+        case 'n': ptSettings->usNumOfPoints   = (uint16_t)atoi(optarg);             break;
+        case 'p': ptSettings->ulPollPeriodMs  = (uint32_t)atol(optarg);             break;
+        case 'r': ptSettings->ulChangeRate    = (uint32_t)atol(optarg);             break;
+        case 'b': ptSettings->usDeadband      = (uint16_t)atoi(optarg);             break;
+        case 'i': ptSettings->usMinIntervalMs = (uint16_t)atoi(optarg);             break;
+        case 't': ptSettings->ulDurationMs    = (uint32_t)(atof(optarg) * 1000.0);  break;
+        default:
+            return false;
+        }
+    }
+
+    return (0 != ptSettings->usNumOfPoints) && (ptSettings->usNumOfPoints <= MAX_POINTS) &&
+           (0 != ptSettings->ulPollPeriodMs) && (0 != ptSettings->ulDurationMs);
+}//end ParseArgs
+
+static void RunPhase(const Settings_t *ptSettings, uint8_t ucPhase, Result_t *ptResult)
+{
+    uint64_t ullStart   = 0;
+    uint64_t ullChanges = 0;
+    uint32_t ulTimeMs   = 0;
+
+    memset(ptResult, 0, sizeof(*ptResult));
+    memset(m_ausRegisters, 0, sizeof(m_ausRegisters));
+    mbap_SubscriptionInit(Notify);
+    m_ptPushResult = ptResult;
+    srand(1);
+
+    if ((ePHASE_PUSH == ucPhase) && !Subscribe(ptSettings, ptResult))
+    {
+        fprintf(stderr, "Subscribe failed\n");
+        exit(1);
+    }
+
+    ullStart = GetCpuNs();
+
+    //time starts at 1 ms, 0 is not a valid poll time
+    for (ulTimeMs = 1; ulTimeMs <= ptSettings->ulDurationMs; ulTimeMs++)
+    {
+        //changes due until now, same sequence in every phase
+        uint64_t ullDue = ((uint64_t)ulTimeMs * ptSettings->ulChangeRate) / 1000u;
+
+        for (; ullChanges < ullDue; ullChanges++)
+        {
+            uint16_t usPoint = (uint16_t)(rand() % ptSettings->usNumOfPoints);
+
+            m_ausRegisters[usPoint] = (uint16_t)(m_ausRegisters[usPoint] + 1u + (rand() % 10));
+            mbap_ChangeMark(NULL, eTABLE_HOLDING_REGISTERS, usPoint, 1);
+        }
+
+        if ((ePHASE_POLL == ucPhase) && (0 == (ulTimeMs % ptSettings->ulPollPeriodMs)))
+        {
+            Poll(ptSettings, ptResult);
+        }
+        else if ((ePHASE_PUSH == ucPhase) && (0 == (ulTimeMs % NOTIFY_PERIOD_MS)))
+        {
+            mbap_SubscriptionPoll(ulTimeMs);
+        }
+    }//end for
+
+    ptResult->ullCpuNs = GetCpuNs() - ullStart;
+}//end RunPhase
+
+static void Poll(const Settings_t *ptSettings, Result_t *ptResult)
+{
+    uint8_t  aucQuery[READ_QUERY_LEN] = {0, 1, 0, 0, 0, 6, UNIT_ID, eFC_READ_HOLDING_REGISTERS};
+    uint8_t  aucResponse[BUFF_SIZE_IN_BYTES];
+    uint16_t usAddress = 0;
+
+    for (usAddress = 0; usAddress < ptSettings->usNumOfPoints; usAddress += MAX_READ_REGISTERS)
+    {
+        uint16_t usCount = (uint16_t)(ptSettings->usNumOfPoints - usAddress);
+
+        usCount      = (usCount > MAX_READ_REGISTERS) ? MAX_READ_REGISTERS : usCount;
+        aucQuery[8]  = (uint8_t)(usAddress >> 8);
+        aucQuery[9]  = (uint8_t)usAddress;
+        aucQuery[10] = (uint8_t)(usCount >> 8);
+        aucQuery[11] = (uint8_t)usCount;
+
+        ptResult->ullAduBytes += READ_QUERY_LEN + mbap_ProcessRequest(aucQuery, READ_QUERY_LEN, aucResponse);
+        ptResult->ullAdus     += 2u;
+    }
+}//end Poll
+
+static bool Subscribe(const Settings_t *ptSettings, Result_t *ptResult)
+{
+    uint8_t         aucQuery[SUBSCRIBE_QUERY_LEN] = {0, 1, 0, 0, 0, 11, UNIT_ID, eFC_SUBSCRIBE, eTABLE_HOLDING_REGISTERS};
+    uint8_t         aucResponse[BUFF_SIZE_IN_BYTES];
+    ModbusRequest_t tRequest;
+    uint16_t        usAddress     = 0;
+    uint16_t        usResponseLen = 0;
+
+    for (usAddress = 0; usAddress < ptSettings->usNumOfPoints; usAddress += SUBSCRIPTION_MAX_REGISTERS)
+    {
+        uint16_t usCount = (uint16_t)(ptSettings->usNumOfPoints - usAddress);
+
+        usCount      = (usCount > SUBSCRIPTION_MAX_REGISTERS) ? SUBSCRIPTION_MAX_REGISTERS : usCount;
+        aucQuery[9]  = (uint8_t)(usAddress >> 8);
+        aucQuery[10] = (uint8_t)usAddress;
+        aucQuery[11] = (uint8_t)(usCount >> 8);
+        aucQuery[12] = (uint8_t)usCount;
+        aucQuery[13] = (uint8_t)(ptSettings->usDeadband >> 8);
+        aucQuery[14] = (uint8_t)ptSettings->usDeadband;
+        aucQuery[15] = (uint8_t)(ptSettings->usMinIntervalMs >> 8);
+        aucQuery[16] = (uint8_t)ptSettings->usMinIntervalMs;
+
+        memset(&tRequest, 0, sizeof(tRequest));
+        tRequest.pucQuery     = aucQuery;
+        tRequest.pucResponse  = aucResponse;
+        tRequest.usQueryLen   = SUBSCRIBE_QUERY_LEN;
+        tRequest.pvConnection = &m_iConnection;
+
+        //subscribe response holds data of range as a poll would
+        usResponseLen = mbap_SubmitRequest(&tRequest);
+
+        if ((uint16_t)(8u + SUBSCRIPTION_HEADER_LEN + (usCount * 2u)) != usResponseLen)
+        {
+            return false;
+        }
+
+        ptResult->ullAduBytes += SUBSCRIBE_QUERY_LEN + usResponseLen;
+        ptResult->ullAdus     += 2u;
+    }
+
+    return true;
+}//end Subscribe
+
+static bool Notify(void *pvConnection, const uint8_t *pucAdu, uint16_t usLen)
+{
+    (void)pvConnection;
+    (void)pucAdu;
+
+    m_ptPushResult->ullAduBytes += usLen;
+    m_ptPushResult->ullAdus++;
+
+    return true;
+}//end Notify
+
+static void ReadHoldingRegisters(uint16_t usStartAddress, uint16_t usNumOfData, uint8_t *pucRecBuf)
+{
+    uint16_t usIndex = 0;
+
+    for (usIndex = 0; usIndex < usNumOfData; usIndex++)
+    {
+        pucRecBuf[usIndex * 2u]      = (uint8_t)(m_ausRegisters[usStartAddress + usIndex] >> 8);
+        pucRecBuf[(usIndex * 2u) + 1u] = (uint8_t)m_ausRegisters[usStartAddress + usIndex];
+    }
+}//end ReadHoldingRegisters
+
+static uint64_t GetCpuNs(void)
+{
+    struct timespec tNow;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &tNow);
+
+    return ((uint64_t)tNow.tv_sec * 1000000000u) + (uint64_t)tNow.tv_nsec;
+}//end GetCpuNs
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
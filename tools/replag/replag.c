@@ -0,0 +1,555 @@
+//! @addtogroup ReplicationLag
+//! @brief Replication lag test
+//! @{
+//!
+//****************************************************************************/
+//! @file replag.c
+//! @brief Two process loopback test of hot standby replication. Starts a
+//!        primary and, after some writes, a standby which joins late and
+//!        catches up from a snapshot. A marker register is then written on
+//!        the primary at a fixed rate while a second connection writes other
+//!        registers as background load, and the standby is read until the
+//!        marker value shows up. Lag is measured from the write response of
+//!        the primary to the first read of the value on the standby. At the
+//!        end writes to the standby must be rejected, and accepted after the
+//!        standby is promoted. Results are printed as JSON.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+//user defined header files
+#include "mbap_hist.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+#define BUFF_SIZE_IN_BYTES   260
+#define MBAP_HEADER_LEN      7
+#define UNIT_ID              1
+//holding registers 0 to 2 accept values 0 to 200
+#define MARKER_REGISTER      0
+#define LOAD_REGISTER        1
+#define MAX_VALUE            200
+//marker not seen on standby within this time counts as lost
+#define MARKER_TIMEOUT_US    1000000u
+#define START_TIMEOUT_US     3000000u
+#define RESPONSE_TIMEOUT_MS  1000
+
+//! @brief Settings taken from command line
+typedef struct Settings
+{
+    const char *pcServer;                           //!<Server binary, NULL - servers already run
+    uint16_t   usPrimaryPort;                       //!<Modbus port of primary
+    uint16_t   usStandbyPort;                       //!<Modbus port of standby
+    uint16_t   usReplicaPort;                       //!<Replication port of primary
+    uint32_t   ulWriteRate;                         //!<Marker writes per second
+    uint32_t   ulLoadRate;                          //!<Background writes per second, 0 - none
+    uint32_t   ulDurationMs;                        //!<Measured phase
+} Settings_t;
+
+//! @brief Background writer
+typedef struct Load
+{
+    uint16_t      usPort;                           //!<Modbus port of primary
+    uint32_t      ulRate;                           //!<Writes per second
+    volatile bool bStop;                            //!<Stop writing
+    uint64_t      ullWrites;                        //!<Writes done
+} Load_t;
+
+//****************************************************************************/
+//                           Local Functions
+//****************************************************************************/
+//
+//! @brief Parse command line
+//! @param[in]  iArgc       Number of arguments
+//! @param[in]  ppcArgv     Arguments
+//! @param[out] ptSettings  Settings
+//! @return     bool        true - valid
+//
+static bool ParseArgs(int iArgc, char **ppcArgv, Settings_t *ptSettings);
+
+//
+//! @brief Start a server process with output discarded
+//! @param[in]  pcServer  Server binary
+//! @param[in]  ppcArgs   Arguments, NULL terminated
+//! @return     pid_t     Process, -1 on error
+//
+static pid_t StartServer(const char *pcServer, char * const *ppcArgs);
+
+//
+//! @brief Connect to a server on loopback, retried until it listens
+//! @param[in]  usPort     Modbus port
+//! @param[in]  ulWaitUs   Time to retry
+//! @return     int        Socket, -1 on error
+//
+static int Connect(uint16_t usPort, uint32_t ulWaitUs);
+
+//
+//! @brief Write one holding register(FC 16)
+//! @param[in]  iSocket    Socket
+//! @param[in]  usAddress  Register
+//! @param[in]  usValue    Value
+//! @return     int        0 - written, exception code, -1 on error
+//
+static int WriteRegister(int iSocket, uint16_t usAddress, uint16_t usValue);
+
+//
+//! @brief Read one holding register(FC 3)
+//! @param[in]  iSocket    Socket
+//! @param[in]  usAddress  Register
+//! @return     int        Value, -1 on error or exception
+//
+static int ReadRegister(int iSocket, uint16_t usAddress);
+
+//
+//! @brief Send query and receive response
+//! @param[in]  iSocket     Socket
+//! @param[in]  pucQuery    Query
+//! @param[in]  usQueryLen  Bytes of query
+//! @param[out] pucResponse Response
+//! @return     int         Bytes of response, -1 on error
+//
+static int Transact(int iSocket, const uint8_t *pucQuery, uint16_t usQueryLen, uint8_t *pucResponse);
+
+//
+//! @brief Read standby until register holds value
+//! @param[in]  iSocket    Standby socket
+//! @param[in]  usAddress  Register
+//! @param[in]  usValue    Value
+//! @param[in]  ulWaitUs   Time to wait
+//! @return     bool       true - value seen
+//
+static bool WaitForValue(int iSocket, uint16_t usAddress, uint16_t usValue, uint32_t ulWaitUs);
+
+//
+//! @brief Background writer thread
+//! @param[in]  pvArg  Load_t
+//! @return     void*  Not used
+//
+static void *LoadThread(void *pvArg);
+
+//
+//! @brief Monotonic time
+//! @param[in]  None
+//! @return     uint64_t  us
+//
+static uint64_t GetTimeUs(void);
+
+//****************************************************************************/
+//                           Local variables
+//****************************************************************************/
+static LatencyHistogram_t m_tLag;
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+int main(int iArgc, char **ppcArgv)
+{
+    Settings_t tSettings;
+    Load_t     tLoad;
+    pthread_t  tLoadThread;
+    char       acPrimaryPort[8];
+    char       acStandbyPort[8];
+    char       acReplicaPort[8];
+    char       acPrimary[32];
+    pid_t      iPrimary      = -1;
+    pid_t      iStandby      = -1;
+    int        iPrimarySock  = -1;
+    int        iStandbySock  = -1;
+    uint64_t   ullJoinUs     = 0;
+    uint64_t   ullStartUs    = 0;
+    uint64_t   ullMarkers    = 0;
+    uint64_t   ullLost       = 0;
+    uint16_t   usValue       = 0;
+    int        iRejected     = -1;
+    int        iPromoted     = -1;
+    uint8_t    ucCount       = 0;
+
+    if (!ParseArgs(iArgc, ppcArgv, &tSettings))
+    {
+        fprintf(stderr, "Usage: %s [-S server] [-p primary port] [-s standby port] [-r replication port] "
+                        "[-w marker writes/s] [-l load writes/s] [-t seconds]\n", ppcArgv[0]);
+        return 1;
+    }
+
+    snprintf(acPrimaryPort, sizeof(acPrimaryPort), "%u", tSettings.usPrimaryPort);
+    snprintf(acStandbyPort, sizeof(acStandbyPort), "%u", tSettings.usStandbyPort);
+    snprintf(acReplicaPort, sizeof(acReplicaPort), "%u", tSettings.usReplicaPort);
+    snprintf(acPrimary, sizeof(acPrimary), "127.0.0.1:%u", tSettings.usReplicaPort);
+
+    if (NULL != tSettings.pcServer)
+    {
+        char *apcArgs[] = {(char *)tSettings.pcServer, "-p", acPrimaryPort, "-M", "0", "-r", acReplicaPort, NULL};
+
+        iPrimary = StartServer(tSettings.pcServer, apcArgs);
+    }
+
+    iPrimarySock = Connect(tSettings.usPrimaryPort, START_TIMEOUT_US);
+
+    if (iPrimarySock < 0)
+    {
+        fprintf(stderr, "Primary not reachable\n");
+        return 1;
+    }
+
+    //writes before standby exists reach it by snapshot
+    for (ucCount = 0; ucCount < 3u; ucCount++)
+    {
+        (void)WriteRegister(iPrimarySock, MARKER_REGISTER + ucCount, 100u + ucCount);
+    }
+
+    ullJoinUs = GetTimeUs();
+
+    if (NULL != tSettings.pcServer)
+    {
+        char *apcArgs[] = {(char *)tSettings.pcServer, "-p", acStandbyPort, "-M", "0", "-s", acPrimary, NULL};
+
+        iStandby = StartServer(tSettings.pcServer, apcArgs);
+    }
+
+    iStandbySock = Connect(tSettings.usStandbyPort, START_TIMEOUT_US);
+
+    if ((iStandbySock < 0) || !WaitForValue(iStandbySock, MARKER_REGISTER + 2u, 102u, START_TIMEOUT_US))
+    {
+        fprintf(stderr, "Standby not synchronised\n");
+        ullLost = 1;
+    }
+
+    ullJoinUs = GetTimeUs() - ullJoinUs;
+
+    memset(&tLoad, 0, sizeof(tLoad));
+    tLoad.usPort = tSettings.usPrimaryPort;
+    tLoad.ulRate = tSettings.ulLoadRate;
+
+    if ((0 != tSettings.ulLoadRate) && (0 != pthread_create(&tLoadThread, NULL, LoadThread, &tLoad)))
+    {
+        tSettings.ulLoadRate = 0;
+    }
+
+    ullStartUs = GetTimeUs();
+
+    while ((0 == ullLost) && ((GetTimeUs() - ullStartUs) < (uint64_t)tSettings.ulDurationMs * 1000u))
+    {
+        uint64_t ullDueUs   = ullStartUs + (ullMarkers * 1000000u) / tSettings.ulWriteRate;
+        uint64_t ullAckedUs = 0;
+        uint64_t ullNowUs   = GetTimeUs();
+
+        if (ullNowUs < ullDueUs)
+        {
+            usleep((useconds_t)(ullDueUs - ullNowUs));
+        }
+
+        //consecutive markers differ
+        usValue = (uint16_t)(ullMarkers % MAX_VALUE + 1u);
+        ullMarkers++;
+
+        if (0 != WriteRegister(iPrimarySock, MARKER_REGISTER, usValue))
+        {
+            ullLost++;
+            break;
+        }
+
+        ullAckedUs = GetTimeUs();
+
+        if (WaitForValue(iStandbySock, MARKER_REGISTER, usValue, MARKER_TIMEOUT_US))
+        {
+            mbap_HistRecord(&m_tLag, (uint32_t)(GetTimeUs() - ullAckedUs));
+        }
+        else
+        {
+            ullLost++;
+        }
+    }//end while
+
+    ullStartUs = GetTimeUs() - ullStartUs;
+
+    if (0 != tSettings.ulLoadRate)
+    {
+        tLoad.bStop = true;
+        pthread_join(tLoadThread, NULL);
+    }
+
+    if ((iStandbySock >= 0) && (NULL != tSettings.pcServer))
+    {
+        //standby is read only until promoted, then keeps replicated state
+        iRejected = WriteRegister(iStandbySock, MARKER_REGISTER, 1u);
+        kill(iPrimary, SIGKILL);
+        kill(iStandby, SIGUSR1);
+        usleep(300000);
+        iPromoted = WriteRegister(iStandbySock, LOAD_REGISTER + 1u, 7u);
+        iPromoted = ((0 == iPromoted) && (usValue == ReadRegister(iStandbySock, MARKER_REGISTER))) ? 0 : iPromoted;
+    }
+
+    printf("{\n"
+           "  \"marker_rate\": %lu,\n"
+           "  \"load_rate\": %lu,\n"
+           "  \"duration_s\": %.3f,\n"
+           "  \"join_sync_ms\": %.3f,\n"
+           "  \"markers\": %llu,\n"
+           "  \"lost\": %llu,\n"
+           "  \"load_writes\": %llu,\n"
+           "  \"lag_us\": {\"p50\": %lu, \"p90\": %lu, \"p99\": %lu, \"max\": %lu, \"mean\": %.1f},\n"
+           "  \"standby_write_exception\": %d,\n"
+           "  \"promoted_write_result\": %d\n"
+           "}\n",
+           (unsigned long)tSettings.ulWriteRate,
+           (unsigned long)tSettings.ulLoadRate,
+           ullStartUs / 1e6,
+           ullJoinUs / 1e3,
+           (unsigned long long)ullMarkers,
+           (unsigned long long)ullLost,
+           (unsigned long long)tLoad.ullWrites,
+           (unsigned long)mbap_HistPercentile(&m_tLag, 500),
+           (unsigned long)mbap_HistPercentile(&m_tLag, 900),
+           (unsigned long)mbap_HistPercentile(&m_tLag, 990),
+           (unsigned long)m_tLag.ulMax,
+           (0 == m_tLag.ulCount) ? 0.0 : ((double)m_tLag.ullSum / m_tLag.ulCount),
+           iRejected,
+           iPromoted);
+
+    close(iPrimarySock);
+    close(iStandbySock);
+
+    if (NULL != tSettings.pcServer)
+    {
+        kill(iPrimary, SIGKILL);
+        kill(iStandby, SIGKILL);
+        waitpid(iPrimary, NULL, 0);
+        waitpid(iStandby, NULL, 0);
+    }
+
+    //failover is only checked with servers started here
+    return ((0 == ullLost) && ((NULL == tSettings.pcServer) || ((0 != iRejected) && (0 == iPromoted)))) ? 0 : 1;
+}//end main
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static bool ParseArgs(int iArgc, char **ppcArgv, Settings_t *ptSettings)
+{
+    int iOption = 0;
+
+    memset(ptSettings, 0, sizeof(Settings_t));
+    ptSettings->usPrimaryPort = 1502;
+    ptSettings->usStandbyPort = 1503;
+    ptSettings->usReplicaPort = 1602;
+    ptSettings->ulWriteRate   = 1000;
+    ptSettings->ulLoadRate    = 5000;
+    ptSettings->ulDurationMs  = 3000;
+
+    while (-1 != (iOption = getopt(iArgc, ppcArgv, "S:p:s:r:w:l:t:")))
+    {
+        switch (iOption)
+        {
+        case 'S': ptSettings->pcServer      = optarg;                             break;
+        case 'p': ptSettings->usPrimaryPort = (uint16_t)atoi(optarg);             break;
+        case 's': ptSettings->usStandbyPort = (uint16_t)atoi(optarg);             break;
+        case 'r': ptSettings->usReplicaPort = (uint16_t)atoi(optarg);             break;
+        case 'w': ptSettings->ulWriteRate   = (uint32_t)atol(optarg);             break;
+        case 'l': ptSettings->ulLoadRate    = (uint32_t)atol(optarg);             break;
+        case 't': ptSettings->ulDurationMs  = (uint32_t)(atof(optarg) * 1000.0);  break;
+        default:
+            return false;
+        }
+    }
+
+    return (0 != ptSettings->ulWriteRate) && (0 != ptSettings->ulDurationMs);
+}//end ParseArgs
+
+static pid_t StartServer(const char *pcServer, char * const *ppcArgs)
+{
+    pid_t iPid = fork();
+
+    if (0 == iPid)
+    {
+        int iNull = open("/dev/null", O_WRONLY);
+
+        (void)dup2(iNull, STDOUT_FILENO);
+        (void)dup2(iNull, STDERR_FILENO);
+        execv(pcServer, ppcArgs);
+        _exit(127);
+    }
+
+    return iPid;
+}//end StartServer
+
+static int Connect(uint16_t usPort, uint32_t ulWaitUs)
+{
+    struct sockaddr_in tServer;
+    struct timeval     tTimeout;
+    uint64_t           ullEndUs = GetTimeUs() + ulWaitUs;
+    int                iOption  = 1;
+
+    memset(&tServer, 0, sizeof(tServer));
+    tServer.sin_family      = AF_INET;
+    tServer.sin_port        = htons(usPort);
+    tServer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    tTimeout.tv_sec         = RESPONSE_TIMEOUT_MS / 1000;
+    tTimeout.tv_usec        = (RESPONSE_TIMEOUT_MS % 1000) * 1000;
+
+    do
+    {
+        int iSocket = socket(AF_INET, SOCK_STREAM, 0);
+
+        if ((iSocket >= 0) && (0 == connect(iSocket, (struct sockaddr *)&tServer, sizeof(tServer))))
+        {
+            (void)setsockopt(iSocket, IPPROTO_TCP, TCP_NODELAY, &iOption, sizeof(iOption));
+            (void)setsockopt(iSocket, SOL_SOCKET, SO_RCVTIMEO, &tTimeout, sizeof(tTimeout));
+            return iSocket;
+        }
+
+        if (iSocket >= 0)
+        {
+            close(iSocket);
+        }
+
+        usleep(20000);
+    } while (GetTimeUs() < ullEndUs);
+
+    return -1;
+}//end Connect
+
+static int WriteRegister(int iSocket, uint16_t usAddress, uint16_t usValue)
+{
+    uint8_t aucQuery[15] = {0, 1, 0, 0, 0, 9, UNIT_ID, 16, 0, 0, 0, 1, 2, 0, 0};
+    uint8_t aucResponse[BUFF_SIZE_IN_BYTES];
+    int     iLen = 0;
+
+    aucQuery[8]  = (uint8_t)(usAddress >> 8);
+    aucQuery[9]  = (uint8_t)usAddress;
+    aucQuery[13] = (uint8_t)(usValue >> 8);
+    aucQuery[14] = (uint8_t)usValue;
+
+    iLen = Transact(iSocket, aucQuery, sizeof(aucQuery), aucResponse);
+
+    if (iLen < (MBAP_HEADER_LEN + 2))
+    {
+        return -1;
+    }
+
+    return (aucResponse[7] & 0x80) ? aucResponse[8] : 0;
+}//end WriteRegister
+
+static int ReadRegister(int iSocket, uint16_t usAddress)
+{
+    uint8_t aucQuery[12] = {0, 2, 0, 0, 0, 6, UNIT_ID, 3, 0, 0, 0, 1};
+    uint8_t aucResponse[BUFF_SIZE_IN_BYTES];
+
+    aucQuery[8] = (uint8_t)(usAddress >> 8);
+    aucQuery[9] = (uint8_t)usAddress;
+
+    if ((Transact(iSocket, aucQuery, sizeof(aucQuery), aucResponse) < (MBAP_HEADER_LEN + 4)) ||
+        (aucResponse[7] & 0x80))
+    {
+        return -1;
+    }
+
+    return (aucResponse[9] << 8) | aucResponse[10];
+}//end ReadRegister
+
+static int Transact(int iSocket, const uint8_t *pucQuery, uint16_t usQueryLen, uint8_t *pucResponse)
+{
+    int iLen = 0;
+
+    if (send(iSocket, pucQuery, usQueryLen, MSG_NOSIGNAL) != (ssize_t)usQueryLen)
+    {
+        return -1;
+    }
+
+    //response is complete once MBAP length is covered
+    while ((iLen < 6) || (iLen < (6 + ((pucResponse[4] << 8) | pucResponse[5]))))
+    {
+        ssize_t lReceived = recv(iSocket, &pucResponse[iLen], BUFF_SIZE_IN_BYTES - iLen, 0);
+
+        if (lReceived <= 0)
+        {
+            return -1;
+        }
+
+        iLen += (int)lReceived;
+    }
+
+    return iLen;
+}//end Transact
+
+static bool WaitForValue(int iSocket, uint16_t usAddress, uint16_t usValue, uint32_t ulWaitUs)
+{
+    uint64_t ullEndUs = GetTimeUs() + ulWaitUs;
+
+    do
+    {
+        if (usValue == ReadRegister(iSocket, usAddress))
+        {
+            return true;
+        }
+    } while (GetTimeUs() < ullEndUs);
+
+    return false;
+}//end WaitForValue
+
+static void *LoadThread(void *pvArg)
+{
+    Load_t   *ptLoad     = (Load_t *)pvArg;
+    int      iSocket     = Connect(ptLoad->usPort, START_TIMEOUT_US);
+    uint64_t ullStartUs  = GetTimeUs();
+
+    while ((iSocket >= 0) && !ptLoad->bStop)
+    {
+        uint64_t ullDueUs = ullStartUs + (ptLoad->ullWrites * 1000000u) / ptLoad->ulRate;
+        uint64_t ullNowUs = GetTimeUs();
+
+        if (ullNowUs < ullDueUs)
+        {
+            usleep((useconds_t)(ullDueUs - ullNowUs));
+        }
+
+        if (0 != WriteRegister(iSocket, LOAD_REGISTER + (uint16_t)(ptLoad->ullWrites & 1u),
+                               (uint16_t)(ptLoad->ullWrites % MAX_VALUE)))
+        {
+            break;
+        }
+
+        ptLoad->ullWrites++;
+    }
+
+    if (iSocket >= 0)
+    {
+        close(iSocket);
+    }
+
+    return NULL;
+}//end LoadThread
+
+static uint64_t GetTimeUs(void)
+{
+    struct timespec tNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &tNow);
+
+    return ((uint64_t)tNow.tv_sec * 1000000u) + ((uint64_t)tNow.tv_nsec / 1000u);
+}//end GetTimeUs
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
@@ -0,0 +1,672 @@
+//! @addtogroup Replay
+//! @brief Replay of captured client traffic
+//! @{
+//!
+//****************************************************************************/
+//! @file replay.c
+//! @brief Replays a capture file written by the tcp server(-c option) over
+//!        loopback. Every captured connection is opened again and its
+//!        queries are sent in captured order, either at recorded speed
+//!        scaled by a factor or as fast as the server answers. Results are
+//!        printed as JSON.
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+//user defined header files
+#include "mbap_hist.h"
+#include "capture.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+#define MAX_SESSIONS         1024
+#define MAX_WINDOW           64
+#define BUFF_SIZE_IN_BYTES   260
+#define RX_BUFF_SIZE         (4 * BUFF_SIZE_IN_BYTES)
+#define MBAP_PREFIX_LEN      6
+#define MBAP_HEADER_LEN      7
+//responses are awaited this long before a session is closed
+#define DRAIN_TIME_US        1000000u
+
+//! @brief Query waiting for response
+typedef struct Outstanding
+{
+    bool     bInUse;                                //!<Slot in use
+    uint16_t usTransactionId;                       //!<Transaction id of query
+    uint64_t ullStart;                              //!<Send time, us
+} Outstanding_t;
+
+//! @brief Replayed connection
+typedef struct Session
+{
+    uint32_t      ulConnectionId;                   //!<Captured connection id
+    int           iSocket;                          //!<Socket, -1 - slot free
+    uint8_t       ucNumOfOutstanding;               //!<Queries waiting for response
+    Outstanding_t atOutstanding[MAX_WINDOW];        //!<Queries waiting for response
+    uint16_t      usRxLen;                          //!<Bytes in receive buffer
+    uint8_t       aucRxBuf[RX_BUFF_SIZE];           //!<Receive buffer
+} Session_t;
+
+//! @brief Settings of a replay
+typedef struct Settings
+{
+    const char    *pcHost;                          //!<Server address
+    uint16_t      usPort;                           //!<Server port
+    double        dSpeed;                           //!<Factor of recorded speed, 0 - as fast as possible
+    uint8_t       ucWindow;                         //!<Queries in flight per connection
+    const char    *pcFile;                          //!<Capture file
+} Settings_t;
+
+//! @brief Results of a replay
+typedef struct Results
+{
+    uint64_t           ullSessions;                 //!<Connections opened
+    uint64_t           ullSent;                     //!<Queries sent
+    uint64_t           ullResponses;                //!<Responses received
+    uint64_t           ullExceptions;               //!<Exception responses
+    uint64_t           ullErrors;                   //!<Unexpected responses or lost queries
+    uint64_t           ullRecordedUs;               //!<Time span of capture
+    LatencyHistogram_t tLatency;                    //!<Latency, us
+} Results_t;
+
+//****************************************************************************/
+//                           Local Functions
+//****************************************************************************/
+//
+//! @brief Parse command line
+//! @param[in]  iArgc       Number of arguments
+//! @param[in]  ppcArgv     Arguments
+//! @param[out] ptSettings  Settings
+//! @return     bool        true - settings valid
+//
+static bool ParseArgs(int iArgc, char **ppcArgv, Settings_t *ptSettings);
+
+//
+//! @brief Read whole capture file
+//! @param[in]  pcFile    Capture file
+//! @param[out] pulSize   File size
+//! @return     uint8_t*  File content, NULL on error
+//
+static uint8_t *ReadCapture(const char *pcFile, uint32_t *pulSize);
+
+//
+//! @brief Find session of a captured connection
+//! @param[in]  ulConnectionId  Captured connection id
+//! @return     Session_t*      Session, NULL if not open
+//
+static Session_t *FindSession(uint32_t ulConnectionId);
+
+//
+//! @brief Open session of a captured connection
+//! @param[in]  ptSettings      Settings
+//! @param[in]  ulConnectionId  Captured connection id
+//! @return     Session_t*      Session, NULL on error
+//
+static Session_t *OpenSession(const Settings_t *ptSettings, uint32_t ulConnectionId);
+
+//
+//! @brief Wait for all responses of session and close it
+//! @param[in]  ptSession  Session
+//! @return     None
+//
+static void CloseSession(Session_t *ptSession);
+
+//
+//! @brief Send captured query of session
+//! @param[in]  ptSession  Session
+//! @param[in]  ucWindow   Queries in flight per connection
+//! @param[in]  pucAdu     Query ADU
+//! @param[in]  usLen      Length of ADU
+//! @return     None
+//
+static void SendQuery(Session_t *ptSession, uint8_t ucWindow, const uint8_t *pucAdu, uint16_t usLen);
+
+//
+//! @brief Receive responses of all sessions until a time
+//! @param[in]  ullUntil   Time to return at, us, 0 - return after one poll
+//! @param[in]  ptSession  Return early when this session has a free window slot, may be NULL
+//! @param[in]  ucWindow   Queries in flight per connection
+//! @return     None
+//
+static void ReceiveResponses(uint64_t ullUntil, const Session_t *ptSession, uint8_t ucWindow);
+
+//
+//! @brief Receive responses of a session
+//! @param[in]  ptSession  Session
+//! @return     bool       false - connection lost
+//
+static bool ReceiveSession(Session_t *ptSession);
+
+//
+//! @brief Print results as JSON
+//! @param[in]  ptSettings  Settings
+//! @param[in]  ullTimeUs   Replay time, us
+//! @return     None
+//
+static void PrintResults(const Settings_t *ptSettings, uint64_t ullTimeUs);
+
+//
+//! @brief Read big endian value
+//! @param[in]  pucData   Data
+//! @param[in]  ucLen     Number of bytes
+//! @return     uint64_t  Value
+//
+static uint64_t ReadValue(const uint8_t *pucData, uint8_t ucLen);
+
+//
+//! @brief Current time of monotonic clock
+//! @param[in]  None
+//! @return     uint64_t  Time in us
+//
+static uint64_t GetTimeUs(void);
+
+//****************************************************************************/
+//                           Local variables
+//****************************************************************************/
+static Session_t m_atSessions[MAX_SESSIONS];
+static Results_t m_tResults;
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+int main(int iArgc, char **ppcArgv)
+{
+    Settings_t tSettings;
+    uint8_t    *pucCapture = NULL;
+    uint32_t   ulSize      = 0;
+    uint32_t   ulOffset    = CP_FILE_HEADER_LEN;
+    uint64_t   ullRecorded = 0;
+    uint64_t   ullStart    = 0;
+    uint16_t   usCount     = 0;
+
+    if (!ParseArgs(iArgc, ppcArgv, &tSettings))
+    {
+        fprintf(stderr,
+                "usage: %s [-h host] [-p port] [-s speed] [-d window] capture file\n"
+                "speed 1 - recorded speed, 0 - as fast as possible\n",
+                ppcArgv[0]);
+        return 1;
+    }
+
+    pucCapture = ReadCapture(tSettings.pcFile, &ulSize);
+
+    if (NULL == pucCapture)
+    {
+        return 1;
+    }
+
+    for (usCount = 0; usCount < MAX_SESSIONS; usCount++)
+    {
+        m_atSessions[usCount].iSocket = -1;
+    }
+
+    ullStart = GetTimeUs();
+
+    while ((ulOffset + CP_RECORD_HEADER_LEN) <= ulSize)
+    {
+        const uint8_t *pucRecord      = &pucCapture[ulOffset];
+        uint32_t      ulConnectionId  = (uint32_t)ReadValue(&pucRecord[4], 4);
+        uint8_t       ucEvent         = pucRecord[8];
+        uint16_t      usLen           = (uint16_t)ReadValue(&pucRecord[9], 2);
+        Session_t     *ptSession      = NULL;
+
+        if ((ulOffset + CP_RECORD_HEADER_LEN + usLen) > ulSize)
+        {
+            //capture stopped while record was written
+            break;
+        }
+
+        ullRecorded += ReadValue(pucRecord, 4);
+        ulOffset    += CP_RECORD_HEADER_LEN + usLen;
+
+        if (0.0 != tSettings.dSpeed)
+        {
+            ReceiveResponses(ullStart + (uint64_t)(ullRecorded / tSettings.dSpeed), NULL, tSettings.ucWindow);
+        }
+
+        ptSession = FindSession(ulConnectionId);
+
+        switch (ucEvent)
+        {
+        case eCAPTURE_OPEN:
+            if (NULL == ptSession)
+            {
+                (void)OpenSession(&tSettings, ulConnectionId);
+            }
+            break;
+        case eCAPTURE_QUERY:
+            if (NULL == ptSession)
+            {
+                //connection was open before capture started
+                ptSession = OpenSession(&tSettings, ulConnectionId);
+            }
+
+            if ((NULL != ptSession) && (usLen >= MBAP_HEADER_LEN) && (usLen <= BUFF_SIZE_IN_BYTES))
+            {
+                SendQuery(ptSession, tSettings.ucWindow, &pucRecord[CP_RECORD_HEADER_LEN], usLen);
+            }
+            break;
+        case eCAPTURE_CLOSE:
+            if (NULL != ptSession)
+            {
+                CloseSession(ptSession);
+            }
+            break;
+        default:
+            break;
+        }
+    }//end while
+
+    for (usCount = 0; usCount < MAX_SESSIONS; usCount++)
+    {
+        if (m_atSessions[usCount].iSocket >= 0)
+        {
+            CloseSession(&m_atSessions[usCount]);
+        }
+    }
+
+    m_tResults.ullRecordedUs = ullRecorded;
+    PrintResults(&tSettings, GetTimeUs() - ullStart);
+    free(pucCapture);
+
+    return 0;
+}//end main
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static bool ParseArgs(int iArgc, char **ppcArgv, Settings_t *ptSettings)
+{
+    int iOption = 0;
+
+    memset(ptSettings, 0, sizeof(Settings_t));
+    ptSettings->pcHost   = "127.0.0.1";
+    ptSettings->usPort   = 502;
+    ptSettings->dSpeed   = 1.0;
+    ptSettings->ucWindow = 16;
+
+    while (-1 != (iOption = getopt(iArgc, ppcArgv, "h:p:s:d:")))
+    {
+        switch (iOption)
+        {
+        case 'h': ptSettings->pcHost   = optarg;                    break;
+        case 'p': ptSettings->usPort   = (uint16_t)atoi(optarg);    break;
+        case 's': ptSettings->dSpeed   = atof(optarg);              break;
+        case 'd': ptSettings->ucWindow = (uint8_t)atoi(optarg);     break;
+        default:
+            return false;
+        }
+    }
+
+    if (optind >= iArgc)
+    {
+        return false;
+    }
+
+    ptSettings->pcFile = ppcArgv[optind];
+
+    return (ptSettings->dSpeed >= 0.0) && (0 != ptSettings->ucWindow) && (ptSettings->ucWindow <= MAX_WINDOW);
+}//end ParseArgs
+
+static uint8_t *ReadCapture(const char *pcFile, uint32_t *pulSize)
+{
+    FILE    *ptFile    = fopen(pcFile, "rb");
+    uint8_t *pucBuf    = NULL;
+    long    lSize      = 0;
+
+    if (NULL == ptFile)
+    {
+        fprintf(stderr, "cannot open %s: %s\n", pcFile, strerror(errno));
+        return NULL;
+    }
+
+    if ((0 == fseek(ptFile, 0, SEEK_END)) && ((lSize = ftell(ptFile)) >= (long)CP_FILE_HEADER_LEN))
+    {
+        pucBuf = (uint8_t *)malloc((size_t)lSize);
+    }
+
+    if ((NULL == pucBuf) || (0 != fseek(ptFile, 0, SEEK_SET)) ||
+        (fread(pucBuf, 1, (size_t)lSize, ptFile) != (size_t)lSize) ||
+        (0 != memcmp(pucBuf, CP_MAGIC, 4)) || (CP_VERSION != ReadValue(&pucBuf[4], 2)))
+    {
+        fprintf(stderr, "%s is no capture file of version %u\n", pcFile, CP_VERSION);
+        free(pucBuf);
+        fclose(ptFile);
+        return NULL;
+    }
+
+    fclose(ptFile);
+    *pulSize = (uint32_t)lSize;
+
+    return pucBuf;
+}//end ReadCapture
+
+static Session_t *FindSession(uint32_t ulConnectionId)
+{
+    uint16_t usCount = 0;
+
+    for (usCount = 0; usCount < MAX_SESSIONS; usCount++)
+    {
+        if ((m_atSessions[usCount].iSocket >= 0) && (ulConnectionId == m_atSessions[usCount].ulConnectionId))
+        {
+            return &m_atSessions[usCount];
+        }
+    }
+
+    return NULL;
+}//end FindSession
+
+static Session_t *OpenSession(const Settings_t *ptSettings, uint32_t ulConnectionId)
+{
+    struct sockaddr_in tServer;
+    Session_t          *ptSession = NULL;
+    uint16_t           usCount    = 0;
+    int                iOption    = 1;
+
+    for (usCount = 0; usCount < MAX_SESSIONS; usCount++)
+    {
+        if (m_atSessions[usCount].iSocket < 0)
+        {
+            ptSession = &m_atSessions[usCount];
+            break;
+        }
+    }
+
+    if (NULL == ptSession)
+    {
+        fprintf(stderr, "too many sessions\n");
+        return NULL;
+    }
+
+    memset(ptSession, 0, sizeof(Session_t));
+    ptSession->ulConnectionId = ulConnectionId;
+    ptSession->iSocket        = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&tServer, 0, sizeof(tServer));
+    tServer.sin_family = AF_INET;
+    tServer.sin_port   = htons(ptSettings->usPort);
+
+    if ((ptSession->iSocket < 0) || (1 != inet_pton(AF_INET, ptSettings->pcHost, &tServer.sin_addr)) ||
+        (0 != connect(ptSession->iSocket, (struct sockaddr *)&tServer, sizeof(tServer))))
+    {
+        fprintf(stderr, "connect failed: %s\n", strerror(errno));
+
+        if (ptSession->iSocket >= 0)
+        {
+            close(ptSession->iSocket);
+        }
+
+        ptSession->iSocket = -1;
+        return NULL;
+    }
+
+    (void)setsockopt(ptSession->iSocket, IPPROTO_TCP, TCP_NODELAY, &iOption, sizeof(iOption));
+    m_tResults.ullSessions++;
+
+    return ptSession;
+}//end OpenSession
+
+static void CloseSession(Session_t *ptSession)
+{
+    uint64_t ullUntil = GetTimeUs() + DRAIN_TIME_US;
+
+    while ((ptSession->iSocket >= 0) && (0 != ptSession->ucNumOfOutstanding) && (GetTimeUs() < ullUntil))
+    {
+        ReceiveResponses(0, NULL, 0);
+    }
+
+    if (ptSession->iSocket >= 0)
+    {
+        m_tResults.ullErrors += ptSession->ucNumOfOutstanding;
+        close(ptSession->iSocket);
+        ptSession->iSocket = -1;
+    }
+}//end CloseSession
+
+static void SendQuery(Session_t *ptSession, uint8_t ucWindow, const uint8_t *pucAdu, uint16_t usLen)
+{
+    uint8_t ucSlot = 0;
+
+    if (ptSession->ucNumOfOutstanding >= ucWindow)
+    {
+        ReceiveResponses(GetTimeUs() + DRAIN_TIME_US, ptSession, ucWindow);
+    }
+
+    if ((ptSession->iSocket < 0) || (ptSession->ucNumOfOutstanding >= ucWindow))
+    {
+        m_tResults.ullErrors++;
+        return;
+    }
+
+    for (ucSlot = 0; ucSlot < MAX_WINDOW; ucSlot++)
+    {
+        if (!ptSession->atOutstanding[ucSlot].bInUse)
+        {
+            break;
+        }
+    }
+
+    if (send(ptSession->iSocket, pucAdu, usLen, MSG_NOSIGNAL) != (ssize_t)usLen)
+    {
+        m_tResults.ullErrors++;
+        return;
+    }
+
+    ptSession->atOutstanding[ucSlot].bInUse          = true;
+    ptSession->atOutstanding[ucSlot].usTransactionId = (uint16_t)ReadValue(pucAdu, 2);
+    ptSession->atOutstanding[ucSlot].ullStart        = GetTimeUs();
+    ptSession->ucNumOfOutstanding++;
+    m_tResults.ullSent++;
+}//end SendQuery
+
+static void ReceiveResponses(uint64_t ullUntil, const Session_t *ptSession, uint8_t ucWindow)
+{
+    struct pollfd atPollFds[MAX_SESSIONS];
+    uint16_t      ausSessions[MAX_SESSIONS];
+
+    do
+    {
+        uint64_t ullNow       = GetTimeUs();
+        nfds_t   ulNumOfFds   = 0;
+        int      iTimeoutMs   = 0;
+        uint16_t usCount      = 0;
+
+        if ((NULL != ptSession) && ((ptSession->iSocket < 0) || (ptSession->ucNumOfOutstanding < ucWindow)))
+        {
+            return;
+        }
+
+        if (ullNow < ullUntil)
+        {
+            iTimeoutMs = (int)((ullUntil - ullNow) / 1000u);
+        }
+
+        for (usCount = 0; usCount < MAX_SESSIONS; usCount++)
+        {
+            if (m_atSessions[usCount].iSocket >= 0)
+            {
+                atPollFds[ulNumOfFds].fd     = m_atSessions[usCount].iSocket;
+                atPollFds[ulNumOfFds].events = POLLIN;
+                ausSessions[ulNumOfFds]      = usCount;
+                ulNumOfFds++;
+            }
+        }
+
+        if ((0 == ullUntil) && (0 != ulNumOfFds))
+        {
+            //wait for next response
+            iTimeoutMs = 10;
+        }
+
+        if (poll(atPollFds, ulNumOfFds, iTimeoutMs) > 0)
+        {
+            nfds_t ulCount = 0;
+
+            for (ulCount = 0; ulCount < ulNumOfFds; ulCount++)
+            {
+                Session_t *ptReceiving = &m_atSessions[ausSessions[ulCount]];
+
+                if ((atPollFds[ulCount].revents & (POLLIN | POLLHUP | POLLERR)) && !ReceiveSession(ptReceiving))
+                {
+                    m_tResults.ullErrors += ptReceiving->ucNumOfOutstanding;
+                    close(ptReceiving->iSocket);
+                    ptReceiving->iSocket = -1;
+                }
+            }
+        }
+    } while (GetTimeUs() < ullUntil);
+}//end ReceiveResponses
+
+static bool ReceiveSession(Session_t *ptSession)
+{
+    ssize_t  sReturn = recv(ptSession->iSocket, &ptSession->aucRxBuf[ptSession->usRxLen],
+                            RX_BUFF_SIZE - ptSession->usRxLen, MSG_DONTWAIT);
+    uint64_t ullNow  = GetTimeUs();
+
+    if (0 == sReturn)
+    {
+        return false;
+    }
+
+    if (sReturn < 0)
+    {
+        return (EAGAIN == errno) || (EWOULDBLOCK == errno) || (EINTR == errno);
+    }
+
+    ptSession->usRxLen += (uint16_t)sReturn;
+
+    while (ptSession->usRxLen >= MBAP_PREFIX_LEN)
+    {
+        uint16_t usAduLen = (uint16_t)(ReadValue(&ptSession->aucRxBuf[4], 2) + MBAP_PREFIX_LEN);
+        uint16_t usTid    = (uint16_t)ReadValue(ptSession->aucRxBuf, 2);
+        uint8_t  ucSlot   = MAX_WINDOW;
+        uint8_t  ucCount  = 0;
+
+        if (usAduLen > BUFF_SIZE_IN_BYTES)
+        {
+            return false;
+        }
+
+        if (ptSession->usRxLen < usAduLen)
+        {
+            break;
+        }
+
+        //oldest query of same transaction id is answered first
+        for (ucCount = 0; ucCount < MAX_WINDOW; ucCount++)
+        {
+            const Outstanding_t *ptCandidate = &ptSession->atOutstanding[ucCount];
+
+            if (ptCandidate->bInUse && (usTid == ptCandidate->usTransactionId) &&
+                ((MAX_WINDOW == ucSlot) || (ptCandidate->ullStart < ptSession->atOutstanding[ucSlot].ullStart)))
+            {
+                ucSlot = ucCount;
+            }
+        }
+
+        if (MAX_WINDOW == ucSlot)
+        {
+            m_tResults.ullErrors++;
+        }
+        else
+        {
+            Outstanding_t *ptOutstanding = &ptSession->atOutstanding[ucSlot];
+            uint64_t      ullLatency     = ullNow - ptOutstanding->ullStart;
+
+            ptOutstanding->bInUse = false;
+            ptSession->ucNumOfOutstanding--;
+            mbap_HistRecord(&m_tResults.tLatency, (ullLatency > 0xFFFFFFFFu) ? 0xFFFFFFFFu : (uint32_t)ullLatency);
+            m_tResults.ullResponses++;
+
+            if (ptSession->aucRxBuf[MBAP_HEADER_LEN] & 0x80)
+            {
+                m_tResults.ullExceptions++;
+            }
+        }
+
+        ptSession->usRxLen -= usAduLen;
+        memmove(ptSession->aucRxBuf, &ptSession->aucRxBuf[usAduLen], ptSession->usRxLen);
+    }//end while
+
+    return true;
+}//end ReceiveSession
+
+static void PrintResults(const Settings_t *ptSettings, uint64_t ullTimeUs)
+{
+    const LatencyHistogram_t *ptLatency = &m_tResults.tLatency;
+
+    printf("{\n"
+           "  \"speed\": %.3f,\n"
+           "  \"window\": %u,\n"
+           "  \"recorded_s\": %.3f,\n"
+           "  \"duration_s\": %.3f,\n"
+           "  \"sessions\": %llu,\n"
+           "  \"sent\": %llu,\n"
+           "  \"responses\": %llu,\n"
+           "  \"exceptions\": %llu,\n"
+           "  \"errors\": %llu,\n"
+           "  \"requests_per_sec\": %.1f,\n"
+           "  \"latency_us\": {\"p50\": %lu, \"p90\": %lu, \"p99\": %lu, \"p999\": %lu, \"max\": %lu, \"mean\": %.1f}\n"
+           "}\n",
+           ptSettings->dSpeed,
+           ptSettings->ucWindow,
+           m_tResults.ullRecordedUs / 1e6,
+           ullTimeUs / 1e6,
+           (unsigned long long)m_tResults.ullSessions,
+           (unsigned long long)m_tResults.ullSent,
+           (unsigned long long)m_tResults.ullResponses,
+           (unsigned long long)m_tResults.ullExceptions,
+           (unsigned long long)m_tResults.ullErrors,
+           (0 == ullTimeUs) ? 0.0 : (m_tResults.ullResponses / (ullTimeUs / 1e6)),
+           (unsigned long)mbap_HistPercentile(ptLatency, 500),
+           (unsigned long)mbap_HistPercentile(ptLatency, 900),
+           (unsigned long)mbap_HistPercentile(ptLatency, 990),
+           (unsigned long)mbap_HistPercentile(ptLatency, 999),
+           (unsigned long)ptLatency->ulMax,
+           (0 == ptLatency->ulCount) ? 0.0 : ((double)ptLatency->ullSum / ptLatency->ulCount));
+}//end PrintResults
+
+static uint64_t ReadValue(const uint8_t *pucData, uint8_t ucLen)
+{
+    uint64_t ullValue = 0;
+    uint8_t  ucCount  = 0;
+
+    for (ucCount = 0; ucCount < ucLen; ucCount++)
+    {
+        ullValue = (ullValue << 8) | pucData[ucCount];
+    }
+
+    return ullValue;
+}//end ReadValue
+
+static uint64_t GetTimeUs(void)
+{
+    struct timespec tNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &tNow);
+
+    return ((uint64_t)tNow.tv_sec * 1000000u) + ((uint64_t)tNow.tv_nsec / 1000u);
+}//end GetTimeUs
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
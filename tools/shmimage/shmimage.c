@@ -0,0 +1,234 @@
+//! @addtogroup SharedImage
+//! @brief Access to shared memory register image
+//! @{
+//!
+//****************************************************************************/
+//! @file shmimage.c
+//! @brief Reads and writes register tables of the shared memory image served
+//!        by the tcp server(-m option) in place, the way a co-located
+//!        process such as a PLC runtime or historian does. Registers are
+//!        printed one per line as "<address> <value>".
+//! @author Savindra Kumar(savindran1989@gmail.com)
+//! @bug No known bugs.
+//!
+//****************************************************************************/
+//****************************************************************************/
+//                           Includes
+//****************************************************************************/
+//standard header files
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+//user defined header files
+#include "mbap_image.h"
+#include "mbap_user.h"
+
+//****************************************************************************/
+//                           Defines and typedefs
+//****************************************************************************/
+#define DEFAULT_NAME         "/modbus"
+//bytes of largest table copied by a read
+#define MAX_TABLE_LEN        (1024u)
+
+//! @brief Settings taken from command line
+typedef struct Settings
+{
+    const char *pcName;                             //!<Shared memory object
+    uint8_t    ucRegion;                            //!<Table(enum UserRegion)
+    uint16_t   usAddress;                           //!<First register or bit
+    uint16_t   usCount;                             //!<Registers or bits
+    bool       bWrite;                              //!<Write usValue instead of read
+    uint16_t   usValue;                             //!<Value written, 0 or 1 for bits
+} Settings_t;
+
+//****************************************************************************/
+//                           Local Functions
+//****************************************************************************/
+//
+//! @brief Parse command line
+//! @param[in]  iArgc       Number of arguments
+//! @param[in]  ppcArgv     Arguments
+//! @param[out] ptSettings  Settings
+//! @return     bool        true - valid
+//
+static bool ParseArgs(int iArgc, char **ppcArgv, Settings_t *ptSettings);
+
+//
+//! @brief Check whether region holds bits
+//! @param[in]  ucRegion  Region
+//! @return     bool      true - discrete inputs or coils
+//
+static bool IsBitRegion(uint8_t ucRegion);
+
+//
+//! @brief Write registers or bits of region in place
+//! @param[in]  ptSettings  Settings
+//! @return     None
+//
+static void WriteRegion(const Settings_t *ptSettings);
+
+//
+//! @brief Print registers or bits of a consistent copy of region
+//! @param[in]  ptSettings  Settings
+//! @return     None
+//
+static void PrintRegion(const Settings_t *ptSettings);
+
+//****************************************************************************/
+//                    G L O B A L  F U N C T I O N S
+//****************************************************************************/
+int main(int iArgc, char **ppcArgv)
+{
+    Settings_t tSettings;
+    uint32_t   ulUnits = 0;
+
+    if (!ParseArgs(iArgc, ppcArgv, &tSettings))
+    {
+        fprintf(stderr, "Usage: %s [-n /name] [-t i|h|d|c] [-a address] [-c count] [-w value]\n", ppcArgv[0]);
+        return 1;
+    }
+
+    if (!mbap_ImageAttach(tSettings.pcName))
+    {
+        fprintf(stderr, "No register image %s\n", tSettings.pcName);
+        return 1;
+    }
+
+    ulUnits = mbap_ImageRegionLength(tSettings.ucRegion);
+    ulUnits = IsBitRegion(tSettings.ucRegion) ? (ulUnits * 8u) : (ulUnits / sizeof(int16_t));
+
+    if (((uint32_t)tSettings.usAddress + tSettings.usCount > ulUnits) ||
+        (mbap_ImageRegionLength(tSettings.ucRegion) > MAX_TABLE_LEN))
+    {
+        fprintf(stderr, "Table holds %u values\n", (unsigned)ulUnits);
+        mbap_ImageClose();
+        return 1;
+    }
+
+    if (tSettings.bWrite)
+    {
+        WriteRegion(&tSettings);
+    }
+    else
+    {
+        PrintRegion(&tSettings);
+    }
+
+    mbap_ImageClose();
+
+    return 0;
+}//end main
+
+//****************************************************************************/
+//                           L O C A L  F U N C T I O N S
+//****************************************************************************/
+static bool ParseArgs(int iArgc, char **ppcArgv, Settings_t *ptSettings)
+{
+    static const char acTables[eNUM_OF_REGIONS] = {'i', 'h', 'd', 'c'};
+    const char *pcTable = NULL;
+    int        iOption  = 0;
+
+    memset(ptSettings, 0, sizeof(Settings_t));
+    ptSettings->pcName   = DEFAULT_NAME;
+    ptSettings->ucRegion = eREGION_HOLDING_REGISTERS;
+    ptSettings->usCount  = 1;
+
+    while (-1 != (iOption = getopt(iArgc, ppcArgv, "n:t:a:c:w:")))
+    {
+        switch (iOption)
+        {
+        case 'n': ptSettings->pcName    = optarg;                       break;
+        case 'a': ptSettings->usAddress = (uint16_t)atoi(optarg);       break;
+        case 'c': ptSettings->usCount   = (uint16_t)atoi(optarg);       break;
+        case 'w': ptSettings->usValue   = (uint16_t)atoi(optarg);
+                  ptSettings->bWrite    = true;                         break;
+        case 't':
+            pcTable = memchr(acTables, optarg[0], sizeof(acTables));
+
+            if (NULL == pcTable)
+            {
+                return false;
+            }
+
+            ptSettings->ucRegion = (uint8_t)(pcTable - acTables);
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return (0 != ptSettings->usCount) &&
+           (!ptSettings->bWrite || !IsBitRegion(ptSettings->ucRegion) || (ptSettings->usValue <= 1u));
+}//end ParseArgs
+
+static bool IsBitRegion(uint8_t ucRegion)
+{
+    return (eREGION_DISCRETE_INPUTS == ucRegion) || (eREGION_COILS == ucRegion);
+}//end IsBitRegion
+
+static void WriteRegion(const Settings_t *ptSettings)
+{
+    uint8_t  *pucRegion = (uint8_t *)mbap_ImageRegion(ptSettings->ucRegion);
+    int16_t  *psRegion  = (int16_t *)mbap_ImageRegion(ptSettings->ucRegion);
+    uint32_t ulIndex    = 0;
+
+    //server sees all values of this write or none
+    mbap_ImageWriteBegin(ptSettings->ucRegion);
+
+    for (ulIndex = ptSettings->usAddress; ulIndex < (uint32_t)ptSettings->usAddress + ptSettings->usCount; ulIndex++)
+    {
+        if (!IsBitRegion(ptSettings->ucRegion))
+        {
+            psRegion[ulIndex] = (int16_t)ptSettings->usValue;
+        }
+        else if (0 != ptSettings->usValue)
+        {
+            pucRegion[ulIndex / 8u] |= (uint8_t)(1u << (ulIndex % 8u));
+        }
+        else
+        {
+            pucRegion[ulIndex / 8u] &= (uint8_t)~(1u << (ulIndex % 8u));
+        }
+    }
+
+    mbap_ImageWriteEnd(ptSettings->ucRegion);
+}//end WriteRegion
+
+static void PrintRegion(const Settings_t *ptSettings)
+{
+    uint8_t  aucCopy[MAX_TABLE_LEN];
+    int16_t  asCopy[MAX_TABLE_LEN / sizeof(int16_t)];
+    uint32_t ulLength   = mbap_ImageRegionLength(ptSettings->ucRegion);
+    uint32_t ulSequence = 0;
+    uint32_t ulIndex    = 0;
+
+    //copy out only to print values of a single write, readers in place
+    //follow the same begin and retry pattern
+    do
+    {
+        ulSequence = mbap_ImageReadBegin(ptSettings->ucRegion);
+        memcpy(aucCopy, mbap_ImageRegion(ptSettings->ucRegion), ulLength);
+    } while (mbap_ImageReadRetry(ptSettings->ucRegion, ulSequence));
+
+    memcpy(asCopy, aucCopy, ulLength);
+
+    for (ulIndex = ptSettings->usAddress; ulIndex < (uint32_t)ptSettings->usAddress + ptSettings->usCount; ulIndex++)
+    {
+        if (IsBitRegion(ptSettings->ucRegion))
+        {
+            printf("%u %u\n", (unsigned)ulIndex, (unsigned)((aucCopy[ulIndex / 8u] >> (ulIndex % 8u)) & 1u));
+        }
+        else
+        {
+            printf("%u %d\n", (unsigned)ulIndex, asCopy[ulIndex]);
+        }
+    }
+}//end PrintRegion
+
+//****************************************************************************/
+//                             End of file
+//****************************************************************************/
+/** @}*/
@@ -0,0 +1,230 @@
+#include "CppUTest/TestHarness.h"
+#include <string.h>
+#include <stdio.h>
+
+
+extern "C"
+{
+    #include "mbap_conf.h"
+    #include "mbap.h"
+    #include "mbap_unit.h"
+    #include "mbap_user.h"
+}
+
+#define QUERY_SIZE_IN_BYTES              (255u)
+#define RESPONSE_SIZE_IN_BYTES           (255u)
+#define MBT_EXCEPTION_PACKET_LEN         (9u)
+//PDU Offset in response
+#define MBT_BYTE_COUNT_OFFSET            (8u)
+#define MBT_DATA_VALUES_OFFSET           (9u)
+#define MBAP_HEADER_LEN                  (7u)
+#define ASYNC_UNIT_ID                    (5u)
+
+static ModbusRequest_t *m_ptPendingRequest = NULL;
+static ModbusRequest_t *m_ptDoneRequest    = NULL;
+static uint8_t         m_ucAsyncResult     = eASYNC_PENDING;
+static uint16_t        m_usSyncReads       = 0;
+static int16_t         m_asLimits[10]      = {0};
+static int16_t         m_asHigherLimits[10] = {100, 100, 100, 100, 100, 100, 100, 100, 100, 100};
+
+static uint8_t AsyncAccess(ModbusRequest_t *ptRequest)
+{
+    m_ptPendingRequest = ptRequest;
+
+    return m_ucAsyncResult;
+}
+
+static void RequestDone(ModbusRequest_t *ptRequest)
+{
+    m_ptDoneRequest = ptRequest;
+}
+
+static void SyncReadHoldingRegisters(uint16_t usStartAddress, uint16_t usNumOfData, uint8_t *pucRecBuf)
+{
+    m_usSyncReads++;
+    memset(pucRecBuf, 0x11, usNumOfData * 2);
+}
+
+TEST_GROUP(Async)
+{
+    uint8_t         *pucQuery    = NULL;
+    uint8_t         *pucResponse = NULL;
+    ModbusData_t    tModbusData;
+    ModbusRequest_t tRequest;
+
+    void setup()
+    {
+        pucQuery     = (uint8_t*)calloc(QUERY_SIZE_IN_BYTES,  sizeof(uint8_t));
+        pucResponse  = (uint8_t*)calloc(RESPONSE_SIZE_IN_BYTES, sizeof(uint8_t));
+
+        memset(&tModbusData, 0, sizeof(tModbusData));
+        tModbusData.usMaxHoldingRegisters        = 10;
+        tModbusData.psHoldingRegisterLowerLimit  = m_asLimits;
+        tModbusData.psHoldingRegisterHigherLimit = m_asHigherLimits;
+        tModbusData.ptfnReadHoldingRegisters     = SyncReadHoldingRegisters;
+        tModbusData.ptfnAsyncAccess              = AsyncAccess;
+
+        memset(&tRequest, 0, sizeof(tRequest));
+        tRequest.pucQuery    = pucQuery;
+        tRequest.pucResponse = pucResponse;
+        tRequest.ptfnDone    = RequestDone;
+
+        m_ptPendingRequest = NULL;
+        m_ptDoneRequest    = NULL;
+        m_ucAsyncResult    = eASYNC_PENDING;
+        m_usSyncReads      = 0;
+
+        //Init modbus data
+        mu_Init();
+        mbap_UnitAdd(0, ASYNC_UNIT_ID, &tModbusData);
+    }
+
+    void teardown()
+    {
+        free(pucQuery);
+        free(pucResponse);
+    }
+};
+
+TEST(Async, PendingReadCompletesLaterTest)
+{
+    uint8_t ucQueryBuf[12] = {0, 7, 0, 0, 0, 6, ASYNC_UNIT_ID, 3, 0, 2, 0, 2};
+
+    memcpy(pucQuery, ucQueryBuf, 12);
+    tRequest.usQueryLen = 12;
+
+    //function under test
+    CHECK_EQUAL(MBAP_RESPONSE_PENDING, mbap_SubmitRequest(&tRequest));
+    POINTERS_EQUAL(&tRequest, m_ptPendingRequest);
+    POINTERS_EQUAL(NULL, m_ptDoneRequest);
+    CHECK_EQUAL(eTABLE_HOLDING_REGISTERS, tRequest.ucTable);
+    CHECK_FALSE(tRequest.bWrite);
+    CHECK_EQUAL(2, tRequest.usStartAddress);
+    CHECK_EQUAL(2, tRequest.usNumOfData);
+
+    //backend delivers data later
+    memset(tRequest.pucReadData, 0x22, 4);
+    mbap_CompleteRequest(&tRequest, eNO_EXCEPTION);
+
+    POINTERS_EQUAL(&tRequest, m_ptDoneRequest);
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 4, tRequest.usResponseLen);
+    CHECK_EQUAL(7, pucResponse[1]);
+    CHECK_EQUAL(4, pucResponse[MBT_BYTE_COUNT_OFFSET]);
+    CHECK_EQUAL(0x22, pucResponse[MBT_DATA_VALUES_OFFSET + 3]);
+}
+
+TEST(Async, PendingWriteCompletesWithExceptionTest)
+{
+    uint8_t ucQueryBuf[12] = {0, 0, 0, 0, 0, 6, ASYNC_UNIT_ID, 6, 0, 1, 0, 50};
+
+    memcpy(pucQuery, ucQueryBuf, 12);
+
+    CHECK_EQUAL(MBAP_RESPONSE_PENDING, mbap_SubmitRequest(&tRequest));
+    CHECK_TRUE(tRequest.bWrite);
+    CHECK_EQUAL(50, tRequest.pucWriteData[1]);
+
+    mbap_CompleteRequest(&tRequest, eSERVER_DEVICE_FAILURE);
+
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, tRequest.usResponseLen);
+    CHECK_EQUAL(eSERVER_DEVICE_FAILURE, pucResponse[MBT_BYTE_COUNT_OFFSET]);
+}
+
+TEST(Async, AsyncAccessDoneImmediatelyTest)
+{
+    uint8_t ucQueryBuf[12] = {0, 0, 0, 0, 0, 6, ASYNC_UNIT_ID, 3, 0, 0, 0, 1};
+
+    memcpy(pucQuery, ucQueryBuf, 12);
+    m_ucAsyncResult = eNO_EXCEPTION;
+
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 2, mbap_SubmitRequest(&tRequest));
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 2, tRequest.usResponseLen);
+    POINTERS_EQUAL(NULL, m_ptDoneRequest);
+}
+
+TEST(Async, RequestWithoutCompletionUsesSynchronousFunctionsTest)
+{
+    uint8_t ucQueryBuf[12] = {0, 0, 0, 0, 0, 6, ASYNC_UNIT_ID, 3, 0, 0, 0, 1};
+
+    memcpy(pucQuery, ucQueryBuf, 12);
+
+    //function under test
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 2, mbap_ProcessRequest(pucQuery, 12, pucResponse));
+    CHECK_EQUAL(1, m_usSyncReads);
+    POINTERS_EQUAL(NULL, m_ptPendingRequest);
+    CHECK_EQUAL(0x11, pucResponse[MBT_DATA_VALUES_OFFSET]);
+}
+
+TEST(Async, ReadMultipleRangesRejectedForAsyncAccessTest)
+{
+    uint8_t ucQueryBuf[14] = {0, 0, 0, 0, 0, 8, ASYNC_UNIT_ID, 69, 1, eTABLE_HOLDING_REGISTERS, 0, 0, 0, 2};
+
+    memcpy(pucQuery, ucQueryBuf, 14);
+    tRequest.usQueryLen = 14;
+
+    //function under test
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, mbap_SubmitRequest(&tRequest));
+    CHECK_EQUAL(eILLEGAL_FUNCTION_CODE, pucResponse[MBT_BYTE_COUNT_OFFSET]);
+    POINTERS_EQUAL(NULL, m_ptPendingRequest);
+    CHECK_EQUAL(0, m_usSyncReads);
+
+    //request without completion uses synchronous functions
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 1 + 4, mbap_ProcessRequest(pucQuery, 14, pucResponse));
+    CHECK_EQUAL(1, m_usSyncReads);
+}
+
+TEST(Async, PendingRequestAccessedByOtherThreadTest)
+{
+    uint8_t ucQueryBuf[12] = {0, 0, 0, 0, 0, 6, ASYNC_UNIT_ID, 3, 0, 1, 0, 3};
+
+    memcpy(pucQuery, ucQueryBuf, 12);
+
+    CHECK_EQUAL(MBAP_RESPONSE_PENDING, mbap_SubmitRequest(&tRequest));
+
+    //worker runs synchronous user function of pending request
+    CHECK_EQUAL(eNO_EXCEPTION, mbap_AccessRequestData(&tRequest));
+    mbap_CompleteRequest(&tRequest, eNO_EXCEPTION);
+
+    CHECK_EQUAL(1, m_usSyncReads);
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 6, tRequest.usResponseLen);
+    CHECK_EQUAL(0x11, pucResponse[MBT_DATA_VALUES_OFFSET + 5]);
+}
+
+TEST(Async, RejectRequestWithServerBusyTest)
+{
+    uint8_t ucQueryBuf[12] = {0, 9, 0, 0, 0, 6, ASYNC_UNIT_ID, 3, 0, 1, 0, 3};
+
+    memcpy(pucQuery, ucQueryBuf, 12);
+
+    //function under test
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, mbap_RejectRequest(&tRequest, eSERVER_BUSY));
+
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, tRequest.usResponseLen);
+    CHECK_EQUAL(9, pucResponse[1]);
+    CHECK_EQUAL(0x83, pucResponse[7]);
+    CHECK_EQUAL(eSERVER_BUSY, pucResponse[MBT_BYTE_COUNT_OFFSET]);
+    POINTERS_EQUAL(NULL, m_ptPendingRequest);
+}
+
+TEST(Async, ReadOnlyTablesRejectWritesTest)
+{
+    uint8_t ucWriteBuf[12] = {0, 0, 0, 0, 0, 6, 1, 6, 0, 1, 0, 50};
+    uint8_t ucReadBuf[12]  = {0, 0, 0, 0, 0, 6, 1, 3, 0, 1, 0, 1};
+
+    //function under test
+    mu_SetReadOnly(true);
+
+    memcpy(pucQuery, ucWriteBuf, 12);
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, mbap_SubmitRequest(&tRequest));
+    CHECK_EQUAL(eILLEGAL_FUNCTION_CODE, pucResponse[MBT_BYTE_COUNT_OFFSET]);
+    memcpy(pucQuery, ucReadBuf, 12);
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 2, mbap_SubmitRequest(&tRequest));
+
+    //promoted standby accepts writes
+    mu_SetReadOnly(false);
+    memcpy(pucQuery, ucWriteBuf, 12);
+    CHECK_EQUAL(12, mbap_SubmitRequest(&tRequest));
+    memcpy(pucQuery, ucReadBuf, 12);
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 2, mbap_SubmitRequest(&tRequest));
+    CHECK_EQUAL(50, pucResponse[MBT_DATA_VALUES_OFFSET + 1]);
+    g_sHoldingRegsBuf[1] = 6;
+}
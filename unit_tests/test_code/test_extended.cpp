@@ -0,0 +1,153 @@
+#include "CppUTest/TestHarness.h"
+#include <string.h>
+#include <stdio.h>
+
+
+extern "C"
+{
+    #include "mbap_conf.h"
+    #include "mbap.h"
+    #include "mbap_unit.h"
+    #include "mbap_user.h"
+}
+
+#define EXT_ADU_LEN                      (16384u)
+#define MBT_EXCEPTION_PACKET_LEN         (9u)
+#define MBT_EXCEPTION_CODE_OFFSET        (8u)
+//PDU Offset in response
+#define MBT_BYTE_COUNT_OFFSET            (8u)
+#define MBT_DATA_VALUES_OFFSET           (9u)
+#define MBAP_HEADER_LEN                  (7u)
+#define WRITE_DATA_OFFSET                (13u)
+#define EXTENDED_UNIT_ID                 (6u)
+#define NUM_OF_REGISTERS                 (4000u)
+
+static uint8_t m_aucRegisters[NUM_OF_REGISTERS * 2];
+static int16_t m_asLowerLimits[NUM_OF_REGISTERS];
+static int16_t m_asHigherLimits[NUM_OF_REGISTERS];
+
+static void ReadHoldingRegisters(uint16_t usStartAddress, uint16_t usNumOfData, uint8_t *pucRecBuf)
+{
+    memcpy(pucRecBuf, &m_aucRegisters[usStartAddress * 2], usNumOfData * 2);
+}
+
+static void WriteHoldingRegisters(uint16_t usStartAddress, uint16_t usNumOfData, const uint8_t *pucWriteBuf)
+{
+    memcpy(&m_aucRegisters[usStartAddress * 2], pucWriteBuf, usNumOfData * 2);
+}
+
+TEST_GROUP(Extended)
+{
+    uint8_t         *pucQuery    = NULL;
+    uint8_t         *pucResponse = NULL;
+    ModbusData_t    tModbusData;
+    ModbusRequest_t tRequest;
+
+    void setup()
+    {
+        uint16_t usCount = 0;
+
+        pucQuery     = (uint8_t*)calloc(EXT_ADU_LEN, sizeof(uint8_t));
+        pucResponse  = (uint8_t*)calloc(EXT_ADU_LEN, sizeof(uint8_t));
+
+        for (usCount = 0; usCount < NUM_OF_REGISTERS; usCount++)
+        {
+            m_aucRegisters[usCount * 2]     = (uint8_t)(usCount >> 8);
+            m_aucRegisters[usCount * 2 + 1] = (uint8_t)usCount;
+            m_asLowerLimits[usCount]        = INT16_MIN;
+            m_asHigherLimits[usCount]       = INT16_MAX;
+        }
+
+        memset(&tModbusData, 0, sizeof(tModbusData));
+        tModbusData.usMaxHoldingRegisters        = NUM_OF_REGISTERS;
+        tModbusData.psHoldingRegisterLowerLimit  = m_asLowerLimits;
+        tModbusData.psHoldingRegisterHigherLimit = m_asHigherLimits;
+        tModbusData.ptfnReadHoldingRegisters     = ReadHoldingRegisters;
+        tModbusData.ptfnWriteHoldingRegisters    = WriteHoldingRegisters;
+
+        memset(&tRequest, 0, sizeof(tRequest));
+        tRequest.pucQuery    = pucQuery;
+        tRequest.pucResponse = pucResponse;
+        tRequest.usMaxAduLen = EXT_ADU_LEN;
+
+        //Init modbus data
+        mu_Init();
+        mbap_UnitAdd(0, EXTENDED_UNIT_ID, &tModbusData);
+    }
+
+    void teardown()
+    {
+        free(pucQuery);
+        free(pucResponse);
+    }
+};
+
+TEST(Extended, ReadThousandsOfRegistersTest)
+{
+    uint8_t ucQueryBuf[12] = {0, 1, 0, 0, 0, 6, EXTENDED_UNIT_ID, 3, 0, 0, 0x0F, 0xA0};
+
+    memcpy(pucQuery, ucQueryBuf, 12);
+    tRequest.usQueryLen = 12;
+    //function under test
+    CHECK_EQUAL(MBT_DATA_VALUES_OFFSET + NUM_OF_REGISTERS * 2, mbap_SubmitRequest(&tRequest));
+    //MBAP length counts unit id, function code, byte count and data
+    CHECK_EQUAL(0x1F, pucResponse[4]);
+    CHECK_EQUAL(0x43, pucResponse[5]);
+    //byte count carries low byte of data length
+    CHECK_EQUAL((uint8_t)(NUM_OF_REGISTERS * 2), pucResponse[MBT_BYTE_COUNT_OFFSET]);
+    CHECK_EQUAL(0, memcmp(&pucResponse[MBT_DATA_VALUES_OFFSET], m_aucRegisters, NUM_OF_REGISTERS * 2));
+}
+
+TEST(Extended, WriteThousandsOfRegistersTest)
+{
+    uint8_t  ucQueryBuf[13] = {0, 2, 0, 0, 0x1F, 0x47, EXTENDED_UNIT_ID, 16, 0, 0, 0x0F, 0xA0, 0x40};
+    uint16_t usCount        = 0;
+
+    memcpy(pucQuery, ucQueryBuf, 13);
+
+    for (usCount = 0; usCount < NUM_OF_REGISTERS * 2; usCount++)
+    {
+        pucQuery[WRITE_DATA_OFFSET + usCount] = 0x5A;
+    }
+
+    tRequest.usQueryLen = WRITE_DATA_OFFSET + NUM_OF_REGISTERS * 2;
+    //function under test
+    CHECK_EQUAL(12, mbap_SubmitRequest(&tRequest));
+    //start address and number of registers are echoed
+    CHECK_EQUAL(0, pucResponse[8]);
+    CHECK_EQUAL(0, pucResponse[9]);
+    CHECK_EQUAL(0x0F, pucResponse[10]);
+    CHECK_EQUAL(0xA0, pucResponse[11]);
+    CHECK_EQUAL(0x5A, m_aucRegisters[0]);
+    CHECK_EQUAL(0x5A, m_aucRegisters[NUM_OF_REGISTERS * 2 - 1]);
+}
+
+TEST(Extended, IncompleteWriteDataRejectedTest)
+{
+    //MBAP length holds 100 registers of data only
+    uint8_t ucQueryBuf[13] = {0, 3, 0, 0, 0, 0xCF, EXTENDED_UNIT_ID, 16, 0, 0, 0x0F, 0xA0, 0x40};
+
+    memcpy(pucQuery, ucQueryBuf, 13);
+    tRequest.usQueryLen = WRITE_DATA_OFFSET + 200;
+    //function under test
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, mbap_SubmitRequest(&tRequest));
+    CHECK_EQUAL(0x90, pucResponse[7]);
+    CHECK_EQUAL(eILLEGAL_DATA_VALUE, pucResponse[MBT_EXCEPTION_CODE_OFFSET]);
+}
+
+TEST(Extended, StandardFramingRejectsLargeReadTest)
+{
+    uint8_t ucQueryBuf[12] = {0, 4, 0, 0, 0, 6, EXTENDED_UNIT_ID, 3, 0, 0, 0, 126};
+
+    memcpy(pucQuery, ucQueryBuf, 12);
+    tRequest.usQueryLen  = 12;
+    tRequest.usMaxAduLen = 0;
+    //function under test
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, mbap_SubmitRequest(&tRequest));
+    CHECK_EQUAL(0x83, pucResponse[7]);
+    CHECK_EQUAL(eILLEGAL_DATA_VALUE, pucResponse[MBT_EXCEPTION_CODE_OFFSET]);
+
+    //largest read of Modbus TCP ADU
+    pucQuery[11] = 125;
+    CHECK_EQUAL(MBT_DATA_VALUES_OFFSET + 250, mbap_SubmitRequest(&tRequest));
+}
@@ -0,0 +1,82 @@
+#include "CppUTest/TestHarness.h"
+#include <string.h>
+#include <stdio.h>
+
+
+extern "C"
+{
+    #include "mbap_hist.h"
+}
+
+TEST_GROUP(Histogram)
+{
+    LatencyHistogram_t tHist;
+
+    void setup()
+    {
+        memset(&tHist, 0, sizeof(tHist));
+    }
+
+    void teardown()
+    {
+    }
+};
+
+TEST(Histogram, EmptyHistogramTest)
+{
+    CHECK_EQUAL(0, mbap_HistPercentile(&tHist, 500));
+}
+
+TEST(Histogram, SmallValuesAreExactTest)
+{
+    for (uint32_t ulValue = 1; ulValue <= 7; ulValue++)
+    {
+        mbap_HistRecord(&tHist, ulValue);
+    }
+
+    CHECK_EQUAL(7, tHist.ulCount);
+    CHECK_EQUAL(4, mbap_HistPercentile(&tHist, 500));
+    CHECK_EQUAL(7, mbap_HistPercentile(&tHist, 1000));
+    CHECK_EQUAL(1, mbap_HistPercentile(&tHist, 0));
+}
+
+TEST(Histogram, PercentilesWithinPrecisionTest)
+{
+    for (uint32_t ulValue = 1; ulValue <= 10000; ulValue++)
+    {
+        mbap_HistRecord(&tHist, ulValue);
+    }
+
+    uint32_t ulP50 = mbap_HistPercentile(&tHist, 500);
+    uint32_t ulP99 = mbap_HistPercentile(&tHist, 990);
+
+    CHECK_TRUE((ulP50 >= 5000) && (ulP50 <= 5000 + 5000 / 8));
+    CHECK_TRUE((ulP99 >= 9900) && (ulP99 <= 10000));
+    CHECK_EQUAL(10000, mbap_HistPercentile(&tHist, 1000));
+    CHECK_EQUAL(10000, tHist.ulMax);
+}
+
+TEST(Histogram, LargestValueTest)
+{
+    mbap_HistRecord(&tHist, 0xFFFFFFFFu);
+
+    CHECK_EQUAL(0xFFFFFFFFu, mbap_HistPercentile(&tHist, 999));
+}
+
+TEST(Histogram, MergeTest)
+{
+    LatencyHistogram_t tOther;
+
+    memset(&tOther, 0, sizeof(tOther));
+    mbap_HistRecord(&tHist, 10);
+    mbap_HistRecord(&tOther, 1000);
+    mbap_HistRecord(&tOther, 1000);
+
+    mbap_HistMerge(&tHist, &tOther);
+
+    CHECK_EQUAL(3, tHist.ulCount);
+    CHECK_EQUAL(2010, tHist.ullSum);
+    CHECK_EQUAL(1000, tHist.ulMax);
+    CHECK_EQUAL(10, mbap_HistPercentile(&tHist, 300));
+    CHECK_EQUAL(1000, mbap_HistPercentile(&tHist, 500));
+}
@@ -0,0 +1,280 @@
+#include "CppUTest/TestHarness.h"
+#include <string.h>
+#include <stdio.h>
+
+
+extern "C"
+{
+    #include "mbap_conf.h"
+    #include "mbap.h"
+    #include "mbap_unit.h"
+    #include "mbap_user.h"
+    #include "mbap_history.h"
+}
+
+#define RESPONSE_SIZE_IN_BYTES           (260u)
+#define MBT_EXCEPTION_PACKET_LEN         (9u)
+#define MBAP_HEADER_LEN                  (7u)
+#define HISTORY_UNIT_ID                  (7u)
+#define NUM_OF_REGISTERS                 (4u)
+//response data follows function code
+#define DATA_OFFSET                      (MBAP_HEADER_LEN + 1u)
+
+static uint16_t m_ausRegisters[NUM_OF_REGISTERS];
+
+static uint8_t AsyncAccess(ModbusRequest_t *ptRequest)
+{
+    return mbap_AccessRequestData(ptRequest);
+}
+
+//registers from 2 on are served by a slow backend
+static bool IsAsyncRange(const ModbusRequest_t *ptRequest)
+{
+    return (ptRequest->usStartAddress + ptRequest->usNumOfData) > 2u;
+}
+
+static void ReadInputRegisters(uint16_t usStartAddress, uint16_t usNumOfData, uint8_t *pucRecBuf)
+{
+    uint16_t usIndex = 0;
+
+    for (usIndex = 0; usIndex < usNumOfData; usIndex++)
+    {
+        pucRecBuf[usIndex * 2]     = (uint8_t)(m_ausRegisters[usStartAddress + usIndex] >> 8);
+        pucRecBuf[usIndex * 2 + 1] = (uint8_t)(m_ausRegisters[usStartAddress + usIndex]);
+    }
+}
+
+//
+//! @brief Decode varint of response
+//
+static uint32_t GetVarint(const uint8_t *pucBuf, uint16_t *pusPos)
+{
+    uint32_t ulValue = 0;
+    uint8_t  ucShift = 0;
+
+    while (pucBuf[*pusPos] & 0x80u)
+    {
+        ulValue |= (uint32_t)(pucBuf[(*pusPos)++] & 0x7Fu) << ucShift;
+        ucShift += 7;
+    }
+
+    return ulValue | ((uint32_t)pucBuf[(*pusPos)++] << ucShift);
+}
+
+TEST_GROUP(History)
+{
+    uint8_t      aucResponse[RESPONSE_SIZE_IN_BYTES];
+    ModbusData_t tModbusData;
+    uint8_t      ucNumOfSamples;
+    uint32_t     ulFirst;
+    uint64_t     aullTimes[64];
+    uint16_t     aausValues[64][NUM_OF_REGISTERS];
+
+    void setup()
+    {
+        memset(m_ausRegisters, 0, sizeof(m_ausRegisters));
+        memset(&tModbusData, 0, sizeof(tModbusData));
+        tModbusData.usMaxInputRegisters    = NUM_OF_REGISTERS;
+        tModbusData.ptfnReadInputRegisters = ReadInputRegisters;
+
+        mu_Init();
+        mbap_UnitAdd(0, HISTORY_UNIT_ID, &tModbusData);
+        mbap_HistoryInit();
+    }
+
+    //
+    //! @brief Send Read History query, decode samples of response
+    //
+    uint16_t ReadHistory(uint8_t ucRange, uint32_t ulSince)
+    {
+        uint8_t  aucQuery[13] = {0, 1, 0, 0, 0, 7, HISTORY_UNIT_ID, eFC_READ_HISTORY, ucRange,
+                                 (uint8_t)(ulSince >> 24), (uint8_t)(ulSince >> 16),
+                                 (uint8_t)(ulSince >> 8), (uint8_t)ulSince};
+        uint16_t usLen    = 0;
+        uint16_t usPos    = DATA_OFFSET + HISTORY_RESPONSE_HEADER_LEN;
+        uint16_t usValue  = 0;
+        uint64_t ullTime  = 0;
+        uint8_t  ucSample = 0;
+        uint8_t  ucIndex  = 0;
+
+        memset(aucResponse, 0, sizeof(aucResponse));
+        memset(aausValues, 0, sizeof(aausValues));
+        usLen = mbap_ProcessRequest(aucQuery, sizeof(aucQuery), aucResponse);
+
+        if (usLen <= MBT_EXCEPTION_PACKET_LEN)
+        {
+            return usLen;
+        }
+
+        CHECK_EQUAL(usLen - 6u, (aucResponse[4] << 8) | aucResponse[5]);
+        CHECK_EQUAL(ucRange, aucResponse[DATA_OFFSET]);
+        ulFirst        = ((uint32_t)aucResponse[DATA_OFFSET + 2] << 24) | ((uint32_t)aucResponse[DATA_OFFSET + 3] << 16) |
+                         ((uint32_t)aucResponse[DATA_OFFSET + 4] << 8) | aucResponse[DATA_OFFSET + 5];
+        ucNumOfSamples = aucResponse[DATA_OFFSET + 6];
+
+        for (ucIndex = 0; ucIndex < 8; ucIndex++)
+        {
+            ullTime = (ullTime << 8) | aucResponse[DATA_OFFSET + 7 + ucIndex];
+        }
+
+        for (ucSample = 0; ucSample < ucNumOfSamples; ucSample++)
+        {
+            ullTime             += GetVarint(aucResponse, &usPos);
+            aullTimes[ucSample]  = ullTime;
+
+            for (ucIndex = 0; ucIndex < aucResponse[DATA_OFFSET + 1]; ucIndex++)
+            {
+                uint32_t ulZigzag = GetVarint(aucResponse, &usPos);
+
+                usValue                       = (ucSample > 0) ? aausValues[ucSample - 1][ucIndex] : 0;
+                aausValues[ucSample][ucIndex] = (uint16_t)(usValue + (uint16_t)((ulZigzag >> 1) ^ (0u - (ulZigzag & 1u))));
+            }
+        }
+
+        CHECK_EQUAL(usLen, usPos);
+
+        return usLen;
+    }
+};
+
+TEST(History, PeriodicSamplesReadSinceSequenceTest)
+{
+    CHECK_EQUAL(0, mbap_HistoryAdd(HISTORY_UNIT_ID, eTABLE_INPUT_REGISTERS, 1, 3, 10, eHISTORY_PERIODIC, 4));
+
+    //function under test
+    m_ausRegisters[1] = 100;
+    m_ausRegisters[3] = 0xFFFF;
+    mbap_HistorySample(1000);
+    m_ausRegisters[1] = 90;
+    mbap_HistorySample(1005);
+    mbap_HistorySample(1010);
+    m_ausRegisters[2] = 7;
+    mbap_HistorySample(1020);
+
+    ReadHistory(0, 0);
+    CHECK_EQUAL(0, ulFirst);
+    CHECK_EQUAL(3, ucNumOfSamples);
+    CHECK_EQUAL(3, aucResponse[DATA_OFFSET + 1]);
+    CHECK_EQUAL(1000, aullTimes[0]);
+    CHECK_EQUAL(1010, aullTimes[1]);
+    CHECK_EQUAL(1020, aullTimes[2]);
+    CHECK_EQUAL(100, aausValues[0][0]);
+    CHECK_EQUAL(0xFFFF, aausValues[0][2]);
+    CHECK_EQUAL(90, aausValues[1][0]);
+    CHECK_EQUAL(0, aausValues[1][1]);
+    CHECK_EQUAL(7, aausValues[2][1]);
+
+    //later samples only, first returned sample is encoded against zero
+    ReadHistory(0, 2);
+    CHECK_EQUAL(2, ulFirst);
+    CHECK_EQUAL(1, ucNumOfSamples);
+    CHECK_EQUAL(1020, aullTimes[0]);
+    CHECK_EQUAL(90, aausValues[0][0]);
+    CHECK_EQUAL(7, aausValues[0][1]);
+}
+
+TEST(History, OnChangeStoresChangedSamplesOnlyTest)
+{
+    CHECK_EQUAL(0, mbap_HistoryAdd(HISTORY_UNIT_ID, eTABLE_INPUT_REGISTERS, 0, 4, 1, eHISTORY_ON_CHANGE, 2));
+
+    //function under test
+    mbap_HistorySample(1);
+    mbap_HistorySample(2);
+    m_ausRegisters[0] = 5;
+    mbap_HistorySample(3);
+    mbap_HistorySample(4);
+
+    ReadHistory(0, 0);
+    CHECK_EQUAL(2, ucNumOfSamples);
+    CHECK_EQUAL(1, aullTimes[0]);
+    CHECK_EQUAL(3, aullTimes[1]);
+    CHECK_EQUAL(5, aausValues[1][0]);
+}
+
+TEST(History, CaughtUpClientGetsNextSequenceTest)
+{
+    CHECK_EQUAL(0, mbap_HistoryAdd(HISTORY_UNIT_ID, eTABLE_INPUT_REGISTERS, 0, 1, 1, eHISTORY_PERIODIC, 2));
+    mbap_HistorySample(1);
+    mbap_HistorySample(2);
+
+    //function under test
+    CHECK_EQUAL(DATA_OFFSET + HISTORY_RESPONSE_HEADER_LEN, ReadHistory(0, 2));
+    CHECK_EQUAL(2, ulFirst);
+    CHECK_EQUAL(0, ucNumOfSamples);
+}
+
+TEST(History, OverwrittenSamplesAreSkippedTest)
+{
+    uint32_t ulSample = 0;
+    uint32_t ulSince  = 0;
+    uint32_t ulRead   = 0;
+
+    CHECK_EQUAL(0, mbap_HistoryAdd(HISTORY_UNIT_ID, eTABLE_INPUT_REGISTERS, 0, 4, 1, eHISTORY_PERIODIC, 2));
+
+    //samples of rising values need more than two blocks
+    for (ulSample = 0; ulSample < 400; ulSample++)
+    {
+        m_ausRegisters[0] = (uint16_t)(ulSample * 1000u);
+        mbap_HistorySample(ulSample + 1u);
+    }
+
+    //function under test
+    ReadHistory(0, 0);
+    CHECK_TRUE(ulFirst > 0);
+    CHECK_TRUE(ucNumOfSamples > 0);
+    CHECK_EQUAL(ulFirst + 1u, aullTimes[0]);
+    CHECK_EQUAL((uint16_t)(ulFirst * 1000u), aausValues[0][0]);
+
+    //remaining samples follow without gap until newest
+    ulSince = ulFirst;
+
+    do
+    {
+        ReadHistory(0, ulSince);
+        CHECK_EQUAL(ulSince, ulFirst);
+        CHECK_EQUAL((0 != ucNumOfSamples) ? (uint16_t)(ulFirst * 1000u) : 0, aausValues[0][0]);
+        ulSince += ucNumOfSamples;
+        ulRead  += ucNumOfSamples;
+    } while (0 != ucNumOfSamples);
+
+    CHECK_EQUAL(400, ulSince);
+    CHECK_TRUE(ulRead < 400);
+}
+
+TEST(History, InvalidRangeOrQueryRejectedTest)
+{
+    uint8_t aucQuery[12] = {0, 1, 0, 0, 0, 6, HISTORY_UNIT_ID, eFC_READ_HISTORY, 0, 0, 0, 0};
+
+    CHECK_EQUAL(HISTORY_NO_RANGE, mbap_HistoryAdd(HISTORY_UNIT_ID, eTABLE_INPUT_REGISTERS, 2, 3, 1, eHISTORY_PERIODIC, 2));
+    CHECK_EQUAL(HISTORY_NO_RANGE, mbap_HistoryAdd(HISTORY_UNIT_ID, eTABLE_COILS, 0, 1, 1, eHISTORY_PERIODIC, 2));
+    CHECK_EQUAL(HISTORY_NO_RANGE, mbap_HistoryAdd(HISTORY_UNIT_ID, eTABLE_INPUT_REGISTERS, 0, 1, 1, eHISTORY_PERIODIC, 1));
+    CHECK_EQUAL(0, mbap_HistoryAdd(HISTORY_UNIT_ID, eTABLE_INPUT_REGISTERS, 0, 1, 1, eHISTORY_PERIODIC, 2));
+
+    //function under test
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, ReadHistory(1, 0));
+    CHECK_EQUAL(0xC1, aucResponse[7]);
+    CHECK_EQUAL(eILLEGAL_DATA_ADDRESS, aucResponse[8]);
+
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, mbap_ProcessRequest(aucQuery, sizeof(aucQuery), aucResponse));
+    CHECK_EQUAL(eILLEGAL_DATA_VALUE, aucResponse[8]);
+}
+
+TEST(History, UnitsNotSafeForSamplerRejectedTest)
+{
+    ModbusProfile_t tProfile;
+
+    memset(&tProfile, 0, sizeof(tProfile));
+    tProfile.tModbusData.usMaxInputRegisters = NUM_OF_REGISTERS;
+    CHECK_TRUE(mbap_UnitAddProfile(0, HISTORY_UNIT_ID + 1u, &tProfile));
+
+    //function under test, pages of profile units are copied on write
+    CHECK_EQUAL(HISTORY_NO_RANGE, mbap_HistoryAdd(HISTORY_UNIT_ID + 1u, eTABLE_INPUT_REGISTERS, 0, 1, 1, eHISTORY_PERIODIC, 2));
+
+    //unit refers to modbus data of test
+    tModbusData.ptfnAsyncAccess = AsyncAccess;
+    CHECK_EQUAL(HISTORY_NO_RANGE, mbap_HistoryAdd(HISTORY_UNIT_ID, eTABLE_INPUT_REGISTERS, 0, 1, 1, eHISTORY_PERIODIC, 2));
+
+    tModbusData.ptfnIsAsyncRange = IsAsyncRange;
+    CHECK_EQUAL(HISTORY_NO_RANGE, mbap_HistoryAdd(HISTORY_UNIT_ID, eTABLE_INPUT_REGISTERS, 1, 2, 1, eHISTORY_PERIODIC, 2));
+    CHECK_EQUAL(0, mbap_HistoryAdd(HISTORY_UNIT_ID, eTABLE_INPUT_REGISTERS, 0, 2, 1, eHISTORY_PERIODIC, 2));
+}
@@ -0,0 +1,252 @@
+#include "CppUTest/TestHarness.h"
+#include <string.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+extern "C"
+{
+    #include "mbap_image.h"
+}
+
+#define IMAGE_PATH                       "test_image.bin"
+#define SHARED_NAME                      "/modbus_test_image"
+#define NUM_OF_REGIONS                   (2u)
+#define REGION_LEN                       (32u)
+
+static uint8_t m_aucDefault0[REGION_LEN];
+static uint8_t m_aucDefault1[REGION_LEN];
+
+//
+//! @brief Simulate restart of system, image was mapped in another boot
+//
+static void ForgetBootId(void)
+{
+    FILE *ptFile = fopen(IMAGE_PATH, "r+b");
+    char acBootId[MBAP_IMAGE_BOOT_ID_LEN] = "previous boot";
+
+    CHECK_TRUE(NULL != ptFile);
+    fseek(ptFile, offsetof(ImageHeader_t, acBootId), SEEK_SET);
+    fwrite(acBootId, 1, sizeof(acBootId), ptFile);
+    fclose(ptFile);
+}
+
+//
+//! @brief Write a byte into region of open image
+//
+static void WriteByte(uint8_t ucRegion, uint8_t ucOffset, uint8_t ucValue)
+{
+    mbap_ImageWriteBegin(ucRegion);
+    ((uint8_t *)mbap_ImageRegion(ucRegion))[ucOffset] = ucValue;
+    mbap_ImageWriteEnd(ucRegion);
+}
+
+//
+//! @brief Overwrite a word of region entry in shared image as a faulty producer would
+//
+static void WriteRegionEntry(uint8_t ucRegion, size_t ulField, uint32_t ulValue)
+{
+    int iFile = shm_open(SHARED_NAME, O_RDWR, 0);
+
+    CHECK_TRUE(iFile >= 0);
+    CHECK_EQUAL(sizeof(ulValue), (size_t)pwrite(iFile, &ulValue, sizeof(ulValue),
+                                                (off_t)(sizeof(ImageHeader_t) + ucRegion * sizeof(ImageRegion_t) + ulField)));
+    close(iFile);
+}
+
+TEST_GROUP(Image)
+{
+    uint32_t aulLengths[NUM_OF_REGIONS];
+    const void *apvDefaults[NUM_OF_REGIONS];
+
+    void setup()
+    {
+        memset(m_aucDefault0, 0x11, sizeof(m_aucDefault0));
+        memset(m_aucDefault1, 0x22, sizeof(m_aucDefault1));
+        aulLengths[0]  = REGION_LEN;
+        aulLengths[1]  = REGION_LEN;
+        apvDefaults[0] = m_aucDefault0;
+        apvDefaults[1] = m_aucDefault1;
+
+        remove(IMAGE_PATH);
+        shm_unlink(SHARED_NAME);
+    }
+
+    void teardown()
+    {
+        mbap_ImageClose();
+        remove(IMAGE_PATH);
+        shm_unlink(SHARED_NAME);
+    }
+
+    bool CreateShared()
+    {
+        shm_unlink(SHARED_NAME);
+
+        bool bCreated = (eIMAGE_CREATED == mbap_ImageOpenShared(SHARED_NAME, aulLengths, apvDefaults, NUM_OF_REGIONS));
+        mbap_ImageClose();
+
+        return bCreated;
+    }
+
+    uint8_t Reopen()
+    {
+        mbap_ImageClose();
+
+        return mbap_ImageOpen(IMAGE_PATH, aulLengths, apvDefaults, NUM_OF_REGIONS);
+    }
+};
+
+TEST(Image, NewImageHoldsDefaultsTest)
+{
+    //function under test
+    CHECK_EQUAL(eIMAGE_CREATED, mbap_ImageOpen(IMAGE_PATH, aulLengths, apvDefaults, NUM_OF_REGIONS));
+
+    MEMCMP_EQUAL(m_aucDefault0, mbap_ImageRegion(0), REGION_LEN);
+    MEMCMP_EQUAL(m_aucDefault1, mbap_ImageRegion(1), REGION_LEN);
+    POINTERS_EQUAL(NULL, mbap_ImageRegion(NUM_OF_REGIONS));
+    //second image is not opened
+    CHECK_EQUAL(eIMAGE_ERROR, mbap_ImageOpen(IMAGE_PATH, aulLengths, apvDefaults, NUM_OF_REGIONS));
+}
+
+TEST(Image, WritesWithoutSyncSurviveProcessRestartTest)
+{
+    CHECK_EQUAL(eIMAGE_CREATED, mbap_ImageOpen(IMAGE_PATH, aulLengths, apvDefaults, NUM_OF_REGIONS));
+    WriteByte(1, 5, 0x55);
+
+    //function under test
+    CHECK_EQUAL(eIMAGE_RESTORED, Reopen());
+
+    CHECK_EQUAL(0x55, ((uint8_t *)mbap_ImageRegion(1))[5]);
+}
+
+TEST(Image, SystemRestartRollsBackToCheckpointTest)
+{
+    CHECK_EQUAL(eIMAGE_CREATED, mbap_ImageOpen(IMAGE_PATH, aulLengths, apvDefaults, NUM_OF_REGIONS));
+    WriteByte(0, 0, 0x01);
+    CHECK_EQUAL(1, mbap_ImageSync());
+    WriteByte(0, 0, 0x02);
+    mbap_ImageClose();
+    ForgetBootId();
+
+    //function under test
+    CHECK_EQUAL(eIMAGE_RECOVERED, Reopen());
+
+    CHECK_EQUAL(0x01, ((uint8_t *)mbap_ImageRegion(0))[0]);
+    CHECK_EQUAL(0x22, ((uint8_t *)mbap_ImageRegion(1))[0]);
+}
+
+TEST(Image, SyncCopiesChangedRegionsOnlyTest)
+{
+    CHECK_EQUAL(eIMAGE_CREATED, mbap_ImageOpen(IMAGE_PATH, aulLengths, apvDefaults, NUM_OF_REGIONS));
+
+    //function under test
+    CHECK_EQUAL(0, mbap_ImageSync());
+    WriteByte(1, 0, 0x33);
+    CHECK_EQUAL(1, mbap_ImageSync());
+    CHECK_EQUAL(0, mbap_ImageSync());
+
+    //region being written is taken at next sync
+    mbap_ImageWriteBegin(0);
+    CHECK_EQUAL(0, mbap_ImageSync());
+    mbap_ImageWriteEnd(0);
+    CHECK_EQUAL(1, mbap_ImageSync());
+}
+
+TEST(Image, TornCheckpointFallsBackToOlderOneTest)
+{
+    ImageRegion_t tRegion;
+    FILE          *ptFile = NULL;
+
+    CHECK_EQUAL(eIMAGE_CREATED, mbap_ImageOpen(IMAGE_PATH, aulLengths, apvDefaults, NUM_OF_REGIONS));
+    WriteByte(0, 0, 0x01);
+    CHECK_EQUAL(1, mbap_ImageSync());
+    WriteByte(0, 0, 0x02);
+    CHECK_EQUAL(1, mbap_ImageSync());
+    mbap_ImageClose();
+
+    //newest checkpoint of region 0 lost on disk
+    ptFile = fopen(IMAGE_PATH, "r+b");
+    fseek(ptFile, sizeof(ImageHeader_t), SEEK_SET);
+    CHECK_EQUAL(1, fread(&tRegion, sizeof(tRegion), 1, ptFile));
+    fseek(ptFile, tRegion.aulSlotOffset[(tRegion.aulSlotSequence[1] > tRegion.aulSlotSequence[0]) ? 1 : 0], SEEK_SET);
+    fputc(0x7F, ptFile);
+    fclose(ptFile);
+    ForgetBootId();
+
+    //function under test
+    CHECK_EQUAL(eIMAGE_RECOVERED, Reopen());
+
+    CHECK_EQUAL(0x01, ((uint8_t *)mbap_ImageRegion(0))[0]);
+}
+
+TEST(Image, OtherLayoutCreatesNewImageTest)
+{
+    CHECK_EQUAL(eIMAGE_CREATED, mbap_ImageOpen(IMAGE_PATH, aulLengths, apvDefaults, NUM_OF_REGIONS));
+    WriteByte(0, 0, 0x01);
+    CHECK_EQUAL(1, mbap_ImageSync());
+
+    //function under test
+    aulLengths[1] = REGION_LEN / 2u;
+    CHECK_EQUAL(eIMAGE_CREATED, Reopen());
+
+    CHECK_EQUAL(0x11, ((uint8_t *)mbap_ImageRegion(0))[0]);
+}
+
+TEST(Image, AttachTakesLayoutOfSharedImageTest)
+{
+    CHECK_EQUAL(eIMAGE_CREATED, mbap_ImageOpenShared(SHARED_NAME, aulLengths, apvDefaults, NUM_OF_REGIONS));
+    WriteByte(1, 3, 0x44);
+    mbap_ImageClose();
+
+    //function under test
+    CHECK_TRUE(mbap_ImageAttach(SHARED_NAME));
+
+    CHECK_EQUAL(REGION_LEN, mbap_ImageRegionLength(1));
+    CHECK_EQUAL(0, mbap_ImageRegionLength(NUM_OF_REGIONS));
+    CHECK_EQUAL(0x44, ((uint8_t *)mbap_ImageRegion(1))[3]);
+    mbap_ImageClose();
+    CHECK_FALSE(mbap_ImageAttach("/modbus_test_missing"));
+}
+
+TEST(Image, AttachRejectsRegionsOutsideOfImageTest)
+{
+    CHECK_TRUE(CreateShared());
+    //function under test, region longer than image
+    WriteRegionEntry(1, offsetof(ImageRegion_t, ulLength), 0xFFFFFFC0u);
+    CHECK_FALSE(mbap_ImageAttach(SHARED_NAME));
+
+    CHECK_TRUE(CreateShared());
+    //misaligned checkpoint slot
+    WriteRegionEntry(0, offsetof(ImageRegion_t, aulSlotOffset[1]), 100);
+    CHECK_FALSE(mbap_ImageAttach(SHARED_NAME));
+
+    CHECK_TRUE(CreateShared());
+    //live region over header
+    WriteRegionEntry(0, offsetof(ImageRegion_t, ulOffset), 0);
+    CHECK_FALSE(mbap_ImageAttach(SHARED_NAME));
+
+    //intact image is attached
+    CHECK_TRUE(CreateShared());
+    CHECK_TRUE(mbap_ImageAttach(SHARED_NAME));
+}
+
+TEST(Image, ReadRetriedAfterWriteTest)
+{
+    uint32_t ulSequence = 0;
+
+    CHECK_EQUAL(eIMAGE_CREATED, mbap_ImageOpenShared(SHARED_NAME, aulLengths, apvDefaults, NUM_OF_REGIONS));
+
+    //function under test
+    ulSequence = mbap_ImageReadBegin(0);
+    CHECK_FALSE(mbap_ImageReadRetry(0, ulSequence));
+    WriteByte(0, 0, 0x01);
+    CHECK_TRUE(mbap_ImageReadRetry(0, ulSequence));
+    //writes of other regions do not disturb readers
+    ulSequence = mbap_ImageReadBegin(0);
+    WriteByte(1, 0, 0x01);
+    CHECK_FALSE(mbap_ImageReadRetry(0, ulSequence));
+}
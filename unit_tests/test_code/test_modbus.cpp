@@ -8,6 +8,7 @@ extern "C"
     #include "mbap_conf.h"
     #include "mbap.h"
     #include "mbap_user.h"
+    #include "mbap_change.h"
 }
 
 #define QUERY_SIZE_IN_BYTES              (255u)
@@ -551,3 +552,126 @@ TEST(Module, IllegalAddressInWriteMultipleCoilsTest)
     //check return value from test function
     CHECK_EQUAL(usExpectedResponseLen, usRecResponseLen);    
 }
+
+TEST(Module, ConditionalReadHoldingRegistersTest)
+{
+    uint8_t ucQueryBuf[17] = {0, 0, 0, 0, 0, 11, 1, 68, eTABLE_HOLDING_REGISTERS, 0, 0, 0, 3, 0, 0, 0, 0};
+    uint8_t ucWriteBuf[12] = {0, 0, 0, 0, 0, 6, 1, 6, 0, 1, 0, 100};
+
+    memcpy(pucQuery, ucQueryBuf, 17);
+
+    //function under test, version 0 always reads
+    uint8_t usRecResponseLen = mbap_ProcessRequest(pucQuery, 17, pucResponse);
+    //MBAP header + function code + version(4 bytes) + byte count + data
+    CHECK_EQUAL(MBAP_HEADER_LEN + 6 + 6, usRecResponseLen);
+    CHECK_EQUAL(6, pucResponse[12]);
+    CHECK_EQUAL(g_sHoldingRegsBuf[2], (int16_t)((pucResponse[17] << 8) | pucResponse[18]));
+
+    //unchanged range since version of response is answered by function code only
+    memcpy(&pucQuery[13], &pucResponse[8], 4);
+    usRecResponseLen = mbap_ProcessRequest(pucQuery, 17, pucResponse);
+    CHECK_EQUAL(MBAP_HEADER_LEN + 1, usRecResponseLen);
+    CHECK_EQUAL(2, pucResponse[5]);
+    CHECK_EQUAL(68, pucResponse[7]);
+
+    //write into range is a change
+    mbap_ProcessRequest(ucWriteBuf, 12, pucResponse);
+    usRecResponseLen = mbap_ProcessRequest(pucQuery, 17, pucResponse);
+    CHECK_EQUAL(MBAP_HEADER_LEN + 6 + 6, usRecResponseLen);
+    CHECK_EQUAL(100, (int16_t)((pucResponse[15] << 8) | pucResponse[16]));
+}
+
+TEST(Module, ConditionalReadSeesWatchedCounterTest)
+{
+    uint8_t         ucQueryBuf[17] = {0, 0, 0, 0, 0, 11, 1, 68, eTABLE_HOLDING_REGISTERS, 0, 0, 0, 3, 0, 0, 0, 0};
+    static uint32_t ulSequence     = 0;
+
+    memcpy(pucQuery, ucQueryBuf, 17);
+    mbap_ChangeWatch(eTABLE_HOLDING_REGISTERS, &ulSequence);
+    mbap_ProcessRequest(pucQuery, 17, pucResponse);
+    memcpy(&pucQuery[13], &pucResponse[8], 4);
+
+    //write of another process moves counter only
+    ulSequence += 2;
+    //function under test
+    uint8_t usRecResponseLen = mbap_ProcessRequest(pucQuery, 17, pucResponse);
+    mbap_ChangeWatch(eTABLE_HOLDING_REGISTERS, NULL);
+    CHECK_EQUAL(MBAP_HEADER_LEN + 6 + 6, usRecResponseLen);
+}
+
+TEST(Module, IllegalConditionalReadTest)
+{
+    uint8_t ucQueryBuf[17] = {0, 0, 0, 0, 0, 11, 1, 68, eTABLE_INPUT_REGISTERS, 0, 0, 0, 124, 0, 0, 0, 0};
+
+    memcpy(pucQuery, ucQueryBuf, 17);
+
+    //function under test, range does not fit into response
+    uint8_t usRecResponseLen = mbap_ProcessRequest(pucQuery, 17, pucResponse);
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, usRecResponseLen);
+    CHECK_EQUAL(eILLEGAL_DATA_VALUE, pucResponse[MBT_BYTE_COUNT_OFFSET]);
+
+    //range beyond table
+    pucQuery[12]     = 16;
+    usRecResponseLen = mbap_ProcessRequest(pucQuery, 17, pucResponse);
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, usRecResponseLen);
+    CHECK_EQUAL(eILLEGAL_DATA_ADDRESS, pucResponse[MBT_BYTE_COUNT_OFFSET]);
+}
+
+TEST(Module, ReadMultipleRangesTest)
+{
+    uint8_t ucQueryBuf[24] = {0, 0, 0, 0, 0, 18, 1, 69, 3,
+                              eTABLE_HOLDING_REGISTERS, 0, 2, 0, 1,
+                              eTABLE_INPUT_REGISTERS, 0, 0, 0, 2,
+                              eTABLE_COILS, 0, 0, 0, 8};
+
+    memcpy(pucQuery, ucQueryBuf, 24);
+
+    //function under test
+    uint8_t usRecResponseLen = mbap_ProcessRequest(pucQuery, 24, pucResponse);
+    //MBAP header + function code + number of ranges + (byte count + data) per range
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 3 + 5 + 2, usRecResponseLen);
+    CHECK_EQUAL(usRecResponseLen - 6, pucResponse[5]);
+    CHECK_EQUAL(3, pucResponse[8]);
+    CHECK_EQUAL(2, pucResponse[9]);
+    CHECK_EQUAL(g_sHoldingRegsBuf[2], (int16_t)((pucResponse[10] << 8) | pucResponse[11]));
+    CHECK_EQUAL(4, pucResponse[12]);
+    CHECK_EQUAL(g_sInputRegsBuf[0], (int16_t)((pucResponse[13] << 8) | pucResponse[14]));
+    CHECK_EQUAL(g_sInputRegsBuf[1], (int16_t)((pucResponse[15] << 8) | pucResponse[16]));
+    CHECK_EQUAL(1, pucResponse[17]);
+    CHECK_EQUAL(g_ucCoilsBuf[0], pucResponse[18]);
+}
+
+TEST(Module, IllegalRangeInReadMultipleRangesTest)
+{
+    uint8_t ucQueryBuf[19] = {0, 0, 0, 0, 0, 13, 1, 69, 2,
+                              eTABLE_INPUT_REGISTERS, 0, 0, 0, 2,
+                              eTABLE_HOLDING_REGISTERS, 0, 14, 0, 2};
+
+    memcpy(pucQuery, ucQueryBuf, 19);
+
+    //function under test, second range beyond table
+    uint8_t usRecResponseLen = mbap_ProcessRequest(pucQuery, 19, pucResponse);
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, usRecResponseLen);
+    CHECK_EQUAL(eILLEGAL_DATA_ADDRESS, pucResponse[MBT_BYTE_COUNT_OFFSET]);
+
+}
+
+TEST(Module, RangesExceedResponseInReadMultipleRangesTest)
+{
+    uint8_t ucQueryBuf[9] = {0, 0, 0, 0, 0, 53, 1, 69, 10};
+
+    memcpy(pucQuery, ucQueryBuf, 9);
+
+    //ten times all holding registers do not fit into one response
+    for (uint8_t ucRange = 0; ucRange < 10; ucRange++)
+    {
+        uint8_t ucDescriptor[5] = {eTABLE_HOLDING_REGISTERS, 0, 0, 0, 15};
+
+        memcpy(&pucQuery[9 + (ucRange * 5)], ucDescriptor, 5);
+    }
+
+    //function under test
+    uint8_t usRecResponseLen = mbap_ProcessRequest(pucQuery, 59, pucResponse);
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, usRecResponseLen);
+    CHECK_EQUAL(eILLEGAL_DATA_VALUE, pucResponse[MBT_BYTE_COUNT_OFFSET]);
+}
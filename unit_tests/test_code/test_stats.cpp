@@ -0,0 +1,182 @@
+#include "CppUTest/TestHarness.h"
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+
+
+extern "C"
+{
+    #include "mbap_conf.h"
+    #include "mbap.h"
+    #include "mbap_hist.h"
+    #include "mbap_stats.h"
+    #include "mbap_user.h"
+}
+
+#define QUERY_SIZE_IN_BYTES              (255u)
+#define RESPONSE_SIZE_IN_BYTES           (255u)
+#define MBT_EXCEPTION_PACKET_LEN         (9u)
+#define MBAP_HEADER_LEN                  (7u)
+#define DUMP_SIZE_IN_BYTES               (4096u)
+
+static ModbusStats_t m_tBefore;
+static ModbusStats_t m_tAfter;
+
+static uint32_t Requests(const ModbusStats_t *ptStats, uint8_t ucFunctionCode)
+{
+    const FunctionCodeStats_t *ptEntry = mbap_StatsFind(ptStats, ucFunctionCode);
+
+    return (NULL == ptEntry) ? 0 : ptEntry->ulRequests;
+}
+
+static uint32_t Exceptions(const ModbusStats_t *ptStats, uint8_t ucFunctionCode, uint8_t ucException)
+{
+    const FunctionCodeStats_t *ptEntry = mbap_StatsFind(ptStats, ucFunctionCode);
+
+    return (NULL == ptEntry) ? 0 : ptEntry->aulExceptions[ucException];
+}
+
+static void *ProcessInThread(void *pvArg)
+{
+    uint8_t aucQuery[12] = {0, 0, 0, 0, 0, 6, 1, 3, 0, 0, 0, 1};
+    uint8_t aucResponse[RESPONSE_SIZE_IN_BYTES];
+
+    mbap_ProcessRequest(aucQuery, sizeof(aucQuery), aucResponse);
+
+    return NULL;
+}
+
+TEST_GROUP(Stats)
+{
+    uint8_t *pucQuery    = NULL;
+    uint8_t *pucResponse = NULL;
+
+    void setup()
+    {
+        pucQuery     = (uint8_t*)calloc(QUERY_SIZE_IN_BYTES,  sizeof(uint8_t));
+        pucResponse  = (uint8_t*)calloc(RESPONSE_SIZE_IN_BYTES, sizeof(uint8_t));
+
+        //Init modbus data
+        mu_Init();
+        //other tests count into same statistics, compare against snapshot
+        mbap_StatsSnapshot(&m_tBefore);
+    }
+
+    void teardown()
+    {
+        free(pucQuery);
+        free(pucResponse);
+    }
+};
+
+TEST(Stats, RequestsAndBytesCountedByFunctionCodeTest)
+{
+    uint8_t ucQueryBuf[12] = {0, 0, 0, 0, 0, 6, 1, 4, 0, 0, 0, 2};
+
+    memcpy(pucQuery, ucQueryBuf, 12);
+
+    //function under test
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 4, mbap_ProcessRequest(pucQuery, 12, pucResponse));
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 4, mbap_ProcessRequest(pucQuery, 12, pucResponse));
+    mbap_StatsSnapshot(&m_tAfter);
+
+    const FunctionCodeStats_t *ptBefore = mbap_StatsFind(&m_tBefore, 4);
+    const FunctionCodeStats_t *ptAfter  = mbap_StatsFind(&m_tAfter, 4);
+
+    CHECK_TRUE(NULL != ptAfter);
+    CHECK_EQUAL(2, Requests(&m_tAfter, 4) - Requests(&m_tBefore, 4));
+    CHECK_EQUAL(2, Exceptions(&m_tAfter, 4, 0) - Exceptions(&m_tBefore, 4, 0));
+    CHECK_EQUAL(24, ptAfter->ullBytesIn - ((NULL == ptBefore) ? 0 : ptBefore->ullBytesIn));
+    CHECK_EQUAL(26, ptAfter->ullBytesOut - ((NULL == ptBefore) ? 0 : ptBefore->ullBytesOut));
+    CHECK_EQUAL(2, ptAfter->tLatency.ulCount - ((NULL == ptBefore) ? 0 : ptBefore->tLatency.ulCount));
+}
+
+TEST(Stats, ExceptionsCountedByCodeTest)
+{
+    uint8_t ucQueryBuf[12] = {0, 0, 0, 0, 0, 6, 1, 3, 0xFF, 0xF0, 0, 2};
+
+    memcpy(pucQuery, ucQueryBuf, 12);
+
+    //function under test
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, mbap_ProcessRequest(pucQuery, 12, pucResponse));
+    mbap_StatsSnapshot(&m_tAfter);
+
+    CHECK_EQUAL(1, Exceptions(&m_tAfter, 3, eILLEGAL_DATA_ADDRESS) - Exceptions(&m_tBefore, 3, eILLEGAL_DATA_ADDRESS));
+    CHECK_EQUAL(0, Exceptions(&m_tAfter, 3, 0) - Exceptions(&m_tBefore, 3, 0));
+}
+
+TEST(Stats, RejectedRequestCountedWithoutLatencyTest)
+{
+    uint8_t         ucQueryBuf[12] = {0, 0, 0, 0, 0, 6, 1, 16, 0, 0, 0, 1};
+    ModbusRequest_t tRequest;
+
+    memset(&tRequest, 0, sizeof(tRequest));
+    memcpy(pucQuery, ucQueryBuf, 12);
+    tRequest.pucQuery    = pucQuery;
+    tRequest.pucResponse = pucResponse;
+    tRequest.usQueryLen  = 12;
+
+    //function under test
+    mbap_RejectRequest(&tRequest, eSERVER_BUSY);
+    mbap_StatsSnapshot(&m_tAfter);
+
+    const FunctionCodeStats_t *ptBefore = mbap_StatsFind(&m_tBefore, 16);
+    const FunctionCodeStats_t *ptAfter  = mbap_StatsFind(&m_tAfter, 16);
+
+    CHECK_EQUAL(1, Exceptions(&m_tAfter, 16, eSERVER_BUSY) - Exceptions(&m_tBefore, 16, eSERVER_BUSY));
+    CHECK_EQUAL(0, ptAfter->tLatency.ulCount - ((NULL == ptBefore) ? 0 : ptBefore->tLatency.ulCount));
+}
+
+TEST(Stats, DumpListsFunctionCodesTest)
+{
+    uint8_t ucQueryBuf[12] = {0, 0, 0, 0, 0, 6, 1, 2, 0, 0, 0, 8};
+    char    acDump[DUMP_SIZE_IN_BYTES];
+
+    memcpy(pucQuery, ucQueryBuf, 12);
+    mbap_ProcessRequest(pucQuery, 12, pucResponse);
+    mbap_StatsSnapshot(&m_tAfter);
+
+    //function under test
+    uint32_t ulLen = mbap_StatsDump(&m_tAfter, acDump, sizeof(acDump));
+
+    CHECK_EQUAL(strlen(acDump), ulLen);
+    CHECK_TRUE(NULL != strstr(acDump, "fc 2: requests "));
+
+    //text is truncated to buffer
+    CHECK_EQUAL(9, mbap_StatsDump(&m_tAfter, acDump, 10));
+    CHECK_EQUAL(9, strlen(acDump));
+}
+
+TEST(Stats, ThreadsBeyondEntriesDropRequestsTest)
+{
+    pthread_t tThread;
+    uint32_t  ulDropped = 0;
+
+    //entry of this thread is taken before all are used up
+    ProcessInThread(NULL);
+
+    for (uint32_t ulCount = 0; ulCount < STATS_THREADS; ulCount++)
+    {
+        CHECK_EQUAL(0, pthread_create(&tThread, NULL, ProcessInThread, NULL));
+        pthread_join(tThread, NULL);
+    }
+
+    mbap_StatsSnapshot(&m_tBefore);
+    ulDropped = m_tBefore.ulDropped;
+
+    //function under test, threads without entry drop every request
+    for (uint32_t ulCount = 0; ulCount < 4u; ulCount++)
+    {
+        CHECK_EQUAL(0, pthread_create(&tThread, NULL, ProcessInThread, NULL));
+        pthread_join(tThread, NULL);
+    }
+
+    mbap_StatsSnapshot(&m_tAfter);
+    CHECK_EQUAL(4, m_tAfter.ulDropped - ulDropped);
+    CHECK_EQUAL(Requests(&m_tBefore, 3), Requests(&m_tAfter, 3));
+
+    //threads with entry keep counting
+    ProcessInThread(NULL);
+    mbap_StatsSnapshot(&m_tAfter);
+    CHECK_EQUAL(1, Requests(&m_tAfter, 3) - Requests(&m_tBefore, 3));
+}
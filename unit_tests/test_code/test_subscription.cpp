@@ -0,0 +1,369 @@
+#include "CppUTest/TestHarness.h"
+#include <string.h>
+#include <stdio.h>
+
+
+extern "C"
+{
+    #include "mbap_conf.h"
+    #include "mbap.h"
+    #include "mbap_unit.h"
+    #include "mbap_user.h"
+    #include "mbap_change.h"
+    #include "mbap_subscription.h"
+}
+
+#define RESPONSE_SIZE_IN_BYTES           (260u)
+#define MBT_EXCEPTION_PACKET_LEN         (9u)
+#define MBAP_HEADER_LEN                  (7u)
+#define SUBSCRIPTION_UNIT_ID             (7u)
+#define NUM_OF_REGISTERS                 (64u)
+#define NUM_OF_COILS                     (64u)
+//subscription id follows function code
+#define DATA_OFFSET                      (MBAP_HEADER_LEN + 1u)
+#define MAX_NOTIFICATIONS                (4u)
+
+static uint16_t m_ausRegisters[NUM_OF_REGISTERS];
+static uint8_t  m_aucCoils[NUM_OF_COILS / 8u];
+static int16_t  m_asLowerLimits[NUM_OF_REGISTERS];
+static int16_t  m_asHigherLimits[NUM_OF_REGISTERS];
+static uint8_t  m_aaucNotifications[MAX_NOTIFICATIONS][RESPONSE_SIZE_IN_BYTES];
+static uint16_t m_ausNotificationLens[MAX_NOTIFICATIONS];
+static uint8_t  m_ucNumOfNotifications;
+static bool     m_bSendBufferFull;
+//connections are only compared by address
+static int      m_iConnection;
+static int      m_iOtherConnection;
+
+static void ReadHoldingRegisters(uint16_t usStartAddress, uint16_t usNumOfData, uint8_t *pucRecBuf)
+{
+    uint16_t usIndex = 0;
+
+    for (usIndex = 0; usIndex < usNumOfData; usIndex++)
+    {
+        pucRecBuf[usIndex * 2]     = (uint8_t)(m_ausRegisters[usStartAddress + usIndex] >> 8);
+        pucRecBuf[usIndex * 2 + 1] = (uint8_t)(m_ausRegisters[usStartAddress + usIndex]);
+    }
+}
+
+static void WriteHoldingRegisters(uint16_t usStartAddress, uint16_t usNumOfData, const uint8_t *pucWriteBuf)
+{
+    uint16_t usIndex = 0;
+
+    for (usIndex = 0; usIndex < usNumOfData; usIndex++)
+    {
+        m_ausRegisters[usStartAddress + usIndex] = (uint16_t)((pucWriteBuf[usIndex * 2] << 8) | pucWriteBuf[usIndex * 2 + 1]);
+    }
+}
+
+static void ReadCoils(uint16_t usStartAddress, int16_t sNumOfData, uint8_t *pucRecBuf)
+{
+    int16_t sIndex = 0;
+
+    memset(pucRecBuf, 0, (sNumOfData + 7) / 8);
+
+    for (sIndex = 0; sIndex < sNumOfData; sIndex++)
+    {
+        uint16_t usCoil = (uint16_t)(usStartAddress + sIndex);
+
+        if (m_aucCoils[usCoil / 8u] & (1u << (usCoil % 8u)))
+        {
+            pucRecBuf[sIndex / 8] |= (uint8_t)(1u << (sIndex % 8));
+        }
+    }
+}
+
+static uint8_t AsyncAccess(ModbusRequest_t *ptRequest)
+{
+    return mbap_AccessRequestData(ptRequest);
+}
+
+//registers from 32 on are served by a slow backend
+static bool IsAsyncRange(const ModbusRequest_t *ptRequest)
+{
+    return (ptRequest->usStartAddress + ptRequest->usNumOfData) > 32u;
+}
+
+static bool Notify(void *pvConnection, const uint8_t *pucAdu, uint16_t usLen)
+{
+    if (m_bSendBufferFull)
+    {
+        return false;
+    }
+
+    CHECK_EQUAL(&m_iConnection, pvConnection);
+    CHECK_TRUE(m_ucNumOfNotifications < MAX_NOTIFICATIONS);
+    memcpy(m_aaucNotifications[m_ucNumOfNotifications], pucAdu, usLen);
+    m_ausNotificationLens[m_ucNumOfNotifications++] = usLen;
+
+    return true;
+}
+
+TEST_GROUP(Subscription)
+{
+    uint8_t      aucResponse[RESPONSE_SIZE_IN_BYTES];
+    ModbusData_t tModbusData;
+
+    void setup()
+    {
+        uint16_t usIndex = 0;
+
+        memset(m_ausRegisters, 0, sizeof(m_ausRegisters));
+        memset(m_aucCoils, 0, sizeof(m_aucCoils));
+
+        for (usIndex = 0; usIndex < NUM_OF_REGISTERS; usIndex++)
+        {
+            m_asLowerLimits[usIndex]  = 0;
+            m_asHigherLimits[usIndex] = 0x7FFF;
+        }
+
+        memset(&tModbusData, 0, sizeof(tModbusData));
+        tModbusData.usMaxHoldingRegisters        = NUM_OF_REGISTERS;
+        tModbusData.usMaxCoils                   = NUM_OF_COILS;
+        tModbusData.psHoldingRegisterLowerLimit  = m_asLowerLimits;
+        tModbusData.psHoldingRegisterHigherLimit = m_asHigherLimits;
+        tModbusData.ptfnReadHoldingRegisters     = ReadHoldingRegisters;
+        tModbusData.ptfnWriteHoldingRegisters    = WriteHoldingRegisters;
+        tModbusData.ptfnReadCoils                = ReadCoils;
+
+        mu_Init();
+        mbap_UnitAdd(0, SUBSCRIPTION_UNIT_ID, &tModbusData);
+        mbap_SubscriptionInit(Notify);
+        m_ucNumOfNotifications = 0;
+        m_bSendBufferFull      = false;
+    }
+
+    //
+    //! @brief Submit query received on a connection
+    //
+    uint16_t Submit(const uint8_t *pucQuery, uint16_t usQueryLen, void *pvConnection)
+    {
+        ModbusRequest_t tRequest;
+
+        memset(&tRequest, 0, sizeof(tRequest));
+        memset(aucResponse, 0, sizeof(aucResponse));
+        tRequest.pucQuery     = pucQuery;
+        tRequest.pucResponse  = aucResponse;
+        tRequest.usQueryLen   = usQueryLen;
+        tRequest.pvConnection = pvConnection;
+
+        return mbap_SubmitRequest(&tRequest);
+    }
+
+    uint16_t Subscribe(uint8_t ucTable, uint16_t usAddress, uint16_t usNumOfData,
+                       uint16_t usDeadband, uint16_t usMinIntervalMs, void *pvConnection)
+    {
+        uint8_t aucQuery[17] = {0x12, 0x34, 0, 0, 0, 11, SUBSCRIPTION_UNIT_ID, eFC_SUBSCRIBE, ucTable,
+                                (uint8_t)(usAddress >> 8), (uint8_t)usAddress,
+                                (uint8_t)(usNumOfData >> 8), (uint8_t)usNumOfData,
+                                (uint8_t)(usDeadband >> 8), (uint8_t)usDeadband,
+                                (uint8_t)(usMinIntervalMs >> 8), (uint8_t)usMinIntervalMs};
+
+        return Submit(aucQuery, sizeof(aucQuery), pvConnection);
+    }
+
+    void WriteRegister(uint16_t usAddress, uint16_t usValue)
+    {
+        uint8_t aucQuery[12] = {0, 2, 0, 0, 0, 6, SUBSCRIPTION_UNIT_ID, eFC_WRITE_HOLDING_REGISTER,
+                                (uint8_t)(usAddress >> 8), (uint8_t)usAddress,
+                                (uint8_t)(usValue >> 8), (uint8_t)usValue};
+
+        CHECK_EQUAL(12, Submit(aucQuery, sizeof(aucQuery), &m_iOtherConnection));
+    }
+};
+
+TEST(Subscription, RegisterChangesAboveDeadbandAreNotifiedTest)
+{
+    m_ausRegisters[10] = 0x0102;
+
+    //function under test
+    CHECK_EQUAL(DATA_OFFSET + SUBSCRIPTION_HEADER_LEN + 8u,
+                Subscribe(eTABLE_HOLDING_REGISTERS, 8, 4, 5, 0, &m_iConnection));
+    CHECK_EQUAL(eFC_SUBSCRIBE, aucResponse[7]);
+    CHECK_EQUAL(0, aucResponse[DATA_OFFSET]);
+    CHECK_EQUAL(8, aucResponse[DATA_OFFSET + 2]);
+    CHECK_EQUAL(4, aucResponse[DATA_OFFSET + 4]);
+    CHECK_EQUAL(8, aucResponse[DATA_OFFSET + 5]);
+    CHECK_EQUAL(0x01, aucResponse[DATA_OFFSET + 10]);
+    CHECK_EQUAL(0x02, aucResponse[DATA_OFFSET + 11]);
+    CHECK_EQUAL(1u, mbap_SubscriptionCount());
+
+    //nothing written
+    mbap_SubscriptionPoll(100);
+    CHECK_EQUAL(0, m_ucNumOfNotifications);
+
+    //within deadband
+    WriteRegister(9, 5);
+    mbap_SubscriptionPoll(101);
+    CHECK_EQUAL(0, m_ucNumOfNotifications);
+
+    //registers 9 and 11 changed, window holds 9 to 11
+    WriteRegister(11, 6);
+    WriteRegister(9, 6);
+    mbap_SubscriptionPoll(102);
+    CHECK_EQUAL(1, m_ucNumOfNotifications);
+    CHECK_EQUAL(DATA_OFFSET + SUBSCRIPTION_HEADER_LEN + 6u, m_ausNotificationLens[0]);
+    CHECK_EQUAL(0x12, m_aaucNotifications[0][0]);
+    CHECK_EQUAL(0x34, m_aaucNotifications[0][1]);
+    CHECK_EQUAL(m_ausNotificationLens[0] - 6u, m_aaucNotifications[0][5]);
+    CHECK_EQUAL(eFC_SUBSCRIBE, m_aaucNotifications[0][7]);
+    CHECK_EQUAL(9, m_aaucNotifications[0][DATA_OFFSET + 2]);
+    CHECK_EQUAL(3, m_aaucNotifications[0][DATA_OFFSET + 4]);
+    CHECK_EQUAL(6, m_aaucNotifications[0][DATA_OFFSET + 5]);
+    CHECK_EQUAL(6, m_aaucNotifications[0][DATA_OFFSET + 7]);
+    CHECK_EQUAL(0x02, m_aaucNotifications[0][DATA_OFFSET + 9]);
+    CHECK_EQUAL(6, m_aaucNotifications[0][DATA_OFFSET + 11]);
+
+    //written outside of range
+    WriteRegister(20, 100);
+    mbap_SubscriptionPoll(103);
+    CHECK_EQUAL(1, m_ucNumOfNotifications);
+}
+
+TEST(Subscription, MinimumIntervalAndFullSendBufferDeferNotificationTest)
+{
+    CHECK_EQUAL(DATA_OFFSET + SUBSCRIPTION_HEADER_LEN + 2u,
+                Subscribe(eTABLE_HOLDING_REGISTERS, 0, 1, 0, 50, &m_iConnection));
+    mbap_SubscriptionPoll(1000);
+
+    //function under test
+    WriteRegister(0, 1);
+    mbap_SubscriptionPoll(1010);
+    CHECK_EQUAL(0, m_ucNumOfNotifications);
+
+    //no further write, change is still sent when due
+    mbap_SubscriptionPoll(1050);
+    CHECK_EQUAL(1, m_ucNumOfNotifications);
+
+    //producer writes in place
+    m_ausRegisters[0] = 2;
+    mbap_ChangeMark(NULL, eTABLE_HOLDING_REGISTERS, 0, 1);
+    m_bSendBufferFull = true;
+    mbap_SubscriptionPoll(1100);
+    CHECK_EQUAL(1, m_ucNumOfNotifications);
+
+    m_bSendBufferFull = false;
+    mbap_SubscriptionPoll(1101);
+    CHECK_EQUAL(2, m_ucNumOfNotifications);
+    CHECK_EQUAL(2, m_aaucNotifications[1][DATA_OFFSET + 7]);
+}
+
+TEST(Subscription, CoilWindowStartsAtFirstChangedCoilTest)
+{
+    m_aucCoils[0] = 0x01;
+
+    CHECK_EQUAL(DATA_OFFSET + SUBSCRIPTION_HEADER_LEN + 3u,
+                Subscribe(eTABLE_COILS, 0, 20, 0, 0, &m_iConnection));
+    CHECK_EQUAL(3, aucResponse[DATA_OFFSET + 5]);
+    CHECK_EQUAL(0x01, aucResponse[DATA_OFFSET + 6]);
+
+    //function under test
+    m_aucCoils[0] = 0x21;
+    m_aucCoils[1] = 0x04;
+    mbap_ChangeMark(NULL, eTABLE_COILS, 0, 16);
+    mbap_SubscriptionPoll(1);
+
+    //coils 5 to 10, 5 and 10 set
+    CHECK_EQUAL(1, m_ucNumOfNotifications);
+    CHECK_EQUAL(5, m_aaucNotifications[0][DATA_OFFSET + 2]);
+    CHECK_EQUAL(6, m_aaucNotifications[0][DATA_OFFSET + 4]);
+    CHECK_EQUAL(1, m_aaucNotifications[0][DATA_OFFSET + 5]);
+    CHECK_EQUAL(0x21, m_aaucNotifications[0][DATA_OFFSET + 6]);
+}
+
+TEST(Subscription, CancelAndDropEndSubscriptionTest)
+{
+    uint8_t aucCancel[9] = {0, 3, 0, 0, 0, 3, SUBSCRIPTION_UNIT_ID, eFC_CANCEL_SUBSCRIPTION, 0};
+
+    Subscribe(eTABLE_HOLDING_REGISTERS, 0, 2, 0, 0, &m_iConnection);
+    Subscribe(eTABLE_HOLDING_REGISTERS, 2, 2, 0, 0, &m_iConnection);
+    CHECK_EQUAL(1, aucResponse[DATA_OFFSET]);
+
+    //function under test
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, Submit(aucCancel, sizeof(aucCancel), &m_iOtherConnection));
+    CHECK_EQUAL(eILLEGAL_DATA_ADDRESS, aucResponse[8]);
+
+    CHECK_EQUAL(sizeof(aucCancel), Submit(aucCancel, sizeof(aucCancel), &m_iConnection));
+    MEMCMP_EQUAL(aucCancel, aucResponse, sizeof(aucCancel));
+    CHECK_EQUAL(1u, mbap_SubscriptionCount());
+
+    WriteRegister(0, 1);
+    mbap_SubscriptionPoll(1);
+    CHECK_EQUAL(0, m_ucNumOfNotifications);
+
+    mbap_SubscriptionDrop(&m_iConnection);
+    CHECK_EQUAL(0u, mbap_SubscriptionCount());
+    WriteRegister(2, 1);
+    mbap_SubscriptionPoll(2);
+    CHECK_EQUAL(0, m_ucNumOfNotifications);
+}
+
+TEST(Subscription, InvalidSubscriptionRejectedTest)
+{
+    //function under test
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, Subscribe(eTABLE_HOLDING_REGISTERS, 0, 1, 0, 0, NULL));
+    CHECK_EQUAL(eILLEGAL_FUNCTION_CODE, aucResponse[8]);
+
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, Subscribe(4, 0, 1, 0, 0, &m_iConnection));
+    CHECK_EQUAL(eILLEGAL_DATA_VALUE, aucResponse[8]);
+
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, Subscribe(eTABLE_HOLDING_REGISTERS, 60, 8, 0, 0, &m_iConnection));
+    CHECK_EQUAL(eILLEGAL_DATA_ADDRESS, aucResponse[8]);
+
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, Subscribe(eTABLE_HOLDING_REGISTERS, 0, 0, 0, 0, &m_iConnection));
+    CHECK_EQUAL(eILLEGAL_DATA_VALUE, aucResponse[8]);
+
+    CHECK_EQUAL(0u, mbap_SubscriptionCount());
+}
+
+TEST(Subscription, ChangeVersionMovesWithWritesOfBlockTest)
+{
+    uint32_t ulVersion = mbap_ChangeVersion(NULL, eTABLE_INPUT_REGISTERS, 0, CHANGE_BLOCK_REGISTERS);
+    uint32_t ulOther   = mbap_ChangeVersion(NULL, eTABLE_INPUT_REGISTERS, CHANGE_BLOCK_REGISTERS, 1);
+
+    //function under test
+    mbap_ChangeMark(NULL, eTABLE_INPUT_REGISTERS, CHANGE_BLOCK_REGISTERS - 1u, 1);
+    CHECK_TRUE(ulVersion != mbap_ChangeVersion(NULL, eTABLE_INPUT_REGISTERS, 0, CHANGE_BLOCK_REGISTERS));
+    CHECK_EQUAL(ulOther, mbap_ChangeVersion(NULL, eTABLE_INPUT_REGISTERS, CHANGE_BLOCK_REGISTERS, 1));
+}
+
+TEST(Subscription, WatchedCounterNotifiesWritesOfOtherProcessesTest)
+{
+    static uint32_t ulSequence = 0;
+
+    mbap_ChangeWatch(eTABLE_HOLDING_REGISTERS, &ulSequence);
+    Subscribe(eTABLE_HOLDING_REGISTERS, 8, 4, 0, 0, &m_iConnection);
+
+    //written in place without mark
+    m_ausRegisters[10] = 0x0203;
+    mbap_SubscriptionPoll(100);
+    CHECK_EQUAL(0, m_ucNumOfNotifications);
+
+    //function under test, writer of other process moves counter
+    ulSequence += 2;
+    mbap_SubscriptionPoll(101);
+    mbap_ChangeWatch(eTABLE_HOLDING_REGISTERS, NULL);
+    CHECK_EQUAL(1, m_ucNumOfNotifications);
+    CHECK_EQUAL(10, m_aaucNotifications[0][DATA_OFFSET + 2]);
+}
+
+TEST(Subscription, RangeDeferredByAsyncAccessRejectedTest)
+{
+    //unit refers to modbus data of test
+    tModbusData.ptfnAsyncAccess = AsyncAccess;
+
+    //function under test, any range may be deferred without range check
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, Subscribe(eTABLE_HOLDING_REGISTERS, 0, 4, 0, 0, &m_iConnection));
+    CHECK_EQUAL(eILLEGAL_FUNCTION_CODE, aucResponse[DATA_OFFSET]);
+
+    tModbusData.ptfnIsAsyncRange = IsAsyncRange;
+
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, Subscribe(eTABLE_HOLDING_REGISTERS, 30, 4, 0, 0, &m_iConnection));
+    CHECK_EQUAL(eILLEGAL_FUNCTION_CODE, aucResponse[DATA_OFFSET]);
+    CHECK_EQUAL(0u, mbap_SubscriptionCount());
+
+    //in memory range is polled by submitting thread
+    CHECK_EQUAL(DATA_OFFSET + SUBSCRIPTION_HEADER_LEN + 8u,
+                Subscribe(eTABLE_HOLDING_REGISTERS, 0, 4, 0, 0, &m_iConnection));
+    CHECK_EQUAL(1u, mbap_SubscriptionCount());
+}
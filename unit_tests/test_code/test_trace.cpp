@@ -0,0 +1,134 @@
+#include "CppUTest/TestHarness.h"
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+
+
+extern "C"
+{
+    #include "mbap_conf.h"
+    #include "mbap.h"
+    #include "mbap_debug.h"
+    #include "mbap_trace.h"
+    #include "mbap_user.h"
+}
+
+#define MAX_RECORDS                      (MBT_CONF_TRACE_RING_SIZE + 16u)
+
+static TraceRecord_t m_atRecords[MAX_RECORDS];
+static uint32_t      m_ulNumOfRecords;
+
+static void StoreRecord(const TraceRecord_t *ptRecord)
+{
+    if (m_ulNumOfRecords < MAX_RECORDS)
+    {
+        m_atRecords[m_ulNumOfRecords] = *ptRecord;
+    }
+
+    m_ulNumOfRecords++;
+}
+
+static void IgnoreRecord(const TraceRecord_t *ptRecord)
+{
+}
+
+static void *RecordInThread(void *pvArg)
+{
+    mbap_TraceRecord(MBT_CONF_DEBUG_LEVEL_MSG, "thread %u %u\r\n", 1, 0);
+    mbap_TraceRecord(MBT_CONF_DEBUG_LEVEL_MSG, "thread %u %u\r\n", 2, 0);
+
+    return NULL;
+}
+
+TEST_GROUP(Trace)
+{
+    void setup()
+    {
+        //records of earlier tests
+        mbap_TraceDrain(IgnoreRecord);
+        m_ulNumOfRecords = 0;
+    }
+
+    void teardown()
+    {
+    }
+};
+
+TEST(Trace, RecordsAreDrainedInOrderTest)
+{
+    mbap_TraceRecord(MBT_CONF_DEBUG_LEVEL_WARNING, "first %u %u\r\n", 1, 2);
+    mbap_TraceRecord(MBT_CONF_DEBUG_LEVEL_MSG, "second %u %u\r\n", 3, 4);
+
+    //function under test
+    CHECK_EQUAL(2, mbap_TraceDrain(StoreRecord));
+
+    CHECK_EQUAL(2, m_ulNumOfRecords);
+    STRCMP_EQUAL("first %u %u\r\n", m_atRecords[0].pcMessage);
+    CHECK_EQUAL(MBT_CONF_DEBUG_LEVEL_WARNING, m_atRecords[0].ucLevel);
+    CHECK_EQUAL(2, m_atRecords[0].aulArgs[1]);
+    CHECK_EQUAL(3, m_atRecords[1].aulArgs[0]);
+    CHECK_TRUE(m_atRecords[1].ullTime >= m_atRecords[0].ullTime);
+    CHECK_EQUAL(0, mbap_TraceDrain(StoreRecord));
+}
+
+TEST(Trace, FullRingDropsRecordsTest)
+{
+    uint32_t ulDropped = mbap_TraceDropped();
+
+    for (uint32_t ulCount = 0; ulCount < MBT_CONF_TRACE_RING_SIZE + 10u; ulCount++)
+    {
+        mbap_TraceRecord(MBT_CONF_DEBUG_LEVEL_MSG, "record %u %u\r\n", ulCount, 0);
+    }
+
+    CHECK_EQUAL(10, mbap_TraceDropped() - ulDropped);
+    CHECK_EQUAL(MBT_CONF_TRACE_RING_SIZE, mbap_TraceDrain(StoreRecord));
+    CHECK_EQUAL(MBT_CONF_TRACE_RING_SIZE - 1u, m_atRecords[MBT_CONF_TRACE_RING_SIZE - 1u].aulArgs[0]);
+}
+
+TEST(Trace, DebugMessageOfRequestIsRecordedTest)
+{
+    uint8_t ucQuery[12]    = {0, 0, 0, 0, 0, 6, 77, 3, 0, 0, 0, 1};
+    uint8_t ucResponse[32] = {0};
+
+    mu_Init();
+    mbap_TraceDrain(IgnoreRecord);
+
+    //unknown unit id
+    CHECK_EQUAL(0, mbap_ProcessRequest(ucQuery, 12, ucResponse));
+
+    mbap_TraceDrain(StoreRecord);
+    CHECK_EQUAL(1, m_ulNumOfRecords);
+    CHECK_EQUAL(77, m_atRecords[0].aulArgs[0]);
+}
+
+TEST(Trace, ThreadsBeyondRingsDropRecordsTest)
+{
+    pthread_t tThread;
+    uint32_t  ulDropped = 0;
+
+    //ring of this thread is taken before all are used up
+    mbap_TraceRecord(MBT_CONF_DEBUG_LEVEL_MSG, "main %u %u\r\n", 0, 0);
+    mbap_TraceDrain(IgnoreRecord);
+
+    for (uint32_t ulCount = 0; ulCount < MBT_CONF_TRACE_THREADS; ulCount++)
+    {
+        CHECK_EQUAL(0, pthread_create(&tThread, NULL, RecordInThread, NULL));
+        pthread_join(tThread, NULL);
+    }
+
+    mbap_TraceDrain(IgnoreRecord);
+    ulDropped = mbap_TraceDropped();
+
+    //function under test, threads without ring drop every record
+    for (uint32_t ulCount = 0; ulCount < 4u; ulCount++)
+    {
+        CHECK_EQUAL(0, pthread_create(&tThread, NULL, RecordInThread, NULL));
+        pthread_join(tThread, NULL);
+    }
+
+    CHECK_EQUAL(8, mbap_TraceDropped() - ulDropped);
+    CHECK_EQUAL(0, mbap_TraceDrain(StoreRecord));
+    //threads with ring keep recording
+    mbap_TraceRecord(MBT_CONF_DEBUG_LEVEL_MSG, "main %u %u\r\n", 1, 0);
+    CHECK_EQUAL(1, mbap_TraceDrain(StoreRecord));
+}
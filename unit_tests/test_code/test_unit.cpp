@@ -0,0 +1,213 @@
+#include "CppUTest/TestHarness.h"
+#include <string.h>
+#include <stdio.h>
+
+
+extern "C"
+{
+    #include "mbap_conf.h"
+    #include "mbap.h"
+    #include "mbap_unit.h"
+    #include "mbap_user.h"
+    #include "mbap_change.h"
+}
+
+#define QUERY_SIZE_IN_BYTES              (255u)
+#define RESPONSE_SIZE_IN_BYTES           (255u)
+#define MBT_EXCEPTION_PACKET_LEN         (9u)
+//PDU Offset in response
+#define MBT_BYTE_COUNT_OFFSET            (8u)
+#define MBT_DATA_VALUES_OFFSET           (9u)
+#define MBAP_HEADER_LEN                  (7u)
+#define PROFILE_REGISTERS                (40u)
+#define PROFILE_BITS                     (40u)
+
+static int16_t m_asTemplateHoldingRegs[PROFILE_REGISTERS];
+static int16_t m_asTemplateInputRegs[PROFILE_REGISTERS];
+static uint8_t m_aucTemplateCoils[PROFILE_BITS / 8]    = {0x01, 0x00, 0x00, 0x00, 0x80};
+static int16_t m_asLowerLimit[PROFILE_REGISTERS];
+static int16_t m_asHigherLimit[PROFILE_REGISTERS];
+
+TEST_GROUP(Unit)
+{
+    uint8_t         *pucQuery    = NULL;
+    uint8_t         *pucResponse = NULL;
+    ModbusProfile_t tProfile;
+
+    void setup()
+    {
+        pucQuery     = (uint8_t*)calloc(QUERY_SIZE_IN_BYTES,  sizeof(uint8_t));
+        pucResponse  = (uint8_t*)calloc(RESPONSE_SIZE_IN_BYTES, sizeof(uint8_t));
+
+        for (uint8_t ucCount = 0; ucCount < PROFILE_REGISTERS; ucCount++)
+        {
+            m_asTemplateHoldingRegs[ucCount] = 100 + ucCount;
+            m_asTemplateInputRegs[ucCount]   = 200 + ucCount;
+            m_asLowerLimit[ucCount]          = 0;
+            m_asHigherLimit[ucCount]         = 1000;
+        }
+
+        memset(&tProfile, 0, sizeof(tProfile));
+        tProfile.tModbusData.usMaxHoldingRegisters        = PROFILE_REGISTERS;
+        tProfile.tModbusData.usMaxInputRegisters          = PROFILE_REGISTERS;
+        tProfile.tModbusData.usMaxCoils                   = PROFILE_BITS;
+        tProfile.tModbusData.usMaxDiscreteInputs          = PROFILE_BITS;
+        tProfile.tModbusData.psHoldingRegisterLowerLimit  = m_asLowerLimit;
+        tProfile.tModbusData.psHoldingRegisterHigherLimit = m_asHigherLimit;
+        tProfile.psHoldingRegisters                       = m_asTemplateHoldingRegs;
+        tProfile.psInputRegisters                         = m_asTemplateInputRegs;
+        tProfile.pucCoils                                 = m_aucTemplateCoils;
+
+        //Init modbus data
+        mu_Init();
+    }
+
+    void teardown()
+    {
+        free(pucQuery);
+        free(pucResponse);
+    }
+};
+
+TEST(Unit, ProfileUnitReadsTemplateTest)
+{
+    uint8_t ucQueryBuf[12] = {0, 0, 0, 0, 0, 6, 7, 3, 0, 20, 0, 2};
+
+    CHECK_TRUE(mbap_UnitAddProfile(0, 7, &tProfile));
+    memcpy(pucQuery, ucQueryBuf, 12);
+
+    //function under test
+    uint16_t usRecResponseLen = mbap_ProcessRequest(pucQuery, 12, pucResponse);
+
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 4, usRecResponseLen);
+    CHECK_EQUAL(0, pucResponse[MBT_DATA_VALUES_OFFSET]);
+    CHECK_EQUAL(120, pucResponse[MBT_DATA_VALUES_OFFSET + 1]);
+    CHECK_EQUAL(121, pucResponse[MBT_DATA_VALUES_OFFSET + 3]);
+    //reading shares template, no private page
+    CHECK_EQUAL(0, mbap_UnitPagesInUse());
+}
+
+TEST(Unit, WriteCopiesPageOnlyForWritingUnitTest)
+{
+    uint8_t ucWriteBuf[12] = {0, 0, 0, 0, 0, 6, 7, 6, 0, 3, 0x01, 0xF4};
+    uint8_t ucReadBuf[12]  = {0, 0, 0, 0, 0, 6, 8, 3, 0, 3, 0, 2};
+
+    CHECK_TRUE(mbap_UnitAddProfile(0, 7, &tProfile));
+    CHECK_TRUE(mbap_UnitAddProfile(0, 8, &tProfile));
+
+    memcpy(pucQuery, ucWriteBuf, 12);
+    CHECK_EQUAL(MBAP_HEADER_LEN + 5, mbap_ProcessRequest(pucQuery, 12, pucResponse));
+    CHECK_EQUAL(1, mbap_UnitPagesInUse());
+
+    //unit 8 still reads template value
+    memcpy(pucQuery, ucReadBuf, 12);
+    mbap_ProcessRequest(pucQuery, 12, pucResponse);
+    CHECK_EQUAL(103, pucResponse[MBT_DATA_VALUES_OFFSET + 1]);
+
+    //unit 7 reads written value and template value of same page
+    pucQuery[6] = 7;
+    mbap_ProcessRequest(pucQuery, 12, pucResponse);
+    CHECK_EQUAL(0x01, pucResponse[MBT_DATA_VALUES_OFFSET]);
+    CHECK_EQUAL(0xF4, pucResponse[MBT_DATA_VALUES_OFFSET + 1]);
+    CHECK_EQUAL(104, pucResponse[MBT_DATA_VALUES_OFFSET + 3]);
+}
+
+TEST(Unit, WriteChangesVersionOfWritingUnitOnlyTest)
+{
+    uint8_t ucWriteBuf[12] = {0, 0, 0, 0, 0, 6, 7, 6, 0, 3, 0x01, 0xF4};
+
+    CHECK_TRUE(mbap_UnitAddProfile(0, 7, &tProfile));
+    CHECK_TRUE(mbap_UnitAddProfile(0, 8, &tProfile));
+
+    const ModbusUnit_t *ptWriter = mbap_UnitFind(0, 7);
+    const ModbusUnit_t *ptOther  = mbap_UnitFind(0, 8);
+    uint32_t ulWriter = mbap_ChangeVersion(ptWriter, eTABLE_HOLDING_REGISTERS, 0, 4);
+    uint32_t ulOther  = mbap_ChangeVersion(ptOther, eTABLE_HOLDING_REGISTERS, 0, 4);
+    uint32_t ulShared = mbap_ChangeVersion(NULL, eTABLE_HOLDING_REGISTERS, 0, 4);
+
+    //function under test
+    memcpy(pucQuery, ucWriteBuf, 12);
+    CHECK_EQUAL(MBAP_HEADER_LEN + 5, mbap_ProcessRequest(pucQuery, 12, pucResponse));
+
+    CHECK_TRUE(ulWriter != mbap_ChangeVersion(ptWriter, eTABLE_HOLDING_REGISTERS, 0, 4));
+    CHECK_EQUAL(ulOther, mbap_ChangeVersion(ptOther, eTABLE_HOLDING_REGISTERS, 0, 4));
+    CHECK_EQUAL(ulShared, mbap_ChangeVersion(NULL, eTABLE_HOLDING_REGISTERS, 0, 4));
+}
+
+TEST(Unit, ReadOnlyRejectsWritesOfAllUnitsTest)
+{
+    uint8_t ucWriteBuf[12] = {0, 0, 0, 0, 0, 6, 7, 6, 0, 3, 0x01, 0xF4};
+    uint8_t ucReadBuf[12]  = {0, 0, 0, 0, 0, 6, 7, 3, 0, 3, 0, 1};
+
+    CHECK_TRUE(mbap_UnitAddProfile(0, 7, &tProfile));
+
+    //function under test
+    mu_SetReadOnly(true);
+    memcpy(pucQuery, ucWriteBuf, 12);
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, mbap_ProcessRequest(pucQuery, 12, pucResponse));
+    CHECK_EQUAL(eILLEGAL_FUNCTION_CODE, pucResponse[MBT_BYTE_COUNT_OFFSET]);
+    //units added before stay
+    memcpy(pucQuery, ucReadBuf, 12);
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 2, mbap_ProcessRequest(pucQuery, 12, pucResponse));
+    CHECK_EQUAL(103, pucResponse[MBT_DATA_VALUES_OFFSET + 1]);
+
+    mu_SetReadOnly(false);
+    memcpy(pucQuery, ucWriteBuf, 12);
+    CHECK_EQUAL(MBAP_HEADER_LEN + 5, mbap_ProcessRequest(pucQuery, 12, pucResponse));
+    CHECK_EQUAL(1, mbap_UnitPagesInUse());
+}
+
+TEST(Unit, WriteCoilsOfProfileUnitTest)
+{
+    uint8_t ucWriteBuf[12] = {0, 0, 0, 0, 0, 6, 7, 5, 0, 1, 0xFF, 0x00};
+    uint8_t ucReadBuf[12]  = {0, 0, 0, 0, 0, 6, 7, 1, 0, 0, 0, 3};
+
+    CHECK_TRUE(mbap_UnitAddProfile(0, 7, &tProfile));
+
+    memcpy(pucQuery, ucWriteBuf, 12);
+    CHECK_EQUAL(MBAP_HEADER_LEN + 5, mbap_ProcessRequest(pucQuery, 12, pucResponse));
+
+    memcpy(pucQuery, ucReadBuf, 12);
+    mbap_ProcessRequest(pucQuery, 12, pucResponse);
+    CHECK_EQUAL(1, pucResponse[MBT_BYTE_COUNT_OFFSET]);
+    CHECK_EQUAL(0x03, pucResponse[MBT_DATA_VALUES_OFFSET]);
+}
+
+TEST(Unit, ExtensionKeyRoutingTest)
+{
+    uint8_t ucQueryBuf[12] = {0, 0, 0, 0, 0, 6, 9, 4, 0, 0, 0, 1};
+
+    for (uint16_t usExtKey = 1; usExtKey <= 1000; usExtKey++)
+    {
+        CHECK_TRUE(mbap_UnitAddProfile(usExtKey, 9, &tProfile));
+    }
+
+    memcpy(pucQuery, ucQueryBuf, 12);
+
+    //unit 9 is only known behind extension keys
+    CHECK_EQUAL(0, mbap_ProcessRequest(pucQuery, 12, pucResponse));
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 2, mbap_ProcessUnitRequest(500, pucQuery, 12, pucResponse));
+    CHECK_EQUAL(200, pucResponse[MBT_DATA_VALUES_OFFSET + 1]);
+    CHECK_EQUAL(0, mbap_ProcessUnitRequest(1001, pucQuery, 12, pucResponse));
+}
+
+TEST(Unit, DuplicateUnitTest)
+{
+    CHECK_FALSE(mbap_UnitAddProfile(0, 1, &tProfile));
+    CHECK_TRUE(mbap_UnitAddProfile(3, 1, &tProfile));
+    CHECK_FALSE(mbap_UnitAddProfile(3, 1, &tProfile));
+}
+
+TEST(Unit, IllegalAddressInProfileUnitTest)
+{
+    uint8_t ucQueryBuf[12] = {0, 0, 0, 0, 0, 6, 7, 3, 0, 39, 0, 2};
+
+    CHECK_TRUE(mbap_UnitAddProfile(0, 7, &tProfile));
+    memcpy(pucQuery, ucQueryBuf, 12);
+
+    //function under test
+    uint16_t usRecResponseLen = mbap_ProcessRequest(pucQuery, 12, pucResponse);
+
+    CHECK_EQUAL(MBT_EXCEPTION_PACKET_LEN, usRecResponseLen);
+    CHECK_EQUAL(eILLEGAL_DATA_ADDRESS, pucResponse[MBT_BYTE_COUNT_OFFSET]);
+}
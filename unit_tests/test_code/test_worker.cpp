@@ -0,0 +1,308 @@
+#include "CppUTest/TestHarness.h"
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+
+
+extern "C"
+{
+    #include "mbap_conf.h"
+    #include "mbap.h"
+    #include "mbap_unit.h"
+    #include "mbap_user.h"
+    #include "worker.h"
+}
+
+#define MBAP_HEADER_LEN                  (7u)
+#define RESPONSE_SIZE_IN_BYTES           (260u)
+#define WORKER_UNIT_ID                   (4u)
+#define NUM_OF_WORKERS                   (2u)
+#define NUM_OF_REGISTERS                 (200u)
+//blocking user functions serve registers 0-99 only
+#define BLOCK_REGISTERS                  (100u)
+//reads of these registers wait until they are released
+#define HELD_ADDRESS_A                   (90u)
+#define HELD_ADDRESS_B                   (91u)
+#define MAX_REQUESTS                     (NUM_OF_WORKERS * WK_QUEUE_SIZE + 3u)
+#define WAIT_TIMEOUT_S                   (5)
+
+//! @brief Request of a client with its buffers
+typedef struct TestRequest
+{
+    ModbusRequest_t tRequest;
+    uint8_t         aucQuery[12];
+    uint8_t         aucResponse[RESPONSE_SIZE_IN_BYTES];
+} TestRequest_t;
+
+static pthread_mutex_t m_tLock      = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  m_tChanged   = PTHREAD_COND_INITIALIZER;
+static pthread_t       m_tServerThread;
+static uint32_t        m_ulNumOfHeld;
+static uint32_t        m_ulNumOfDone;
+static uint32_t        m_ulServerReads;
+static bool            m_bDoneByServer;
+static bool            m_abReleased[2];
+static ModbusData_t    m_tModbusData;
+static TestRequest_t   m_atRequests[MAX_REQUESTS];
+static int16_t         m_asLimits[NUM_OF_REGISTERS];
+static int16_t         m_asHigherLimits[NUM_OF_REGISTERS];
+
+static void ReadHoldingRegisters(uint16_t usStartAddress, uint16_t usNumOfData, uint8_t *pucRecBuf)
+{
+    pthread_mutex_lock(&m_tLock);
+
+    if (pthread_equal(pthread_self(), m_tServerThread))
+    {
+        m_ulServerReads++;
+    }
+    else if ((HELD_ADDRESS_A == usStartAddress) || (HELD_ADDRESS_B == usStartAddress))
+    {
+        //worker blocks like a slow bus read
+        m_ulNumOfHeld++;
+        pthread_cond_broadcast(&m_tChanged);
+
+        while (!m_abReleased[usStartAddress - HELD_ADDRESS_A])
+        {
+            pthread_cond_wait(&m_tChanged, &m_tLock);
+        }
+    }
+
+    pthread_mutex_unlock(&m_tLock);
+    memset(pucRecBuf, (uint8_t)usStartAddress, usNumOfData * 2u);
+}
+
+static void RequestDone(ModbusRequest_t *ptRequest)
+{
+    pthread_mutex_lock(&m_tLock);
+    m_ulNumOfDone++;
+    m_bDoneByServer = m_bDoneByServer || pthread_equal(pthread_self(), m_tServerThread);
+    pthread_cond_broadcast(&m_tChanged);
+    pthread_mutex_unlock(&m_tLock);
+}
+
+//
+//! @brief Wait until a counter of worker threads reaches a value
+//! @return true - value reached, false - timed out
+//
+static bool WaitFor(const uint32_t *pulCounter, uint32_t ulValue)
+{
+    struct timespec tDeadline;
+    bool            bReached = false;
+
+    clock_gettime(CLOCK_REALTIME, &tDeadline);
+    tDeadline.tv_sec += WAIT_TIMEOUT_S;
+
+    pthread_mutex_lock(&m_tLock);
+
+    while ((*pulCounter < ulValue) && (0 == pthread_cond_timedwait(&m_tChanged, &m_tLock, &tDeadline)))
+    {
+    }
+
+    bReached = (*pulCounter >= ulValue);
+    pthread_mutex_unlock(&m_tLock);
+
+    return bReached;
+}
+
+static void Release(uint16_t usAddress)
+{
+    pthread_mutex_lock(&m_tLock);
+    m_abReleased[usAddress - HELD_ADDRESS_A] = true;
+    pthread_cond_broadcast(&m_tChanged);
+    pthread_mutex_unlock(&m_tLock);
+}
+
+TEST_GROUP(Worker)
+{
+    uint16_t usNumOfRequests = 0;
+    uint32_t ulNumOfPending  = 0;
+
+    void setup()
+    {
+        static bool bStarted = false;
+
+        //pool threads live as long as the process
+        if (!bStarted)
+        {
+            CHECK_TRUE(wk_Init(NUM_OF_WORKERS));
+            CHECK_TRUE(wk_AddBlock(eTABLE_HOLDING_REGISTERS, 0, BLOCK_REGISTERS));
+            bStarted = true;
+        }
+
+        for (uint16_t usCount = 0; usCount < NUM_OF_REGISTERS; usCount++)
+        {
+            m_asLimits[usCount]       = INT16_MIN;
+            m_asHigherLimits[usCount] = INT16_MAX;
+        }
+
+        memset(&m_tModbusData, 0, sizeof(m_tModbusData));
+        m_tModbusData.usMaxHoldingRegisters        = NUM_OF_REGISTERS;
+        m_tModbusData.psHoldingRegisterLowerLimit  = m_asLimits;
+        m_tModbusData.psHoldingRegisterHigherLimit = m_asHigherLimits;
+        m_tModbusData.ptfnReadHoldingRegisters     = ReadHoldingRegisters;
+        m_tModbusData.ptfnAsyncAccess              = wk_AsyncAccess;
+        m_tModbusData.ptfnIsAsyncRange             = wk_IsAsyncRange;
+
+        m_tServerThread = pthread_self();
+        m_ulNumOfHeld   = 0;
+        m_ulNumOfDone   = 0;
+        m_ulServerReads = 0;
+        m_bDoneByServer = false;
+        m_abReleased[0] = false;
+        m_abReleased[1] = false;
+        usNumOfRequests = 0;
+        ulNumOfPending  = 0;
+
+        //Init modbus data
+        mu_Init();
+        mbap_UnitAdd(0, WORKER_UNIT_ID, &m_tModbusData);
+    }
+
+    void teardown()
+    {
+        //workers must be idle for next test
+        Release(HELD_ADDRESS_A);
+        Release(HELD_ADDRESS_B);
+        CHECK_TRUE(WaitFor(&m_ulNumOfDone, ulNumOfPending));
+    }
+
+    //
+    //! @brief Submit read of one holding register as the server thread does
+    //
+    uint16_t SubmitRead(uint16_t usAddress)
+    {
+        TestRequest_t *ptTest      = &m_atRequests[usNumOfRequests++];
+        uint8_t       aucQuery[12] = {0, (uint8_t)usNumOfRequests, 0, 0, 0, 6, WORKER_UNIT_ID, 3,
+                                      (uint8_t)(usAddress >> 8), (uint8_t)usAddress, 0, 1};
+
+        memcpy(ptTest->aucQuery, aucQuery, sizeof(aucQuery));
+        memset(&ptTest->tRequest, 0, sizeof(ptTest->tRequest));
+        ptTest->tRequest.pucQuery    = ptTest->aucQuery;
+        ptTest->tRequest.pucResponse = ptTest->aucResponse;
+        ptTest->tRequest.usQueryLen  = sizeof(aucQuery);
+        ptTest->tRequest.ptfnDone    = RequestDone;
+
+        if (MBAP_RESPONSE_PENDING != mbap_SubmitRequest(&ptTest->tRequest))
+        {
+            return ptTest->tRequest.usResponseLen;
+        }
+
+        ulNumOfPending++;
+
+        return MBAP_RESPONSE_PENDING;
+    }
+
+    //
+    //! @brief Submit read multiple ranges of two holding register ranges
+    //
+    uint16_t SubmitReadRanges(uint16_t usAddressA, uint16_t usAddressB)
+    {
+        TestRequest_t *ptTest      = &m_atRequests[usNumOfRequests++];
+        uint8_t       aucQuery[19] = {0, (uint8_t)usNumOfRequests, 0, 0, 0, 13, WORKER_UNIT_ID, 69, 2,
+                                      eTABLE_HOLDING_REGISTERS, (uint8_t)(usAddressA >> 8), (uint8_t)usAddressA, 0, 1,
+                                      eTABLE_HOLDING_REGISTERS, (uint8_t)(usAddressB >> 8), (uint8_t)usAddressB, 0, 1};
+
+        memset(&ptTest->tRequest, 0, sizeof(ptTest->tRequest));
+        ptTest->tRequest.pucQuery    = aucQuery;
+        ptTest->tRequest.pucResponse = ptTest->aucResponse;
+        ptTest->tRequest.usQueryLen  = sizeof(aucQuery);
+        ptTest->tRequest.ptfnDone    = RequestDone;
+
+        //ranges are never deferred, query may live on stack
+        CHECK(MBAP_RESPONSE_PENDING != mbap_SubmitRequest(&ptTest->tRequest));
+
+        return ptTest->tRequest.usResponseLen;
+    }
+};
+
+TEST(Worker, RequestOfDesignatedBlockIsOffloadedTest)
+{
+    //function under test
+    CHECK_EQUAL(MBAP_RESPONSE_PENDING, SubmitRead(10));
+
+    CHECK_TRUE(WaitFor(&m_ulNumOfDone, 1));
+    CHECK_EQUAL(0, m_ulServerReads);
+    CHECK_FALSE(m_bDoneByServer);
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 2, m_atRequests[0].tRequest.usResponseLen);
+    CHECK_EQUAL(1, m_atRequests[0].aucResponse[1]);
+    CHECK_EQUAL(10, m_atRequests[0].aucResponse[MBAP_HEADER_LEN + 2]);
+}
+
+TEST(Worker, RequestOutsideBlocksCompletesInServerThreadTest)
+{
+    //function under test, no context switch for in memory data
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 2, SubmitRead(BLOCK_REGISTERS + 5u));
+
+    CHECK_EQUAL(1, m_ulServerReads);
+    CHECK_EQUAL(0, m_ulNumOfDone);
+    CHECK_EQUAL(BLOCK_REGISTERS + 5u, m_atRequests[0].aucResponse[MBAP_HEADER_LEN + 2]);
+}
+
+TEST(Worker, IdleWorkerStealsRequestsOfBlockedWorkerTest)
+{
+    //each worker blocks in a user function
+    CHECK_EQUAL(MBAP_RESPONSE_PENDING, SubmitRead(HELD_ADDRESS_A));
+    CHECK_EQUAL(MBAP_RESPONSE_PENDING, SubmitRead(HELD_ADDRESS_B));
+    CHECK_TRUE(WaitFor(&m_ulNumOfHeld, NUM_OF_WORKERS));
+
+    //round robin queues requests to both workers
+    for (uint16_t usCount = 0; usCount < 4u; usCount++)
+    {
+        CHECK_EQUAL(MBAP_RESPONSE_PENDING, SubmitRead(usCount));
+    }
+
+    //function under test, released worker serves queue of blocked one as well
+    Release(HELD_ADDRESS_A);
+    CHECK_TRUE(WaitFor(&m_ulNumOfDone, 5));
+    CHECK_EQUAL(5, m_ulNumOfDone);
+
+    Release(HELD_ADDRESS_B);
+    CHECK_TRUE(WaitFor(&m_ulNumOfDone, 6));
+    CHECK_EQUAL(0, m_ulServerReads);
+}
+
+TEST(Worker, FullQueuesFallBackToServerThreadTest)
+{
+    uint16_t usCount = 0;
+
+    CHECK_EQUAL(MBAP_RESPONSE_PENDING, SubmitRead(HELD_ADDRESS_A));
+    CHECK_EQUAL(MBAP_RESPONSE_PENDING, SubmitRead(HELD_ADDRESS_B));
+    CHECK_TRUE(WaitFor(&m_ulNumOfHeld, NUM_OF_WORKERS));
+
+    for (usCount = 0; usCount < NUM_OF_WORKERS * WK_QUEUE_SIZE; usCount++)
+    {
+        CHECK_EQUAL(MBAP_RESPONSE_PENDING, SubmitRead(usCount % (BLOCK_REGISTERS / 2u)));
+    }
+
+    //function under test, every queue is full
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 2, SubmitRead(20));
+    CHECK_EQUAL(1, m_ulServerReads);
+    CHECK_EQUAL(20, m_atRequests[usNumOfRequests - 1u].aucResponse[MBAP_HEADER_LEN + 2]);
+
+    Release(HELD_ADDRESS_A);
+    Release(HELD_ADDRESS_B);
+    CHECK_TRUE(WaitFor(&m_ulNumOfDone, NUM_OF_WORKERS * WK_QUEUE_SIZE + 2u));
+    CHECK_FALSE(m_bDoneByServer);
+}
+
+TEST(Worker, ReadMultipleRangesInMemoryServedByServerThreadTest)
+{
+    //function under test
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2 + 2 * 3, SubmitReadRanges(BLOCK_REGISTERS + 1u, BLOCK_REGISTERS + 2u));
+
+    CHECK_EQUAL(2, m_ulServerReads);
+    CHECK_EQUAL(0, m_ulNumOfDone);
+    CHECK_EQUAL(BLOCK_REGISTERS + 1u, m_atRequests[0].aucResponse[MBAP_HEADER_LEN + 3]);
+    CHECK_EQUAL(BLOCK_REGISTERS + 2u, m_atRequests[0].aucResponse[MBAP_HEADER_LEN + 6]);
+}
+
+TEST(Worker, ReadMultipleRangesOfDesignatedBlockRejectedTest)
+{
+    //function under test, second range would be run by a worker
+    CHECK_EQUAL(MBAP_HEADER_LEN + 2, SubmitReadRanges(BLOCK_REGISTERS + 1u, 10));
+
+    CHECK_EQUAL(0x80 | 69, m_atRequests[0].aucResponse[MBAP_HEADER_LEN]);
+    CHECK_EQUAL(eILLEGAL_FUNCTION_CODE, m_atRequests[0].aucResponse[MBAP_HEADER_LEN + 1]);
+    CHECK_EQUAL(0, m_ulNumOfDone);
+}